@@ -0,0 +1,187 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <graphics/vec2.h>
+#include <graphics/vec3.h>
+#include "sw-subsystem.h"
+
+static void copy_vertices(struct gs_vertex_buffer *vb,
+			  const struct gs_vb_data *data)
+{
+	size_t num = data->num;
+
+	if (data->points) {
+		da_resize(vb->points, num);
+		memcpy(vb->points.array, data->points,
+		       num * sizeof(struct vec3));
+	}
+
+	if (data->colors) {
+		da_resize(vb->colors, num);
+		memcpy(vb->colors.array, data->colors, num * sizeof(uint32_t));
+	}
+
+	/* only the first texture coordinate set is ever sampled */
+	if (data->num_tex && data->tvarray[0].array) {
+		const float *uv = data->tvarray[0].array;
+		size_t width = data->tvarray[0].width;
+
+		da_resize(vb->uvs, num);
+		for (size_t i = 0; i < num; i++)
+			vec2_set(vb->uvs.array + i, uv[i * width],
+				 width > 1 ? uv[i * width + 1] : 0.0f);
+	}
+
+	vb->num = num;
+}
+
+gs_vertbuffer_t *device_vertexbuffer_create(gs_device_t *device,
+					    struct gs_vb_data *data,
+					    uint32_t flags)
+{
+	struct gs_vertex_buffer *vb = bzalloc(sizeof(struct gs_vertex_buffer));
+	vb->device = device;
+	vb->data = data;
+	vb->dynamic = flags & GS_DYNAMIC;
+
+	copy_vertices(vb, data);
+
+	if (!vb->dynamic) {
+		gs_vbdata_destroy(vb->data);
+		vb->data = NULL;
+	}
+
+	return vb;
+}
+
+void gs_vertexbuffer_destroy(gs_vertbuffer_t *vb)
+{
+	if (vb) {
+		if (vb->device->cur_vertex_buffer == vb)
+			vb->device->cur_vertex_buffer = NULL;
+
+		da_free(vb->points);
+		da_free(vb->colors);
+		da_free(vb->uvs);
+		gs_vbdata_destroy(vb->data);
+
+		bfree(vb);
+	}
+}
+
+static inline void gs_vertexbuffer_flush_internal(gs_vertbuffer_t *vb,
+						  const struct gs_vb_data *data)
+{
+	if (!vb->dynamic) {
+		blog(LOG_ERROR, "vertex buffer is not dynamic");
+		blog(LOG_ERROR, "gs_vertexbuffer_flush (software) failed");
+		return;
+	}
+
+	copy_vertices(vb, data);
+}
+
+void gs_vertexbuffer_flush(gs_vertbuffer_t *vb)
+{
+	gs_vertexbuffer_flush_internal(vb, vb->data);
+}
+
+void gs_vertexbuffer_flush_direct(gs_vertbuffer_t *vb,
+				  const struct gs_vb_data *data)
+{
+	gs_vertexbuffer_flush_internal(vb, data);
+}
+
+struct gs_vb_data *gs_vertexbuffer_get_data(const gs_vertbuffer_t *vb)
+{
+	return vb->data;
+}
+
+gs_indexbuffer_t *device_indexbuffer_create(gs_device_t *device,
+					    enum gs_index_type type,
+					    void *indices, size_t num,
+					    uint32_t flags)
+{
+	struct gs_index_buffer *ib = bzalloc(sizeof(struct gs_index_buffer));
+	size_t width = type == GS_UNSIGNED_LONG ? 4 : 2;
+
+	ib->device = device;
+	ib->data = indices;
+	ib->dynamic = flags & GS_DYNAMIC;
+	ib->num = num;
+	ib->width = width;
+	ib->type = type;
+
+	da_resize(ib->indices, width * num);
+	memcpy(ib->indices.array, indices, width * num);
+
+	if (!ib->dynamic) {
+		bfree(ib->data);
+		ib->data = NULL;
+	}
+
+	return ib;
+}
+
+void gs_indexbuffer_destroy(gs_indexbuffer_t *ib)
+{
+	if (ib) {
+		if (ib->device->cur_index_buffer == ib)
+			ib->device->cur_index_buffer = NULL;
+
+		da_free(ib->indices);
+		bfree(ib->data);
+		bfree(ib);
+	}
+}
+
+static inline void gs_indexbuffer_flush_internal(gs_indexbuffer_t *ib,
+						 const void *data)
+{
+	if (!ib->dynamic) {
+		blog(LOG_ERROR, "Index buffer is not dynamic");
+		blog(LOG_ERROR, "gs_indexbuffer_flush (software) failed");
+		return;
+	}
+
+	memcpy(ib->indices.array, data, ib->width * ib->num);
+}
+
+void gs_indexbuffer_flush(gs_indexbuffer_t *ib)
+{
+	gs_indexbuffer_flush_internal(ib, ib->data);
+}
+
+void gs_indexbuffer_flush_direct(gs_indexbuffer_t *ib, const void *data)
+{
+	gs_indexbuffer_flush_internal(ib, data);
+}
+
+void *gs_indexbuffer_get_data(const gs_indexbuffer_t *ib)
+{
+	return ib->data;
+}
+
+size_t gs_indexbuffer_get_num_indices(const gs_indexbuffer_t *ib)
+{
+	return ib->num;
+}
+
+enum gs_index_type gs_indexbuffer_get_type(const gs_indexbuffer_t *ib)
+{
+	return ib->type;
+}
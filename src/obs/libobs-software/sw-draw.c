@@ -0,0 +1,438 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include <util/base.h>
+#include <graphics/vec2.h>
+#include <graphics/vec3.h>
+#include <graphics/vec4.h>
+#include "sw-subsystem.h"
+
+struct sw_vertex {
+	float x, y;
+	struct vec2 uv;
+	struct vec4 color;
+};
+
+/* everything a triangle needs that stays the same for the whole draw */
+struct sw_raster {
+	gs_device_t *device;
+	struct gs_texture *target;
+	struct gs_texture *image;
+	struct gs_sampler_state *sampler;
+	struct vec4 color;
+	bool has_vertex_colors;
+
+	int min_x, min_y, max_x, max_y;
+};
+
+void device_clear(gs_device_t *device, uint32_t clear_flags,
+		  const struct vec4 *color, float depth, uint8_t stencil)
+{
+	struct gs_texture *target = device->cur_render_target;
+
+	if (!target && device->cur_swap)
+		target = device->cur_swap->target;
+
+	if ((clear_flags & GS_CLEAR_COLOR) != 0 && target &&
+	    sw_format_supported(target->format)) {
+		sw_set_pixel(target, 0, 0, color);
+
+		/* fill the first row, then copy it down */
+		size_t pixel_size = target->bpp / 8;
+		for (uint32_t x = 1; x < target->width; x++)
+			memcpy(target->data + x * pixel_size, target->data,
+			       pixel_size);
+		for (uint32_t y = 1; y < target->height; y++)
+			memcpy(target->data + y * target->linesize,
+			       target->data, target->linesize);
+	}
+
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(stencil);
+}
+
+static inline float wrap_coord(float val, enum gs_address_mode mode)
+{
+	if (mode == GS_ADDRESS_WRAP)
+		return val - floorf(val);
+	if (val < 0.0f)
+		return 0.0f;
+	if (val > 1.0f)
+		return 1.0f;
+	return val;
+}
+
+static inline uint32_t clamp_texel(int val, uint32_t size)
+{
+	if (val < 0)
+		return 0;
+	if ((uint32_t)val >= size)
+		return size - 1;
+	return (uint32_t)val;
+}
+
+static inline void lerp(struct vec4 *dst, const struct vec4 *a,
+			const struct vec4 *b, float t)
+{
+	struct vec4 diff;
+	vec4_sub(&diff, b, a);
+	vec4_mulf(&diff, &diff, t);
+	vec4_add(dst, a, &diff);
+}
+
+static void sample(const struct sw_raster *r, const struct vec2 *uv,
+		   struct vec4 *out)
+{
+	const struct gs_texture *tex = r->image;
+	const struct gs_sampler_info *info = &r->sampler->info;
+	float u = wrap_coord(uv->x, info->address_u) * (float)tex->width;
+	float v = wrap_coord(uv->y, info->address_v) * (float)tex->height;
+
+	if (info->filter == GS_FILTER_POINT) {
+		sw_get_pixel(tex, clamp_texel((int)u, tex->width),
+			     clamp_texel((int)v, tex->height), out);
+		return;
+	}
+
+	struct vec4 c00, c10, c01, c11, top, bottom;
+	float fu = u - 0.5f;
+	float fv = v - 0.5f;
+	int x = (int)floorf(fu);
+	int y = (int)floorf(fv);
+	float tx = fu - (float)x;
+	float ty = fv - (float)y;
+
+	uint32_t x0 = clamp_texel(x, tex->width);
+	uint32_t x1 = clamp_texel(x + 1, tex->width);
+	uint32_t y0 = clamp_texel(y, tex->height);
+	uint32_t y1 = clamp_texel(y + 1, tex->height);
+
+	sw_get_pixel(tex, x0, y0, &c00);
+	sw_get_pixel(tex, x1, y0, &c10);
+	sw_get_pixel(tex, x0, y1, &c01);
+	sw_get_pixel(tex, x1, y1, &c11);
+
+	lerp(&top, &c00, &c10, tx);
+	lerp(&bottom, &c01, &c11, tx);
+	lerp(out, &top, &bottom, ty);
+}
+
+static inline float blend_factor(enum gs_blend_type type, float src_val,
+				 float dst_val, float src_a, float dst_a)
+{
+	switch (type) {
+	case GS_BLEND_ZERO:
+		return 0.0f;
+	case GS_BLEND_ONE:
+		return 1.0f;
+	case GS_BLEND_SRCCOLOR:
+		return src_val;
+	case GS_BLEND_INVSRCCOLOR:
+		return 1.0f - src_val;
+	case GS_BLEND_SRCALPHA:
+		return src_a;
+	case GS_BLEND_INVSRCALPHA:
+		return 1.0f - src_a;
+	case GS_BLEND_DSTCOLOR:
+		return dst_val;
+	case GS_BLEND_INVDSTCOLOR:
+		return 1.0f - dst_val;
+	case GS_BLEND_DSTALPHA:
+		return dst_a;
+	case GS_BLEND_INVDSTALPHA:
+		return 1.0f - dst_a;
+	case GS_BLEND_SRCALPHASAT:
+		return fminf(src_a, 1.0f - dst_a);
+	}
+
+	return 1.0f;
+}
+
+static void write_pixel(const struct sw_raster *r, uint32_t x, uint32_t y,
+			const struct vec4 *src)
+{
+	gs_device_t *device = r->device;
+	const struct sw_blend_state *blend = &device->blend;
+	struct vec4 dst, out;
+
+	if (!blend->enabled && device->write_red && device->write_green &&
+	    device->write_blue && device->write_alpha) {
+		sw_set_pixel(r->target, x, y, src);
+		return;
+	}
+
+	sw_get_pixel(r->target, x, y, &dst);
+
+	if (blend->enabled) {
+		for (size_t i = 0; i < 3; i++) {
+			float s = blend_factor(blend->src_c, src->ptr[i],
+					       dst.ptr[i], src->w, dst.w);
+			float d = blend_factor(blend->dest_c, src->ptr[i],
+					       dst.ptr[i], src->w, dst.w);
+			out.ptr[i] = src->ptr[i] * s + dst.ptr[i] * d;
+		}
+
+		out.w = src->w * blend_factor(blend->src_a, src->w, dst.w,
+					      src->w, dst.w) +
+			dst.w * blend_factor(blend->dest_a, src->w, dst.w,
+					     src->w, dst.w);
+	} else {
+		out = *src;
+	}
+
+	if (!device->write_red)
+		out.x = dst.x;
+	if (!device->write_green)
+		out.y = dst.y;
+	if (!device->write_blue)
+		out.z = dst.z;
+	if (!device->write_alpha)
+		out.w = dst.w;
+
+	sw_set_pixel(r->target, x, y, &out);
+}
+
+static inline float edge(const struct sw_vertex *a, const struct sw_vertex *b,
+			 float x, float y)
+{
+	return (b->x - a->x) * (y - a->y) - (b->y - a->y) * (x - a->x);
+}
+
+/* attributes are interpolated linearly in screen space, which is exact for
+ * the 2D quads libobs draws */
+static void rasterize_triangle(struct sw_raster *r, const struct sw_vertex *v0,
+			       const struct sw_vertex *v1,
+			       const struct sw_vertex *v2)
+{
+	float area = edge(v0, v1, v2->x, v2->y);
+	if (fabsf(area) < 1e-8f)
+		return;
+
+	int min_x = (int)floorf(fminf(v0->x, fminf(v1->x, v2->x)));
+	int min_y = (int)floorf(fminf(v0->y, fminf(v1->y, v2->y)));
+	int max_x = (int)ceilf(fmaxf(v0->x, fmaxf(v1->x, v2->x)));
+	int max_y = (int)ceilf(fmaxf(v0->y, fmaxf(v1->y, v2->y)));
+
+	if (min_x < r->min_x)
+		min_x = r->min_x;
+	if (min_y < r->min_y)
+		min_y = r->min_y;
+	if (max_x > r->max_x)
+		max_x = r->max_x;
+	if (max_y > r->max_y)
+		max_y = r->max_y;
+
+	r->device->triangles++;
+
+	float inv_area = 1.0f / area;
+
+	for (int y = min_y; y < max_y; y++) {
+		float py = (float)y + 0.5f;
+
+		for (int x = min_x; x < max_x; x++) {
+			float px = (float)x + 0.5f;
+			float w0 = edge(v1, v2, px, py) * inv_area;
+			float w1 = edge(v2, v0, px, py) * inv_area;
+			float w2 = edge(v0, v1, px, py) * inv_area;
+			struct vec4 color;
+
+			if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+				continue;
+
+			if (r->image) {
+				struct vec2 uv;
+				uv.x = v0->uv.x * w0 + v1->uv.x * w1 +
+				       v2->uv.x * w2;
+				uv.y = v0->uv.y * w0 + v1->uv.y * w1 +
+				       v2->uv.y * w2;
+				sample(r, &uv, &color);
+				vec4_mul(&color, &color, &r->color);
+			} else {
+				color = r->color;
+			}
+
+			if (r->has_vertex_colors) {
+				struct vec4 vc, tmp;
+				vec4_mulf(&vc, &v0->color, w0);
+				vec4_mulf(&tmp, &v1->color, w1);
+				vec4_add(&vc, &vc, &tmp);
+				vec4_mulf(&tmp, &v2->color, w2);
+				vec4_add(&vc, &vc, &tmp);
+				vec4_mul(&color, &color, &vc);
+			}
+
+			write_pixel(r, (uint32_t)x, (uint32_t)y, &color);
+			r->device->pixels++;
+		}
+	}
+}
+
+static inline void unpack_color(uint32_t color, struct vec4 *out)
+{
+	vec4_set(out, (float)(color & 0xFF) / 255.0f,
+		 (float)((color >> 8) & 0xFF) / 255.0f,
+		 (float)((color >> 16) & 0xFF) / 255.0f,
+		 (float)(color >> 24) / 255.0f);
+}
+
+static void transform_vertex(const struct sw_raster *r, uint32_t idx,
+			     struct sw_vertex *out)
+{
+	gs_device_t *device = r->device;
+	struct gs_vertex_buffer *vb = device->cur_vertex_buffer;
+	const struct vec3 *point = vb->points.array + idx;
+	struct vec4 pos;
+
+	vec4_set(&pos, point->x, point->y, point->z, 1.0f);
+	vec4_transform(&pos, &pos, &device->cur_viewproj);
+
+	if (fabsf(pos.w) > 1e-8f) {
+		pos.x /= pos.w;
+		pos.y /= pos.w;
+	}
+
+	out->x = (float)device->viewport.x +
+		 (pos.x + 1.0f) * 0.5f * (float)device->viewport.cx;
+	out->y = (float)device->viewport.y +
+		 (1.0f - pos.y) * 0.5f * (float)device->viewport.cy;
+
+	if (idx < vb->uvs.num)
+		out->uv = vb->uvs.array[idx];
+	else
+		vec2_zero(&out->uv);
+
+	if (idx < vb->colors.num)
+		unpack_color(vb->colors.array[idx], &out->color);
+	else
+		vec4_set(&out->color, 1.0f, 1.0f, 1.0f, 1.0f);
+}
+
+static inline uint32_t get_index(const struct gs_index_buffer *ib, size_t i)
+{
+	if (ib->type == GS_UNSIGNED_LONG)
+		return ((const uint32_t *)ib->indices.array)[i];
+	return ((const uint16_t *)ib->indices.array)[i];
+}
+
+static void init_raster(gs_device_t *device, struct sw_raster *r)
+{
+	struct gs_shader *ps = device->cur_pixel_shader;
+
+	memset(r, 0, sizeof(*r));
+	r->device = device;
+	r->target = device->cur_render_target;
+	vec4_set(&r->color, 1.0f, 1.0f, 1.0f, 1.0f);
+
+	if (ps && ps->image && ps->image->texture) {
+		struct gs_texture *image = ps->image->texture;
+
+		if (sw_format_supported(image->format))
+			r->image = image;
+
+		r->sampler = ps->image->next_sampler;
+		if (!r->sampler && ps->samplers.num)
+			r->sampler = ps->samplers.array[0];
+		if (!r->sampler)
+			r->sampler = &device->default_sampler;
+	}
+
+	if (ps && ps->color &&
+	    ps->color->cur_value.num == sizeof(struct vec4))
+		memcpy(r->color.ptr, ps->color->cur_value.array,
+		       sizeof(struct vec4));
+
+	r->has_vertex_colors = device->cur_vertex_buffer->colors.num > 0;
+
+	r->min_x = device->viewport.x > 0 ? device->viewport.x : 0;
+	r->min_y = device->viewport.y > 0 ? device->viewport.y : 0;
+	r->max_x = device->viewport.x + device->viewport.cx;
+	r->max_y = device->viewport.y + device->viewport.cy;
+
+	if (device->scissor_enabled) {
+		const struct gs_rect *s = &device->scissor;
+		if (r->min_x < s->x)
+			r->min_x = s->x;
+		if (r->min_y < s->y)
+			r->min_y = s->y;
+		if (r->max_x > s->x + s->cx)
+			r->max_x = s->x + s->cx;
+		if (r->max_y > s->y + s->cy)
+			r->max_y = s->y + s->cy;
+	}
+
+	if (r->max_x > (int)r->target->width)
+		r->max_x = (int)r->target->width;
+	if (r->max_y > (int)r->target->height)
+		r->max_y = (int)r->target->height;
+}
+
+void sw_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+	     uint32_t start_vert, uint32_t num_verts)
+{
+	struct gs_vertex_buffer *vb = device->cur_vertex_buffer;
+	struct gs_index_buffer *ib = device->cur_index_buffer;
+	struct gs_texture *target = device->cur_render_target;
+	struct sw_raster r;
+	size_t count;
+
+	if (!target && device->cur_swap)
+		target = device->cur_render_target = device->cur_swap->target;
+
+	if (!vb) {
+		blog(LOG_ERROR, "device_draw (software): No vertex buffer "
+				"specified");
+		return;
+	}
+
+	device->draws++;
+
+	/* points and lines are only used for editing aids */
+	if (!target || !sw_format_supported(target->format) ||
+	    (draw_mode != GS_TRIS && draw_mode != GS_TRISTRIP)) {
+		device->skipped_draws++;
+		return;
+	}
+
+	count = num_verts ? num_verts : (ib ? ib->num : vb->num);
+	if (ib && start_vert + count > ib->num)
+		count = start_vert < ib->num ? ib->num - start_vert : 0;
+
+	init_raster(device, &r);
+	if (r.min_x >= r.max_x || r.min_y >= r.max_y)
+		return;
+
+	size_t step = draw_mode == GS_TRIS ? 3 : 1;
+
+	for (size_t i = 0; i + 2 < count; i += step) {
+		struct sw_vertex v[3];
+		bool valid = true;
+
+		for (size_t j = 0; j < 3; j++) {
+			size_t pos = start_vert + i + j;
+			uint32_t idx = ib ? get_index(ib, pos) : (uint32_t)pos;
+
+			if (idx >= vb->points.num) {
+				valid = false;
+				break;
+			}
+
+			transform_vertex(&r, idx, v + j);
+		}
+
+		if (valid)
+			rasterize_triangle(&r, v, v + 1, v + 2);
+	}
+}
@@ -0,0 +1,654 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <inttypes.h>
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <graphics/vec4.h>
+#include "sw-subsystem.h"
+
+const char *device_get_name(void)
+{
+	return "Software";
+}
+
+int device_get_type(void)
+{
+	return GS_DEVICE_SOFTWARE;
+}
+
+const char *device_preprocessor_name(void)
+{
+	return "_SOFTWARE";
+}
+
+int device_create(gs_device_t **p_device, uint32_t adapter,
+		  void (*callback)(bool render_working))
+{
+	struct gs_device *device = bzalloc(sizeof(struct gs_device));
+
+	device->default_sampler.device = device;
+	device->default_sampler.info.filter = GS_FILTER_LINEAR;
+	device->default_sampler.info.address_u = GS_ADDRESS_CLAMP;
+	device->default_sampler.info.address_v = GS_ADDRESS_CLAMP;
+	device->default_sampler.info.address_w = GS_ADDRESS_CLAMP;
+	device->default_sampler.info.max_anisotropy = 1;
+
+	device->blend.enabled = true;
+	device->blend.src_c = GS_BLEND_SRCALPHA;
+	device->blend.dest_c = GS_BLEND_INVSRCALPHA;
+	device->blend.src_a = GS_BLEND_ONE;
+	device->blend.dest_a = GS_BLEND_INVSRCALPHA;
+	device->write_red = device->write_green = true;
+	device->write_blue = device->write_alpha = true;
+	device->cull_mode = GS_NEITHER;
+
+	matrix4_identity(&device->cur_proj);
+	matrix4_identity(&device->cur_view);
+	matrix4_identity(&device->cur_viewproj);
+
+	blog(LOG_INFO, "---------------------------------");
+	blog(LOG_INFO, "Initializing software graphics...");
+	blog(LOG_INFO, "Rendering on the CPU, shaders are replaced by a "
+		       "fixed function pipeline");
+
+	*p_device = device;
+
+	UNUSED_PARAMETER(adapter);
+	UNUSED_PARAMETER(callback);
+	return GS_SUCCESS;
+}
+
+void device_rebuild(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_destroy(gs_device_t *device)
+{
+	if (!device)
+		return;
+
+	blog(LOG_INFO,
+	     "Software graphics: %" PRIu64 " draws (%" PRIu64 " skipped), "
+	     "%" PRIu64 " triangles, %" PRIu64 " pixels",
+	     device->draws, device->skipped_draws, device->triangles,
+	     device->pixels);
+
+	da_free(device->proj_stack);
+	bfree(device);
+}
+
+void device_enter_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_leave_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void *device_get_device_obj(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+	return NULL;
+}
+
+gs_swapchain_t *device_swapchain_create(gs_device_t *device,
+					const struct gs_init_data *info)
+{
+	struct gs_swap_chain *swap = bzalloc(sizeof(struct gs_swap_chain));
+
+	swap->device = device;
+	swap->info = *info;
+	swap->target = device_texture_create(device, info->cx, info->cy,
+					     info->format, 1, NULL,
+					     GS_RENDER_TARGET);
+	if (!swap->target) {
+		bfree(swap);
+		return NULL;
+	}
+
+	return swap;
+}
+
+void gs_swapchain_destroy(gs_swapchain_t *swapchain)
+{
+	if (!swapchain)
+		return;
+
+	if (swapchain->device->cur_swap == swapchain)
+		device_load_swapchain(swapchain->device, NULL);
+
+	gs_texture_destroy(swapchain->target);
+	bfree(swapchain);
+}
+
+void device_resize(gs_device_t *device, uint32_t cx, uint32_t cy)
+{
+	struct gs_swap_chain *swap = device->cur_swap;
+
+	if (!swap) {
+		blog(LOG_WARNING, "device_resize (software): No active swap");
+		return;
+	}
+
+	gs_texture_destroy(swap->target);
+	swap->info.cx = cx;
+	swap->info.cy = cy;
+	swap->target = device_texture_create(device, cx, cy, swap->info.format,
+					     1, NULL, GS_RENDER_TARGET);
+}
+
+void device_get_size(const gs_device_t *device, uint32_t *cx, uint32_t *cy)
+{
+	if (device->cur_swap) {
+		*cx = device->cur_swap->info.cx;
+		*cy = device->cur_swap->info.cy;
+	} else {
+		*cx = 0;
+		*cy = 0;
+	}
+}
+
+uint32_t device_get_width(const gs_device_t *device)
+{
+	return device->cur_swap ? device->cur_swap->info.cx : 0;
+}
+
+uint32_t device_get_height(const gs_device_t *device)
+{
+	return device->cur_swap ? device->cur_swap->info.cy : 0;
+}
+
+gs_samplerstate_t *device_samplerstate_create(gs_device_t *device,
+					      const struct gs_sampler_info *info)
+{
+	struct gs_sampler_state *sampler =
+		bzalloc(sizeof(struct gs_sampler_state));
+
+	sampler->device = device;
+	sampler->info = *info;
+	return sampler;
+}
+
+void gs_samplerstate_destroy(gs_samplerstate_t *samplerstate)
+{
+	if (!samplerstate)
+		return;
+
+	for (size_t i = 0; i < MAX_TEXTURES; i++) {
+		if (samplerstate->device->cur_samplers[i] == samplerstate)
+			samplerstate->device->cur_samplers[i] = NULL;
+	}
+
+	bfree(samplerstate);
+}
+
+gs_timer_t *device_timer_create(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+	return bzalloc(sizeof(struct gs_timer));
+}
+
+gs_timer_range_t *device_timer_range_create(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+	return bzalloc(sizeof(struct gs_timer_range));
+}
+
+void gs_timer_destroy(gs_timer_t *timer)
+{
+	bfree(timer);
+}
+
+void gs_timer_begin(gs_timer_t *timer)
+{
+	timer->begin = os_gettime_ns();
+}
+
+void gs_timer_end(gs_timer_t *timer)
+{
+	timer->end = os_gettime_ns();
+}
+
+/* everything happens synchronously, so the timers measure CPU time */
+bool gs_timer_get_data(gs_timer_t *timer, uint64_t *ticks)
+{
+	if (timer->end < timer->begin)
+		return false;
+
+	*ticks = timer->end - timer->begin;
+	return true;
+}
+
+void gs_timer_range_destroy(gs_timer_range_t *range)
+{
+	bfree(range);
+}
+
+void gs_timer_range_begin(gs_timer_range_t *range)
+{
+	range->active = true;
+}
+
+void gs_timer_range_end(gs_timer_range_t *range)
+{
+	range->active = false;
+}
+
+bool gs_timer_range_get_data(gs_timer_range_t *range, bool *disjoint,
+			     uint64_t *frequency)
+{
+	*disjoint = false;
+	*frequency = 1000000000;
+
+	UNUSED_PARAMETER(range);
+	return true;
+}
+
+void device_load_vertexbuffer(gs_device_t *device, gs_vertbuffer_t *vb)
+{
+	device->cur_vertex_buffer = vb;
+}
+
+void device_load_indexbuffer(gs_device_t *device, gs_indexbuffer_t *ib)
+{
+	device->cur_index_buffer = ib;
+}
+
+void device_load_texture(gs_device_t *device, gs_texture_t *tex, int unit)
+{
+	if (unit < 0 || unit >= MAX_TEXTURES)
+		return;
+
+	device->cur_textures[unit] = tex;
+}
+
+void device_load_samplerstate(gs_device_t *device, gs_samplerstate_t *ss,
+			      int unit)
+{
+	if (unit < 0 || unit >= MAX_TEXTURES)
+		return;
+
+	device->cur_samplers[unit] = ss;
+}
+
+void device_load_default_samplerstate(gs_device_t *device, bool b_3d,
+				      int unit)
+{
+	UNUSED_PARAMETER(b_3d);
+	device_load_samplerstate(device, &device->default_sampler, unit);
+}
+
+void device_load_vertexshader(gs_device_t *device, gs_shader_t *vertshader)
+{
+	if (vertshader && vertshader->type != GS_SHADER_VERTEX) {
+		blog(LOG_ERROR, "Specified shader is not a vertex shader");
+		return;
+	}
+
+	device->cur_vertex_shader = vertshader;
+}
+
+void device_load_pixelshader(gs_device_t *device, gs_shader_t *pixelshader)
+{
+	if (pixelshader && pixelshader->type != GS_SHADER_PIXEL) {
+		blog(LOG_ERROR, "Specified shader is not a pixel shader");
+		return;
+	}
+
+	device->cur_pixel_shader = pixelshader;
+
+	if (!pixelshader)
+		return;
+
+	for (size_t i = 0; i < pixelshader->samplers.num && i < MAX_TEXTURES;
+	     i++)
+		device->cur_samplers[i] = pixelshader->samplers.array[i];
+}
+
+gs_shader_t *device_get_vertex_shader(const gs_device_t *device)
+{
+	return device->cur_vertex_shader;
+}
+
+gs_shader_t *device_get_pixel_shader(const gs_device_t *device)
+{
+	return device->cur_pixel_shader;
+}
+
+gs_texture_t *device_get_render_target(const gs_device_t *device)
+{
+	return device->cur_render_target;
+}
+
+gs_zstencil_t *device_get_zstencil_target(const gs_device_t *device)
+{
+	return device->cur_zstencil_buffer;
+}
+
+void device_set_render_target(gs_device_t *device, gs_texture_t *tex,
+			      gs_zstencil_t *zstencil)
+{
+	if (tex && !tex->is_render_target) {
+		blog(LOG_ERROR, "device_set_render_target (software): "
+				"texture is not a render target");
+		return;
+	}
+
+	device->cur_render_target = tex;
+	device->cur_zstencil_buffer = zstencil;
+}
+
+void device_set_cube_render_target(gs_device_t *device, gs_texture_t *cubetex,
+				   int side, gs_zstencil_t *zstencil)
+{
+	blog(LOG_ERROR, "device_set_cube_render_target (software): "
+			"cube textures are not supported");
+
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(cubetex);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(zstencil);
+}
+
+void device_begin_scene(gs_device_t *device)
+{
+	for (size_t i = 0; i < MAX_TEXTURES; i++)
+		device->cur_textures[i] = NULL;
+}
+
+void device_end_scene(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_load_swapchain(gs_device_t *device, gs_swapchain_t *swapchain)
+{
+	device->cur_swap = swapchain;
+}
+
+void device_present(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_flush(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+		 uint32_t start_vert, uint32_t num_verts)
+{
+	gs_effect_t *effect = gs_get_effect();
+
+	if (effect)
+		gs_effect_update_params(effect);
+
+	gs_matrix_get(&device->cur_view);
+	matrix4_mul(&device->cur_viewproj, &device->cur_view,
+		    &device->cur_proj);
+
+	sw_draw(device, draw_mode, start_vert, num_verts);
+}
+
+void device_set_cull_mode(gs_device_t *device, enum gs_cull_mode mode)
+{
+	device->cull_mode = mode;
+}
+
+enum gs_cull_mode device_get_cull_mode(const gs_device_t *device)
+{
+	return device->cull_mode;
+}
+
+void device_enable_blending(gs_device_t *device, bool enable)
+{
+	device->blend.enabled = enable;
+}
+
+void device_enable_depth_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_write(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_color(gs_device_t *device, bool red, bool green, bool blue,
+			 bool alpha)
+{
+	device->write_red = red;
+	device->write_green = green;
+	device->write_blue = blue;
+	device->write_alpha = alpha;
+}
+
+void device_blend_function(gs_device_t *device, enum gs_blend_type src,
+			   enum gs_blend_type dest)
+{
+	device_blend_function_separate(device, src, dest, src, dest);
+}
+
+void device_blend_function_separate(gs_device_t *device,
+				    enum gs_blend_type src_c,
+				    enum gs_blend_type dest_c,
+				    enum gs_blend_type src_a,
+				    enum gs_blend_type dest_a)
+{
+	device->blend.src_c = src_c;
+	device->blend.dest_c = dest_c;
+	device->blend.src_a = src_a;
+	device->blend.dest_a = dest_a;
+}
+
+void device_depth_function(gs_device_t *device, enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_function(gs_device_t *device, enum gs_stencil_side side,
+			     enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_op(gs_device_t *device, enum gs_stencil_side side,
+		       enum gs_stencil_op_type fail,
+		       enum gs_stencil_op_type zfail,
+		       enum gs_stencil_op_type zpass)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(fail);
+	UNUSED_PARAMETER(zfail);
+	UNUSED_PARAMETER(zpass);
+}
+
+void device_set_viewport(gs_device_t *device, int x, int y, int width,
+			 int height)
+{
+	device->viewport.x = x;
+	device->viewport.y = y;
+	device->viewport.cx = width;
+	device->viewport.cy = height;
+}
+
+void device_get_viewport(const gs_device_t *device, struct gs_rect *rect)
+{
+	*rect = device->viewport;
+}
+
+void device_set_scissor_rect(gs_device_t *device, const struct gs_rect *rect)
+{
+	if (rect)
+		device->scissor = *rect;
+	device->scissor_enabled = rect != NULL;
+}
+
+void device_ortho(gs_device_t *device, float left, float right, float top,
+		  float bottom, float znear, float zfar)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml = right - left;
+	float bmt = bottom - top;
+	float fmn = zfar - znear;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x = 2.0f / rml;
+	dst->t.x = (left + right) / -rml;
+
+	dst->y.y = 2.0f / -bmt;
+	dst->t.y = (bottom + top) / bmt;
+
+	dst->z.z = 1.0f / fmn;
+	dst->t.z = znear / -fmn;
+
+	dst->t.w = 1.0f;
+}
+
+void device_frustum(gs_device_t *device, float left, float right, float top,
+		    float bottom, float znear, float zfar)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml = right - left;
+	float bmt = bottom - top;
+	float fmn = zfar - znear;
+	float nearx2 = 2.0f * znear;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x = nearx2 / rml;
+	dst->z.x = (left + right) / -rml;
+
+	dst->y.y = nearx2 / -bmt;
+	dst->z.y = (bottom + top) / bmt;
+
+	dst->z.z = zfar / fmn;
+	dst->t.z = (znear * zfar) / -fmn;
+
+	dst->z.w = 1.0f;
+}
+
+void device_projection_push(gs_device_t *device)
+{
+	da_push_back(device->proj_stack, &device->cur_proj);
+}
+
+void device_projection_pop(gs_device_t *device)
+{
+	if (!device->proj_stack.num)
+		return;
+
+	device->cur_proj = *(struct matrix4 *)da_end(device->proj_stack);
+	da_pop_back(device->proj_stack);
+}
+
+bool device_nv12_available(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+	return false;
+}
+
+void device_debug_marker_begin(gs_device_t *device, const char *markername,
+			       const float color[4])
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(markername);
+	UNUSED_PARAMETER(color);
+}
+
+void device_debug_marker_end(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+uint64_t device_texture_get_max_size(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+	return 16384;
+}
+
+gs_stagesurf_t *device_canvas_map(gs_device_t *device, uint32_t *cx,
+				  uint32_t *cy, enum gs_color_format *fmt,
+				  uint8_t **data, uint32_t *linesize)
+{
+	struct gs_texture *target = device->cur_render_target;
+	gs_stagesurf_t *surface;
+
+	if (!target)
+		return NULL;
+
+	surface = device_stagesurface_create(device, target->width,
+					     target->height, target->format);
+	if (!surface)
+		return NULL;
+
+	device_stage_texture(device, surface, target);
+	gs_stagesurface_map(surface, data, linesize);
+
+	*cx = target->width;
+	*cy = target->height;
+	*fmt = target->format;
+	return surface;
+}
+
+void device_canvas_unmap(gs_device_t *device, gs_stagesurf_t *surface)
+{
+	if (surface) {
+		gs_stagesurface_unmap(surface);
+		gs_stagesurface_destroy(surface);
+	}
+
+	UNUSED_PARAMETER(device);
+}
+
+#ifdef _WIN32
+bool device_gdi_texture_available(void)
+{
+	return false;
+}
+
+bool device_shared_texture_available(void)
+{
+	return false;
+}
+#endif
@@ -0,0 +1,207 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <util/darray.h>
+#include <util/threading.h>
+#include <graphics/graphics.h>
+#include <graphics/device-exports.h>
+#include <graphics/matrix4.h>
+#include <graphics/vec4.h>
+
+/*
+ * Software graphics subsystem
+ *
+ *   Implements the device API entirely on the CPU so that libobs can render,
+ * convert and output without a GPU, for benchmarks and tests on headless
+ * hosts.  Textures, render targets and stage surfaces are plain memory.
+ *
+ *   Shaders are not executed.  Their parameters are parsed so effects work
+ * as usual, and draws are rasterized with a fixed function pipeline instead:
+ * the output is the pixel shader's "image" texture (or its first texture)
+ * modulated by its "color" parameter and the vertex colors, blended with the
+ * current blend state.  Effects that do more than that, such as the format
+ * conversion and scaling shaders, run at roughly the right cost but don't
+ * produce the same pixels as a GPU would.
+ */
+
+#define MAX_TEXTURES 8
+
+struct gs_sampler_state {
+	gs_device_t *device;
+	struct gs_sampler_info info;
+};
+
+struct gs_shader_param {
+	enum gs_shader_param_type type;
+
+	char *name;
+	gs_shader_t *shader;
+	gs_samplerstate_t *next_sampler;
+	int array_count;
+
+	struct gs_texture *texture;
+
+	DARRAY(uint8_t) cur_value;
+	DARRAY(uint8_t) def_value;
+};
+
+struct gs_shader {
+	gs_device_t *device;
+	enum gs_shader_type type;
+
+	struct gs_shader_param *viewproj;
+	struct gs_shader_param *world;
+
+	/* fixed function inputs of pixel shaders */
+	struct gs_shader_param *image;
+	struct gs_shader_param *color;
+
+	DARRAY(struct gs_shader_param) params;
+	DARRAY(gs_samplerstate_t *) samplers;
+};
+
+struct gs_vertex_buffer {
+	gs_device_t *device;
+	struct gs_vb_data *data;
+	bool dynamic;
+
+	/* what the GPU would have, only updated by flushes */
+	size_t num;
+	DARRAY(struct vec3) points;
+	DARRAY(uint32_t) colors;
+	DARRAY(struct vec2) uvs;
+};
+
+struct gs_index_buffer {
+	gs_device_t *device;
+	enum gs_index_type type;
+	void *data;
+	size_t num;
+	size_t width;
+	bool dynamic;
+
+	DARRAY(uint8_t) indices;
+};
+
+struct gs_texture {
+	gs_device_t *device;
+	enum gs_texture_type type;
+	enum gs_color_format format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t bpp;
+	uint32_t linesize;
+	bool is_dynamic;
+	bool is_render_target;
+
+	uint8_t *data;
+};
+
+struct gs_stage_surface {
+	gs_device_t *device;
+	enum gs_color_format format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t bpp;
+	uint32_t linesize;
+
+	uint8_t *data;
+};
+
+struct gs_zstencil_buffer {
+	gs_device_t *device;
+	enum gs_zstencil_format format;
+	uint32_t width;
+	uint32_t height;
+};
+
+struct gs_swap_chain {
+	gs_device_t *device;
+	struct gs_init_data info;
+	struct gs_texture *target;
+};
+
+struct gs_timer {
+	uint64_t begin;
+	uint64_t end;
+};
+
+struct gs_timer_range {
+	bool active;
+};
+
+struct sw_blend_state {
+	bool enabled;
+	enum gs_blend_type src_c;
+	enum gs_blend_type dest_c;
+	enum gs_blend_type src_a;
+	enum gs_blend_type dest_a;
+};
+
+struct gs_device {
+	struct gs_texture *cur_render_target;
+	struct gs_zstencil_buffer *cur_zstencil_buffer;
+	struct gs_texture *cur_textures[MAX_TEXTURES];
+	struct gs_sampler_state *cur_samplers[MAX_TEXTURES];
+	struct gs_vertex_buffer *cur_vertex_buffer;
+	struct gs_index_buffer *cur_index_buffer;
+	struct gs_shader *cur_vertex_shader;
+	struct gs_shader *cur_pixel_shader;
+	struct gs_swap_chain *cur_swap;
+
+	struct gs_sampler_state default_sampler;
+
+	enum gs_cull_mode cull_mode;
+	struct sw_blend_state blend;
+	bool write_red, write_green, write_blue, write_alpha;
+
+	struct gs_rect viewport;
+	struct gs_rect scissor;
+	bool scissor_enabled;
+
+	struct matrix4 cur_proj;
+	struct matrix4 cur_view;
+	struct matrix4 cur_viewproj;
+	DARRAY(struct matrix4) proj_stack;
+
+	/* statistics, logged when the device is destroyed */
+	uint64_t draws;
+	uint64_t skipped_draws;
+	uint64_t triangles;
+	uint64_t pixels;
+};
+
+/* imports that device-exports.h doesn't declare */
+EXPORT uint64_t device_texture_get_max_size(gs_device_t *device);
+EXPORT gs_stagesurf_t *device_canvas_map(gs_device_t *device, uint32_t *cx,
+					 uint32_t *cy,
+					 enum gs_color_format *fmt,
+					 uint8_t **data, uint32_t *linesize);
+EXPORT void device_canvas_unmap(gs_device_t *device, gs_stagesurf_t *surface);
+#ifdef _WIN32
+EXPORT bool device_gdi_texture_available(void);
+EXPORT bool device_shared_texture_available(void);
+#endif
+
+extern bool sw_get_pixel(const struct gs_texture *tex, uint32_t x, uint32_t y,
+			 struct vec4 *color);
+extern void sw_set_pixel(struct gs_texture *tex, uint32_t x, uint32_t y,
+			 const struct vec4 *color);
+extern bool sw_format_supported(enum gs_color_format format);
+
+extern void sw_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+		    uint32_t start_vert, uint32_t num_verts);
@@ -0,0 +1,483 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include "sw-subsystem.h"
+
+bool sw_format_supported(enum gs_color_format format)
+{
+	switch (format) {
+	case GS_A8:
+	case GS_R8:
+	case GS_R8G8:
+	case GS_RGBA:
+	case GS_BGRA:
+	case GS_BGRX:
+	case GS_R32F:
+	case GS_RGBA32F:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static inline float unorm(uint8_t val)
+{
+	return (float)val * (1.0f / 255.0f);
+}
+
+static inline uint8_t to_unorm(float val)
+{
+	if (val <= 0.0f)
+		return 0;
+	if (val >= 1.0f)
+		return 255;
+	return (uint8_t)(val * 255.0f + 0.5f);
+}
+
+bool sw_get_pixel(const struct gs_texture *tex, uint32_t x, uint32_t y,
+		  struct vec4 *color)
+{
+	const uint8_t *p = tex->data + y * tex->linesize + x * (tex->bpp / 8);
+	const float *f = (const float *)p;
+
+	switch (tex->format) {
+	case GS_A8:
+		vec4_set(color, 1.0f, 1.0f, 1.0f, unorm(p[0]));
+		return true;
+	case GS_R8:
+		vec4_set(color, unorm(p[0]), 0.0f, 0.0f, 1.0f);
+		return true;
+	case GS_R8G8:
+		vec4_set(color, unorm(p[0]), unorm(p[1]), 0.0f, 1.0f);
+		return true;
+	case GS_RGBA:
+		vec4_set(color, unorm(p[0]), unorm(p[1]), unorm(p[2]),
+			 unorm(p[3]));
+		return true;
+	case GS_BGRA:
+		vec4_set(color, unorm(p[2]), unorm(p[1]), unorm(p[0]),
+			 unorm(p[3]));
+		return true;
+	case GS_BGRX:
+		vec4_set(color, unorm(p[2]), unorm(p[1]), unorm(p[0]), 1.0f);
+		return true;
+	case GS_R32F:
+		vec4_set(color, f[0], 0.0f, 0.0f, 1.0f);
+		return true;
+	case GS_RGBA32F:
+		vec4_set(color, f[0], f[1], f[2], f[3]);
+		return true;
+	default:
+		return false;
+	}
+}
+
+void sw_set_pixel(struct gs_texture *tex, uint32_t x, uint32_t y,
+		  const struct vec4 *color)
+{
+	uint8_t *p = tex->data + y * tex->linesize + x * (tex->bpp / 8);
+	float *f = (float *)p;
+
+	switch (tex->format) {
+	case GS_A8:
+		p[0] = to_unorm(color->w);
+		break;
+	case GS_R8:
+		p[0] = to_unorm(color->x);
+		break;
+	case GS_R8G8:
+		p[0] = to_unorm(color->x);
+		p[1] = to_unorm(color->y);
+		break;
+	case GS_RGBA:
+		p[0] = to_unorm(color->x);
+		p[1] = to_unorm(color->y);
+		p[2] = to_unorm(color->z);
+		p[3] = to_unorm(color->w);
+		break;
+	case GS_BGRA:
+	case GS_BGRX:
+		p[0] = to_unorm(color->z);
+		p[1] = to_unorm(color->y);
+		p[2] = to_unorm(color->x);
+		p[3] = to_unorm(color->w);
+		break;
+	case GS_R32F:
+		f[0] = color->x;
+		break;
+	case GS_RGBA32F:
+		f[0] = color->x;
+		f[1] = color->y;
+		f[2] = color->z;
+		f[3] = color->w;
+		break;
+	default:
+		break;
+	}
+}
+
+gs_texture_t *device_texture_create(gs_device_t *device, uint32_t width,
+				    uint32_t height,
+				    enum gs_color_format color_format,
+				    uint32_t levels, const uint8_t **data,
+				    uint32_t flags)
+{
+	struct gs_texture *tex;
+
+	if (gs_is_compressed_format(color_format)) {
+		blog(LOG_ERROR, "device_texture_create (software): "
+				"compressed formats are not supported");
+		return NULL;
+	}
+
+	if (!width || !height) {
+		blog(LOG_ERROR, "device_texture_create (software): "
+				"invalid size %ux%u",
+		     width, height);
+		return NULL;
+	}
+
+	tex = bzalloc(sizeof(struct gs_texture));
+	tex->device = device;
+	tex->type = GS_TEXTURE_2D;
+	tex->format = color_format;
+	tex->width = width;
+	tex->height = height;
+	tex->bpp = gs_get_format_bpp(color_format);
+	tex->linesize = width * tex->bpp / 8;
+	tex->is_dynamic = (flags & GS_DYNAMIC) != 0;
+	tex->is_render_target = (flags & GS_RENDER_TARGET) != 0;
+
+	/* mipmaps are never sampled, only the first level is kept */
+	tex->data = bzalloc((size_t)tex->linesize * height);
+	if (data && *data)
+		memcpy(tex->data, *data, (size_t)tex->linesize * height);
+
+	UNUSED_PARAMETER(levels);
+	return tex;
+}
+
+gs_texture_t *device_cubetexture_create(gs_device_t *device, uint32_t size,
+					enum gs_color_format color_format,
+					uint32_t levels, const uint8_t **data,
+					uint32_t flags)
+{
+	blog(LOG_ERROR, "device_cubetexture_create (software): "
+			"cube textures are not supported");
+
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(size);
+	UNUSED_PARAMETER(color_format);
+	UNUSED_PARAMETER(levels);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(flags);
+	return NULL;
+}
+
+gs_texture_t *device_voltexture_create(gs_device_t *device, uint32_t width,
+				       uint32_t height, uint32_t depth,
+				       enum gs_color_format color_format,
+				       uint32_t levels, const uint8_t **data,
+				       uint32_t flags)
+{
+	blog(LOG_ERROR, "device_voltexture_create (software): "
+			"volume textures are not supported");
+
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(width);
+	UNUSED_PARAMETER(height);
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(color_format);
+	UNUSED_PARAMETER(levels);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(flags);
+	return NULL;
+}
+
+enum gs_texture_type device_get_texture_type(const gs_texture_t *texture)
+{
+	return texture->type;
+}
+
+void gs_texture_destroy(gs_texture_t *tex)
+{
+	gs_device_t *device;
+
+	if (!tex)
+		return;
+
+	device = tex->device;
+	if (device->cur_render_target == tex)
+		device->cur_render_target = NULL;
+
+	for (size_t i = 0; i < MAX_TEXTURES; i++) {
+		if (device->cur_textures[i] == tex)
+			device->cur_textures[i] = NULL;
+	}
+
+	bfree(tex->data);
+	bfree(tex);
+}
+
+uint32_t gs_texture_get_width(const gs_texture_t *tex)
+{
+	return tex->width;
+}
+
+uint32_t gs_texture_get_height(const gs_texture_t *tex)
+{
+	return tex->height;
+}
+
+enum gs_color_format gs_texture_get_color_format(const gs_texture_t *tex)
+{
+	return tex->format;
+}
+
+bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
+{
+	if (!tex->is_dynamic) {
+		blog(LOG_ERROR, "Texture is not dynamic");
+		return false;
+	}
+
+	*ptr = tex->data;
+	*linesize = tex->linesize;
+	return true;
+}
+
+void gs_texture_unmap(gs_texture_t *tex)
+{
+	UNUSED_PARAMETER(tex);
+}
+
+bool gs_texture_is_rect(const gs_texture_t *tex)
+{
+	UNUSED_PARAMETER(tex);
+	return false;
+}
+
+void *gs_texture_get_obj(gs_texture_t *tex)
+{
+	return tex->data;
+}
+
+void gs_cubetexture_destroy(gs_texture_t *cubetex)
+{
+	UNUSED_PARAMETER(cubetex);
+}
+
+uint32_t gs_cubetexture_get_size(const gs_texture_t *cubetex)
+{
+	UNUSED_PARAMETER(cubetex);
+	return 0;
+}
+
+enum gs_color_format
+gs_cubetexture_get_color_format(const gs_texture_t *cubetex)
+{
+	UNUSED_PARAMETER(cubetex);
+	return GS_UNKNOWN;
+}
+
+void gs_voltexture_destroy(gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+}
+
+uint32_t gs_voltexture_get_width(const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+uint32_t gs_voltexture_get_height(const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+uint32_t gs_voltexture_get_depth(const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+enum gs_color_format gs_voltexture_get_color_format(const gs_texture_t *voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return GS_UNKNOWN;
+}
+
+void device_copy_texture_region(gs_device_t *device, gs_texture_t *dst,
+				uint32_t dst_x, uint32_t dst_y,
+				gs_texture_t *src, uint32_t src_x,
+				uint32_t src_y, uint32_t src_w, uint32_t src_h)
+{
+	if (!src) {
+		blog(LOG_ERROR, "Source texture is NULL");
+		goto fail;
+	}
+
+	if (!dst) {
+		blog(LOG_ERROR, "Destination texture is NULL");
+		goto fail;
+	}
+
+	if (dst->format != src->format) {
+		blog(LOG_ERROR, "Source and destination formats do not match");
+		goto fail;
+	}
+
+	uint32_t nw = src_w ? src_w : (src->width - src_x);
+	uint32_t nh = src_h ? src_h : (src->height - src_y);
+
+	if (dst->width - dst_x < nw || dst->height - dst_y < nh) {
+		blog(LOG_ERROR, "Destination texture region is not big "
+				"enough to hold the source region");
+		goto fail;
+	}
+
+	size_t pixel_size = src->bpp / 8;
+
+	for (uint32_t y = 0; y < nh; y++) {
+		uint8_t *out = dst->data + (dst_y + y) * dst->linesize +
+			       dst_x * pixel_size;
+		const uint8_t *in = src->data + (src_y + y) * src->linesize +
+				    src_x * pixel_size;
+		memcpy(out, in, nw * pixel_size);
+	}
+
+	UNUSED_PARAMETER(device);
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_copy_texture_region (software) failed");
+}
+
+void device_copy_texture(gs_device_t *device, gs_texture_t *dst,
+			 gs_texture_t *src)
+{
+	device_copy_texture_region(device, dst, 0, 0, src, 0, 0, 0, 0);
+}
+
+gs_stagesurf_t *device_stagesurface_create(gs_device_t *device, uint32_t width,
+					   uint32_t height,
+					   enum gs_color_format color_format)
+{
+	struct gs_stage_surface *surf = bzalloc(sizeof(struct gs_stage_surface));
+
+	surf->device = device;
+	surf->format = color_format;
+	surf->width = width;
+	surf->height = height;
+	surf->bpp = gs_get_format_bpp(color_format);
+	surf->linesize = width * surf->bpp / 8;
+	surf->data = bzalloc((size_t)surf->linesize * height);
+	return surf;
+}
+
+void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
+			  gs_texture_t *src)
+{
+	if (!src) {
+		blog(LOG_ERROR, "Source texture is NULL");
+		goto fail;
+	}
+
+	if (!dst) {
+		blog(LOG_ERROR, "Destination surface is NULL");
+		goto fail;
+	}
+
+	if (dst->format != src->format || dst->width != src->width ||
+	    dst->height != src->height) {
+		blog(LOG_ERROR, "Source and destination surfaces do not match");
+		goto fail;
+	}
+
+	memcpy(dst->data, src->data, (size_t)dst->linesize * dst->height);
+
+	UNUSED_PARAMETER(device);
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_stage_texture (software) failed");
+}
+
+void gs_stagesurface_destroy(gs_stagesurf_t *stagesurf)
+{
+	if (!stagesurf)
+		return;
+
+	bfree(stagesurf->data);
+	bfree(stagesurf);
+}
+
+uint32_t gs_stagesurface_get_width(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->width;
+}
+
+uint32_t gs_stagesurface_get_height(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->height;
+}
+
+enum gs_color_format
+gs_stagesurface_get_color_format(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->format;
+}
+
+bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
+			 uint32_t *linesize)
+{
+	*data = stagesurf->data;
+	*linesize = stagesurf->linesize;
+	return true;
+}
+
+void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
+{
+	UNUSED_PARAMETER(stagesurf);
+}
+
+gs_zstencil_t *device_zstencil_create(gs_device_t *device, uint32_t width,
+				      uint32_t height,
+				      enum gs_zstencil_format format)
+{
+	struct gs_zstencil_buffer *zs =
+		bzalloc(sizeof(struct gs_zstencil_buffer));
+
+	zs->device = device;
+	zs->format = format;
+	zs->width = width;
+	zs->height = height;
+	return zs;
+}
+
+void gs_zstencil_destroy(gs_zstencil_t *zstencil)
+{
+	if (!zstencil)
+		return;
+
+	if (zstencil->device->cur_zstencil_buffer == zstencil)
+		zstencil->device->cur_zstencil_buffer = NULL;
+
+	bfree(zstencil);
+}
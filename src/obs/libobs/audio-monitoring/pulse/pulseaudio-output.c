@@ -1,33 +1,70 @@
 #include "obs-internal.h"
 #include "pulseaudio-wrapper.h"
 
-#define PULSE_DATA(voidptr) struct audio_monitor *data = voidptr;
+#define PULSE_DATA(voidptr) struct monitor_mixer *data = voidptr;
 #define blog(level, msg, ...) blog(level, "pulse-am: " msg, ##__VA_ARGS__)
 
-struct audio_monitor {
-	obs_source_t *source;
-	pa_stream *stream;
+/* a source that hasn't sent audio for this long doesn't hold up the mix */
+#define INPUT_IDLE_NS 100000000ULL
+
+/* Monitored sources are summed by a single mixer which feeds one PulseAudio
+ * stream, instead of every source opening its own stream.  The mixer is
+ * shared by all monitors of the current device and latency, and closes its
+ * stream when the last monitor goes away. */
+struct monitor_mixer {
+	long refs;
+	char *device_id;
+	uint32_t latency_ms;
+
 	char *device;
+	pa_stream *stream;
 	pa_buffer_attr attr;
-	enum speaker_layout speakers;
+	uint32_t max_tlength;
 	pa_sample_format_t format;
 	uint_fast32_t samples_per_sec;
 	uint_fast32_t bytes_per_frame;
 	uint_fast8_t channels;
 
-	uint_fast32_t packets;
-	uint_fast64_t frames;
+	/* the inputs are interleaved float at the rate and layout of libobs,
+	 * the mix is converted to the device format once */
+	size_t in_channels;
+	size_t max_input_frames;
+	size_t max_wait_frames;
+	audio_resampler_t *resampler;
+
+	pthread_mutex_t mutex;
+	DARRAY(struct audio_monitor *) inputs;
+	DARRAY(float) mix;
+	DARRAY(float) scratch;
+	struct circlebuf out;
+	size_t max_out_size;
+	size_t bytes_remaining;
+
+	/* keeps writes to the stream in order */
+	pthread_mutex_t write_mutex;
+	DARRAY(uint8_t) write_buf;
+
+	uint64_t frames;
+	uint64_t dropped_frames;
+	uint32_t underflows;
+};
+
+struct audio_monitor {
+	obs_source_t *source;
+	struct monitor_mixer *mixer;
 
 	struct circlebuf new_data;
-	audio_resampler_t *resampler;
-	size_t buffer_size;
-	size_t bytesRemaining;
-	size_t bytes_per_channel;
+	uint64_t last_data_ts;
+
+	uint_fast32_t packets;
+	uint_fast64_t frames;
 
 	bool ignore;
-	pthread_mutex_t playback_mutex;
 };
 
+/* the current mixer, protected by the monitoring mutex */
+static struct monitor_mixer *cur_mixer = NULL;
+
 static enum speaker_layout
 pulseaudio_channels_to_obs_speakers(uint_fast32_t channels)
 {
@@ -125,132 +162,14 @@ static pa_channel_map pulseaudio_channel_map(enum speaker_layout layout)
 	return ret;
 }
 
-static void process_byte(void *p, size_t frames, size_t channels, float vol)
-{
-	register char *cur = (char *)p;
-	register char *end = cur + frames * channels;
-
-	while (cur < end)
-		*(cur++) *= vol;
-}
-
-static void process_short(void *p, size_t frames, size_t channels, float vol)
-{
-	register short *cur = (short *)p;
-	register short *end = cur + frames * channels;
-
-	while (cur < end)
-		*(cur++) *= vol;
-}
-
-static void process_float(void *p, size_t frames, size_t channels, float vol)
-{
-	register float *cur = (float *)p;
-	register float *end = cur + frames * channels;
-
-	while (cur < end)
-		*(cur++) *= vol;
-}
-
-void process_volume(const struct audio_monitor *monitor, float vol,
-		    uint8_t *const *resample_data, uint32_t resample_frames)
-{
-	switch (monitor->bytes_per_channel) {
-	case 1:
-		process_byte(resample_data[0], resample_frames,
-			     monitor->channels, vol);
-		break;
-	case 2:
-		process_short(resample_data[0], resample_frames,
-			      monitor->channels, vol);
-		break;
-	default:
-		process_float(resample_data[0], resample_frames,
-			      monitor->channels, vol);
-		break;
-	}
-}
-
-static void do_stream_write(void *param)
-{
-	PULSE_DATA(param);
-	uint8_t *buffer = NULL;
-
-	while (data->new_data.size >= data->buffer_size &&
-	       data->bytesRemaining > 0) {
-		size_t bytesToFill = data->buffer_size;
-
-		if (bytesToFill > data->bytesRemaining)
-			bytesToFill = data->bytesRemaining;
-
-		pa_stream_begin_write(data->stream, (void **)&buffer,
-				      &bytesToFill);
-
-		circlebuf_pop_front(&data->new_data, buffer, bytesToFill);
-
-		pulseaudio_lock();
-		pa_stream_write(data->stream, buffer, bytesToFill, NULL, 0LL,
-				PA_SEEK_RELATIVE);
-		pulseaudio_unlock();
-
-		data->bytesRemaining -= bytesToFill;
-	}
-}
-
-static void on_audio_playback(void *param, obs_source_t *source,
-			      const struct audio_data *audio_data, bool muted)
-{
-	struct audio_monitor *monitor = param;
-	float vol = source->user_volume;
-	size_t bytes;
-
-	uint8_t *resample_data[MAX_AV_PLANES];
-	uint32_t resample_frames;
-	uint64_t ts_offset;
-	bool success;
-
-	if (pthread_mutex_trylock(&monitor->playback_mutex) != 0)
-		return;
-
-	if (os_atomic_load_long(&source->activate_refs) == 0)
-		goto unlock;
-
-	success = audio_resampler_resample(
-		monitor->resampler, resample_data, &resample_frames, &ts_offset,
-		(const uint8_t *const *)audio_data->data,
-		(uint32_t)audio_data->frames);
-
-	if (!success)
-		goto unlock;
-
-	bytes = monitor->bytes_per_frame * resample_frames;
-
-	if (muted) {
-		memset(resample_data[0], 0, bytes);
-	} else {
-		if (!close_float(vol, 1.0f, EPSILON)) {
-			process_volume(monitor, vol, resample_data,
-				       resample_frames);
-		}
-	}
-
-	circlebuf_push_back(&monitor->new_data, resample_data[0], bytes);
-	monitor->packets++;
-	monitor->frames += resample_frames;
-
-unlock:
-	pthread_mutex_unlock(&monitor->playback_mutex);
-	do_stream_write(param);
-}
-
 static void pulseaudio_stream_write(pa_stream *p, size_t nbytes, void *userdata)
 {
 	UNUSED_PARAMETER(p);
 	PULSE_DATA(userdata);
 
-	pthread_mutex_lock(&data->playback_mutex);
-	data->bytesRemaining += nbytes;
-	pthread_mutex_unlock(&data->playback_mutex);
+	pthread_mutex_lock(&data->mutex);
+	data->bytes_remaining += nbytes;
+	pthread_mutex_unlock(&data->mutex);
 
 	pulseaudio_signal(0);
 }
@@ -260,12 +179,23 @@ static void pulseaudio_underflow(pa_stream *p, void *userdata)
 	UNUSED_PARAMETER(p);
 	PULSE_DATA(userdata);
 
-	pthread_mutex_lock(&data->playback_mutex);
-	if (obs_source_active(data->source))
+	pthread_mutex_lock(&data->mutex);
+	data->underflows++;
+
+	/* only grow the buffer while something is actually playing */
+	if (data->inputs.num && data->attr.tlength < data->max_tlength) {
 		data->attr.tlength = (data->attr.tlength * 3) / 2;
+		if (data->attr.tlength > data->max_tlength)
+			data->attr.tlength = data->max_tlength;
 
-	pa_stream_set_buffer_attr(data->stream, &data->attr, NULL, NULL);
-	pthread_mutex_unlock(&data->playback_mutex);
+		pa_stream_set_buffer_attr(data->stream, &data->attr, NULL,
+					  NULL);
+	}
+	pthread_mutex_unlock(&data->mutex);
+
+	os_atomic_inc_long(&obs->audio.monitoring_underflows);
+	blog(LOG_DEBUG, "Underflow, target length now %" PRIu32 " bytes",
+	     data->attr.tlength);
 
 	pulseaudio_signal(0);
 }
@@ -328,79 +258,69 @@ skip:
 	pulseaudio_signal(0);
 }
 
-static void pulseaudio_stop_playback(struct audio_monitor *monitor)
+static void mixer_destroy(struct monitor_mixer *mixer)
 {
-	if (monitor->stream) {
-		pa_stream_disconnect(monitor->stream);
-		pa_stream_unref(monitor->stream);
-		monitor->stream = NULL;
+	if (mixer->stream) {
+		pa_stream_disconnect(mixer->stream);
+		pa_stream_unref(mixer->stream);
+
+		blog(LOG_INFO, "Stopped Monitoring in '%s'", mixer->device);
+		blog(LOG_INFO,
+		     "Mixed %" PRIu64 " frames, %" PRIu64 " dropped, "
+		     "%" PRIu32 " underflows",
+		     mixer->frames, mixer->dropped_frames, mixer->underflows);
 	}
 
-	blog(LOG_INFO, "Stopped Monitoring in '%s'", monitor->device);
-	blog(LOG_INFO,
-	     "Got %" PRIuFAST32 " packets with %" PRIuFAST64 " frames",
-	     monitor->packets, monitor->frames);
+	audio_resampler_destroy(mixer->resampler);
+	pthread_mutex_destroy(&mixer->mutex);
+	pthread_mutex_destroy(&mixer->write_mutex);
+	circlebuf_free(&mixer->out);
+	da_free(mixer->inputs);
+	da_free(mixer->mix);
+	da_free(mixer->scratch);
+	da_free(mixer->write_buf);
+	pulseaudio_unref();
 
-	monitor->packets = 0;
-	monitor->frames = 0;
+	bfree(mixer->device);
+	bfree(mixer->device_id);
+	bfree(mixer);
 }
 
-static bool audio_monitor_init(struct audio_monitor *monitor,
-			       obs_source_t *source)
+static bool mixer_init(struct monitor_mixer *mixer)
 {
-	pthread_mutex_init_value(&monitor->playback_mutex);
-
-	monitor->source = source;
-
-	const char *id = obs->audio.monitoring_device_id;
-	if (!id)
-		return false;
-
-	if (source->info.output_flags & OBS_SOURCE_DO_NOT_SELF_MONITOR) {
-		obs_data_t *s = obs_source_get_settings(source);
-		const char *s_dev_id = obs_data_get_string(s, "device_id");
-		bool match = devices_match(s_dev_id, id);
-		obs_data_release(s);
-
-		if (match) {
-			monitor->ignore = true;
-			blog(LOG_INFO, "Prevented feedback-loop in '%s'",
-			     s_dev_id);
-			return true;
-		}
-	}
+	const char *id = mixer->device_id;
 
 	pulseaudio_init();
 
 	if (strcmp(id, "default") == 0)
-		get_default_id(&monitor->device);
+		get_default_id(&mixer->device);
 	else
-		monitor->device = bstrdup(id);
+		mixer->device = bstrdup(id);
 
-	if (!monitor->device)
+	if (!mixer->device)
 		return false;
 
 	if (pulseaudio_get_server_info(pulseaudio_server_info,
-				       (void *)monitor) < 0) {
+				       (void *)mixer) < 0) {
 		blog(LOG_ERROR, "Unable to get server info !");
 		return false;
 	}
 
-	if (pulseaudio_get_source_info(pulseaudio_source_info, monitor->device,
-				       (void *)monitor) < 0) {
+	if (pulseaudio_get_source_info(pulseaudio_source_info, mixer->device,
+				       (void *)mixer) < 0) {
 		blog(LOG_ERROR, "Unable to get source info !");
 		return false;
 	}
-	if (monitor->format == PA_SAMPLE_INVALID) {
+	if (mixer->format == PA_SAMPLE_INVALID) {
 		blog(LOG_ERROR,
 		     "An error occurred while getting the source info!");
 		return false;
 	}
 
 	pa_sample_spec spec;
-	spec.format = monitor->format;
-	spec.rate = (uint32_t)monitor->samples_per_sec;
-	spec.channels = monitor->channels;
+	spec.format = mixer->format;
+	spec.rate = (uint32_t)mixer->samples_per_sec;
+	spec.channels = mixer->channels;
 
 	if (!pa_sample_spec_valid(&spec)) {
 		blog(LOG_ERROR, "Sample spec is not valid");
@@ -409,84 +329,343 @@ static bool audio_monitor_init(struct audio_monitor *monitor,
 
 	const struct audio_output_info *info =
 		audio_output_get_info(obs->audio.audio);
+	enum speaker_layout speakers =
+		pulseaudio_channels_to_obs_speakers(mixer->channels);
 
 	struct resample_info from = {.samples_per_sec = info->samples_per_sec,
 				     .speakers = info->speakers,
-				     .format = AUDIO_FORMAT_FLOAT_PLANAR};
+				     .format = AUDIO_FORMAT_FLOAT};
 	struct resample_info to = {
-		.samples_per_sec = (uint32_t)monitor->samples_per_sec,
-		.speakers =
-			pulseaudio_channels_to_obs_speakers(monitor->channels),
-		.format = pulseaudio_to_obs_audio_format(monitor->format)};
+		.samples_per_sec = (uint32_t)mixer->samples_per_sec,
+		.speakers = speakers,
+		.format = pulseaudio_to_obs_audio_format(mixer->format)};
 
-	monitor->resampler = audio_resampler_create(&to, &from);
-	if (!monitor->resampler) {
+	mixer->resampler = audio_resampler_create(&to, &from);
+	if (!mixer->resampler) {
 		blog(LOG_WARNING, "%s: %s", __FUNCTION__,
 		     "Failed to create resampler");
 		return false;
 	}
 
-	monitor->bytes_per_channel = get_audio_bytes_per_channel(
-		pulseaudio_to_obs_audio_format(monitor->format));
-	monitor->speakers = pulseaudio_channels_to_obs_speakers(spec.channels);
-	monitor->bytes_per_frame = pa_frame_size(&spec);
+	mixer->in_channels = get_audio_channels(info->speakers);
+	mixer->max_input_frames = info->samples_per_sec;
+	mixer->max_wait_frames =
+		(size_t)info->samples_per_sec * mixer->latency_ms / 1000;
+	mixer->bytes_per_frame = pa_frame_size(&spec);
 
-	pa_channel_map channel_map = pulseaudio_channel_map(monitor->speakers);
+	pa_channel_map channel_map = pulseaudio_channel_map(speakers);
 
-	monitor->stream = pulseaudio_stream_new(
-		obs_source_get_name(monitor->source), &spec, &channel_map);
-	if (!monitor->stream) {
+	mixer->stream = pulseaudio_stream_new("Audio Monitor", &spec,
+					      &channel_map);
+	if (!mixer->stream) {
 		blog(LOG_ERROR, "Unable to create stream");
 		return false;
 	}
 
-	monitor->attr.fragsize = (uint32_t)-1;
-	monitor->attr.maxlength = (uint32_t)-1;
-	monitor->attr.minreq = (uint32_t)-1;
-	monitor->attr.prebuf = (uint32_t)-1;
-	monitor->attr.tlength = pa_usec_to_bytes(25000, &spec);
+	pa_usec_t latency = (pa_usec_t)mixer->latency_ms * 1000;
 
-	monitor->buffer_size =
-		monitor->bytes_per_frame * pa_usec_to_bytes(5000, &spec);
+	mixer->attr.fragsize = (uint32_t)-1;
+	mixer->attr.maxlength = (uint32_t)-1;
+	mixer->attr.minreq = (uint32_t)-1;
+	mixer->attr.prebuf = (uint32_t)-1;
+	mixer->attr.tlength = (uint32_t)pa_usec_to_bytes(latency, &spec);
+	mixer->max_tlength = mixer->attr.tlength * 4;
+	mixer->max_out_size = pa_usec_to_bytes(latency * 4, &spec);
 
 	pa_stream_flags_t flags = PA_STREAM_INTERPOLATE_TIMING |
-				  PA_STREAM_AUTO_TIMING_UPDATE;
+				  PA_STREAM_AUTO_TIMING_UPDATE |
+				  PA_STREAM_ADJUST_LATENCY;
 
-	if (pthread_mutex_init(&monitor->playback_mutex, NULL) != 0) {
-		blog(LOG_WARNING, "%s: %s", __FUNCTION__,
-		     "Failed to init mutex");
-		return false;
-	}
+	pulseaudio_write_callback(mixer->stream, pulseaudio_stream_write,
+				  (void *)mixer);
+	pulseaudio_set_underflow_callback(mixer->stream, pulseaudio_underflow,
+					  (void *)mixer);
 
 	int_fast32_t ret = pulseaudio_connect_playback(
-		monitor->stream, monitor->device, &monitor->attr, flags);
+		mixer->stream, mixer->device, &mixer->attr, flags);
 	if (ret < 0) {
-		pulseaudio_stop_playback(monitor);
+		pa_stream_unref(mixer->stream);
+		mixer->stream = NULL;
 		blog(LOG_ERROR, "Unable to connect to stream");
 		return false;
 	}
 
-	blog(LOG_INFO, "Started Monitoring in '%s'", monitor->device);
+	blog(LOG_INFO, "Started Monitoring in '%s' with %" PRIu32 " ms latency",
+	     mixer->device, mixer->latency_ms);
 	return true;
 }
 
+static struct monitor_mixer *mixer_acquire(const char *id, uint32_t latency_ms)
+{
+	struct monitor_mixer *mixer;
+
+	pthread_mutex_lock(&obs->audio.monitoring_mutex);
+
+	mixer = cur_mixer;
+	if (mixer && strcmp(mixer->device_id, id) == 0 &&
+	    mixer->latency_ms == latency_ms) {
+		mixer->refs++;
+		goto unlock;
+	}
+
+	mixer = bzalloc(sizeof(*mixer));
+	mixer->device_id = bstrdup(id);
+	mixer->latency_ms = latency_ms;
+	mixer->refs = 1;
+
+	pthread_mutex_init_value(&mixer->mutex);
+	pthread_mutex_init_value(&mixer->write_mutex);
+
+	if (pthread_mutex_init(&mixer->mutex, NULL) != 0 ||
+	    pthread_mutex_init(&mixer->write_mutex, NULL) != 0) {
+		blog(LOG_WARNING, "%s: %s", __FUNCTION__,
+		     "Failed to init mutex");
+		mixer_destroy(mixer);
+		mixer = NULL;
+		goto unlock;
+	}
+
+	if (!mixer_init(mixer)) {
+		mixer_destroy(mixer);
+		mixer = NULL;
+		goto unlock;
+	}
+
+	/* monitors of a previous device keep their mixer until reset */
+	cur_mixer = mixer;
+
+unlock:
+	pthread_mutex_unlock(&obs->audio.monitoring_mutex);
+	return mixer;
+}
+
+static void mixer_release(struct monitor_mixer *mixer)
+{
+	if (!mixer)
+		return;
+
+	pthread_mutex_lock(&obs->audio.monitoring_mutex);
+	if (--mixer->refs == 0) {
+		if (cur_mixer == mixer)
+			cur_mixer = NULL;
+		mixer_destroy(mixer);
+	}
+	pthread_mutex_unlock(&obs->audio.monitoring_mutex);
+}
+
+static void mixer_push(struct monitor_mixer *mixer,
+		       struct audio_monitor *monitor,
+		       const struct audio_data *audio_data, float vol)
+{
+	size_t channels = mixer->in_channels;
+	size_t frames = audio_data->frames;
+	size_t frame_size = channels * sizeof(float);
+	float *out;
+
+	da_resize(mixer->scratch, frames * channels);
+	out = mixer->scratch.array;
+
+	for (size_t i = 0; i < frames; i++) {
+		for (size_t ch = 0; ch < channels; ch++) {
+			const float *in = (const float *)audio_data->data[ch];
+			*(out++) = in[i] * vol;
+		}
+	}
+
+	circlebuf_push_back(&monitor->new_data, mixer->scratch.array,
+			    frames * frame_size);
+	monitor->last_data_ts = os_gettime_ns();
+	monitor->packets++;
+	monitor->frames += frames;
+
+	/* the mix is stuck on something, don't let this input grow */
+	if (monitor->new_data.size > mixer->max_input_frames * frame_size) {
+		size_t drop = monitor->new_data.size -
+			      mixer->max_input_frames * frame_size;
+		circlebuf_pop_front(&monitor->new_data, NULL, drop);
+		mixer->dropped_frames += drop / frame_size;
+	}
+}
+
+static size_t mixer_get_frames(struct monitor_mixer *mixer)
+{
+	size_t frame_size = mixer->in_channels * sizeof(float);
+	uint64_t ts = os_gettime_ns();
+	size_t frames = SIZE_MAX;
+	size_t max_frames = 0;
+
+	for (size_t i = 0; i < mixer->inputs.num; i++) {
+		struct audio_monitor *monitor = mixer->inputs.array[i];
+		size_t avail = monitor->new_data.size / frame_size;
+
+		if (avail > max_frames)
+			max_frames = avail;
+		if (!avail && ts - monitor->last_data_ts > INPUT_IDLE_NS)
+			continue;
+		if (avail < frames)
+			frames = avail;
+	}
+
+	/* an input that lags behind for longer than the target latency
+	 * is mixed as silence */
+	if (max_frames > mixer->max_wait_frames)
+		return max_frames;
+	return frames == SIZE_MAX ? 0 : frames;
+}
+
+static void mixer_mix(struct monitor_mixer *mixer)
+{
+	size_t channels = mixer->in_channels;
+	size_t frame_size = channels * sizeof(float);
+	size_t frames = mixer_get_frames(mixer);
+	uint8_t *resample_data[MAX_AV_PLANES];
+	const uint8_t *in[MAX_AV_PLANES] = {0};
+	uint32_t resample_frames;
+	uint64_t ts_offset;
+	size_t bytes;
+
+	if (!frames)
+		return;
+
+	da_resize(mixer->mix, frames * channels);
+	memset(mixer->mix.array, 0, frames * frame_size);
+
+	for (size_t i = 0; i < mixer->inputs.num; i++) {
+		struct audio_monitor *monitor = mixer->inputs.array[i];
+		size_t count = monitor->new_data.size / frame_size;
+		float *mix = mixer->mix.array;
+		float *cur;
+
+		if (count > frames)
+			count = frames;
+		if (!count)
+			continue;
+
+		da_resize(mixer->scratch, count * channels);
+		circlebuf_pop_front(&monitor->new_data, mixer->scratch.array,
+				    count * frame_size);
+
+		cur = mixer->scratch.array;
+		for (size_t j = count * channels; j > 0; j--)
+			*(mix++) += *(cur++);
+	}
+
+	in[0] = (const uint8_t *)mixer->mix.array;
+	if (!audio_resampler_resample(mixer->resampler, resample_data,
+				      &resample_frames, &ts_offset, in,
+				      (uint32_t)frames))
+		return;
+
+	bytes = resample_frames * mixer->bytes_per_frame;
+	circlebuf_push_back(&mixer->out, resample_data[0], bytes);
+	mixer->frames += resample_frames;
+
+	/* the device isn't taking data, drop the oldest instead of adding
+	 * latency */
+	if (mixer->out.size > mixer->max_out_size) {
+		size_t drop = mixer->out.size - mixer->max_out_size;
+		drop -= drop % mixer->bytes_per_frame;
+
+		circlebuf_pop_front(&mixer->out, NULL, drop);
+		mixer->dropped_frames += drop / mixer->bytes_per_frame;
+	}
+}
+
+static void mixer_write(struct monitor_mixer *mixer)
+{
+	size_t bytes;
+
+	pthread_mutex_lock(&mixer->write_mutex);
+
+	pthread_mutex_lock(&mixer->mutex);
+	bytes = mixer->out.size;
+	if (bytes > mixer->bytes_remaining)
+		bytes = mixer->bytes_remaining;
+	bytes -= bytes % mixer->bytes_per_frame;
+
+	if (bytes) {
+		da_resize(mixer->write_buf, bytes);
+		circlebuf_pop_front(&mixer->out, mixer->write_buf.array, bytes);
+		mixer->bytes_remaining -= bytes;
+	}
+	pthread_mutex_unlock(&mixer->mutex);
+
+	/* the mainloop lock is never taken with the mixer locked, the write
+	 * callback locks them the other way around */
+	if (bytes) {
+		pulseaudio_lock();
+		pa_stream_write(mixer->stream, mixer->write_buf.array, bytes,
+				NULL, 0LL, PA_SEEK_RELATIVE);
+		pulseaudio_unlock();
+	}
+
+	pthread_mutex_unlock(&mixer->write_mutex);
+}
+
+static void on_audio_playback(void *param, obs_source_t *source,
+			      const struct audio_data *audio_data, bool muted)
+{
+	struct audio_monitor *monitor = param;
+	struct monitor_mixer *mixer = monitor->mixer;
+	float vol = muted ? 0.0f : source->user_volume;
+
+	if (os_atomic_load_long(&source->activate_refs) == 0)
+		return;
+
+	pthread_mutex_lock(&mixer->mutex);
+	mixer_push(mixer, monitor, audio_data, vol);
+	mixer_mix(mixer);
+	pthread_mutex_unlock(&mixer->mutex);
+
+	mixer_write(mixer);
+}
+
+static bool audio_monitor_init(struct audio_monitor *monitor,
+			       obs_source_t *source)
+{
+	monitor->source = source;
+
+	const char *id = obs->audio.monitoring_device_id;
+	if (!id)
+		return false;
+
+	if (source->info.output_flags & OBS_SOURCE_DO_NOT_SELF_MONITOR) {
+		obs_data_t *s = obs_source_get_settings(source);
+		const char *s_dev_id = obs_data_get_string(s, "device_id");
+		bool match = devices_match(s_dev_id, id);
+		obs_data_release(s);
+
+		if (match) {
+			monitor->ignore = true;
+			blog(LOG_INFO, "Prevented feedback-loop in '%s'",
+			     s_dev_id);
+			return true;
+		}
+	}
+
+	monitor->mixer = mixer_acquire(id, obs->audio.monitoring_latency_ms);
+	return monitor->mixer != NULL;
+}
+
 static void audio_monitor_init_final(struct audio_monitor *monitor)
 {
+	struct monitor_mixer *mixer = monitor->mixer;
+
 	if (monitor->ignore)
 		return;
 
+	pthread_mutex_lock(&mixer->mutex);
+	da_push_back(mixer->inputs, &monitor);
+	pthread_mutex_unlock(&mixer->mutex);
+
 	obs_source_add_audio_capture_callback(monitor->source,
 					      on_audio_playback, monitor);
-
-	pulseaudio_write_callback(monitor->stream, pulseaudio_stream_write,
-				  (void *)monitor);
-
-	pulseaudio_set_underflow_callback(monitor->stream, pulseaudio_underflow,
-					  (void *)monitor);
 }
 
 static inline void audio_monitor_free(struct audio_monitor *monitor)
 {
+	struct monitor_mixer *mixer = monitor->mixer;
+
 	if (monitor->ignore)
 		return;
 
@@ -494,14 +673,21 @@ static inline void audio_monitor_free(struct audio_monitor *monitor)
 		obs_source_remove_audio_capture_callback(
 			monitor->source, on_audio_playback, monitor);
 
-	audio_resampler_destroy(monitor->resampler);
-	circlebuf_free(&monitor->new_data);
+	if (mixer) {
+		pthread_mutex_lock(&mixer->mutex);
+		da_erase_item(mixer->inputs, &monitor);
+		pthread_mutex_unlock(&mixer->mutex);
 
-	if (monitor->stream)
-		pulseaudio_stop_playback(monitor);
-	pulseaudio_unref();
+		blog(LOG_INFO,
+		     "Got %" PRIuFAST32 " packets with %" PRIuFAST64
+		     " frames from '%s'",
+		     monitor->packets, monitor->frames,
+		     obs_source_get_name(monitor->source));
+	}
 
-	bfree(monitor->device);
+	circlebuf_free(&monitor->new_data);
+	mixer_release(mixer);
+	monitor->mixer = NULL;
 }
 
 struct audio_monitor *audio_monitor_create(obs_source_t *source)
@@ -532,9 +718,7 @@ void audio_monitor_reset(struct audio_monitor *monitor)
 	bool success;
 	audio_monitor_free(monitor);
 
-	pthread_mutex_lock(&monitor->playback_mutex);
 	success = audio_monitor_init(&new_monitor, monitor->source);
-	pthread_mutex_unlock(&monitor->playback_mutex);
 
 	if (success) {
 		*monitor = new_monitor;
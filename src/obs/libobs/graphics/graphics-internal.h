@@ -182,6 +182,11 @@ struct gs_exports {
 	bool (*gs_texture_map)(gs_texture_t *tex, uint8_t **ptr,
 			       uint32_t *linesize);
 	void (*gs_texture_unmap)(gs_texture_t *tex);
+	bool (*gs_texture_set_image_region)(gs_texture_t *tex, uint32_t x,
+					    uint32_t y, uint32_t width,
+					    uint32_t height,
+					    const uint8_t *data,
+					    uint32_t linesize);
 	bool (*gs_texture_is_rect)(const gs_texture_t *tex);
 	void *(*gs_texture_get_obj)(const gs_texture_t *tex);
 
@@ -346,6 +351,12 @@ struct blend_state {
 	enum gs_blend_type dest_a;
 };
 
+struct gs_sprite_run {
+	gs_texture_t *tex;
+	uint32_t start;
+	uint32_t count;
+};
+
 struct graphics_subsystem {
 	void *module;
 	gs_device_t *device;
@@ -361,6 +372,14 @@ struct graphics_subsystem {
 
 	gs_vertbuffer_t *sprite_buffer;
 
+	/* sprite batching, see gs_sprite_batch_begin */
+	gs_vertbuffer_t *batch_buffer;
+	gs_eparam_t *batch_image;
+	DARRAY(struct gs_sprite_run) batch_runs;
+	size_t batch_sprites;
+	uint32_t batch_draws;
+	bool batching;
+
 	bool using_immediate;
 	struct gs_vb_data *vbd;
 	gs_vertbuffer_t *immediate_vertbuffer;
@@ -138,6 +138,32 @@ static bool graphics_init_sprite_vb(struct graphics_subsystem *graphics)
 	return true;
 }
 
+/* sprites are drawn as separate triangles so that any run of them can be
+ * drawn with a single call */
+#define BATCH_VERTS_PER_SPRITE 6
+#define MAX_BATCH_SPRITES 256
+
+static bool graphics_init_batch_vb(struct graphics_subsystem *graphics)
+{
+	const size_t num = MAX_BATCH_SPRITES * BATCH_VERTS_PER_SPRITE;
+	struct gs_vb_data *vbd;
+
+	vbd = gs_vbdata_create();
+	vbd->num = num;
+	vbd->points = bzalloc(sizeof(struct vec3) * num);
+	vbd->num_tex = 1;
+	vbd->tvarray = bmalloc(sizeof(struct gs_tvertarray));
+	vbd->tvarray[0].width = 2;
+	vbd->tvarray[0].array = bzalloc(sizeof(struct vec2) * num);
+
+	graphics->batch_buffer = graphics->exports.device_vertexbuffer_create(
+		graphics->device, vbd, GS_DYNAMIC);
+	if (!graphics->batch_buffer)
+		return false;
+
+	return true;
+}
+
 static bool graphics_init(struct graphics_subsystem *graphics)
 {
 	struct matrix4 top_mat;
@@ -151,6 +177,8 @@ static bool graphics_init(struct graphics_subsystem *graphics)
 		return false;
 	if (!graphics_init_sprite_vb(graphics))
 		return false;
+	if (!graphics_init_batch_vb(graphics))
+		return false;
 	if (pthread_mutex_init(&graphics->mutex, NULL) != 0)
 		return false;
 	if (pthread_mutex_init(&graphics->effect_mutex, NULL) != 0)
@@ -277,6 +305,8 @@ void gs_destroy(graphics_t *graphics)
 
 		graphics->exports.gs_vertexbuffer_destroy(
 			graphics->sprite_buffer);
+		graphics->exports.gs_vertexbuffer_destroy(
+			graphics->batch_buffer);
 		graphics->exports.gs_vertexbuffer_destroy(
 			graphics->immediate_vertbuffer);
 		graphics->exports.device_destroy(graphics->device);
@@ -288,6 +318,7 @@ void gs_destroy(graphics_t *graphics)
 	pthread_mutex_destroy(&graphics->effect_mutex);
 	da_free(graphics->matrix_stack);
 	da_free(graphics->viewport_stack);
+	da_free(graphics->batch_runs);
 	da_free(graphics->blend_state_stack);
 	if (graphics->module)
 		os_dlclose(graphics->module);
@@ -1117,6 +1148,169 @@ void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip, uint32_t sub_x,
 	gs_draw(GS_TRISTRIP, 0, 0);
 }
 
+void gs_sprite_batch_begin(gs_eparam_t *image)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p("gs_sprite_batch_begin", image))
+		return;
+	if (graphics->batching) {
+		blog(LOG_ERROR, "gs_sprite_batch_begin: already batching");
+		return;
+	}
+
+	graphics->batch_image = image;
+	graphics->batch_sprites = 0;
+	graphics->batch_draws = 0;
+	graphics->batching = true;
+	da_resize(graphics->batch_runs, 0);
+}
+
+static void sprite_batch_flush(graphics_t *graphics)
+{
+	struct gs_vb_data *data;
+	size_t num;
+
+	if (!graphics->batch_sprites)
+		return;
+
+	/* the batch is uploaded once, then drawn with one call per texture */
+	data = gs_vertexbuffer_get_data(graphics->batch_buffer);
+	num = data->num;
+	data->num = graphics->batch_sprites * BATCH_VERTS_PER_SPRITE;
+	gs_vertexbuffer_flush(graphics->batch_buffer);
+	data->num = num;
+
+	gs_load_vertexbuffer(graphics->batch_buffer);
+	gs_load_indexbuffer(NULL);
+
+	/* the vertices are already transformed */
+	gs_matrix_push();
+	gs_matrix_identity();
+
+	for (size_t i = 0; i < graphics->batch_runs.num; i++) {
+		struct gs_sprite_run *run = graphics->batch_runs.array + i;
+
+		gs_effect_set_texture(graphics->batch_image, run->tex);
+		gs_draw(GS_TRIS, run->start * BATCH_VERTS_PER_SPRITE,
+			run->count * BATCH_VERTS_PER_SPRITE);
+		graphics->batch_draws++;
+	}
+
+	gs_matrix_pop();
+
+	graphics->batch_sprites = 0;
+	da_resize(graphics->batch_runs, 0);
+}
+
+static void batch_sprite(struct gs_vb_data *data, size_t idx,
+			 const struct matrix4 *mat, gs_texture_t *tex,
+			 float fcx, float fcy, uint32_t flip)
+{
+	static const uint8_t order[BATCH_VERTS_PER_SPRITE] = {0, 1, 2,
+							      2, 1, 3};
+	struct vec3 *points = data->points + idx * BATCH_VERTS_PER_SPRITE;
+	struct vec2 *tvarray = (struct vec2 *)data->tvarray[0].array +
+			       idx * BATCH_VERTS_PER_SPRITE;
+	float start_u, end_u;
+	float start_v, end_v;
+	struct vec3 corners[4];
+	struct vec2 uvs[4];
+
+	if (gs_texture_is_rect(tex)) {
+		float width = (float)gs_texture_get_width(tex);
+		float height = (float)gs_texture_get_height(tex);
+
+		assign_sprite_rect(&start_u, &end_u, width,
+				   (flip & GS_FLIP_U) != 0);
+		assign_sprite_rect(&start_v, &end_v, height,
+				   (flip & GS_FLIP_V) != 0);
+	} else {
+		assign_sprite_uv(&start_u, &end_u, (flip & GS_FLIP_U) != 0);
+		assign_sprite_uv(&start_v, &end_v, (flip & GS_FLIP_V) != 0);
+	}
+
+	vec3_zero(&corners[0]);
+	vec3_set(&corners[1], fcx, 0.0f, 0.0f);
+	vec3_set(&corners[2], 0.0f, fcy, 0.0f);
+	vec3_set(&corners[3], fcx, fcy, 0.0f);
+	vec2_set(&uvs[0], start_u, start_v);
+	vec2_set(&uvs[1], end_u, start_v);
+	vec2_set(&uvs[2], start_u, end_v);
+	vec2_set(&uvs[3], end_u, end_v);
+
+	for (size_t i = 0; i < 4; i++)
+		vec3_transform(&corners[i], &corners[i], mat);
+
+	for (size_t i = 0; i < BATCH_VERTS_PER_SPRITE; i++) {
+		vec3_copy(points + i, &corners[order[i]]);
+		vec2_copy(tvarray + i, &uvs[order[i]]);
+	}
+}
+
+void gs_sprite_batch_draw(gs_texture_t *tex, uint32_t flip, uint32_t width,
+			  uint32_t height)
+{
+	graphics_t *graphics = thread_graphics;
+	struct gs_sprite_run *run;
+	struct matrix4 mat;
+	float fcx, fcy;
+
+	if (!gs_valid_p("gs_sprite_batch_draw", tex))
+		return;
+	if (!graphics->batching) {
+		blog(LOG_ERROR, "gs_sprite_batch_draw: not batching");
+		return;
+	}
+	if (gs_get_texture_type(tex) != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "A sprite must be a 2D texture");
+		return;
+	}
+
+	if (graphics->batch_sprites == MAX_BATCH_SPRITES)
+		sprite_batch_flush(graphics);
+
+	fcx = width ? (float)width : (float)gs_texture_get_width(tex);
+	fcy = height ? (float)height : (float)gs_texture_get_height(tex);
+
+	gs_matrix_get(&mat);
+	batch_sprite(gs_vertexbuffer_get_data(graphics->batch_buffer),
+		     graphics->batch_sprites, &mat, tex, fcx, fcy, flip);
+
+	run = graphics->batch_runs.num ? da_end(graphics->batch_runs) : NULL;
+	if (!run || run->tex != tex) {
+		run = da_push_back_new(graphics->batch_runs);
+		run->tex = tex;
+		run->start = (uint32_t)graphics->batch_sprites;
+	}
+
+	run->count++;
+	graphics->batch_sprites++;
+}
+
+void gs_sprite_batch_flush(void)
+{
+	if (!gs_valid("gs_sprite_batch_flush"))
+		return;
+
+	sprite_batch_flush(thread_graphics);
+}
+
+uint32_t gs_sprite_batch_end(void)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid("gs_sprite_batch_end"))
+		return 0;
+	if (!graphics->batching)
+		return 0;
+
+	sprite_batch_flush(graphics);
+	graphics->batching = false;
+	graphics->batch_image = NULL;
+	return graphics->batch_draws;
+}
+
 void gs_draw_cube_backdrop(gs_texture_t *cubetex, const struct quat *rot,
 			   float left, float right, float top, float bottom,
 			   float znear)
@@ -2336,6 +2530,22 @@ void gs_texture_unmap(gs_texture_t *tex)
 	graphics->exports.gs_texture_unmap(tex);
 }
 
+bool gs_texture_set_image_region(gs_texture_t *tex, uint32_t x, uint32_t y,
+				 uint32_t width, uint32_t height,
+				 const uint8_t *data, uint32_t linesize)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p2("gs_texture_set_image_region", tex, data))
+		return false;
+
+	if (graphics->exports.gs_texture_set_image_region)
+		return graphics->exports.gs_texture_set_image_region(
+			tex, x, y, width, height, data, linesize);
+	else
+		return false;
+}
+
 bool gs_texture_is_rect(const gs_texture_t *tex)
 {
 	graphics_t *graphics = thread_graphics;
@@ -498,6 +498,7 @@ struct gs_init_data {
 
 #define GS_DEVICE_OPENGL 1
 #define GS_DEVICE_DIRECT3D_11 2
+#define GS_DEVICE_SOFTWARE 3
 
 EXPORT const char *gs_get_device_name(void);
 EXPORT int gs_get_device_type(void);
@@ -586,6 +587,25 @@ EXPORT void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip,
 				     uint32_t x, uint32_t y, uint32_t cx,
 				     uint32_t cy);
 
+/**
+ * Sprite batching
+ *
+ *   Sprites drawn between gs_sprite_batch_begin and gs_sprite_batch_end are
+ * transformed with the current matrix and collected into one vertex buffer,
+ * which is uploaded once and drawn with one call per run of sprites that use
+ * the same texture.  The current effect technique pass must stay the same for
+ * the whole batch, the textures must stay valid until the batch is flushed,
+ * and nothing else may be drawn in between without calling
+ * gs_sprite_batch_flush first.
+ *
+ *   gs_sprite_batch_end returns the number of draw calls issued for the batch.
+ */
+EXPORT void gs_sprite_batch_begin(gs_eparam_t *image);
+EXPORT void gs_sprite_batch_draw(gs_texture_t *tex, uint32_t flip,
+				 uint32_t width, uint32_t height);
+EXPORT void gs_sprite_batch_flush(void);
+EXPORT uint32_t gs_sprite_batch_end(void);
+
 EXPORT void gs_draw_cube_backdrop(gs_texture_t *cubetex, const struct quat *rot,
 				  float left, float right, float top,
 				  float bottom, float znear);
@@ -748,6 +768,12 @@ gs_texture_get_color_format(const gs_texture_t *tex);
 EXPORT bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr,
 			   uint32_t *linesize);
 EXPORT void gs_texture_unmap(gs_texture_t *tex);
+/** special-case function (GL only) - uploads only a region of the texture,
+ * keeping the rest of its contents.  Returns false if it isn't supported. */
+EXPORT bool gs_texture_set_image_region(gs_texture_t *tex, uint32_t x,
+					uint32_t y, uint32_t width,
+					uint32_t height, const uint8_t *data,
+					uint32_t linesize);
 /** special-case function (GL only) - specifies whether the texture is a
  * GL_TEXTURE_RECTANGLE type, which doesn't use normalized texture
  * coordinates, doesn't support mipmapping, and requires address clamping */
@@ -29,9 +29,6 @@
 #include "audio-io.h"
 #include "audio-resampler.h"
 
-//PRISM/LiuHaibin/20200213/#214/for outro
-#include "obs-internal.h"
-
 extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
 /* #define DEBUG_AUDIO */
@@ -173,39 +170,6 @@ static inline void do_audio_output(struct audio_output *audio, size_t mix_idx,
 	pthread_mutex_unlock(&audio->input_mutex);
 }
 
-/* ------------------------------------------------------------------------- */
-//PRISM/LiuHaibin/20200213/#214/for outro
-static inline void do_audio_output_for_outro(struct audio_output *audio,
-					     uint64_t timestamp,
-					     uint32_t frames,
-					     obs_outro_t *outro)
-{
-	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
-		struct audio_mix *mix = &audio->mixes[mix_idx];
-		struct audio_data data;
-
-		pthread_mutex_lock(&audio->input_mutex);
-
-		for (size_t i = mix->inputs.num; i > 0; i--) {
-			struct audio_input *input = mix->inputs.array + (i - 1);
-
-			for (size_t i = 0; i < audio->planes; i++)
-				data.data[i] =
-					(uint8_t *)
-						outro->fake_audio_mix_buffer[i];
-			data.frames = frames;
-			data.timestamp = timestamp;
-
-			if (resample_audio_output(input, &data))
-				input->callback(input->param, mix_idx, &data);
-		}
-
-		pthread_mutex_unlock(&audio->input_mutex);
-	}
-}
-//End
-/* ------------------------------------------------------------------------- */
-
 static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
 {
 	size_t float_size = bytes / sizeof(float);
@@ -277,18 +241,6 @@ static void input_and_output(struct audio_output *audio, uint64_t audio_time,
 	clamp_audio_output(audio, bytes);
 
 	/* output */
-
-	/* ------------------------------------------------------------------------- */
-	//PRISM/LiuHaibin/20200213/#214/for outro
-	obs_outro_t *outro = obs_get_outro();
-	if (obs_outro_active(outro)) {
-		do_audio_output_for_outro(audio, new_ts, AUDIO_OUTPUT_FRAMES,
-					  outro);
-		return;
-	}
-	//End
-	/* ------------------------------------------------------------------------- */
-
 	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
 		do_audio_output(audio, i, new_ts, AUDIO_OUTPUT_FRAMES);
 }
@@ -32,31 +32,66 @@
 
 extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
-#define MAX_CONVERT_BUFFERS 3
 #define MAX_CACHE_SIZE 16
 
 struct cached_frame_info {
 	struct video_data frame;
+	uint64_t id;
 	int skipped;
 	int count;
+
+	/* held by the video thread until it has passed the frame to every
+	 * input, and by each input that has the frame queued */
+	long refs;
 };
 
-struct video_input {
+/* cached frame queued for an input, passed to its callback count times */
+struct input_frame {
+	size_t cache_idx;
+	uint64_t timestamp;
+	int count;
+};
+
+/* Scaled copies of the cached frames for one conversion.  Inputs that ask for
+ * the same conversion share a target, so every frame is only scaled once for
+ * all of them, by whichever input gets to it first.
+ *
+ * frames[idx] follows the refs of cache[idx]: it is only rescaled when the
+ * cached frame has a new id, and video_output_lock_frame only gives the slot
+ * a new frame once no input holds it any more, so no input can still be
+ * reading the old scaled copy. */
+struct video_scale_target {
 	struct video_scale_info conversion;
 	video_scaler_t *scaler;
-	struct video_frame frame[MAX_CONVERT_BUFFERS];
-	int cur_frame;
+	long refs;
+
+	pthread_mutex_t mutex;
+	struct video_frame frames[MAX_CACHE_SIZE];
+	uint64_t frame_ids[MAX_CACHE_SIZE];
+};
+
+struct video_input {
+	struct video_scale_info conversion;
+	struct video_scale_target *target;
 
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
-};
 
-static inline void video_input_free(struct video_input *input)
-{
-	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-		video_frame_free(&input->frame[i]);
-	video_scaler_destroy(input->scaler);
-}
+	struct video_output *video;
+	pthread_t thread;
+	bool thread_created;
+	os_sem_t *sem;
+	volatile bool stop;
+
+	/* protected by the data mutex of the video output */
+	struct input_frame queue[MAX_CACHE_SIZE];
+	size_t queue_start;
+	size_t queue_num;
+	size_t pending;
+
+	volatile long skipped_frames;
+	volatile long total_frames;
+};
 
 struct video_output {
 	struct video_output_info info;
@@ -73,12 +108,19 @@ struct video_output {
 	bool initialized;
 
 	pthread_mutex_t input_mutex;
-	DARRAY(struct video_input) inputs;
+	DARRAY(struct video_input *) inputs;
+	DARRAY(struct video_scale_target *) scale_targets;
+
+	/* inputs that disconnected themselves from their own callback, their
+	 * threads are joined by the next call that isn't made from them */
+	DARRAY(struct video_input *) removed_inputs;
 
 	size_t available_frames;
 	size_t first_added;
 	size_t last_added;
 	struct cached_frame_info cache[MAX_CACHE_SIZE];
+	uint64_t next_frame_id;
+	size_t input_queue_size;
 
 	volatile bool raw_active;
 	volatile long gpu_refs;
@@ -86,82 +128,321 @@ struct video_output {
 
 /* ------------------------------------------------------------------------- */
 
-static inline bool scale_video_output(struct video_input *input,
-				      struct video_data *data)
+static inline bool same_conversion(const struct video_scale_info *a,
+				   const struct video_scale_info *b)
+{
+	return a->format == b->format && a->width == b->width &&
+	       a->height == b->height && a->range == b->range &&
+	       a->colorspace == b->colorspace;
+}
+
+static void video_scale_target_destroy(struct video_scale_target *target)
+{
+	for (size_t i = 0; i < MAX_CACHE_SIZE; i++)
+		video_frame_free(&target->frames[i]);
+	video_scaler_destroy(target->scaler);
+	pthread_mutex_destroy(&target->mutex);
+	bfree(target);
+}
+
+/* call with input_mutex locked */
+static struct video_scale_target *
+video_scale_target_get(struct video_output *video,
+		       const struct video_scale_info *conversion)
+{
+	struct video_scale_target *target;
+	struct video_scale_info from = {.format = video->info.format,
+					.width = video->info.width,
+					.height = video->info.height,
+					.range = video->info.range,
+					.colorspace = video->info.colorspace};
+
+	for (size_t i = 0; i < video->scale_targets.num; i++) {
+		target = video->scale_targets.array[i];
+
+		if (same_conversion(&target->conversion, conversion)) {
+			target->refs++;
+			return target;
+		}
+	}
+
+	target = bzalloc(sizeof(struct video_scale_target));
+	target->conversion = *conversion;
+	target->refs = 1;
+
+	if (pthread_mutex_init(&target->mutex, NULL) != 0) {
+		blog(LOG_ERROR, "video_input_init: Failed to create mutex");
+		bfree(target);
+		return NULL;
+	}
+
+	/* the scaler gets some threads of its own for large frames, as
+	 * several inputs may be waiting for the same scaled frame */
+	int ret = video_scaler_create_threaded(
+		&target->scaler, conversion, &from, VIDEO_SCALE_FAST_BILINEAR,
+		os_get_logical_cores() / 2);
+	if (ret != VIDEO_SCALER_SUCCESS) {
+		if (ret == VIDEO_SCALER_BAD_CONVERSION)
+			blog(LOG_ERROR, "video_input_init: Bad "
+					"scale conversion type");
+		else
+			blog(LOG_ERROR, "video_input_init: Failed to "
+					"create scaler");
+
+		video_scale_target_destroy(target);
+		return NULL;
+	}
+
+	da_push_back(video->scale_targets, &target);
+	return target;
+}
+
+/* call with input_mutex locked */
+static void video_scale_target_release(struct video_output *video,
+				       struct video_scale_target *target)
+{
+	if (!target || --target->refs > 0)
+		return;
+
+	da_erase_item(video->scale_targets, &target);
+	video_scale_target_destroy(target);
+}
+
+static void video_input_free(struct video_input *input)
+{
+	struct video_output *video = input->video;
+
+	if (input->thread_created) {
+		os_atomic_set_bool(&input->stop, true);
+		os_sem_post(input->sem);
+		pthread_join(input->thread, NULL);
+	}
+
+	pthread_mutex_lock(&video->input_mutex);
+	video_scale_target_release(video, input->target);
+	pthread_mutex_unlock(&video->input_mutex);
+
+	os_sem_destroy(input->sem);
+	bfree(input);
+}
+
+/* The input holds a reference to the cached frame until its callback has
+ * returned, so the frame can't be replaced by a newer one and neither can its
+ * scaled copy, which is only read outside of the target mutex. */
+static inline bool scale_video_output(struct video_input *input, size_t idx,
+				      uint64_t id, struct video_data *data)
 {
+	struct video_scale_target *target = input->target;
+	struct video_frame *frame;
 	bool success = true;
 
-	if (input->scaler) {
-		struct video_frame *frame;
+	if (!target)
+		return true;
+
+	frame = &target->frames[idx];
 
-		if (++input->cur_frame == MAX_CONVERT_BUFFERS)
-			input->cur_frame = 0;
+	pthread_mutex_lock(&target->mutex);
 
-		frame = &input->frame[input->cur_frame];
+	if (target->frame_ids[idx] != id) {
+		if (!frame->data[0])
+			video_frame_init(frame, target->conversion.format,
+					 target->conversion.width,
+					 target->conversion.height);
 
-		success = video_scaler_scale(input->scaler, frame->data,
+		success = video_scaler_scale(target->scaler, frame->data,
 					     frame->linesize,
 					     (const uint8_t *const *)data->data,
 					     data->linesize);
 
-		if (success) {
-			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-				data->data[i] = frame->data[i];
-				data->linesize[i] = frame->linesize[i];
-			}
-		} else {
-			blog(LOG_WARNING, "video-io: Could not scale frame!");
+		target->frame_ids[idx] = success ? id : 0;
+	}
+
+	pthread_mutex_unlock(&target->mutex);
+
+	if (success) {
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			data->data[i] = frame->data[i];
+			data->linesize[i] = frame->linesize[i];
 		}
+	} else {
+		blog(LOG_WARNING, "video-io: Could not scale frame!");
 	}
 
 	return success;
 }
 
-static inline bool video_output_cur_frame(struct video_output *video)
+/* call with data_mutex locked */
+static inline void release_cached_frame(struct video_output *video,
+					size_t idx)
 {
-	struct cached_frame_info *frame_info;
-	bool complete;
-	bool skipped;
+	if (--video->cache[idx].refs == 0) {
+		if (++video->available_frames == video->info.cache_size)
+			video->last_added = video->first_added;
+	}
+}
 
-	/* -------------------------------- */
+/* call with data_mutex locked, returns true if the frame was skipped for the
+ * input */
+static bool video_input_queue_frame(struct video_input *input, size_t idx,
+				    uint64_t timestamp)
+{
+	struct video_output *video = input->video;
+	struct input_frame *last = NULL;
+	bool skipped = false;
+
+	if (input->queue_num) {
+		size_t last_idx = input->queue_start + input->queue_num - 1;
+		last = &input->queue[last_idx % MAX_CACHE_SIZE];
+	}
+
+	if (last && last->cache_idx == idx) {
+		last->count++;
+
+	} else if (last && input->pending >= video->input_queue_size) {
+		/* the input is lagging behind, so repeat the last frame it
+		 * has queued rather than holding on to more of the cache,
+		 * which would stall the other inputs as well */
+		last->count++;
+		os_atomic_inc_long(&input->skipped_frames);
+		skipped = true;
+
+	} else {
+		size_t new_idx = input->queue_start + input->queue_num++;
+		struct input_frame *queued =
+			&input->queue[new_idx % MAX_CACHE_SIZE];
+
+		queued->cache_idx = idx;
+		queued->timestamp = timestamp;
+		queued->count = 1;
+		video->cache[idx].refs++;
+	}
+
+	input->pending++;
+	os_sem_post(input->sem);
+	return skipped;
+}
+
+static void *video_input_thread(void *param)
+{
+	struct video_input *input = param;
+	struct video_output *video = input->video;
+
+	os_set_thread_name("video-io: input thread");
+
+	const char *input_thread_name =
+		profile_store_name(obs_get_profiler_name_store(),
+				   "video_input_thread(%s)", video->info.name);
+
+	while (os_sem_wait(input->sem) == 0) {
+		struct input_frame *queued;
+		struct video_data frame;
+		uint64_t id;
+		size_t idx;
+		bool last;
+
+		if (os_atomic_load_bool(&input->stop))
+			break;
+
+		pthread_mutex_lock(&video->data_mutex);
+
+		queued = &input->queue[input->queue_start];
+		idx = queued->cache_idx;
+		frame = video->cache[idx].frame;
+		frame.timestamp = queued->timestamp;
+		id = video->cache[idx].id;
+		queued->timestamp += video->frame_time;
+
+		last = --queued->count == 0;
+		if (last) {
+			if (++input->queue_start == MAX_CACHE_SIZE)
+				input->queue_start = 0;
+			input->queue_num--;
+		}
+		input->pending--;
+
+		pthread_mutex_unlock(&video->data_mutex);
+
+		profile_start(input_thread_name);
+
+		if (scale_video_output(input, idx, id, &frame))
+			input->callback(input->param, &frame);
+
+		profile_end(input_thread_name);
+
+		os_atomic_inc_long(&input->total_frames);
+
+		if (last) {
+			pthread_mutex_lock(&video->data_mutex);
+			release_cached_frame(video, idx);
+			pthread_mutex_unlock(&video->data_mutex);
+		}
+
+		profile_reenable_thread();
+	}
 
 	pthread_mutex_lock(&video->data_mutex);
 
-	frame_info = &video->cache[video->first_added];
+	while (input->queue_num) {
+		release_cached_frame(video,
+				     input->queue[input->queue_start].cache_idx);
+		if (++input->queue_start == MAX_CACHE_SIZE)
+			input->queue_start = 0;
+		input->queue_num--;
+	}
+	input->pending = 0;
 
 	pthread_mutex_unlock(&video->data_mutex);
 
+	return NULL;
+}
+
+/* hands the current frame to the queue of every input, each input scales and
+ * processes it on its own thread so a slow encoder doesn't hold up the
+ * others */
+static inline bool video_output_cur_frame(struct video_output *video)
+{
+	struct cached_frame_info *frame_info;
+	bool input_skipped = false;
+	bool complete;
+	bool skipped;
+	size_t idx;
+
 	/* -------------------------------- */
 
 	pthread_mutex_lock(&video->input_mutex);
+	pthread_mutex_lock(&video->data_mutex);
+
+	idx = video->first_added;
+	frame_info = &video->cache[idx];
 
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array + i;
-		struct video_data frame = frame_info->frame;
+		struct video_input *input = video->inputs.array[i];
 
-		if (scale_video_output(input, &frame))
-			input->callback(input->param, &frame);
+		if (video_input_queue_frame(input, idx,
+					    frame_info->frame.timestamp))
+			input_skipped = true;
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
 
 	/* -------------------------------- */
 
-	pthread_mutex_lock(&video->data_mutex);
-
 	frame_info->frame.timestamp += video->frame_time;
 	complete = --frame_info->count == 0;
 	skipped = frame_info->skipped > 0;
 
+	if (!complete && skipped) {
+		--frame_info->skipped;
+		os_atomic_inc_long(&video->skipped_frames);
+	} else if (input_skipped) {
+		os_atomic_inc_long(&video->skipped_frames);
+	}
+
 	if (complete) {
 		if (++video->first_added == video->info.cache_size)
 			video->first_added = 0;
 
-		if (++video->available_frames == video->info.cache_size)
-			video->last_added = video->first_added;
-	} else if (skipped) {
-		--frame_info->skipped;
-		os_atomic_inc_long(&video->skipped_frames);
+		release_cached_frame(video, idx);
 	}
 
 	pthread_mutex_unlock(&video->data_mutex);
@@ -221,6 +502,12 @@ static inline void init_cache(struct video_output *video)
 	}
 
 	video->available_frames = video->info.cache_size;
+
+	/* deep enough to smooth out uneven encode times, while a lagging
+	 * input never holds more than half of the cache */
+	video->input_queue_size = video->info.cache_size / 2;
+	if (!video->input_queue_size)
+		video->input_queue_size = 1;
 }
 
 int video_output_open(video_t **video, struct video_output_info *info)
@@ -275,9 +562,14 @@ void video_output_close(video_t *video)
 	video_output_stop(video);
 
 	for (size_t i = 0; i < video->inputs.num; i++)
-		video_input_free(&video->inputs.array[i]);
+		video_input_free(video->inputs.array[i]);
 	da_free(video->inputs);
 
+	for (size_t i = 0; i < video->removed_inputs.num; i++)
+		video_input_free(video->removed_inputs.array[i]);
+	da_free(video->removed_inputs);
+	da_free(video->scale_targets);
+
 	for (size_t i = 0; i < video->info.cache_size; i++)
 		video_frame_free((struct video_frame *)&video->cache[i]);
 
@@ -293,7 +585,7 @@ static size_t video_get_input_idx(const video_t *video,
 				  void *param)
 {
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array + i;
+		struct video_input *input = video->inputs.array[i];
 		if (input->callback == callback && input->param == param)
 			return i;
 	}
@@ -307,37 +599,52 @@ static inline bool video_input_init(struct video_input *input,
 	if (input->conversion.width != video->info.width ||
 	    input->conversion.height != video->info.height ||
 	    input->conversion.format != video->info.format) {
-		struct video_scale_info from = {.format = video->info.format,
-						.width = video->info.width,
-						.height = video->info.height,
-						.range = video->info.range,
-						.colorspace =
-							video->info.colorspace};
-
-		int ret = video_scaler_create(&input->scaler,
-					      &input->conversion, &from,
-					      VIDEO_SCALE_FAST_BILINEAR);
-		if (ret != VIDEO_SCALER_SUCCESS) {
-			if (ret == VIDEO_SCALER_BAD_CONVERSION)
-				blog(LOG_ERROR, "video_input_init: Bad "
-						"scale conversion type");
-			else
-				blog(LOG_ERROR, "video_input_init: Failed to "
-						"create scaler");
-
+		input->target = video_scale_target_get(video,
+						       &input->conversion);
+		if (!input->target)
 			return false;
-		}
+	}
 
-		for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-			video_frame_init(&input->frame[i],
-					 input->conversion.format,
-					 input->conversion.width,
-					 input->conversion.height);
+	if (os_sem_init(&input->sem, 0) != 0) {
+		blog(LOG_ERROR, "video_input_init: Failed to create semaphore");
+		return false;
 	}
 
+	if (pthread_create(&input->thread, NULL, video_input_thread, input) !=
+	    0) {
+		blog(LOG_ERROR, "video_input_init: Failed to create thread");
+		return false;
+	}
+
+	input->thread_created = true;
 	return true;
 }
 
+static void video_output_reap_inputs(struct video_output *video)
+{
+	DARRAY(struct video_input *) removed;
+	da_init(removed);
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	for (size_t i = 0; i < video->removed_inputs.num;) {
+		struct video_input *input = video->removed_inputs.array[i];
+
+		if (pthread_equal(input->thread, pthread_self())) {
+			i++;
+		} else {
+			da_push_back(removed, &input);
+			da_erase(video->removed_inputs, i);
+		}
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+
+	for (size_t i = 0; i < removed.num; i++)
+		video_input_free(removed.array[i]);
+	da_free(removed);
+}
+
 static inline void reset_frames(video_t *video)
 {
 	os_atomic_set_long(&video->skipped_frames, 0);
@@ -353,29 +660,32 @@ bool video_output_connect(
 	if (!video || !callback)
 		return false;
 
+	video_output_reap_inputs(video);
+
 	pthread_mutex_lock(&video->input_mutex);
 
 	if (video_get_input_idx(video, callback, param) == DARRAY_INVALID) {
-		struct video_input input;
-		memset(&input, 0, sizeof(input));
+		struct video_input *input =
+			bzalloc(sizeof(struct video_input));
 
-		input.callback = callback;
-		input.param = param;
+		input->callback = callback;
+		input->param = param;
+		input->video = video;
 
 		if (conversion) {
-			input.conversion = *conversion;
+			input->conversion = *conversion;
 		} else {
-			input.conversion.format = video->info.format;
-			input.conversion.width = video->info.width;
-			input.conversion.height = video->info.height;
+			input->conversion.format = video->info.format;
+			input->conversion.width = video->info.width;
+			input->conversion.height = video->info.height;
 		}
 
-		if (input.conversion.width == 0)
-			input.conversion.width = video->info.width;
-		if (input.conversion.height == 0)
-			input.conversion.height = video->info.height;
+		if (input->conversion.width == 0)
+			input->conversion.width = video->info.width;
+		if (input->conversion.height == 0)
+			input->conversion.height = video->info.height;
 
-		success = video_input_init(&input, video);
+		success = video_input_init(input, video);
 		if (success) {
 			if (video->inputs.num == 0) {
 				if (!os_atomic_load_long(&video->gpu_refs)) {
@@ -384,6 +694,8 @@ bool video_output_connect(
 				os_atomic_set_bool(&video->raw_active, true);
 			}
 			da_push_back(video->inputs, &input);
+		} else {
+			video_input_free(input);
 		}
 	}
 
@@ -414,6 +726,8 @@ void video_output_disconnect(video_t *video,
 					      struct video_data *frame),
 			     void *param)
 {
+	struct video_input *input = NULL;
+
 	if (!video || !callback)
 		return;
 
@@ -421,7 +735,7 @@ void video_output_disconnect(video_t *video,
 
 	size_t idx = video_get_input_idx(video, callback, param);
 	if (idx != DARRAY_INVALID) {
-		video_input_free(video->inputs.array + idx);
+		input = video->inputs.array[idx];
 		da_erase(video->inputs, idx);
 
 		if (video->inputs.num == 0) {
@@ -430,9 +744,23 @@ void video_output_disconnect(video_t *video,
 				log_skipped(video);
 			}
 		}
+
+		/* the thread can't be joined from its own callback */
+		if (pthread_equal(input->thread, pthread_self())) {
+			os_atomic_set_bool(&input->stop, true);
+			os_sem_post(input->sem);
+			da_push_back(video->removed_inputs, &input);
+			input = NULL;
+		}
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
+
+	/* joined outside of the mutex, the callback may still be using it */
+	if (input)
+		video_input_free(input);
+
+	video_output_reap_inputs(video);
 }
 
 bool video_output_active(const video_t *video)
@@ -451,6 +779,7 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 			     int count, uint64_t timestamp)
 {
 	struct cached_frame_info *cfi;
+	size_t next;
 	bool locked;
 
 	if (!video)
@@ -458,21 +787,41 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 
 	pthread_mutex_lock(&video->data_mutex);
 
-	if (video->available_frames == 0) {
-		video->cache[video->last_added].count += count;
-		video->cache[video->last_added].skipped += count;
+	next = video->last_added;
+	if (video->available_frames != video->info.cache_size) {
+		if (++next == video->info.cache_size)
+			next = 0;
+	}
+
+	/* inputs release their frames out of order, so the next frame of the
+	 * ring can still be held by a slow input while other ones are free.
+	 * It must not be overwritten, the input (and the scaled copy other
+	 * inputs share with it) still reads it. */
+	if (video->available_frames == 0 || video->cache[next].refs > 0) {
+		cfi = &video->cache[video->last_added];
+
+		/* the next cached frame has been handed to the inputs
+		 * already and is still in use by them, so hand out the last
+		 * one again */
+		if (cfi->count == 0) {
+			video->first_added = video->last_added;
+			cfi->refs++;
+			os_sem_post(video->update_semaphore);
+		}
+
+		cfi->count += count;
+		cfi->skipped += count;
 		locked = false;
 
 	} else {
-		if (video->available_frames != video->info.cache_size) {
-			if (++video->last_added == video->info.cache_size)
-				video->last_added = 0;
-		}
+		video->last_added = next;
 
 		cfi = &video->cache[video->last_added];
 		cfi->frame.timestamp = timestamp;
+		cfi->id = ++video->next_frame_id;
 		cfi->count = count;
 		cfi->skipped = 0;
+		cfi->refs = 1;
 
 		memcpy(frame, &cfi->frame, sizeof(*frame));
 
@@ -491,6 +840,9 @@ void video_output_unlock_frame(video_t *video)
 
 	pthread_mutex_lock(&video->data_mutex);
 
+	profile_trace_mark("frame_queued",
+			   video->cache[video->last_added].frame.timestamp);
+
 	video->available_frames--;
 	os_sem_post(video->update_semaphore);
 
@@ -558,6 +910,35 @@ uint32_t video_output_get_total_frames(const video_t *video)
 	return (uint32_t)os_atomic_load_long(&video->total_frames);
 }
 
+bool video_output_get_input_frames(
+	video_t *video, void (*callback)(void *param, struct video_data *frame),
+	void *param, uint32_t *total_frames, uint32_t *skipped_frames)
+{
+	bool found = false;
+
+	if (!video || !callback)
+		return false;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	size_t idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID) {
+		struct video_input *input = video->inputs.array[idx];
+
+		if (total_frames)
+			*total_frames = (uint32_t)os_atomic_load_long(
+				&input->total_frames);
+		if (skipped_frames)
+			*skipped_frames = (uint32_t)os_atomic_load_long(
+				&input->skipped_frames);
+		found = true;
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+
+	return found;
+}
+
 /* Note: These four functions below are a very slight bit of a hack.  If the
  * texture encoder thread is active while the raw encoder thread is active, the
  * total frame count will just be doubled while they're both active.  Which is
@@ -271,6 +271,12 @@ EXPORT double video_output_get_frame_rate(const video_t *video);
 EXPORT uint32_t video_output_get_skipped_frames(const video_t *video);
 EXPORT uint32_t video_output_get_total_frames(const video_t *video);
 
+/* frame counts of a single connected callback, skipped frames are frames
+ * repeated for it because it fell behind */
+EXPORT bool video_output_get_input_frames(
+	video_t *video, void (*callback)(void *param, struct video_data *frame),
+	void *param, uint32_t *total_frames, uint32_t *skipped_frames);
+
 extern void video_output_inc_texture_encoders(video_t *video);
 extern void video_output_dec_texture_encoders(video_t *video);
 extern void video_output_inc_texture_frames(video_t *video);
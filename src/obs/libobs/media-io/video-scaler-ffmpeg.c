@@ -16,13 +16,48 @@
 ******************************************************************************/
 
 #include "../util/bmem.h"
+#include "../util/threading.h"
 #include "video-scaler.h"
 
 #include <libswscale/swscale.h>
 
+#define MAX_SLICES 8
+
+/* frames smaller than this aren't worth splitting across threads */
+#define MIN_SLICED_PIXELS (1280 * 720)
+
+struct video_scaler;
+
+/* horizontal band of the frame, scaled by its own context */
+struct scaler_slice {
+	struct video_scaler *scaler;
+	struct SwsContext *swscale;
+	int y;
+	int height;
+
+	pthread_t thread;
+	bool thread_created;
+	os_sem_t *start;
+	bool success;
+};
+
 struct video_scaler {
 	struct SwsContext *swscale;
 	int src_height;
+
+	enum video_format src_format;
+	enum video_format dst_format;
+
+	/* the first slice is scaled on the calling thread */
+	struct scaler_slice slices[MAX_SLICES];
+	size_t num_slices;
+	os_sem_t *slices_done;
+	volatile bool stop;
+
+	const uint8_t *const *input;
+	const uint32_t *in_linesize;
+	uint8_t **output;
+	const uint32_t *out_linesize;
 };
 
 static inline enum AVPixelFormat
@@ -115,10 +150,22 @@ static inline int get_ffmpeg_range_type(enum video_range_type type)
 
 #define FIXED_1_0 (1 << 16)
 
-int video_scaler_create(video_scaler_t **scaler_out,
-			const struct video_scale_info *dst,
-			const struct video_scale_info *src,
-			enum video_scale_type type)
+static inline bool is_vertically_subsampled(enum video_format format)
+{
+	return format == VIDEO_FORMAT_I420 || format == VIDEO_FORMAT_NV12 ||
+	       format == VIDEO_FORMAT_I40A;
+}
+
+static inline int get_plane_row(enum video_format format, size_t plane,
+				int y)
+{
+	bool chroma = plane == 1 || (plane == 2 && format != VIDEO_FORMAT_NV12);
+	return chroma && is_vertically_subsampled(format) ? y / 2 : y;
+}
+
+static struct SwsContext *create_swscale(const struct video_scale_info *dst,
+					 const struct video_scale_info *src,
+					 enum video_scale_type type, int height)
 {
 	enum AVPixelFormat format_src = get_ffmpeg_video_format(src->format);
 	enum AVPixelFormat format_dst = get_ffmpeg_video_format(dst->format);
@@ -127,9 +174,151 @@ int video_scaler_create(video_scaler_t **scaler_out,
 	const int *coeff_dst = get_ffmpeg_coeffs(dst->colorspace);
 	int range_src = get_ffmpeg_range_type(src->range);
 	int range_dst = get_ffmpeg_range_type(dst->range);
-	struct video_scaler *scaler;
+	struct SwsContext *swscale;
 	int ret;
 
+	swscale = sws_getCachedContext(NULL, src->width,
+				       height ? height : (int)src->height,
+				       format_src, dst->width,
+				       height ? height : (int)dst->height,
+				       format_dst, scale_type, NULL, NULL,
+				       NULL);
+	if (!swscale)
+		return NULL;
+
+	ret = sws_setColorspaceDetails(swscale, coeff_src, range_src,
+				       coeff_dst, range_dst, 0, FIXED_1_0,
+				       FIXED_1_0);
+	if (ret < 0) {
+		blog(LOG_DEBUG, "video_scaler_create: "
+				"sws_setColorspaceDetails failed, ignoring");
+	}
+
+	return swscale;
+}
+
+static bool scale_slice(struct scaler_slice *slice)
+{
+	struct video_scaler *scaler = slice->scaler;
+	const uint8_t *input[MAX_AV_PLANES] = {0};
+	uint8_t *output[MAX_AV_PLANES] = {0};
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		int in_row = get_plane_row(scaler->src_format, i, slice->y);
+		int out_row = get_plane_row(scaler->dst_format, i, slice->y);
+
+		if (scaler->input[i])
+			input[i] = scaler->input[i] +
+				   (size_t)in_row * scaler->in_linesize[i];
+		if (scaler->output[i])
+			output[i] = scaler->output[i] +
+				    (size_t)out_row * scaler->out_linesize[i];
+	}
+
+	int ret = sws_scale(slice->swscale, input,
+			    (const int *)scaler->in_linesize, 0, slice->height,
+			    output, (const int *)scaler->out_linesize);
+	if (ret <= 0) {
+		blog(LOG_ERROR, "video_scaler_scale: sws_scale failed: %d",
+		     ret);
+		return false;
+	}
+
+	return true;
+}
+
+static void *slice_thread(void *param)
+{
+	struct scaler_slice *slice = param;
+	struct video_scaler *scaler = slice->scaler;
+
+	os_set_thread_name("video-scaler: slice thread");
+
+	while (os_sem_wait(slice->start) == 0) {
+		if (os_atomic_load_bool(&scaler->stop))
+			break;
+
+		slice->success = scale_slice(slice);
+		os_sem_post(scaler->slices_done);
+	}
+
+	return NULL;
+}
+
+/* Rows only map one to one between source and destination if neither the
+ * height nor the vertical chroma subsampling changes.  Otherwise the
+ * vertical filters would need rows of neighbouring slices, and scaling the
+ * slices independently would leave seams. */
+static size_t get_num_slices(const struct video_scale_info *dst,
+			     const struct video_scale_info *src, int threads)
+{
+	if (threads < 2 || dst->height != src->height ||
+	    is_vertically_subsampled(dst->format) !=
+		    is_vertically_subsampled(src->format))
+		return 1;
+	if ((uint64_t)dst->width * dst->height < MIN_SLICED_PIXELS)
+		return 1;
+
+	return threads > MAX_SLICES ? MAX_SLICES : (size_t)threads;
+}
+
+static bool init_slices(struct video_scaler *scaler,
+			const struct video_scale_info *dst,
+			const struct video_scale_info *src,
+			enum video_scale_type type, size_t num_slices)
+{
+	/* even heights keep subsampled chroma rows within a slice */
+	int height = (int)dst->height;
+	int slice_height = (height / (int)num_slices) & ~1;
+
+	if (os_sem_init(&scaler->slices_done, 0) != 0)
+		return false;
+
+	for (size_t i = 0; i < num_slices; i++) {
+		struct scaler_slice *slice = &scaler->slices[i];
+		int y = (int)i * slice_height;
+
+		slice->scaler = scaler;
+		slice->y = y;
+		slice->height = i == num_slices - 1 ? height - y : slice_height;
+		slice->swscale = create_swscale(dst, src, type, slice->height);
+		scaler->num_slices++;
+
+		if (!slice->swscale)
+			return false;
+		if (i == 0)
+			continue;
+
+		if (os_sem_init(&slice->start, 0) != 0)
+			return false;
+		if (pthread_create(&slice->thread, NULL, slice_thread, slice) !=
+		    0)
+			return false;
+
+		slice->thread_created = true;
+	}
+
+	return true;
+}
+
+int video_scaler_create(video_scaler_t **scaler_out,
+			const struct video_scale_info *dst,
+			const struct video_scale_info *src,
+			enum video_scale_type type)
+{
+	return video_scaler_create_threaded(scaler_out, dst, src, type, 1);
+}
+
+int video_scaler_create_threaded(video_scaler_t **scaler_out,
+				 const struct video_scale_info *dst,
+				 const struct video_scale_info *src,
+				 enum video_scale_type type, int threads)
+{
+	enum AVPixelFormat format_src = get_ffmpeg_video_format(src->format);
+	enum AVPixelFormat format_dst = get_ffmpeg_video_format(dst->format);
+	struct video_scaler *scaler;
+	size_t num_slices;
+
 	if (!scaler_out)
 		return VIDEO_SCALER_FAILED;
 
@@ -138,23 +327,25 @@ int video_scaler_create(video_scaler_t **scaler_out,
 
 	scaler = bzalloc(sizeof(struct video_scaler));
 	scaler->src_height = src->height;
+	scaler->src_format = src->format;
+	scaler->dst_format = dst->format;
 
-	scaler->swscale = sws_getCachedContext(NULL, src->width, src->height,
-					       format_src, dst->width,
-					       dst->height, format_dst,
-					       scale_type, NULL, NULL, NULL);
-	if (!scaler->swscale) {
-		blog(LOG_ERROR, "video_scaler_create: Could not create "
-				"swscale");
-		goto fail;
-	}
+	num_slices = get_num_slices(dst, src, threads);
 
-	ret = sws_setColorspaceDetails(scaler->swscale, coeff_src, range_src,
-				       coeff_dst, range_dst, 0, FIXED_1_0,
-				       FIXED_1_0);
-	if (ret < 0) {
-		blog(LOG_DEBUG, "video_scaler_create: "
-				"sws_setColorspaceDetails failed, ignoring");
+	if (num_slices > 1) {
+		if (!init_slices(scaler, dst, src, type, num_slices)) {
+			blog(LOG_ERROR, "video_scaler_create: Could not "
+					"create scaler slices");
+			goto fail;
+		}
+
+	} else {
+		scaler->swscale = create_swscale(dst, src, type, 0);
+		if (!scaler->swscale) {
+			blog(LOG_ERROR, "video_scaler_create: Could not create "
+					"swscale");
+			goto fail;
+		}
 	}
 
 	*scaler_out = scaler;
@@ -168,6 +359,21 @@ fail:
 void video_scaler_destroy(video_scaler_t *scaler)
 {
 	if (scaler) {
+		os_atomic_set_bool(&scaler->stop, true);
+
+		for (size_t i = 0; i < scaler->num_slices; i++) {
+			struct scaler_slice *slice = &scaler->slices[i];
+
+			if (slice->thread_created) {
+				os_sem_post(slice->start);
+				pthread_join(slice->thread, NULL);
+			}
+
+			os_sem_destroy(slice->start);
+			sws_freeContext(slice->swscale);
+		}
+
+		os_sem_destroy(scaler->slices_done);
 		sws_freeContext(scaler->swscale);
 		bfree(scaler);
 	}
@@ -181,6 +387,27 @@ bool video_scaler_scale(video_scaler_t *scaler, uint8_t *output[],
 	if (!scaler)
 		return false;
 
+	if (scaler->num_slices) {
+		bool success;
+
+		scaler->input = input;
+		scaler->in_linesize = in_linesize;
+		scaler->output = output;
+		scaler->out_linesize = out_linesize;
+
+		for (size_t i = 1; i < scaler->num_slices; i++)
+			os_sem_post(scaler->slices[i].start);
+
+		success = scale_slice(&scaler->slices[0]);
+
+		for (size_t i = 1; i < scaler->num_slices; i++) {
+			os_sem_wait(scaler->slices_done);
+			success = success && scaler->slices[i].success;
+		}
+
+		return success;
+	}
+
 	int ret = sws_scale(scaler->swscale, input, (const int *)in_linesize, 0,
 			    scaler->src_height, output,
 			    (const int *)out_linesize);
@@ -35,6 +35,15 @@ EXPORT int video_scaler_create(video_scaler_t **scaler,
 			       const struct video_scale_info *dst,
 			       const struct video_scale_info *src,
 			       enum video_scale_type type);
+
+/* Large frames are split into horizontal slices that are scaled on up to
+ * the given number of threads at once, as long as the rows of the frame map
+ * one to one (same height and vertical chroma subsampling) */
+EXPORT int video_scaler_create_threaded(video_scaler_t **scaler,
+					const struct video_scale_info *dst,
+					const struct video_scale_info *src,
+					enum video_scale_type type,
+					int threads);
 EXPORT void video_scaler_destroy(video_scaler_t *scaler);
 
 EXPORT bool video_scaler_scale(video_scaler_t *scaler, uint8_t *output[],
@@ -458,7 +458,12 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 
 	/* ------------------------------------------------ */
 	/* mix audio */
-	if (!audio->buffering_wait_ticks) {
+
+	//PRISM/LiuHaibin/20200213/#214/for outro
+	/* the outputs get silence while the outro plays, the mix buffers are
+	 * cleared before every tick so the sources are just not mixed */
+	if (!audio->buffering_wait_ticks &&
+	    !obs_outro_active(obs->video.outro)) {
 		for (size_t i = 0; i < audio->root_nodes.num; i++) {
 			obs_source_t *source = audio->root_nodes.array[i];
 
@@ -26,12 +26,16 @@
 #include "graphics/quat.h"
 #include "obs-data.h"
 
-#include <jansson.h>
+#include <errno.h>
+#include <locale.h>
+#include <math.h>
 
 struct obs_data_item {
 	volatile long ref;
 	struct obs_data *parent;
 	struct obs_data_item *next;
+	struct obs_data_item *prev;
+	uint32_t hash;
 	enum obs_data_type type;
 	size_t name_len;
 	size_t data_len;
@@ -49,6 +53,13 @@ struct obs_data {
 	volatile long ref;
 	char *json;
 	struct obs_data_item *first_item;
+	struct obs_data_item *last_item;
+	size_t num_items;
+
+	/* open addressing name index, only built once an object holds enough
+	 * items for linear lookups to show up in profiles */
+	struct obs_data_item **index;
+	size_t index_size;
 };
 
 struct obs_data_array {
@@ -264,6 +275,117 @@ static inline void item_autoselect_data_addref(struct obs_data_item *item)
 	}
 }
 
+/* ------------------------------------------------------------------------- */
+/* Name index */
+
+#define INDEX_MIN_ITEMS 16
+
+static inline uint32_t get_name_hash(const char *name)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*name) {
+		hash ^= (uint8_t)*(name++);
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static void index_insert(struct obs_data *data, struct obs_data_item *item)
+{
+	size_t mask = data->index_size - 1;
+	size_t slot = item->hash & mask;
+
+	while (data->index[slot])
+		slot = (slot + 1) & mask;
+
+	data->index[slot] = item;
+}
+
+static void index_rebuild(struct obs_data *data, size_t size)
+{
+	bfree(data->index);
+	data->index = bzalloc(size * sizeof(struct obs_data_item *));
+	data->index_size = size;
+
+	for (struct obs_data_item *item = data->first_item; item;
+	     item = item->next)
+		index_insert(data, item);
+}
+
+static inline size_t index_find_slot(struct obs_data *data, uint32_t hash,
+				     const struct obs_data_item *item)
+{
+	size_t mask = data->index_size - 1;
+	size_t slot = hash & mask;
+
+	while (data->index[slot] != item)
+		slot = (slot + 1) & mask;
+
+	return slot;
+}
+
+static void index_remove(struct obs_data *data, struct obs_data_item *item)
+{
+	size_t mask = data->index_size - 1;
+	size_t slot = index_find_slot(data, item->hash, item);
+	size_t next = slot;
+
+	/* backward shift deletion, keeps probe chains intact without
+	 * tombstones */
+	for (;;) {
+		struct obs_data_item *cur;
+		size_t home;
+
+		next = (next + 1) & mask;
+		cur = data->index[next];
+		if (!cur)
+			break;
+
+		home = cur->hash & mask;
+		if (((next - home) & mask) >= ((next - slot) & mask)) {
+			data->index[slot] = cur;
+			slot = next;
+		}
+	}
+
+	data->index[slot] = NULL;
+}
+
+static struct obs_data_item *index_find(struct obs_data *data,
+					const char *name, uint32_t hash)
+{
+	size_t mask = data->index_size - 1;
+	size_t slot = hash & mask;
+	struct obs_data_item *item;
+
+	while ((item = data->index[slot]) != NULL) {
+		if (item->hash == hash && strcmp(get_item_name(item), name) == 0)
+			return item;
+
+		slot = (slot + 1) & mask;
+	}
+
+	return NULL;
+}
+
+static inline void index_add_item(struct obs_data *data,
+				  struct obs_data_item *item)
+{
+	if (data->index) {
+		if (data->num_items * 2 > data->index_size)
+			index_rebuild(data, data->index_size * 2);
+		else
+			index_insert(data, item);
+
+	} else if (data->num_items >= INDEX_MIN_ITEMS) {
+		index_rebuild(data, INDEX_MIN_ITEMS * 4);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
 static struct obs_data_item *obs_data_item_create(const char *name,
 						  const void *data, size_t size,
 						  enum obs_data_type type,
@@ -284,6 +406,7 @@ static struct obs_data_item *obs_data_item_create(const char *name,
 	item->capacity = total_size;
 	item->type = type;
 	item->name_len = name_size;
+	item->hash = get_name_hash(name);
 	item->ref = 1;
 
 	if (default_data) {
@@ -305,45 +428,95 @@ static struct obs_data_item *obs_data_item_create(const char *name,
 	return item;
 }
 
-static struct obs_data_item **get_item_prev_next(struct obs_data *data,
-						 struct obs_data_item *current)
+/* items are kept sorted by name */
+static void obs_data_item_attach(struct obs_data *data,
+				 struct obs_data_item *item)
 {
-	if (!current || !data)
-		return NULL;
+	const char *name = get_item_name(item);
+	struct obs_data_item *next = NULL;
+
+	/* saved data is already sorted, so loading it always appends */
+	if (data->last_item &&
+	    strcmp(get_item_name(data->last_item), name) > 0) {
+		next = data->first_item;
+		while (strcmp(get_item_name(next), name) < 0)
+			next = next->next;
+	}
 
-	struct obs_data_item **prev_next = &data->first_item;
-	struct obs_data_item *item = data->first_item;
+	item->parent = data;
+	item->next = next;
+	item->prev = next ? next->prev : data->last_item;
 
-	while (item) {
-		if (item == current)
-			return prev_next;
+	if (item->prev)
+		item->prev->next = item;
+	else
+		data->first_item = item;
 
-		prev_next = &item->next;
-		item = item->next;
-	}
+	if (next)
+		next->prev = item;
+	else
+		data->last_item = item;
 
-	return NULL;
+	data->num_items++;
+	index_add_item(data, item);
+}
+
+static inline bool obs_data_item_attached(struct obs_data_item *item,
+					  struct obs_data_item *ptr)
+{
+	if (!item->parent)
+		return false;
+
+	return item->prev ? item->prev->next == ptr
+			  : item->parent->first_item == ptr;
 }
 
 static inline void obs_data_item_detach(struct obs_data_item *item)
 {
-	struct obs_data_item **prev_next =
-		get_item_prev_next(item->parent, item);
+	struct obs_data *data = item->parent;
 
-	if (prev_next) {
-		*prev_next = item->next;
-		item->next = NULL;
-	}
+	if (!obs_data_item_attached(item, item))
+		return;
+
+	if (item->prev)
+		item->prev->next = item->next;
+	else
+		data->first_item = item->next;
+
+	if (item->next)
+		item->next->prev = item->prev;
+	else
+		data->last_item = item->prev;
+
+	if (data->index)
+		index_remove(data, item);
+
+	data->num_items--;
+	item->next = NULL;
+	item->prev = NULL;
 }
 
 static inline void obs_data_item_reattach(struct obs_data_item *old_ptr,
 					  struct obs_data_item *new_ptr)
 {
-	struct obs_data_item **prev_next =
-		get_item_prev_next(new_ptr->parent, old_ptr);
+	struct obs_data *data = new_ptr->parent;
+
+	if (!obs_data_item_attached(new_ptr, old_ptr))
+		return;
+
+	if (new_ptr->prev)
+		new_ptr->prev->next = new_ptr;
+	else
+		data->first_item = new_ptr;
 
-	if (prev_next)
-		*prev_next = new_ptr;
+	if (new_ptr->next)
+		new_ptr->next->prev = new_ptr;
+	else
+		data->last_item = new_ptr;
+
+	if (data->index)
+		data->index[index_find_slot(data, new_ptr->hash, old_ptr)] =
+			new_ptr;
 }
 
 static struct obs_data_item *
@@ -472,155 +645,739 @@ obs_data_item_set_autoselect_data(struct obs_data_item **p_item,
 }
 
 /* ------------------------------------------------------------------------- */
+/* JSON reading
+ *
+ * Parses straight into obs_data objects instead of going through a jansson
+ * tree.  Accepts the same documents as json_loads with
+ * JSON_REJECT_DUPLICATES; null values and array elements that aren't objects
+ * are skipped. */
+
+#define JSON_MAX_DEPTH 2048
+
+struct json_reader {
+	const char *start;
+	const char *pos;
+	struct dstr str;
+	DARRAY(struct dstr) keys;
+	size_t depth;
+	const char *error;
+};
 
-static void obs_data_add_json_item(obs_data_t *data, const char *key,
-				   json_t *json);
+static struct obs_data_item *get_item(struct obs_data *data, const char *name);
+
+/* returns the length of a valid UTF-8 sequence, or 0 */
+static inline size_t utf8_seq_len(const uint8_t *p)
+{
+	uint8_t c = p[0];
+
+	if (c < 0x80)
+		return 1;
+
+	if (c >= 0xC2 && c <= 0xDF)
+		return (p[1] & 0xC0) == 0x80 ? 2 : 0;
+
+	if (c >= 0xE0 && c <= 0xEF) {
+		if ((p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80)
+			return 0;
+		if ((c == 0xE0 && p[1] < 0xA0) || (c == 0xED && p[1] >= 0xA0))
+			return 0;
+		return 3;
+	}
+
+	if (c >= 0xF0 && c <= 0xF4) {
+		if ((p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80 ||
+		    (p[3] & 0xC0) != 0x80)
+			return 0;
+		if ((c == 0xF0 && p[1] < 0x90) || (c == 0xF4 && p[1] >= 0x90))
+			return 0;
+		return 4;
+	}
+
+	return 0;
+}
 
-static inline void obs_data_add_json_object_data(obs_data_t *data, json_t *jobj)
+/* skips characters that can appear in a JSON string as they are, returns
+ * NULL on invalid UTF-8 */
+static inline const uint8_t *json_skip_plain(const uint8_t *p)
 {
-	const char *item_key;
-	json_t *jitem;
+	for (;;) {
+		if (*p >= 0x80) {
+			size_t len = utf8_seq_len(p);
+			if (!len)
+				return NULL;
+			p += len;
+
+		} else if (*p >= 0x20 && *p != '"' && *p != '\\') {
+			p++;
 
-	json_object_foreach (jobj, item_key, jitem) {
-		obs_data_add_json_item(data, item_key, jitem);
+		} else {
+			return p;
+		}
 	}
 }
 
-static inline void obs_data_add_json_object(obs_data_t *data, const char *key,
-					    json_t *jobj)
+static inline bool json_fail(struct json_reader *r, const char *pos,
+			     const char *error)
+{
+	if (!r->error) {
+		r->pos = pos;
+		r->error = error;
+	}
+	return false;
+}
+
+static inline void json_skip_ws(struct json_reader *r)
+{
+	const char *p = r->pos;
+
+	while (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')
+		p++;
+
+	r->pos = p;
+}
+
+static inline void json_str_clear(struct dstr *str)
+{
+	dstr_ensure_capacity(str, 1);
+	str->array[0] = 0;
+	str->len = 0;
+}
+
+static inline bool json_read_hex4(const char *p, uint32_t *val)
 {
-	obs_data_t *sub_obj = obs_data_create();
+	uint32_t v = 0;
 
-	obs_data_add_json_object_data(sub_obj, jobj);
-	obs_data_set_obj(data, key, sub_obj);
-	obs_data_release(sub_obj);
+	for (size_t i = 0; i < 4; i++) {
+		char c = p[i];
+
+		v <<= 4;
+		if (c >= '0' && c <= '9')
+			v |= (uint32_t)(c - '0');
+		else if (c >= 'a' && c <= 'f')
+			v |= (uint32_t)(c - 'a' + 10);
+		else if (c >= 'A' && c <= 'F')
+			v |= (uint32_t)(c - 'A' + 10);
+		else
+			return false;
+	}
+
+	*val = v;
+	return true;
 }
 
-static void obs_data_add_json_array(obs_data_t *data, const char *key,
-				    json_t *jarray)
+static bool json_read_unicode_escape(struct json_reader *r, struct dstr *str,
+				     const char **p_pos)
 {
-	obs_data_array_t *array = obs_data_array_create();
-	size_t idx;
-	json_t *jitem;
+	const char *p = *p_pos;
+	uint32_t cp, low;
+	char utf8[4];
+	size_t len;
+
+	if (!json_read_hex4(p, &cp))
+		return json_fail(r, p, "invalid escape");
+	p += 4;
 
-	json_array_foreach (jarray, idx, jitem) {
-		obs_data_t *item;
+	if (cp >= 0xD800 && cp <= 0xDBFF) {
+		if (p[0] != '\\' || p[1] != 'u' ||
+		    !json_read_hex4(p + 2, &low) || low < 0xDC00 ||
+		    low > 0xDFFF)
+			return json_fail(r, p,
+					 "invalid Unicode surrogate pair");
+
+		cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+		p += 6;
+
+	} else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+		return json_fail(r, p, "invalid Unicode low surrogate");
+
+	} else if (cp == 0) {
+		return json_fail(r, p, "\\u0000 is not allowed");
+	}
 
-		if (!json_is_object(jitem))
+	if (cp < 0x80) {
+		utf8[0] = (char)cp;
+		len = 1;
+	} else if (cp < 0x800) {
+		utf8[0] = (char)(0xC0 | (cp >> 6));
+		utf8[1] = (char)(0x80 | (cp & 0x3F));
+		len = 2;
+	} else if (cp < 0x10000) {
+		utf8[0] = (char)(0xE0 | (cp >> 12));
+		utf8[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		utf8[2] = (char)(0x80 | (cp & 0x3F));
+		len = 3;
+	} else {
+		utf8[0] = (char)(0xF0 | (cp >> 18));
+		utf8[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+		utf8[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		utf8[3] = (char)(0x80 | (cp & 0x3F));
+		len = 4;
+	}
+
+	dstr_ncat(str, utf8, len);
+	*p_pos = p;
+	return true;
+}
+
+static bool json_read_string(struct json_reader *r, struct dstr *str)
+{
+	const char *p = r->pos + 1;
+
+	json_str_clear(str);
+
+	for (;;) {
+		const char *run = p;
+		char ch;
+
+		p = (const char *)json_skip_plain((const uint8_t *)p);
+		if (!p)
+			return json_fail(r, run, "invalid UTF-8 in string");
+
+		if (p != run)
+			dstr_ncat(str, run, p - run);
+
+		if (*p == '"')
+			break;
+		if (!*p)
+			return json_fail(r, p, "premature end of input");
+		if (*p != '\\')
+			return json_fail(r, p, "control character in string");
+
+		switch (*(++p)) {
+		case '"':
+		case '\\':
+		case '/':
+			ch = *p;
+			break;
+		case 'b':
+			ch = '\b';
+			break;
+		case 'f':
+			ch = '\f';
+			break;
+		case 'n':
+			ch = '\n';
+			break;
+		case 'r':
+			ch = '\r';
+			break;
+		case 't':
+			ch = '\t';
+			break;
+		case 'u':
+			p++;
+			if (!json_read_unicode_escape(r, str, &p))
+				return false;
 			continue;
+		default:
+			return json_fail(r, p, "invalid escape");
+		}
 
-		item = obs_data_create();
-		obs_data_add_json_object_data(item, jitem);
-		obs_data_array_push_back(array, item);
-		obs_data_release(item);
+		dstr_cat_ch(str, ch);
+		p++;
 	}
 
-	obs_data_set_array(data, key, array);
-	obs_data_array_release(array);
+	r->pos = p + 1;
+	return true;
 }
 
-static void obs_data_add_json_item(obs_data_t *data, const char *key,
-				   json_t *json)
+static inline bool is_digit(char c)
 {
-	if (json_is_object(json))
-		obs_data_add_json_object(data, key, json);
-	else if (json_is_array(json))
-		obs_data_add_json_array(data, key, json);
-	else if (json_is_string(json))
-		obs_data_set_string(data, key, json_string_value(json));
-	else if (json_is_integer(json))
-		obs_data_set_int(data, key, json_integer_value(json));
-	else if (json_is_real(json))
-		obs_data_set_double(data, key, json_real_value(json));
-	else if (json_is_true(json))
-		obs_data_set_bool(data, key, true);
-	else if (json_is_false(json))
-		obs_data_set_bool(data, key, false);
+	return c >= '0' && c <= '9';
 }
 
-/* ------------------------------------------------------------------------- */
+static bool json_read_number(struct json_reader *r, obs_data_t *data,
+			     const char *key)
+{
+	const char *start = r->pos;
+	const char *p = start;
+	bool is_real = false;
+
+	if (*p == '-')
+		p++;
+
+	if (*p == '0') {
+		if (is_digit(*(++p)))
+			return json_fail(r, p, "invalid token");
+	} else if (is_digit(*p)) {
+		while (is_digit(*p))
+			p++;
+	} else {
+		return json_fail(r, p, "invalid token");
+	}
+
+	if (*p == '.') {
+		if (!is_digit(*(++p)))
+			return json_fail(r, p, "invalid token");
+		while (is_digit(*p))
+			p++;
+		is_real = true;
+	}
+
+	if (*p == 'e' || *p == 'E') {
+		p++;
+		if (*p == '+' || *p == '-')
+			p++;
+		if (!is_digit(*p))
+			return json_fail(r, p, "invalid token");
+		while (is_digit(*p))
+			p++;
+		is_real = true;
+	}
+
+	errno = 0;
+
+	if (!is_real) {
+		long long val = strtoll(start, NULL, 10);
+
+		if (errno == ERANGE)
+			return json_fail(r, start,
+					 *start == '-'
+						 ? "too big negative integer"
+						 : "too big integer");
+		if (data)
+			obs_data_set_int(data, key, val);
+
+	} else {
+		const char *point = localeconv()->decimal_point;
+		const char *num = start;
+		double val;
+
+		/* strtod follows the locale's decimal separator */
+		if (*point != '.') {
+			dstr_ncopy(&r->str, start, p - start);
+			char *dot = strchr(r->str.array, '.');
+			if (dot)
+				*dot = *point;
+			num = r->str.array;
+		}
+
+		val = strtod(num, NULL);
+		if (errno == ERANGE && (val == HUGE_VAL || val == -HUGE_VAL))
+			return json_fail(r, start, "real number overflow");
+		if (data)
+			obs_data_set_double(data, key, val);
+	}
+
+	r->pos = p;
+	return true;
+}
+
+static bool json_read_object(struct json_reader *r, obs_data_t *data);
+static bool json_read_array(struct json_reader *r, obs_data_array_t *array);
+
+static inline bool json_read_literal(struct json_reader *r, const char *str,
+				     size_t len)
+{
+	if (strncmp(r->pos, str, len) != 0)
+		return json_fail(r, r->pos, "invalid token");
+
+	r->pos += len;
+	return true;
+}
+
+/* reads any value, storing it in data if data is not NULL */
+static bool json_read_value(struct json_reader *r, obs_data_t *data,
+			    const char *key)
+{
+	bool success;
+
+	switch (*r->pos) {
+	case '{': {
+		obs_data_t *obj = data ? obs_data_create() : NULL;
+
+		success = json_read_object(r, obj);
+		if (success && obj)
+			obs_data_set_obj(data, key, obj);
+		obs_data_release(obj);
+		return success;
+	}
+	case '[': {
+		obs_data_array_t *array = data ? obs_data_array_create() : NULL;
+
+		success = json_read_array(r, array);
+		if (success && array)
+			obs_data_set_array(data, key, array);
+		obs_data_array_release(array);
+		return success;
+	}
+	case '"':
+		if (!json_read_string(r, &r->str))
+			return false;
+		if (data)
+			obs_data_set_string(data, key, r->str.array);
+		return true;
+	case 't':
+		if (!json_read_literal(r, "true", 4))
+			return false;
+		if (data)
+			obs_data_set_bool(data, key, true);
+		return true;
+	case 'f':
+		if (!json_read_literal(r, "false", 5))
+			return false;
+		if (data)
+			obs_data_set_bool(data, key, false);
+		return true;
+	case 'n':
+		return json_read_literal(r, "null", 4);
+	case '\0':
+		return json_fail(r, r->pos, "unexpected end of input");
+	default:
+		return json_read_number(r, data, key);
+	}
+}
+
+static inline bool json_enter(struct json_reader *r)
+{
+	if (++r->depth > JSON_MAX_DEPTH)
+		return json_fail(r, r->pos, "maximum parsing depth reached");
+
+	r->pos++;
+	json_skip_ws(r);
+	return true;
+}
+
+static bool json_read_object(struct json_reader *r, obs_data_t *data)
+{
+	size_t level = r->depth;
+
+	if (!json_enter(r))
+		return false;
+
+	/* one key buffer per nesting level, reused for every object */
+	while (r->keys.num <= level)
+		da_push_back_new(r->keys);
 
-static inline void set_json_string(json_t *json, const char *name,
-				   obs_data_item_t *item)
+	if (*r->pos != '}') {
+		for (;;) {
+			/* nested objects can move the key buffer array */
+			struct dstr *key = r->keys.array + level;
+
+			if (*r->pos != '"')
+				return json_fail(r, r->pos,
+						 "string or '}' expected");
+			if (!json_read_string(r, key))
+				return false;
+			if (data && get_item(data, key->array))
+				return json_fail(r, r->pos,
+						 "duplicate object key");
+
+			json_skip_ws(r);
+			if (*r->pos != ':')
+				return json_fail(r, r->pos, "':' expected");
+
+			r->pos++;
+			json_skip_ws(r);
+
+			if (!json_read_value(r, data, key->array))
+				return false;
+
+			json_skip_ws(r);
+			if (*r->pos != ',')
+				break;
+
+			r->pos++;
+			json_skip_ws(r);
+		}
+
+		if (*r->pos != '}')
+			return json_fail(r, r->pos, "'}' expected");
+	}
+
+	r->pos++;
+	r->depth--;
+	return true;
+}
+
+static bool json_read_array(struct json_reader *r, obs_data_array_t *array)
 {
-	const char *val = obs_data_item_get_string(item);
-	json_object_set_new(json, name, json_string(val));
+	if (!json_enter(r))
+		return false;
+
+	if (*r->pos != ']') {
+		for (;;) {
+			if (array && *r->pos == '{') {
+				obs_data_t *obj = obs_data_create();
+				bool success = json_read_object(r, obj);
+
+				if (success)
+					obs_data_array_push_back(array, obj);
+				obs_data_release(obj);
+				if (!success)
+					return false;
+
+			} else if (!json_read_value(r, NULL, NULL)) {
+				return false;
+			}
+
+			json_skip_ws(r);
+			if (*r->pos != ',')
+				break;
+
+			r->pos++;
+			json_skip_ws(r);
+		}
+
+		if (*r->pos != ']')
+			return json_fail(r, r->pos, "']' expected");
+	}
+
+	r->pos++;
+	r->depth--;
+	return true;
 }
 
-static inline void set_json_number(json_t *json, const char *name,
-				   obs_data_item_t *item)
+static bool json_read_root(struct json_reader *r, obs_data_t *data)
 {
-	enum obs_data_number_type type = obs_data_item_numtype(item);
+	json_skip_ws(r);
 
-	if (type == OBS_DATA_NUM_INT) {
-		long long val = obs_data_item_get_int(item);
-		json_object_set_new(json, name, json_integer(val));
+	if (*r->pos == '{') {
+		if (!json_read_object(r, data))
+			return false;
+	} else if (*r->pos == '[') {
+		if (!json_read_array(r, NULL))
+			return false;
 	} else {
-		double val = obs_data_item_get_double(item);
-		json_object_set_new(json, name, json_real(val));
+		return json_fail(r, r->pos, "'[' or '{' expected");
+	}
+
+	json_skip_ws(r);
+	if (*r->pos)
+		return json_fail(r, r->pos, "end of file expected");
+
+	return true;
+}
+
+static int json_reader_line(struct json_reader *r)
+{
+	int line = 1;
+
+	for (const char *p = r->start; p < r->pos; p++) {
+		if (*p == '\n')
+			line++;
 	}
+
+	return line;
 }
 
-static inline void set_json_bool(json_t *json, const char *name,
-				 obs_data_item_t *item)
+static void json_reader_free(struct json_reader *r)
 {
-	bool val = obs_data_item_get_bool(item);
-	json_object_set_new(json, name, val ? json_true() : json_false());
+	for (size_t i = 0; i < r->keys.num; i++)
+		dstr_free(r->keys.array + i);
+
+	da_free(r->keys);
+	dstr_free(&r->str);
 }
 
-static json_t *obs_data_to_json(obs_data_t *data);
+/* ------------------------------------------------------------------------- */
+/* JSON writing
+ *
+ * Writes the same text json_dumps did with JSON_PRESERVE_ORDER and
+ * JSON_INDENT(4), directly from the items.  Values jansson refused to store
+ * (strings that aren't valid UTF-8, non-finite numbers) are left out. */
+
+#define JSON_INDENT 4
+
+static void json_write_obj(struct dstr *out, obs_data_t *data, int depth);
+
+static inline void json_write_indent(struct dstr *out, int depth)
+{
+	size_t spaces = (size_t)depth * JSON_INDENT;
+
+	dstr_ensure_capacity(out, out->len + spaces + 2);
+	out->array[out->len++] = '\n';
+	memset(out->array + out->len, ' ', spaces);
+	out->len += spaces;
+	out->array[out->len] = 0;
+}
+
+static bool json_write_string(struct dstr *out, const char *str)
+{
+	const uint8_t *p = (const uint8_t *)str;
+
+	dstr_cat_ch(out, '"');
+
+	for (;;) {
+		const uint8_t *run = p;
+		char esc[8];
+
+		p = json_skip_plain(p);
+		if (!p)
+			return false;
+
+		if (p != run)
+			dstr_ncat(out, (const char *)run, p - run);
+
+		if (!*p)
+			break;
+
+		switch (*p) {
+		case '"':
+			dstr_ncat(out, "\\\"", 2);
+			break;
+		case '\\':
+			dstr_ncat(out, "\\\\", 2);
+			break;
+		case '\b':
+			dstr_ncat(out, "\\b", 2);
+			break;
+		case '\f':
+			dstr_ncat(out, "\\f", 2);
+			break;
+		case '\n':
+			dstr_ncat(out, "\\n", 2);
+			break;
+		case '\r':
+			dstr_ncat(out, "\\r", 2);
+			break;
+		case '\t':
+			dstr_ncat(out, "\\t", 2);
+			break;
+		default:
+			snprintf(esc, sizeof(esc), "\\u%04X", *p);
+			dstr_ncat(out, esc, 6);
+		}
+
+		p++;
+	}
+
+	dstr_cat_ch(out, '"');
+	return true;
+}
 
-static inline void set_json_obj(json_t *json, const char *name,
-				obs_data_item_t *item)
+static bool json_write_double(struct dstr *out, double val)
 {
-	obs_data_t *obj = obs_data_item_get_obj(item);
-	json_object_set_new(json, name, obs_data_to_json(obj));
-	obs_data_release(obj);
+	const char *point = localeconv()->decimal_point;
+	char buf[64];
+	char *pos;
+	int len;
+
+	if (!isfinite(val))
+		return false;
+
+	len = snprintf(buf, sizeof(buf), "%.17g", val);
+	if (len < 0 || len >= (int)sizeof(buf) - 2)
+		return false;
+
+	if (*point != '.' && (pos = strchr(buf, *point)) != NULL)
+		*pos = '.';
+
+	/* keep it a real when read back */
+	if (!strchr(buf, '.') && !strchr(buf, 'e')) {
+		buf[len++] = '.';
+		buf[len++] = '0';
+		buf[len] = 0;
+	}
+
+	/* strip '+' and leading zeros from the exponent */
+	pos = strchr(buf, 'e');
+	if (pos) {
+		char *start = pos + 1;
+		char *end = start + 1;
+
+		if (*start == '-')
+			start++;
+		while (*end == '0')
+			end++;
+
+		if (end != start) {
+			memmove(start, end, len - (end - buf) + 1);
+			len -= (int)(end - start);
+		}
+	}
+
+	dstr_ncat(out, buf, len);
+	return true;
 }
 
-static inline void set_json_array(json_t *json, const char *name,
-				  obs_data_item_t *item)
+static void json_write_array(struct dstr *out, obs_data_array_t *array,
+			     int depth)
 {
-	json_t *jarray = json_array();
-	obs_data_array_t *array = obs_data_item_get_array(item);
-	size_t count = obs_data_array_count(array);
+	size_t count = array ? array->objects.num : 0;
 
-	for (size_t idx = 0; idx < count; idx++) {
-		obs_data_t *sub_item = obs_data_array_item(array, idx);
-		json_t *jitem = obs_data_to_json(sub_item);
-		json_array_append_new(jarray, jitem);
-		obs_data_release(sub_item);
+	dstr_cat_ch(out, '[');
+
+	for (size_t i = 0; i < count; i++) {
+		if (i)
+			dstr_cat_ch(out, ',');
+		json_write_indent(out, depth + 1);
+		json_write_obj(out, array->objects.array[i], depth + 1);
 	}
 
-	json_object_set_new(json, name, jarray);
-	obs_data_array_release(array);
+	if (count)
+		json_write_indent(out, depth);
+	dstr_cat_ch(out, ']');
+}
+
+static bool json_write_item(struct dstr *out, struct obs_data_item *item,
+			    int depth)
+{
+	char buf[32];
+
+	switch (item->type) {
+	case OBS_DATA_STRING:
+		return json_write_string(out, obs_data_item_get_string(item));
+
+	case OBS_DATA_NUMBER:
+		if (obs_data_item_numtype(item) == OBS_DATA_NUM_DOUBLE)
+			return json_write_double(
+				out, obs_data_item_get_double(item));
+
+		snprintf(buf, sizeof(buf), "%lld", obs_data_item_get_int(item));
+		dstr_cat(out, buf);
+		return true;
+
+	case OBS_DATA_BOOLEAN:
+		dstr_cat(out, obs_data_item_get_bool(item) ? "true" : "false");
+		return true;
+
+	case OBS_DATA_OBJECT:
+		json_write_obj(out, get_item_obj(item), depth);
+		return true;
+
+	case OBS_DATA_ARRAY:
+		json_write_array(out, get_item_array(item), depth);
+		return true;
+
+	default:
+		return false;
+	}
 }
 
-static json_t *obs_data_to_json(obs_data_t *data)
+static void json_write_obj(struct dstr *out, obs_data_t *data, int depth)
 {
-	json_t *json = json_object();
-	obs_data_item_t *item = NULL;
+	struct obs_data_item *item = data ? data->first_item : NULL;
+	bool empty = true;
 
-	for (item = obs_data_first(data); item; obs_data_item_next(&item)) {
-		enum obs_data_type type = obs_data_item_gettype(item);
-		const char *name = get_item_name(item);
+	dstr_cat_ch(out, '{');
+
+	for (; item; item = item->next) {
+		size_t rollback = out->len;
 
 		if (!obs_data_item_has_user_value(item))
 			continue;
 
-		if (type == OBS_DATA_STRING)
-			set_json_string(json, name, item);
-		else if (type == OBS_DATA_NUMBER)
-			set_json_number(json, name, item);
-		else if (type == OBS_DATA_BOOLEAN)
-			set_json_bool(json, name, item);
-		else if (type == OBS_DATA_OBJECT)
-			set_json_obj(json, name, item);
-		else if (type == OBS_DATA_ARRAY)
-			set_json_array(json, name, item);
+		if (!empty)
+			dstr_cat_ch(out, ',');
+		json_write_indent(out, depth + 1);
+
+		if (json_write_string(out, get_item_name(item))) {
+			dstr_ncat(out, ": ", 2);
+
+			if (json_write_item(out, item, depth + 1)) {
+				empty = false;
+				continue;
+			}
+		}
+
+		out->len = rollback;
+		out->array[rollback] = 0;
 	}
 
-	return json;
+	if (!empty)
+		json_write_indent(out, depth);
+	dstr_cat_ch(out, '}');
 }
 
 /* ------------------------------------------------------------------------- */
@@ -654,22 +1411,21 @@ obs_data_t *obs_data_create()
 obs_data_t *obs_data_create_from_json(const char *json_string)
 {
 	obs_data_t *data = obs_data_create();
+	struct json_reader reader = {0};
 
-	json_error_t error;
-	json_t *root = json_loads(json_string, JSON_REJECT_DUPLICATES, &error);
+	reader.start = json_string ? json_string : "";
+	reader.pos = reader.start;
 
-	if (root) {
-		obs_data_add_json_object_data(data, root);
-		json_decref(root);
-	} else {
+	if (!json_read_root(&reader, data)) {
 		blog(LOG_ERROR,
 		     "obs-data.c: [obs_data_create_from_json] "
 		     "Failed reading json string (%d): %s",
-		     error.line, error.text);
+		     json_reader_line(&reader), reader.error);
 		obs_data_release(data);
 		data = NULL;
 	}
 
+	json_reader_free(&reader);
 	return data;
 }
 
@@ -729,12 +1485,17 @@ static inline void obs_data_destroy(struct obs_data *data)
 
 	while (item) {
 		struct obs_data_item *next = item->next;
+
+		/* items can outlive their parent if still referenced */
+		item->parent = NULL;
+		item->prev = NULL;
+		item->next = NULL;
 		obs_data_item_release(&item);
 		item = next;
 	}
 
-	/* NOTE: don't use bfree for json text, allocated by json */
-	free(data->json);
+	bfree(data->index);
+	bfree(data->json);
 	bfree(data);
 }
 
@@ -752,13 +1513,11 @@ const char *obs_data_get_json(obs_data_t *data)
 	if (!data)
 		return NULL;
 
-	/* NOTE: don't use libobs bfree for json text */
-	free(data->json);
-	data->json = NULL;
+	struct dstr json = {0};
 
-	json_t *root = obs_data_to_json(data);
-	data->json = json_dumps(root, JSON_PRESERVE_ORDER | JSON_INDENT(4));
-	json_decref(root);
+	bfree(data->json);
+	json_write_obj(&json, data, 0);
+	data->json = json.array;
 
 	return data->json;
 }
@@ -790,13 +1549,17 @@ bool obs_data_save_json_safe(obs_data_t *data, const char *file,
 
 static struct obs_data_item *get_item(struct obs_data *data, const char *name)
 {
-	if (!data)
+	if (!data || !name)
 		return NULL;
 
+	uint32_t hash = get_name_hash(name);
+	if (data->index)
+		return index_find(data, name, hash);
+
 	struct obs_data_item *item = data->first_item;
 
 	while (item) {
-		if (strcmp(get_item_name(item), name) == 0)
+		if (item->hash == hash && strcmp(get_item_name(item), name) == 0)
 			return item;
 
 		item = item->next;
@@ -811,8 +1574,7 @@ static struct obs_data_item *get_item_by_index(struct obs_data *data,
 	if (!data)
 		return NULL;
 
-	size_t count = obs_data_item_count(data);
-	if (index >= count) {
+	if (index >= data->num_items) {
 		return NULL;
 	}
 
@@ -835,31 +1597,8 @@ static void set_item_data(struct obs_data *data, struct obs_data_item **item,
 	if ((!item || (item && !*item)) && data) {
 		new_item = obs_data_item_create(name, ptr, size, type,
 						default_data, autoselect_data);
-
-		obs_data_item_t *prev = obs_data_first(data);
-		obs_data_item_t *next = obs_data_first(data);
-		obs_data_item_next(&next);
-		for (; prev && next;
-		     obs_data_item_next(&prev), obs_data_item_next(&next)) {
-			if (strcmp(get_item_name(next), name) > 0)
-				break;
-		}
-
-		new_item->parent = data;
-		if (prev && strcmp(get_item_name(prev), name) < 0) {
-			prev->next = new_item;
-			new_item->next = next;
-
-		} else {
-			data->first_item = new_item;
-			new_item->next = prev;
-		}
-
-		if (!prev)
-			data->first_item = new_item;
-
-		obs_data_item_release(&prev);
-		obs_data_item_release(&next);
+		if (new_item)
+			obs_data_item_attach(data, new_item);
 
 	} else if (default_data) {
 		obs_data_item_set_default_data(item, ptr, size, type);
@@ -1552,20 +2291,7 @@ void obs_data_item_remove(obs_data_item_t **item)
 
 size_t obs_data_item_count(obs_data_t *data)
 {
-	if (!data)
-		return 0;
-
-	obs_data_item_t *item = obs_data_first(data);
-	if (!item) {
-		return 0;
-	}
-
-	size_t count = 0;
-	do {
-		count++;
-	} while (obs_data_item_next(&item));
-
-	return count;
+	return data ? data->num_items : 0;
 }
 
 enum obs_data_type obs_data_item_gettype(obs_data_item_t *item)
@@ -15,6 +15,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include "graphics/vec2.h"
 #include "graphics/vec4.h"
 #include "obs.h"
 #include "obs-internal.h"
@@ -189,6 +190,40 @@ static inline void render_display_end()
 	gs_end_scene();
 }
 
+/* capped frames are paced on the video clock so the display stays in step
+ * with the frames it shows, half an output frame of slack keeps a cap equal
+ * to a divisor of the output rate from dropping an extra frame to jitter */
+static bool display_capped_frame_due(struct obs_display *display)
+{
+	uint32_t max_fps = display->max_fps;
+	uint64_t ts = obs->video.video_time;
+	uint64_t interval;
+
+	if (!max_fps || !display->last_render_ts)
+		return true;
+
+	interval = 1000000000ULL / max_fps;
+	return ts - display->last_render_ts +
+		       obs->video.video_frame_interval_ns / 2 >=
+	       interval;
+}
+
+static bool display_frame_due(struct obs_display *display, bool size_changed)
+{
+	switch (display->render_policy) {
+	case OBS_DISPLAY_RENDER_OFF:
+		return false;
+	case OBS_DISPLAY_RENDER_ON_CHANGE:
+		return size_changed || display->render_requested;
+	case OBS_DISPLAY_RENDER_CAPPED:
+		return size_changed || display->render_requested ||
+		       display_capped_frame_due(display);
+	case OBS_DISPLAY_RENDER_FULL:;
+	}
+
+	return true;
+}
+
 void render_display(struct obs_display *display)
 {
 	uint32_t cx, cy;
@@ -197,8 +232,6 @@ void render_display(struct obs_display *display)
 	if (!display || !display->enabled)
 		return;
 
-	GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_DISPLAY, "obs_display");
-
 	/* -------------------------------------------- */
 
 	pthread_mutex_lock(&display->draw_info_mutex);
@@ -207,11 +240,24 @@ void render_display(struct obs_display *display)
 	cy = display->cy;
 	size_changed = display->size_changed;
 
+	if (!display_frame_due(display, size_changed)) {
+		pthread_mutex_unlock(&display->draw_info_mutex);
+		obs->video.render_timing.displays_skipped++;
+		return;
+	}
+
 	if (size_changed)
 		display->size_changed = false;
 
+	display->render_requested = false;
+	display->last_render_ts = obs->video.video_time;
+
 	pthread_mutex_unlock(&display->draw_info_mutex);
 
+	obs->video.render_timing.displays_rendered++;
+
+	GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_DISPLAY, "obs_display");
+
 	/* -------------------------------------------- */
 
 	render_display_begin(display, cx, cy, size_changed);
@@ -265,3 +311,170 @@ void obs_display_size(obs_display_t *display, uint32_t *width, uint32_t *height)
 		pthread_mutex_unlock(&display->draw_info_mutex);
 	}
 }
+
+void obs_display_set_render_policy(obs_display_t *display,
+				   enum obs_display_render_policy policy)
+{
+	if (!display)
+		return;
+
+	pthread_mutex_lock(&display->draw_info_mutex);
+	if (display->render_policy != policy) {
+		display->render_policy = policy;
+		display->render_requested = true;
+	}
+	pthread_mutex_unlock(&display->draw_info_mutex);
+}
+
+enum obs_display_render_policy
+obs_display_get_render_policy(obs_display_t *display)
+{
+	return display ? display->render_policy : OBS_DISPLAY_RENDER_FULL;
+}
+
+void obs_display_set_max_fps(obs_display_t *display, uint32_t fps)
+{
+	if (!display)
+		return;
+
+	pthread_mutex_lock(&display->draw_info_mutex);
+	display->max_fps = fps;
+	display->last_render_ts = 0;
+	pthread_mutex_unlock(&display->draw_info_mutex);
+}
+
+uint32_t obs_display_get_max_fps(obs_display_t *display)
+{
+	return display ? display->max_fps : 0;
+}
+
+void obs_display_request_render(obs_display_t *display)
+{
+	if (!display)
+		return;
+
+	pthread_mutex_lock(&display->draw_info_mutex);
+	display->render_requested = true;
+	pthread_mutex_unlock(&display->draw_info_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/* shared scaled copies of the main texture */
+
+extern THREAD_LOCAL bool is_graphics_thread;
+
+static gs_effect_t *get_scaled_copy_effect(struct obs_core_video *video,
+					   uint32_t cx, uint32_t cy)
+{
+	/* same reasoning as the output scale: below half size the other
+	 * filters can't sample enough pixels */
+	if (cx < video->base_width / 2 && cy < video->base_height / 2 &&
+	    video->bilinear_lowres_effect)
+		return video->bilinear_lowres_effect;
+	if (video->area_effect)
+		return video->area_effect;
+	return video->default_effect;
+}
+
+static bool render_scaled_copy(struct obs_core_video *video,
+			       struct obs_scaled_copy *copy)
+{
+	gs_effect_t *effect = get_scaled_copy_effect(video, copy->cx, copy->cy);
+	gs_texture_t *tex = video->render_texture;
+	gs_eparam_t *param;
+	struct vec2 base;
+	struct vec2 base_i;
+
+	gs_texrender_reset(copy->texrender);
+	if (!gs_texrender_begin(copy->texrender, copy->cx, copy->cy))
+		return false;
+
+	vec2_set(&base, (float)video->base_width, (float)video->base_height);
+	vec2_set(&base_i, 1.0f / (float)video->base_width,
+		 1.0f / (float)video->base_height);
+
+	gs_enable_depth_test(false);
+	gs_set_cull_mode(GS_NEITHER);
+	gs_ortho(0.0f, (float)video->base_width, 0.0f,
+		 (float)video->base_height, -100.0f, 100.0f);
+
+	param = gs_effect_get_param_by_name(effect, "image");
+	gs_effect_set_texture(param, tex);
+	param = gs_effect_get_param_by_name(effect, "base_dimension");
+	if (param)
+		gs_effect_set_vec2(param, &base);
+	param = gs_effect_get_param_by_name(effect, "base_dimension_i");
+	if (param)
+		gs_effect_set_vec2(param, &base_i);
+
+	gs_blend_state_push();
+	gs_enable_blending(false);
+
+	while (gs_effect_loop(effect, "Draw"))
+		gs_draw_sprite(tex, 0, 0, 0);
+
+	gs_blend_state_pop();
+	gs_texrender_end(copy->texrender);
+	return true;
+}
+
+gs_texture_t *obs_get_scaled_main_texture(uint32_t cx, uint32_t cy)
+{
+	struct obs_core_video *video;
+	struct obs_scaled_copy *copy = NULL;
+
+	if (!obs || !is_graphics_thread)
+		return NULL;
+
+	video = &obs->video;
+	if (!video->texture_rendered || !cx || !cy)
+		return NULL;
+
+	/* nothing to share when it wouldn't be a downscale */
+	if (cx >= video->base_width || cy >= video->base_height)
+		return NULL;
+
+	for (size_t i = 0; i < video->scaled_copies.num; i++) {
+		struct obs_scaled_copy *cur = video->scaled_copies.array + i;
+		if (cur->cx == cx && cur->cy == cy) {
+			copy = cur;
+			break;
+		}
+	}
+
+	if (!copy) {
+		copy = da_push_back_new(video->scaled_copies);
+		copy->cx = cx;
+		copy->cy = cy;
+		copy->texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+		copy->frame = video->render_frame - 1;
+	}
+
+	if (copy->frame != video->render_frame) {
+		if (!render_scaled_copy(video, copy))
+			return NULL;
+		copy->frame = video->render_frame;
+	}
+
+	return gs_texrender_get_texture(copy->texrender);
+}
+
+void obs_free_scaled_copies(bool unused_only)
+{
+	struct obs_core_video *video = &obs->video;
+	size_t i = video->scaled_copies.num;
+
+	while (i > 0) {
+		struct obs_scaled_copy *copy = video->scaled_copies.array + --i;
+
+		if (unused_only && video->render_frame - copy->frame <=
+					   SCALED_COPY_KEEP_FRAMES)
+			continue;
+
+		gs_texrender_destroy(copy->texrender);
+		da_erase(video->scaled_copies, i);
+	}
+
+	if (!unused_only)
+		da_free(video->scaled_copies);
+}
@@ -227,6 +227,24 @@ static void add_connection(struct obs_encoder *encoder)
 	set_encoder_active(encoder, true);
 }
 
+static void log_skipped_frames(struct obs_encoder *encoder)
+{
+	uint32_t total_frames;
+	uint32_t skipped_frames;
+
+	if (!video_output_get_input_frames(encoder->media, receive_video,
+					   encoder, &total_frames,
+					   &skipped_frames))
+		return;
+
+	if (skipped_frames && total_frames)
+		blog(LOG_INFO,
+		     "encoder '%s': number of skipped frames due to encoding "
+		     "lag: %u/%u (%0.1f%%)",
+		     encoder->context.name, skipped_frames, total_frames,
+		     (double)skipped_frames / (double)total_frames * 100.0);
+}
+
 static void remove_connection(struct obs_encoder *encoder, bool shutdown)
 {
 	if (encoder->info.type == OBS_ENCODER_AUDIO) {
@@ -236,6 +254,7 @@ static void remove_connection(struct obs_encoder *encoder, bool shutdown)
 		if (gpu_encode_available(encoder)) {
 			stop_gpu_encode(encoder);
 		} else {
+			log_skipped_frames(encoder);
 			stop_raw_video(encoder->media, receive_video, encoder);
 		}
 	}
@@ -948,6 +967,10 @@ void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 		pkt->sys_dts_usec += encoder->pause.ts_offset / 1000;
 		pthread_mutex_unlock(&encoder->pause.mutex);
 
+		if (pkt->type == OBS_ENCODER_VIDEO && profiler_trace_enabled())
+			profile_trace_mark("frame_encoded",
+					   encoder_packet_trace_id(pkt));
+
 		pthread_mutex_lock(&encoder->callbacks_mutex);
 
 		for (size_t i = encoder->callbacks.num; i > 0; i--) {
@@ -960,6 +983,42 @@ void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 	}
 }
 
+static inline size_t trace_frame_index(struct obs_encoder *encoder,
+				       int64_t pts)
+{
+	int64_t frame = encoder->timebase_num ? pts / encoder->timebase_num
+					      : pts;
+	return (size_t)frame % ENCODER_TRACE_FRAMES;
+}
+
+void encoder_trace_frame(struct obs_encoder *encoder, int64_t pts,
+			 uint64_t timestamp)
+{
+	if (!profiler_trace_enabled())
+		return;
+
+	struct encoder_trace_frame *tf =
+		&encoder->trace_frames[trace_frame_index(encoder, pts)];
+	tf->pts = pts;
+	tf->timestamp = timestamp;
+
+	profile_trace_mark("encode_frame", timestamp);
+}
+
+/* returns the raw frame timestamp of a video packet, or its pts if the frame
+ * is no longer known */
+uint64_t encoder_packet_trace_id(const struct encoder_packet *pkt)
+{
+	struct obs_encoder *encoder = pkt->encoder;
+
+	if (!encoder || pkt->type != OBS_ENCODER_VIDEO)
+		return (uint64_t)pkt->pts;
+
+	struct encoder_trace_frame *tf =
+		&encoder->trace_frames[trace_frame_index(encoder, pkt->pts)];
+	return tf->pts == pkt->pts ? tf->timestamp : (uint64_t)pkt->pts;
+}
+
 static const char *do_encode_name = "do_encode";
 bool do_encode(struct obs_encoder *encoder, struct encoder_frame *frame)
 {
@@ -1049,6 +1108,7 @@ static void receive_video(void *param, struct video_data *frame)
 
 	enc_frame.frames = 1;
 	enc_frame.pts = encoder->cur_pts;
+	encoder_trace_frame(encoder, enc_frame.pts, frame->timestamp);
 
 	if (do_encode(encoder, &enc_frame))
 		encoder->cur_pts += encoder->timebase_num;
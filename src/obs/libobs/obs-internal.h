@@ -46,6 +46,7 @@
 #define MICROSECOND_DEN 1000000
 #define NUM_ENCODE_TEXTURES 3
 #define NUM_ENCODE_TEXTURE_FRAMES_TO_WAIT 1
+#define DEFAULT_MONITORING_LATENCY_MS 25
 
 static inline int64_t packet_dts_usec(struct encoder_packet *packet)
 {
@@ -213,6 +214,12 @@ struct obs_display {
 	pthread_mutex_t draw_info_mutex;
 	DARRAY(struct draw_callback) draw_callbacks;
 
+	/* skipped frames leave the last image in the swap chain */
+	enum obs_display_render_policy render_policy;
+	uint32_t max_fps;
+	uint64_t last_render_ts;
+	bool render_requested;
+
 	struct obs_display *next;
 	struct obs_display **prev_next;
 };
@@ -221,9 +228,44 @@ extern bool obs_display_init(struct obs_display *display,
 			     const struct gs_init_data *graphics_data);
 extern void obs_display_free(struct obs_display *display);
 
+/* the main texture scaled to the size of a display, made at most once per
+ * frame and shared by every display drawing it at that size */
+struct obs_scaled_copy {
+	uint32_t cx, cy;
+	gs_texrender_t *texrender;
+	uint64_t frame;
+};
+
+#define SCALED_COPY_KEEP_FRAMES 60
+
+/* graphics context must be entered */
+extern void obs_free_scaled_copies(bool unused_only);
+
 /* ------------------------------------------------------------------------- */
 /* core */
 
+/* frames of latency before the GPU timers of a frame are read back, so that
+ * reading them doesn't wait on the GPU */
+#define GPU_TIMER_SLOTS 4
+
+struct obs_gpu_timer_slot {
+	gs_timer_range_t *range;
+	gs_timer_t *output;
+	gs_timer_t *displays;
+	bool pending;
+};
+
+struct obs_render_timing {
+	uint64_t output_cpu_ns;
+	uint64_t displays_cpu_ns;
+	uint64_t output_gpu_ns;
+	uint64_t displays_gpu_ns;
+	uint32_t frames;
+	uint32_t gpu_frames;
+	uint32_t displays_rendered;
+	uint32_t displays_skipped;
+};
+
 struct obs_vframe_info {
 	uint64_t timestamp;
 	int count;
@@ -292,6 +334,25 @@ struct obs_core_video {
 	uint32_t lagged_frames;
 	bool thread_initialized;
 
+	/* graphics thread iterations, scopes the render cache */
+	uint64_t render_frame;
+	uint64_t render_cache_hits;
+	uint64_t render_cache_misses;
+
+	/* graphics thread only */
+	DARRAY(struct obs_scaled_copy) scaled_copies;
+
+	/* display cost next to the output render, accumulated over a second
+	 * by the graphics thread, the last second is read without locking
+	 * like the fps counters */
+	struct obs_gpu_timer_slot gpu_timers[GPU_TIMER_SLOTS];
+	size_t cur_gpu_timer;
+	bool gpu_timers_created;
+	bool gpu_timers_failed;
+	struct obs_render_timing render_timing;
+	struct obs_render_timing last_render_timing;
+	struct obs_render_timing total_render_timing;
+
 	bool gpu_conversion;
 	const char *conversion_techs[NUM_CHANNELS];
 	bool conversion_needed;
@@ -304,6 +365,13 @@ struct obs_core_video {
 	float color_matrix[16];
 	enum obs_scale_type scale_type;
 
+	gs_effect_t *output_effect;
+	gs_technique_t *output_tech;
+	gs_eparam_t *output_image;
+	gs_eparam_t *output_base_dim;
+	gs_eparam_t *output_base_dim_i;
+	bool output_passthrough;
+
 	gs_texture_t *transparent_texture;
 
 	gs_effect_t *deinterlace_discard_effect;
@@ -355,6 +423,8 @@ struct obs_core_audio {
 	DARRAY(struct audio_monitor *) monitors;
 	char *monitoring_device_name;
 	char *monitoring_device_id;
+	uint32_t monitoring_latency_ms;
+	volatile long monitoring_underflows;
 
 	//PRISM/LiuHaibin/20200908/#4748/add mp3 info
 	pthread_mutex_t id3v2_mutex;
@@ -362,6 +432,8 @@ struct obs_core_audio {
 };
 
 /* user sources, output channels, and displays */
+struct obs_scene_items;
+
 struct obs_core_data {
 	struct obs_source *first_source;
 	struct obs_source *first_audio_source;
@@ -371,6 +443,10 @@ struct obs_core_data {
 	struct obs_service *first_service;
 
 	pthread_mutex_t sources_mutex;
+
+	/* scene item snapshots without readers, queued by the scene ticks
+	 * and freed after the source walk, graphics thread only */
+	DARRAY(struct obs_scene_items *) reclaimed_scene_items;
 	pthread_mutex_t displays_mutex;
 	pthread_mutex_t outputs_mutex;
 	pthread_mutex_t encoders_mutex;
@@ -460,6 +536,12 @@ extern struct obs_core *obs;
 
 extern void *obs_graphics_thread(void *param);
 
+/* in obs-scene.c */
+extern void obs_scene_free_reclaimed_items(void);
+
+/* graphics context must be entered */
+extern void obs_free_gpu_timers(void);
+
 extern gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file);
 
 extern bool audio_callback(void *param, uint64_t start_ts_in,
@@ -732,6 +814,14 @@ struct obs_source {
 	enum obs_allow_direct_render allow_direct;
 	bool rendering_filter;
 
+	/* output of the current frame, when rendered more than once */
+	gs_texrender_t *render_cache;
+	uint64_t render_cache_frame;
+	uint64_t render_cache_used;
+	uint32_t render_cache_refs;
+	uint32_t render_cache_prev_refs;
+	bool render_cache_valid;
+
 	/* sources specific hotkeys */
 	obs_hotkey_pair_id mute_unmute_key;
 	obs_hotkey_id push_to_mute_key;
@@ -871,6 +961,8 @@ convert_video_format(enum video_format format)
 extern void obs_source_activate(obs_source_t *source, enum view_type type);
 extern void obs_source_deactivate(obs_source_t *source, enum view_type type);
 extern void obs_source_video_tick(obs_source_t *source, float seconds);
+extern gs_texture_t *obs_source_get_sprite_texture(obs_source_t *source,
+						   uint32_t *cx, uint32_t *cy);
 extern float obs_source_get_target_volume(obs_source_t *source,
 					  obs_source_t *target);
 
@@ -1074,6 +1166,13 @@ struct encoder_callback {
 	void *param;
 };
 
+#define ENCODER_TRACE_FRAMES 256
+
+struct encoder_trace_frame {
+	int64_t pts;
+	uint64_t timestamp;
+};
+
 struct obs_encoder {
 	struct obs_context_data context;
 	struct obs_encoder_info info;
@@ -1142,6 +1241,10 @@ struct obs_encoder {
 
 	//PRISM/LiuHaibin/20200703/#None/gpu encoder deadlock
 	volatile bool gpu_encoder_error;
+
+	/* maps recent video pts values back to their raw frame timestamps so
+	 * trace marks can follow a frame through encoding and output */
+	struct encoder_trace_frame trace_frames[ENCODER_TRACE_FRAMES];
 };
 
 extern struct obs_encoder_info *find_encoder(const char *id);
@@ -1167,6 +1270,9 @@ extern bool start_gpu_encode(obs_encoder_t *encoder);
 extern void stop_gpu_encode(obs_encoder_t *encoder);
 
 extern bool do_encode(struct obs_encoder *encoder, struct encoder_frame *frame);
+extern void encoder_trace_frame(struct obs_encoder *encoder, int64_t pts,
+				uint64_t timestamp);
+extern uint64_t encoder_packet_trace_id(const struct encoder_packet *pkt);
 extern void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 				    bool received, struct encoder_packet *pkt);
 
@@ -1238,9 +1344,14 @@ extern obs_watermark_t *obs_watermark_create(void);
 /** destroy the watermark. */
 extern void obs_watermark_destroy(obs_watermark_t *watermark);
 
-/** render watermark to texture. */
-extern gs_texture_t *obs_watermark_render(obs_watermark_t *watermark,
-					  gs_texture_t *texture);
+/**
+ * advances the watermark animation, returns true if the watermark has to be
+ * rendered this frame.
+ */
+extern bool obs_watermark_visible(obs_watermark_t *watermark);
+
+/** render watermark over the current render target. */
+extern void obs_watermark_render(obs_watermark_t *watermark);
 
 /** gets the current watermark, returns NULL if no video */
 extern obs_watermark_t *obs_get_watermark(void);
@@ -1254,7 +1365,10 @@ extern bool obs_watermark_enabled(const obs_watermark_t *watermark);
 /* ------------------------------------------------------------------------- */
 //PRISM/LiuHaibin/20200217/#432/for live thumbnail
 
-/** destroy thumbnail. */
+/** create thumbnail and its encode thread. */
+extern obs_thumbnail_t *obs_thumbnail_create(void);
+
+/** destroy thumbnail, outstanding requests fail. */
 extern void obs_thumbnail_destroy(obs_thumbnail_t *thumbnail);
 
 /** save current render texture as thumbnail. */
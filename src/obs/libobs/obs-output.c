@@ -1334,6 +1334,10 @@ static inline void send_interleaved(struct obs_output *output)
 	}
 
 	output->info.encoded_packet(output->context.data, &out);
+
+	if (out.type == OBS_ENCODER_VIDEO && profiler_trace_enabled())
+		profile_trace_mark("packet_sent", encoder_packet_trace_id(&out));
+
 	obs_encoder_packet_release(&out);
 }
 
@@ -1678,6 +1682,9 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 
 	if (packet->type == OBS_ENCODER_AUDIO)
 		packet->track_idx = get_track_index(output, packet);
+	else if (profiler_trace_enabled())
+		profile_trace_mark("packet_interleaved",
+				   encoder_packet_trace_id(packet));
 
 	pthread_mutex_lock(&output->interleaved_mutex);
 
@@ -1735,8 +1742,14 @@ static void default_encoded_callback(void *param, struct encoder_packet *packet)
 
 		output->info.encoded_packet(output->context.data, packet);
 
-		if (packet->type == OBS_ENCODER_VIDEO)
+		if (packet->type == OBS_ENCODER_VIDEO) {
 			output->total_frames++;
+
+			if (profiler_trace_enabled())
+				profile_trace_mark(
+					"packet_sent",
+					encoder_packet_trace_id(packet));
+		}
 	}
 
 	if (output->active_delay_ns)
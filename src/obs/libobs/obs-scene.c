@@ -112,6 +112,11 @@ static void *scene_create(obs_data_t *settings, struct obs_source *source)
 				"mutex");
 		goto fail;
 	}
+	if (pthread_mutex_init(&scene->items_mutex, NULL) != 0) {
+		blog(LOG_ERROR, "scene_create: Couldn't initialize items "
+				"mutex");
+		goto fail;
+	}
 
 	UNUSED_PARAMETER(settings);
 	return scene;
@@ -127,6 +132,120 @@ fail:
 #define audio_unlock(scene) pthread_mutex_unlock(&scene->audio_mutex)
 #define video_unlock(scene) pthread_mutex_unlock(&scene->video_mutex)
 
+/* ------------------------------------------------------------------------- */
+/* item snapshots
+ *
+ * The item list is only changed with the video lock held.  Each time the lock
+ * is released after a change a new snapshot of the list is published, which
+ * the render and tick paths use without taking the scene locks, so they never
+ * wait for the UI thread.  Snapshots hold a reference to their items. */
+
+static bool items_changed(struct obs_scene *scene)
+{
+	struct obs_scene_items *items = scene->items;
+	struct obs_scene_item *item = scene->first_item;
+	size_t i = 0;
+
+	for (; item; item = item->next, i++) {
+		if (!items || i >= items->num || items->array[i] != item)
+			return true;
+	}
+
+	return items ? i != items->num : false;
+}
+
+/* assumes video lock */
+static void publish_items(struct obs_scene *scene)
+{
+	struct obs_scene_items *items, *old;
+	struct obs_scene_item *item;
+	size_t num = 0;
+
+	if (!items_changed(scene))
+		return;
+
+	for (item = scene->first_item; item; item = item->next)
+		num++;
+
+	items = bmalloc(sizeof(*items) + num * sizeof(items->array[0]));
+	items->readers = 0;
+	items->num = num;
+
+	num = 0;
+	for (item = scene->first_item; item; item = item->next) {
+		obs_sceneitem_addref(item);
+		items->array[num++] = item;
+	}
+
+	pthread_mutex_lock(&scene->items_mutex);
+	old = scene->items;
+	scene->items = items;
+	if (old)
+		da_push_back(scene->retired_items, &old);
+	pthread_mutex_unlock(&scene->items_mutex);
+}
+
+static struct obs_scene_items *acquire_items(struct obs_scene *scene)
+{
+	struct obs_scene_items *items;
+
+	pthread_mutex_lock(&scene->items_mutex);
+	items = scene->items;
+	if (items)
+		os_atomic_inc_long(&items->readers);
+	pthread_mutex_unlock(&scene->items_mutex);
+
+	return items;
+}
+
+static inline void release_items(struct obs_scene_items *items)
+{
+	if (items)
+		os_atomic_dec_long(&items->readers);
+}
+
+static void free_items(struct obs_scene_items *items)
+{
+	for (size_t i = 0; i < items->num; i++)
+		obs_sceneitem_release(items->array[i]);
+	bfree(items);
+}
+
+/* only called from the video tick while tick_sources walks the source list,
+ * so the snapshots are only queued: releasing an item can release the last
+ * reference of its source, and that source may be the next one the walk
+ * visits.  They're freed by obs_scene_free_reclaimed_items once the walk
+ * is done, on the same thread, so the list needs no lock. */
+static void reclaim_items(struct obs_scene *scene)
+{
+	struct obs_core_data *data = &obs->data;
+
+	pthread_mutex_lock(&scene->items_mutex);
+	for (size_t i = scene->retired_items.num; i > 0; i--) {
+		struct obs_scene_items *items =
+			scene->retired_items.array[i - 1];
+
+		if (os_atomic_load_long(&items->readers) == 0) {
+			da_push_back(data->reclaimed_scene_items, &items);
+			da_erase(scene->retired_items, i - 1);
+		}
+	}
+	pthread_mutex_unlock(&scene->items_mutex);
+}
+
+/* graphics thread, without the sources mutex.  Releasing the last reference
+ * of an item enters the graphics context */
+void obs_scene_free_reclaimed_items(void)
+{
+	struct obs_core_data *data = &obs->data;
+
+	for (size_t i = 0; i < data->reclaimed_scene_items.num; i++)
+		free_items(data->reclaimed_scene_items.array[i]);
+	da_resize(data->reclaimed_scene_items, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+
 static inline void full_lock(struct obs_scene *scene)
 {
 	video_lock(scene);
@@ -135,6 +254,7 @@ static inline void full_lock(struct obs_scene *scene)
 
 static inline void full_unlock(struct obs_scene *scene)
 {
+	publish_items(scene);
 	audio_unlock(scene);
 	video_unlock(scene);
 }
@@ -182,8 +302,17 @@ static void scene_destroy(void *data)
 
 	remove_all_items(scene);
 
+	/* nothing reads a scene that is being destroyed */
+	for (size_t i = 0; i < scene->retired_items.num; i++)
+		free_items(scene->retired_items.array[i]);
+	da_free(scene->retired_items);
+
+	if (scene->items)
+		free_items(scene->items);
+
 	pthread_mutex_destroy(&scene->video_mutex);
 	pthread_mutex_destroy(&scene->audio_mutex);
+	pthread_mutex_destroy(&scene->items_mutex);
 	bfree(scene);
 }
 
@@ -600,16 +729,18 @@ cleanup:
 static void scene_video_tick(void *data, float seconds)
 {
 	struct obs_scene *scene = data;
-	struct obs_scene_item *item;
+	struct obs_scene_items *items;
+
+	reclaim_items(scene);
+
+	items = acquire_items(scene);
+	for (size_t i = 0; items && i < items->num; i++) {
+		struct obs_scene_item *item = items->array[i];
 
-	video_lock(scene);
-	item = scene->first_item;
-	while (item) {
 		if (item->item_render)
 			gs_texrender_reset(item->item_render);
-		item = item->next;
 	}
-	video_unlock(scene);
+	release_items(items);
 
 	UNUSED_PARAMETER(seconds);
 }
@@ -640,10 +771,15 @@ update_transforms_and_prune_sources(obs_scene_t *scene,
 		if (item->is_group) {
 			obs_scene_t *group_scene = item->source->context.data;
 
-			video_lock(group_scene);
-			update_transforms_and_prune_sources(group_scene,
-							    remove_items, item);
-			video_unlock(group_scene);
+			/* updated on a later frame if the group is being
+			 * edited */
+			if (pthread_mutex_trylock(&group_scene->video_mutex) ==
+			    0) {
+				update_transforms_and_prune_sources(
+					group_scene, remove_items, item);
+				publish_items(group_scene);
+				video_unlock(group_scene);
+			}
 		}
 
 		if (os_atomic_load_bool(&item->update_transform) ||
@@ -660,35 +796,101 @@ update_transforms_and_prune_sources(obs_scene_t *scene,
 		resize_group(group_sceneitem);
 }
 
+/* consecutive items that are nothing but a sprite drawn with the default
+ * effect are batched, so a scene full of images costs one vertex buffer
+ * upload instead of one per item */
+struct sprite_batch {
+	gs_technique_t *tech;
+	uint32_t draw_calls;
+	uint32_t batched_items;
+};
+
+static bool batch_item(struct sprite_batch *batch,
+		       struct obs_scene_item *item)
+{
+	gs_effect_t *effect = obs->video.default_effect;
+	gs_texture_t *tex;
+	uint32_t cx = 0;
+	uint32_t cy = 0;
+
+	/* cropped and scale filtered items render to their own texture */
+	if (item->item_render)
+		return false;
+
+	tex = obs_source_get_sprite_texture(item->source, &cx, &cy);
+	if (!tex)
+		return false;
+
+	if (!batch->tech) {
+		batch->tech = gs_effect_get_technique(effect, "Draw");
+		gs_technique_begin(batch->tech);
+		gs_technique_begin_pass(batch->tech, 0);
+		gs_sprite_batch_begin(
+			gs_effect_get_param_by_name(effect, "image"));
+	}
+
+	gs_matrix_push();
+	gs_matrix_mul(&item->draw_transform);
+	gs_sprite_batch_draw(tex, 0, cx, cy);
+	gs_matrix_pop();
+
+	batch->batched_items++;
+	return true;
+}
+
+static void end_batch(struct sprite_batch *batch)
+{
+	if (!batch->tech)
+		return;
+
+	batch->draw_calls += gs_sprite_batch_end();
+	gs_technique_end_pass(batch->tech);
+	gs_technique_end(batch->tech);
+	batch->tech = NULL;
+}
+
 static void scene_video_render(void *data, gs_effect_t *effect)
 {
 	DARRAY(struct obs_scene_item *) remove_items;
 	struct obs_scene *scene = data;
-	struct obs_scene_item *item;
+	struct obs_scene_items *items;
+	struct sprite_batch batch = {0};
 
 	da_init(remove_items);
 
-	video_lock(scene);
-
-	if (!scene->is_group) {
+	/* if the UI thread is editing the scene, the transforms are updated on
+	 * the next frame instead of waiting for it */
+	if (!scene->is_group &&
+	    pthread_mutex_trylock(&scene->video_mutex) == 0) {
 		update_transforms_and_prune_sources(scene, &remove_items.da,
 						    NULL);
+		publish_items(scene);
+		video_unlock(scene);
 	}
 
 	gs_blend_state_push();
 	gs_reset_blend_state();
 
-	item = scene->first_item;
-	while (item) {
-		if (item->user_visible)
-			render_item(item);
+	items = acquire_items(scene);
+	for (size_t i = 0; items && i < items->num; i++) {
+		struct obs_scene_item *item = items->array[i];
 
-		item = item->next;
+		if (!item->user_visible || item->removed)
+			continue;
+
+		if (!batch_item(&batch, item)) {
+			end_batch(&batch);
+			render_item(item);
+			batch.draw_calls++;
+		}
 	}
+	release_items(items);
+	end_batch(&batch);
 
 	gs_blend_state_pop();
 
-	video_unlock(scene);
+	os_atomic_set_long(&scene->draw_calls, (long)batch.draw_calls);
+	os_atomic_set_long(&scene->batched_items, (long)batch.batched_items);
 
 	for (size_t i = 0; i < remove_items.num; i++)
 		obs_sceneitem_release(remove_items.array[i]);
@@ -1455,6 +1657,19 @@ obs_scene_t *obs_group_from_source(const obs_source_t *source)
 	return source->context.data;
 }
 
+void obs_scene_get_draw_stats(const obs_scene_t *scene, uint32_t *draw_calls,
+			      uint32_t *batched_items)
+{
+	if (!obs_ptr_valid(scene, "obs_scene_get_draw_stats"))
+		return;
+
+	if (draw_calls)
+		*draw_calls = (uint32_t)os_atomic_load_long(&scene->draw_calls);
+	if (batched_items)
+		*batched_items =
+			(uint32_t)os_atomic_load_long(&scene->batched_items);
+}
+
 obs_sceneitem_t *obs_scene_find_source(obs_scene_t *scene, const char *name)
 {
 	struct obs_scene_item *item;
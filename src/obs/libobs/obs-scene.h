@@ -84,6 +84,13 @@ struct obs_scene_item {
 	struct obs_scene_item *next;
 };
 
+/* snapshot of the item list of a scene for the render and tick paths */
+struct obs_scene_items {
+	volatile long readers;
+	size_t num;
+	struct obs_scene_item *array[];
+};
+
 struct obs_scene {
 	struct obs_source *source;
 
@@ -97,4 +104,14 @@ struct obs_scene {
 	pthread_mutex_t video_mutex;
 	pthread_mutex_t audio_mutex;
 	struct obs_scene_item *first_item;
+
+	/* the current snapshot is replaced whenever the list changes, the
+	 * replaced ones are freed on tick once nothing renders them anymore */
+	pthread_mutex_t items_mutex;
+	struct obs_scene_items *items;
+	DARRAY(struct obs_scene_items *) retired_items;
+
+	/* draw calls and batched sprites of the last rendered frame */
+	volatile long draw_calls;
+	volatile long batched_items;
 };
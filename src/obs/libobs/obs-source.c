@@ -71,6 +71,7 @@ static const char *source_signals[] = {
 	"void enable(ptr source, bool enabled)",
 	"void rename(ptr source, string new_name, string prev_name)",
 	"void volume(ptr source, in out float volume)",
+	"void update(ptr source)",
 	"void update_properties(ptr source)",
 	"void update_flags(ptr source, int flags)",
 	"void audio_sync(ptr source, int out int offset)",
@@ -658,6 +659,7 @@ void obs_source_destroy(struct obs_source *source)
 	}
 	if (source->filter_texrender)
 		gs_texrender_destroy(source->filter_texrender);
+	gs_texrender_destroy(source->render_cache);
 
 	//PRISM/LiuHaibin/20200609/#3174/camera effect
 	if (source->cam_shared_texture)
@@ -957,6 +959,8 @@ void obs_source_update(obs_source_t *source, obs_data_t *settings)
 		source->info.update(source->context.data,
 				    source->context.settings);
 	}
+
+	obs_source_dosignal(source, NULL, "update");
 }
 
 //PRISM/Zhangdewen/20200921/#/chat source
@@ -1315,6 +1319,9 @@ static void async_tick(obs_source_t *source)
 	}
 }
 
+/* frames without a second render after which the render cache is freed */
+#define RENDER_CACHE_KEEP_FRAMES 60
+
 void obs_source_video_tick(obs_source_t *source, float seconds)
 {
 	bool now_showing, now_active;
@@ -1335,6 +1342,16 @@ void obs_source_video_tick(obs_source_t *source, float seconds)
 	if (source->filter_texrender)
 		gs_texrender_reset(source->filter_texrender);
 
+	/* free the render cache once the source is no longer shared */
+	if (source->render_cache &&
+	    obs->video.render_frame - source->render_cache_used >
+		    RENDER_CACHE_KEEP_FRAMES) {
+		obs_enter_graphics();
+		gs_texrender_destroy(source->render_cache);
+		source->render_cache = NULL;
+		obs_leave_graphics();
+	}
+
 	/* call show/hide if the reference changed */
 	now_showing = !!source->show_refs;
 	if (now_showing != source->showing) {
@@ -2675,13 +2692,130 @@ static inline void render_video(obs_source_t *source)
 	GS_DEBUG_MARKER_END();
 }
 
+/* returns the texture of a source that draws nothing but a sprite with the
+ * default effect, so the scene can batch it with its other items */
+gs_texture_t *obs_source_get_sprite_texture(obs_source_t *source,
+					    uint32_t *cx, uint32_t *cy)
+{
+	uint32_t flags = source->info.output_flags;
+
+	if (!source->info.get_sprite_texture || !source->context.data ||
+	    !source->enabled)
+		return NULL;
+	if ((flags & OBS_SOURCE_VIDEO) == 0 ||
+	    (flags & OBS_SOURCE_CUSTOM_DRAW) != 0)
+		return NULL;
+	if (source->filters.num || source->filter_parent)
+		return NULL;
+
+	return source->info.get_sprite_texture(source->context.data, cx, cy);
+}
+
+extern THREAD_LOCAL bool is_graphics_thread;
+
+/* only sources that do more than drawing a texture are worth a copy, and
+ * the render of a filter target has to bypass the cache of its source.
+ * scenes and groups draw their items where they are, which can be past
+ * their own size, so they are only cached when filters already bound them */
+static inline bool render_cache_enabled(const obs_source_t *source)
+{
+	if (!is_graphics_thread || source->filter_parent ||
+	    source->rendering_filter)
+		return false;
+
+	return source->info.type == OBS_SOURCE_TYPE_TRANSITION ||
+	       source->filters.num > 0;
+}
+
+static bool render_cache_fill(obs_source_t *source)
+{
+	uint32_t cx = obs_source_get_width(source);
+	uint32_t cy = obs_source_get_height(source);
+	struct vec4 clear_color;
+
+	if (!source->render_cache)
+		source->render_cache = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+
+	gs_texrender_reset(source->render_cache);
+	if (!gs_texrender_begin(source->render_cache, cx, cy))
+		return false;
+
+	vec4_zero(&clear_color);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+	gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+	render_video(source);
+
+	gs_texrender_end(source->render_cache);
+	return true;
+}
+
+static void render_cache_draw(obs_source_t *source)
+{
+	gs_texture_t *tex = gs_texrender_get_texture(source->render_cache);
+	gs_effect_t *effect = obs->video.default_effect;
+
+	if (!tex)
+		return;
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+
+	while (gs_effect_loop(effect, "Draw"))
+		obs_source_draw(tex, 0, 0, 0, 0, 0);
+
+	gs_blend_state_pop();
+}
+
+/* returns false if the source has to be rendered directly */
+static bool render_cached(obs_source_t *source)
+{
+	uint64_t frame = obs->video.render_frame;
+
+	if (source->render_cache_frame != frame) {
+		source->render_cache_prev_refs =
+			source->render_cache_frame + 1 == frame
+				? source->render_cache_refs
+				: 0;
+		source->render_cache_frame = frame;
+		source->render_cache_refs = 0;
+		source->render_cache_valid = false;
+	}
+
+	source->render_cache_refs++;
+
+	if (source->render_cache_valid) {
+		obs->video.render_cache_hits++;
+		source->render_cache_used = frame;
+		render_cache_draw(source);
+		return true;
+	}
+
+	/* cache the first render if the previous frame rendered the source
+	 * more than once, otherwise start at the second one */
+	if (source->render_cache_prev_refs > 1 ||
+	    source->render_cache_refs > 1) {
+		if (!render_cache_fill(source))
+			return false;
+
+		obs->video.render_cache_misses++;
+		source->render_cache_valid = true;
+		source->render_cache_used = frame;
+		render_cache_draw(source);
+		return true;
+	}
+
+	return false;
+}
+
 void obs_source_video_render(obs_source_t *source)
 {
 	if (!obs_source_valid(source, "obs_source_video_render"))
 		return;
 
 	obs_source_addref(source);
-	render_video(source);
+	if (!render_cache_enabled(source) || !render_cached(source))
+		render_video(source);
 	obs_source_release(source);
 }
 
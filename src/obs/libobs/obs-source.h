@@ -593,6 +593,24 @@ struct obs_source_info {
 	void (*properties_edit_start)(void *data, obs_data_t *settings);
 	// source properties window close
 	void (*properties_edit_end)(void *data, obs_data_t *settings);
+
+	/* ----------------------------------------------------------------- */
+	/**
+	 * Gets the texture the source would draw as a plain sprite in
+	 * video_render (optional)
+	 *
+	 * Sources that implement this can have their sprite batched with
+	 * other scene items instead of being rendered one by one, in which
+	 * case video_render is not called.  Return NULL to be rendered
+	 * normally.
+	 *
+	 * @param  data  Source data
+	 * @param  cx    Receives the width of the sprite
+	 * @param  cy    Receives the height of the sprite
+	 * @return       The texture, valid until the end of the frame
+	 */
+	gs_texture_t *(*get_sprite_texture)(void *data, uint32_t *cx,
+					    uint32_t *cy);
 };
 
 EXPORT void obs_register_source_s(const struct obs_source_info *info,
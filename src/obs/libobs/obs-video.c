@@ -17,12 +17,14 @@
 
 #include <time.h>
 #include <stdlib.h>
+#include <inttypes.h>
 
 #include "obs.h"
 #include "obs-internal.h"
 #include "graphics/vec4.h"
 #include "media-io/format-conversion.h"
 #include "media-io/video-frame.h"
+#include "util/util_uint64.h"
 
 #ifdef _WIN32
 #define WIN32_MEAN_AND_LEAN
@@ -84,6 +86,8 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 
 	pthread_mutex_unlock(&data->sources_mutex);
 
+	obs_scene_free_reclaimed_items();
+
 	//PRISM/WangShaohui/20201028/NoIssue/while accessing source list, cann't release source
 	for (size_t i = 0; i < delay_release_list.num; i++) {
 		struct obs_source *source = *(delay_release_list.array + i);
@@ -118,6 +122,8 @@ static inline void render_displays(void)
 
 	pthread_mutex_unlock(&obs->data.displays_mutex);
 
+	obs_free_scaled_copies(true);
+
 	gs_leave_context();
 }
 
@@ -229,6 +235,34 @@ static inline gs_effect_t *get_scale_effect(struct obs_core_video *video,
 }
 
 static const char *render_output_texture_name = "render_output_texture";
+
+/* the scale pass only depends on the video settings, so it is chosen once
+ * after each video reset instead of every frame */
+static void init_output_scale(struct obs_core_video *video, uint32_t width,
+			      uint32_t height)
+{
+	gs_effect_t *effect = get_scale_effect(video, width, height);
+
+	video->output_passthrough = false;
+
+	if (video->ovi.output_format == VIDEO_FORMAT_RGBA) {
+		video->output_tech =
+			gs_effect_get_technique(effect, "DrawAlphaDivide");
+	} else {
+		video->output_passthrough = (effect == video->default_effect) &&
+					    (width == video->base_width) &&
+					    (height == video->base_height);
+		video->output_tech = gs_effect_get_technique(effect, "Draw");
+	}
+
+	video->output_image = gs_effect_get_param_by_name(effect, "image");
+	video->output_base_dim =
+		gs_effect_get_param_by_name(effect, "base_dimension");
+	video->output_base_dim_i =
+		gs_effect_get_param_by_name(effect, "base_dimension_i");
+	video->output_effect = effect;
+}
+
 static inline gs_texture_t *render_output_texture(struct obs_core_video *video)
 {
 	/* ------------------------------------- */
@@ -237,7 +271,7 @@ static inline gs_texture_t *render_output_texture(struct obs_core_video *video)
 	if (obs_outro_active(video->outro))
 		return obs_outro_render(video);
 
-	bool watermark_enabled = obs_watermark_enabled(video->watermark);
+	bool watermark_visible = obs_watermark_visible(video->watermark);
 	gs_texture_t *texture = video->render_texture;
 
 	//End
@@ -251,51 +285,36 @@ static inline gs_texture_t *render_output_texture(struct obs_core_video *video)
 	uint32_t width = gs_texture_get_width(target);
 	uint32_t height = gs_texture_get_height(target);
 
-	gs_effect_t *effect = get_scale_effect(video, width, height);
-	gs_technique_t *tech;
+	if (!video->output_effect)
+		init_output_scale(video, width, height);
 
-	if (video->ovi.output_format == VIDEO_FORMAT_RGBA) {
-		tech = gs_effect_get_technique(effect, "DrawAlphaDivide");
-	} else {
-		if ((effect == video->default_effect) &&
-		    (width == video->base_width) &&
-		    (height == video->base_height))
-			//PRISM/LiuHaibin/20200117/#215/for watermark
-			return watermark_enabled
-				       ? obs_watermark_render(video->watermark,
-							      texture)
-				       : texture;
-
-		tech = gs_effect_get_technique(effect, "Draw");
-	}
+	//PRISM/LiuHaibin/20200117/#215/for watermark
+	if (video->output_passthrough && !watermark_visible)
+		return texture;
 
 	profile_start(render_output_texture_name);
 
-	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
-	gs_eparam_t *bres =
-		gs_effect_get_param_by_name(effect, "base_dimension");
-	gs_eparam_t *bres_i =
-		gs_effect_get_param_by_name(effect, "base_dimension_i");
+	gs_technique_t *tech = video->output_tech;
 	size_t passes, i;
 
 	gs_set_render_target(target, NULL);
 	set_render_size(width, height);
 
-	if (bres) {
+	if (video->output_base_dim) {
 		struct vec2 base;
 		vec2_set(&base, (float)video->base_width,
 			 (float)video->base_height);
-		gs_effect_set_vec2(bres, &base);
+		gs_effect_set_vec2(video->output_base_dim, &base);
 	}
 
-	if (bres_i) {
+	if (video->output_base_dim_i) {
 		struct vec2 base_i;
 		vec2_set(&base_i, 1.0f / (float)video->base_width,
 			 1.0f / (float)video->base_height);
-		gs_effect_set_vec2(bres_i, &base_i);
+		gs_effect_set_vec2(video->output_base_dim_i, &base_i);
 	}
 
-	gs_effect_set_texture(image, texture);
+	gs_effect_set_texture(video->output_image, texture);
 
 	gs_enable_blending(false);
 	passes = gs_technique_begin(tech);
@@ -307,12 +326,13 @@ static inline gs_texture_t *render_output_texture(struct obs_core_video *video)
 	gs_technique_end(tech);
 	gs_enable_blending(true);
 
+	//PRISM/LiuHaibin/20200219/#215/for watermark
+	if (watermark_visible)
+		obs_watermark_render(video->watermark);
+
 	profile_end(render_output_texture_name);
 
-	//PRISM/LiuHaibin/20200219/#215/for watermark
-	return watermark_enabled
-		       ? obs_watermark_render(video->watermark, target)
-		       : target;
+	return target;
 }
 
 static void render_convert_plane(gs_effect_t *effect, gs_texture_t *target,
@@ -961,6 +981,162 @@ static void uninit_winrt_state(struct winrt_state *winrt)
 static const char *tick_sources_name = "tick_sources";
 static const char *render_displays_name = "render_displays";
 static const char *output_frame_name = "output_frame";
+
+static bool create_gpu_timers(struct obs_core_video *video)
+{
+	for (size_t i = 0; i < GPU_TIMER_SLOTS; i++) {
+		struct obs_gpu_timer_slot *slot = &video->gpu_timers[i];
+
+		slot->range = gs_timer_range_create();
+		slot->output = gs_timer_create();
+		slot->displays = gs_timer_create();
+		if (!slot->range || !slot->output || !slot->displays)
+			return false;
+	}
+
+	return true;
+}
+
+void obs_free_gpu_timers(void)
+{
+	struct obs_core_video *video = &obs->video;
+
+	for (size_t i = 0; i < GPU_TIMER_SLOTS; i++) {
+		struct obs_gpu_timer_slot *slot = &video->gpu_timers[i];
+
+		gs_timer_range_destroy(slot->range);
+		gs_timer_destroy(slot->output);
+		gs_timer_destroy(slot->displays);
+		memset(slot, 0, sizeof(*slot));
+	}
+
+	video->gpu_timers_created = false;
+	video->gpu_timers_failed = false;
+}
+
+static void read_gpu_timers(struct obs_core_video *video,
+			    struct obs_gpu_timer_slot *slot)
+{
+	uint64_t frequency;
+	uint64_t output_ticks;
+	uint64_t displays_ticks;
+	bool disjoint;
+
+	if (!slot->pending)
+		return;
+
+	slot->pending = false;
+
+	if (!gs_timer_range_get_data(slot->range, &disjoint, &frequency) ||
+	    disjoint || !frequency)
+		return;
+	if (!gs_timer_get_data(slot->output, &output_ticks) ||
+	    !gs_timer_get_data(slot->displays, &displays_ticks))
+		return;
+
+	video->render_timing.output_gpu_ns +=
+		util_mul_div64(output_ticks, 1000000000ULL, frequency);
+	video->render_timing.displays_gpu_ns +=
+		util_mul_div64(displays_ticks, 1000000000ULL, frequency);
+	video->render_timing.gpu_frames++;
+}
+
+/* the context is only entered around the timer queries, output_frame leaves
+ * it while it copies the raw frame and that shouldn't hold the graphics
+ * mutex.  The results of the oldest slot are read back before it's reused */
+static struct obs_gpu_timer_slot *begin_render_timing(void)
+{
+	struct obs_core_video *video = &obs->video;
+	struct obs_gpu_timer_slot *slot = NULL;
+
+	gs_enter_context(video->graphics);
+
+	if (!video->gpu_timers_created && !video->gpu_timers_failed) {
+		video->gpu_timers_created = create_gpu_timers(video);
+		if (!video->gpu_timers_created) {
+			blog(LOG_INFO, "GPU timers unavailable, display "
+				       "render stats are CPU only");
+			obs_free_gpu_timers();
+			video->gpu_timers_failed = true;
+		}
+	}
+
+	if (video->gpu_timers_created) {
+		slot = &video->gpu_timers[video->cur_gpu_timer];
+		video->cur_gpu_timer =
+			(video->cur_gpu_timer + 1) % GPU_TIMER_SLOTS;
+
+		read_gpu_timers(video, slot);
+
+		gs_timer_range_begin(slot->range);
+		gs_timer_begin(slot->output);
+	}
+
+	gs_leave_context();
+	return slot;
+}
+
+static inline void switch_render_timing(struct obs_gpu_timer_slot *slot)
+{
+	if (slot) {
+		gs_enter_context(obs->video.graphics);
+		gs_timer_end(slot->output);
+		gs_timer_begin(slot->displays);
+		gs_leave_context();
+	}
+}
+
+static inline void end_render_timing(struct obs_gpu_timer_slot *slot)
+{
+	if (slot) {
+		gs_enter_context(obs->video.graphics);
+		gs_timer_end(slot->displays);
+		gs_timer_range_end(slot->range);
+		slot->pending = true;
+		gs_leave_context();
+	}
+}
+
+static inline void add_render_timing(struct obs_render_timing *dst,
+				     const struct obs_render_timing *src)
+{
+	dst->output_cpu_ns += src->output_cpu_ns;
+	dst->displays_cpu_ns += src->displays_cpu_ns;
+	dst->output_gpu_ns += src->output_gpu_ns;
+	dst->displays_gpu_ns += src->displays_gpu_ns;
+	dst->frames += src->frames;
+	dst->gpu_frames += src->gpu_frames;
+	dst->displays_rendered += src->displays_rendered;
+	dst->displays_skipped += src->displays_skipped;
+}
+
+static inline double avg_ms(uint64_t total_ns, uint32_t frames)
+{
+	return frames ? (double)total_ns / (double)frames / 1000000.0 : 0.0;
+}
+
+static void log_render_timing(void)
+{
+	struct obs_render_timing *t = &obs->video.total_render_timing;
+
+	add_render_timing(t, &obs->video.render_timing);
+	if (!t->frames)
+		return;
+
+	blog(LOG_INFO,
+	     "Display rendering: %.3f ms CPU per frame (output %.3f ms), "
+	     "%" PRIu32 " display frames rendered, %" PRIu32 " skipped",
+	     avg_ms(t->displays_cpu_ns, t->frames),
+	     avg_ms(t->output_cpu_ns, t->frames), t->displays_rendered,
+	     t->displays_skipped);
+
+	if (t->gpu_frames)
+		blog(LOG_INFO,
+		     "Display rendering: %.3f ms GPU per frame "
+		     "(output %.3f ms)",
+		     avg_ms(t->displays_gpu_ns, t->gpu_frames),
+		     avg_ms(t->output_gpu_ns, t->gpu_frames));
+}
 void *obs_graphics_thread(void *param)
 {
 #ifdef _WIN32
@@ -993,6 +1169,10 @@ void *obs_graphics_thread(void *param)
 
 	srand((unsigned int)time(NULL));
 
+	memset(&obs->video.render_timing, 0, sizeof(obs->video.render_timing));
+	memset(&obs->video.total_render_timing, 0,
+	       sizeof(obs->video.total_render_timing));
+
 	while (!video_output_stopped(obs->video.video)) {
 		uint64_t frame_start = os_gettime_ns();
 		uint64_t frame_time_ns;
@@ -1020,6 +1200,8 @@ void *obs_graphics_thread(void *param)
 
 		profile_start(video_thread_name);
 
+		obs->video.render_frame++;
+
 		profile_start(tick_sources_name);
 		last_time = tick_sources(obs->video.video_time, last_time);
 		profile_end(tick_sources_name);
@@ -1036,13 +1218,29 @@ void *obs_graphics_thread(void *param)
 
 		//PRISM/Wang.Chuanjing/20200408/#2321 for device rebuild
 		if (is_render_working()) {
+			struct obs_gpu_timer_slot *timers =
+				begin_render_timing();
+			uint64_t output_start = os_gettime_ns();
+			uint64_t displays_start;
+
 			profile_start(output_frame_name);
 			output_frame(raw_active, gpu_active);
 			profile_end(output_frame_name);
 
+			switch_render_timing(timers);
+			displays_start = os_gettime_ns();
+
 			profile_start(render_displays_name);
 			render_displays();
 			profile_end(render_displays_name);
+
+			obs->video.render_timing.output_cpu_ns +=
+				displays_start - output_start;
+			obs->video.render_timing.displays_cpu_ns +=
+				os_gettime_ns() - displays_start;
+			obs->video.render_timing.frames++;
+
+			end_render_timing(timers);
 		} else {
 			gs_device_rebuild(obs->video.graphics);
 		}
@@ -1071,9 +1269,18 @@ void *obs_graphics_thread(void *param)
 			frame_time_total_ns = 0;
 			fps_total_ns = 0;
 			fps_total_frames = 0;
+
+			add_render_timing(&obs->video.total_render_timing,
+					  &obs->video.render_timing);
+			obs->video.last_render_timing =
+				obs->video.render_timing;
+			memset(&obs->video.render_timing, 0,
+			       sizeof(obs->video.render_timing));
 		}
 	}
 
+	log_render_timing();
+
 #ifdef _WIN32
 	uninit_winrt_state(&winrt);
 #endif
@@ -453,6 +453,9 @@ static int obs_init_video(struct obs_video_info *ovi)
 	video->outro = obs_outro_create("pls_outro");
 	video->watermark = obs_watermark_create();
 
+	//PRISM/LiuHaibin/20200217/#432/for live thumbnail
+	video->thumbnail = obs_thumbnail_create();
+
 	//End
 	/* ------------------------------------------------------------------------- */
 
@@ -516,6 +519,9 @@ static void obs_free_video(void)
 {
 	struct obs_core_video *video = &obs->video;
 
+	//PRISM/LiuHaibin/20200217/#432/for live thumbnail
+	free_thumbnail();
+
 	if (video->video) {
 		video_output_close(video->video);
 		video->video = NULL;
@@ -566,6 +572,9 @@ static void obs_free_video(void)
 		video->render_texture = NULL;
 		video->output_texture = NULL;
 
+		obs_free_scaled_copies(false);
+		obs_free_gpu_timers();
+
 		gs_leave_context();
 
 		circlebuf_free(&video->vframe_info_buffer);
@@ -588,6 +597,7 @@ static void obs_free_video(void)
 
 		video->gpu_encoder_active = 0;
 		video->cur_texture = 0;
+		video->output_effect = NULL;
 	}
 }
 
@@ -646,6 +656,7 @@ static bool obs_init_audio(struct audio_output_info *ai)
 
 	audio->monitoring_device_name = bstrdup("Default");
 	audio->monitoring_device_id = bstrdup("default");
+	audio->monitoring_latency_ms = DEFAULT_MONITORING_LATENCY_MS;
 
 	errorcode = audio_output_open(&audio->audio, ai);
 	if (errorcode == AUDIO_OUTPUT_SUCCESS)
@@ -758,12 +769,19 @@ static void obs_free_data(void)
 
 	blog(LOG_INFO, "Freeing OBS context data");
 
+	/* queued by the last video tick, the video thread is stopped so no
+	 * more are queued.  Freed while their sources are still alive, the
+	 * remaining sources are destroyed regardless of their references. */
+	obs_scene_free_reclaimed_items();
+
 	FREE_OBS_LINKED_LIST(source);
 	FREE_OBS_LINKED_LIST(output);
 	FREE_OBS_LINKED_LIST(encoder);
 	FREE_OBS_LINKED_LIST(display);
 	FREE_OBS_LINKED_LIST(service);
 
+	da_free(data->reclaimed_scene_items);
+
 	pthread_mutex_destroy(&data->sources_mutex);
 	pthread_mutex_destroy(&data->audio_sources_mutex);
 	pthread_mutex_destroy(&data->displays_mutex);
@@ -1105,9 +1123,6 @@ void obs_shutdown(void)
 	//PRISM/LiuHaibin/20200117/#215/for watermark
 	stop_watermark();
 
-	//PRISM/LiuHaibin/20200217/#432/for live thumbnail
-	free_thumbnail();
-
 	stop_video();
 	stop_hotkeys();
 
@@ -1875,6 +1890,59 @@ void obs_render_main_texture_src_color_only(void)
 					 GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
 }
 
+static void obs_render_main_texture_scaled_internal(
+	uint32_t cx, uint32_t cy, enum gs_blend_type src_c,
+	enum gs_blend_type dest_c, enum gs_blend_type src_a,
+	enum gs_blend_type dest_a)
+{
+	struct obs_core_video *video;
+	gs_texture_t *tex;
+	gs_effect_t *effect;
+	gs_eparam_t *param;
+
+	if (!obs)
+		return;
+
+	video = &obs->video;
+	if (!video->texture_rendered)
+		return;
+
+	tex = obs_get_scaled_main_texture(cx, cy);
+	if (!tex) {
+		obs_render_main_texture_internal(src_c, dest_c, src_a, dest_a);
+		return;
+	}
+
+	effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	param = gs_effect_get_param_by_name(effect, "image");
+	gs_effect_set_texture(param, tex);
+
+	gs_blend_state_push();
+	gs_blend_function_separate(src_c, dest_c, src_a, dest_a);
+
+	/* drawn over the base size so it replaces obs_render_main_texture
+	 * in the same projection */
+	while (gs_effect_loop(effect, "Draw"))
+		gs_draw_sprite(tex, 0, video->base_width, video->base_height);
+
+	gs_blend_state_pop();
+}
+
+void obs_render_main_texture_scaled(uint32_t cx, uint32_t cy)
+{
+	obs_render_main_texture_scaled_internal(cx, cy, GS_BLEND_ONE,
+						GS_BLEND_INVSRCALPHA,
+						GS_BLEND_ONE,
+						GS_BLEND_INVSRCALPHA);
+}
+
+void obs_render_main_texture_scaled_src_color_only(uint32_t cx, uint32_t cy)
+{
+	obs_render_main_texture_scaled_internal(cx, cy, GS_BLEND_ONE,
+						GS_BLEND_ZERO, GS_BLEND_ONE,
+						GS_BLEND_INVSRCALPHA);
+}
+
 gs_texture_t *obs_get_main_texture(void)
 {
 	struct obs_core_video *video;
@@ -2467,6 +2535,43 @@ void obs_get_audio_monitoring_device(const char **name, const char **id)
 		*id = obs->audio.monitoring_device_id;
 }
 
+bool obs_set_audio_monitoring_latency(uint32_t latency_ms)
+{
+	if (!obs || !latency_ms)
+		return false;
+
+#if defined(_WIN32) || HAVE_PULSEAUDIO || defined(__APPLE__)
+	pthread_mutex_lock(&obs->audio.monitoring_mutex);
+
+	if (latency_ms != obs->audio.monitoring_latency_ms) {
+		obs->audio.monitoring_latency_ms = latency_ms;
+
+		for (size_t i = 0; i < obs->audio.monitors.num; i++) {
+			struct audio_monitor *monitor =
+				obs->audio.monitors.array[i];
+			audio_monitor_reset(monitor);
+		}
+	}
+
+	pthread_mutex_unlock(&obs->audio.monitoring_mutex);
+	return true;
+#else
+	return false;
+#endif
+}
+
+uint32_t obs_get_audio_monitoring_latency(void)
+{
+	return obs ? obs->audio.monitoring_latency_ms : 0;
+}
+
+uint32_t obs_get_audio_monitoring_underflows(void)
+{
+	return obs ? (uint32_t)os_atomic_load_long(
+			     &obs->audio.monitoring_underflows)
+		   : 0;
+}
+
 void obs_add_tick_callback(void (*tick)(void *param, float seconds),
 			   void *param)
 {
@@ -2531,6 +2636,46 @@ uint32_t obs_get_lagged_frames(void)
 	return obs ? obs->video.lagged_frames : 0;
 }
 
+void obs_get_render_cache_stats(uint64_t *hits, uint64_t *misses)
+{
+	if (hits)
+		*hits = obs ? obs->video.render_cache_hits : 0;
+	if (misses)
+		*misses = obs ? obs->video.render_cache_misses : 0;
+}
+
+void obs_get_display_render_stats(struct obs_display_render_stats *stats)
+{
+	struct obs_render_timing t;
+
+	if (!stats)
+		return;
+
+	memset(stats, 0, sizeof(*stats));
+	if (!obs)
+		return;
+
+	t = obs->video.last_render_timing;
+
+	if (t.frames) {
+		stats->output_cpu_ms =
+			(double)t.output_cpu_ns / (double)t.frames / 1000000.0;
+		stats->displays_cpu_ms = (double)t.displays_cpu_ns /
+					 (double)t.frames / 1000000.0;
+	}
+
+	if (t.gpu_frames) {
+		stats->output_gpu_ms = (double)t.output_gpu_ns /
+				       (double)t.gpu_frames / 1000000.0;
+		stats->displays_gpu_ms = (double)t.displays_gpu_ns /
+					 (double)t.gpu_frames / 1000000.0;
+		stats->gpu_valid = true;
+	}
+
+	stats->displays_rendered = t.displays_rendered;
+	stats->displays_skipped = t.displays_skipped;
+}
+
 void start_raw_video(video_t *v, const struct video_scale_info *conversion,
 		     void (*callback)(void *param, struct video_data *frame),
 		     void *param)
@@ -121,6 +121,18 @@ enum obs_allow_direct_render {
 	OBS_ALLOW_DIRECT_RENDERING,
 };
 
+/** How often a display is redrawn, see obs_display_set_render_policy */
+enum obs_display_render_policy {
+	/** Every frame */
+	OBS_DISPLAY_RENDER_FULL,
+	/** Every frame up to the rate of obs_display_set_max_fps */
+	OBS_DISPLAY_RENDER_CAPPED,
+	/** Only when resized or after obs_display_request_render */
+	OBS_DISPLAY_RENDER_ON_CHANGE,
+	/** Never, the size change of a resize is kept for later */
+	OBS_DISPLAY_RENDER_OFF,
+};
+
 enum obs_scale_type {
 	OBS_SCALE_DISABLE,
 	OBS_SCALE_POINT,
@@ -690,6 +702,26 @@ EXPORT void obs_render_main_texture_src_color_only(void);
  * is unavailable. */
 EXPORT gs_texture_t *obs_get_main_texture(void);
 
+/**
+ * Returns the last main output texture scaled down to cx x cy pixels.  The
+ * copy is made at most once per frame for each size and shared by everything
+ * drawing that size, so several previews of the same size cost a single
+ * scale pass.  Only valid on the graphics thread, and returns NULL if the
+ * texture is unavailable or wouldn't be smaller than the base resolution.
+ */
+EXPORT gs_texture_t *obs_get_scaled_main_texture(uint32_t cx, uint32_t cy);
+
+/**
+ * Renders the last main output texture through its shared copy scaled to
+ * cx x cy, the size it covers on screen.  It's drawn over the base size like
+ * obs_render_main_texture, and falls back to it when there is no copy.
+ */
+EXPORT void obs_render_main_texture_scaled(uint32_t cx, uint32_t cy);
+
+/** Renders the scaled main output texture ignoring background color */
+EXPORT void obs_render_main_texture_scaled_src_color_only(uint32_t cx,
+							  uint32_t cy);
+
 /** Sets the master user volume */
 EXPORT void obs_set_master_volume(float volume);
 
@@ -746,6 +778,17 @@ EXPORT void obs_enum_audio_monitoring_devices(obs_enum_audio_device_cb cb,
 EXPORT bool obs_set_audio_monitoring_device(const char *name, const char *id);
 EXPORT void obs_get_audio_monitoring_device(const char **name, const char **id);
 
+/**
+ * Sets the target latency of audio monitoring in milliseconds.  Not every
+ * monitoring backend uses it, PulseAudio mixes all monitored sources into
+ * one stream with this buffer length.
+ */
+EXPORT bool obs_set_audio_monitoring_latency(uint32_t latency_ms);
+EXPORT uint32_t obs_get_audio_monitoring_latency(void);
+
+/** Number of times the monitoring device ran out of audio */
+EXPORT uint32_t obs_get_audio_monitoring_underflows(void);
+
 EXPORT void obs_add_tick_callback(void (*tick)(void *param, float seconds),
 				  void *param);
 EXPORT void obs_remove_tick_callback(void (*tick)(void *param, float seconds),
@@ -772,6 +815,33 @@ EXPORT uint64_t obs_get_frame_interval_ns(void);
 EXPORT uint32_t obs_get_total_frames(void);
 EXPORT uint32_t obs_get_lagged_frames(void);
 
+/**
+ * Transitions and sources with filters that are rendered more than once in
+ * a frame (multiview, projectors, nested scenes) are rendered once into a
+ * texture which is reused for the rest of the frame.  Gets the number
+ * of renders served from that texture, and the number that had to fill it.
+ */
+EXPORT void obs_get_render_cache_stats(uint64_t *hits, uint64_t *misses);
+
+/** Cost of the displays next to the output render, over the last second */
+struct obs_display_render_stats {
+	/* averages per frame in milliseconds */
+	double output_cpu_ms;
+	double displays_cpu_ms;
+	double output_gpu_ms;
+	double displays_gpu_ms;
+
+	/* false if the GPU timers are unavailable */
+	bool gpu_valid;
+
+	/* display frames rendered and skipped by their render policies */
+	uint32_t displays_rendered;
+	uint32_t displays_skipped;
+};
+
+EXPORT void
+obs_get_display_render_stats(struct obs_display_render_stats *stats);
+
 EXPORT bool obs_nv12_tex_active(void);
 
 EXPORT void obs_apply_private_data(obs_data_t *settings);
@@ -863,6 +933,27 @@ EXPORT void obs_display_set_background_color(obs_display_t *display,
 EXPORT void obs_display_size(obs_display_t *display, uint32_t *width,
 			     uint32_t *height);
 
+/**
+ * Sets how often the display is redrawn and presented, independently of the
+ * output frame rate.  Skipped frames leave the last presented image on
+ * screen.  Displays start with OBS_DISPLAY_RENDER_FULL.
+ */
+EXPORT void
+obs_display_set_render_policy(obs_display_t *display,
+			      enum obs_display_render_policy policy);
+EXPORT enum obs_display_render_policy
+obs_display_get_render_policy(obs_display_t *display);
+
+/**
+ * Sets the rate of OBS_DISPLAY_RENDER_CAPPED, 0 (the default) doesn't cap
+ * it.
+ */
+EXPORT void obs_display_set_max_fps(obs_display_t *display, uint32_t fps);
+EXPORT uint32_t obs_display_get_max_fps(obs_display_t *display);
+
+/** Redraws an OBS_DISPLAY_RENDER_ON_CHANGE display on the next frame */
+EXPORT void obs_display_request_render(obs_display_t *display);
+
 /* ------------------------------------------------------------------------- */
 /* Sources */
 
@@ -1566,6 +1657,15 @@ EXPORT void obs_scene_enum_items(obs_scene_t *scene,
 						  obs_sceneitem_t *, void *),
 				 void *param);
 
+/**
+ * Gets the draw calls the last rendered frame of a scene took, and how many
+ * of its items were batched into shared sprite draws.  Items that are not
+ * batched count as one draw call each, nested scenes are not included.
+ */
+EXPORT void obs_scene_get_draw_stats(const obs_scene_t *scene,
+				     uint32_t *draw_calls,
+				     uint32_t *batched_items);
+
 EXPORT bool obs_scene_reorder_items(obs_scene_t *scene,
 				    obs_sceneitem_t *const *item_order,
 				    size_t item_order_size);
@@ -2363,14 +2463,46 @@ EXPORT void obs_watermark_set_refresh(bool update);
 /* ------------------------------------------------------------------------- */
 //PRISM/LiuHaibin/20200217/#432/for live thumbnail
 
-/** request live thumbnail */
+enum obs_thumbnail_format {
+	OBS_THUMBNAIL_RGBA,
+	OBS_THUMBNAIL_PNG,
+	OBS_THUMBNAIL_JPEG,
+};
+
+/** called with the image, or NULL data if the request failed */
+typedef void (*obs_thumbnail_image_cb)(void *param, const uint8_t *data,
+				       size_t size, uint32_t width,
+				       uint32_t height);
+
+/** request live thumbnail, the callback is called from the thumbnail
+ * encode thread once obs_thumbnail_retrieve can return it */
 EXPORT void obs_thumbnail_request(uint32_t width, uint32_t height,
 				  bool (*callback)(void *param, uint32_t width,
 						   uint32_t height,
 						   bool request_succeed),
 				  void *param);
 
-/** retrieve live thumbnail data */
+/**
+ * request live thumbnail as an image.  The request doesn't wait for the GPU,
+ * the thumbnail is read back a few frames later and encoded on the thumbnail
+ * encode thread, which also calls the callback.  Requests of different sizes
+ * can be outstanding at the same time.
+ *
+ * @param quality JPEG quality from 1 to 100, unused for other formats
+ */
+EXPORT void obs_thumbnail_request_image(uint32_t width, uint32_t height,
+					enum obs_thumbnail_format format,
+					int quality,
+					obs_thumbnail_image_cb callback,
+					void *param);
+
+/**
+ * retrieve live thumbnail data
+ *
+ * The RGBA data is owned by libobs.  It stays valid until the next call to
+ * obs_thumbnail_retrieve or obs_thumbnail_free, whichever comes first, so
+ * copy it before retrieving again.
+ */
 EXPORT bool obs_thumbnail_retrieve(void **data, uint32_t *width,
 				   uint32_t *height);
 
@@ -24,13 +24,12 @@ static void reset_outro(obs_outro_t *outro)
 	outro->timeout_nsec = 0;
 	outro->start_time_nsec = 0;
 
+	outro->scale_effect = NULL;
+
 	if (outro->name) {
 		bfree(outro->name);
 		outro->name = NULL;
 	}
-
-	memset(outro->fake_audio_mix_buffer, 0,
-	       sizeof(float) * MAX_AUDIO_CHANNELS * AUDIO_OUTPUT_FRAMES);
 }
 
 static void activate_outro_source(struct obs_outro *outro)
@@ -151,6 +150,7 @@ static bool reset_texture(struct obs_outro *outro)
 
 	outro->render_width = source_width;
 	outro->render_height = source_height;
+	outro->scale_effect = NULL;
 
 	return true;
 }
@@ -422,35 +422,91 @@ void *obs_outro_thread(void *param)
 	return NULL;
 }
 
+/* renders the outro source straight into the output texture, for when it
+ * doesn't need more than the bilinear filtering of the source itself */
+static void render_outro_direct(obs_outro_t *outro, gs_texture_t *target,
+				uint32_t base_width, uint32_t base_height,
+				uint32_t x, uint32_t y, uint32_t cx,
+				uint32_t cy)
+{
+	struct vec4 clear_color;
+	vec4_set(&clear_color, 0.0f, 0.0f, 0.0f, 0.0f);
+
+	gs_set_render_target(target, NULL);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 1.0f, 0);
+
+	gs_enable_depth_test(false);
+	gs_set_cull_mode(GS_NEITHER);
+
+	gs_ortho(0.0f, (float)base_width, 0.0f, (float)base_height, -100.0f,
+		 100.0f);
+	gs_set_viewport(x, y, cx, cy);
+
+	struct obs_source *source = outro->source;
+	if (source) {
+		if (source->removed) {
+			obs_source_release(source);
+		} else {
+			obs_source_video_render(source);
+		}
+	}
+}
+
 gs_texture_t *obs_outro_render(struct obs_core_video *video)
 {
 	if (video && video->outro) {
-		if (!reset_texture(video->outro))
-			return NULL;
-		
-		uint32_t base_width = video->outro->render_width;
-		uint32_t base_height = video->outro->render_height;
+		obs_outro_t *outro = video->outro;
+		uint32_t base_width = obs_source_get_width(outro->source);
+		uint32_t base_height = obs_source_get_height(outro->source);
 
-		gs_texture_t *texture = render_outro_internal(video->outro);
+		if (!base_width || !base_height)
+			return NULL;
 
 		gs_texture_t *target = video->output_texture;
 		uint32_t width = gs_texture_get_width(target);
 		uint32_t height = gs_texture_get_height(target);
 
-		gs_effect_t *effect = get_scale_effect(video, width, height);
-		gs_technique_t *tech;
+		uint32_t x = 0;
+		uint32_t y = 0;
+		uint32_t cx = 0;
+		uint32_t cy = 0;
 
-		if (video->ovi.output_format == VIDEO_FORMAT_RGBA) {
-			tech = gs_effect_get_technique(effect,
-						       "DrawAlphaDivide");
+		double target_ratio = (double)width / (double)height;
+		double base_ratio = (double)base_width / (double)base_height;
+		if (target_ratio > base_ratio) {
+			cy = height;
+			cx = cy * base_ratio;
 		} else {
-			if ((effect == video->default_effect) &&
-			    (width == base_width) && (height == base_height))
-				return texture;
+			cx = width;
+			cy = cx / base_ratio;
+		}
+
+		x = (width - cx) / 2;
+		y = (height - cy) / 2;
 
-			tech = gs_effect_get_technique(effect, "Draw");
+		/* at about the same size the scale filter makes no
+		 * difference, so skip the intermediate texture */
+		if (labs((long)base_width - (long)cx) <= 16 &&
+		    labs((long)base_height - (long)cy) <= 16) {
+			render_outro_direct(outro, target, base_width,
+					    base_height, x, y, cx, cy);
+			return target;
 		}
 
+		gs_texture_t *texture = render_outro_internal(outro);
+		if (!texture)
+			return NULL;
+
+		if (!outro->scale_effect)
+			outro->scale_effect =
+				get_scale_effect(video, width, height);
+
+		gs_effect_t *effect = outro->scale_effect;
+		gs_technique_t *tech = gs_effect_get_technique(
+			effect, video->ovi.output_format == VIDEO_FORMAT_RGBA
+					? "DrawAlphaDivide"
+					: "Draw");
+
 		gs_eparam_t *image =
 			gs_effect_get_param_by_name(effect, "image");
 		gs_eparam_t *bres =
@@ -467,24 +523,6 @@ gs_texture_t *obs_outro_render(struct obs_core_video *video)
 		gs_ortho(0.0f, (float)width, 0.0f, (float)height, -100.0f,
 			 100.0f);
 
-		uint32_t x = 0;
-		uint32_t y = 0;
-		uint32_t cx = 0;
-		uint32_t cy = 0;
-
-		double target_ratio = (double)width / (double)height;
-		double base_ratio = (double)base_width / (double)base_height;
-		if (target_ratio > base_ratio) {
-			cy = height;
-			cx = cy * base_ratio;
-		} else {
-			cx = width;
-			cy = cx / base_ratio;
-		}
-
-		x = (width - cx) / 2;
-		y = (height - cy) / 2;
-
 		gs_set_viewport(x, y, cx, cy);
 
 		if (bres) {
@@ -19,8 +19,8 @@ struct obs_outro {
 	uint64_t start_time_nsec;
 
 	pthread_t outro_thread;
-	
-	float fake_audio_mix_buffer[MAX_AUDIO_CHANNELS][AUDIO_OUTPUT_FRAMES];
+
+	gs_effect_t *scale_effect;
 };
 
 extern void *obs_outro_thread(void *param);
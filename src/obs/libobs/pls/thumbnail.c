@@ -2,6 +2,35 @@
 #include "obs-internal.h"
 #include "thumbnail.h"
 
+#if HAVE_AVCODEC
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+#endif
+
+/* frames between staging a thumbnail and mapping it, by then the copy has
+ * finished on the GPU and mapping doesn't stall */
+#define THUMBNAIL_MAP_DELAY 2
+
+/* unused render targets kept for requests of the same size */
+#define MAX_FREE_SURFACES 4
+
+struct thumbnail_request {
+	uint32_t width;
+	uint32_t height;
+	enum obs_thumbnail_format format;
+	int quality;
+
+	struct thumbnail_surface surface;
+	uint64_t staged_frame;
+	uint8_t *data;
+	bool failed;
+
+	obs_thumbnail_image_cb callback;
+	bool (*raw_callback)(void *param, uint32_t width, uint32_t height,
+			     bool request_succeed);
+	void *param;
+};
+
 static inline void set_render_size(uint32_t width, uint32_t height)
 {
 	gs_enable_depth_test(false);
@@ -64,125 +93,258 @@ static inline gs_effect_t *get_scale_effect(struct obs_core_video *video,
 	}
 }
 
-static bool reset_thumbnail(obs_thumbnail_t *thumbnail, uint32_t width,
-			    uint32_t height)
+/* ------------------------------------------------------------------------- */
+/* encode thread */
+
+#if HAVE_AVCODEC
+static inline int jpeg_qscale(int quality)
 {
-	thumbnail->data = brealloc(thumbnail->data, width * height * 4); //RGBA
-	if (!thumbnail->data) {
-		blog(LOG_WARNING,
-		     "fail to alloc thumbnail buffer (width/height: %d/%d)",
-		     width, height);
+	/* mjpeg qscale goes from 2 (best) to 31 (worst) */
+	if (quality < 1)
+		quality = 1;
+	else if (quality > 100)
+		quality = 100;
+	return 31 - (quality - 1) * 29 / 99;
+}
+
+static bool encode_image(struct thumbnail_request *req, uint8_t **out,
+			 size_t *out_size)
+{
+	bool png = req->format == OBS_THUMBNAIL_PNG;
+	const uint8_t *src[1] = {req->data};
+	int src_linesize[1] = {(int)req->width * 4};
+	struct SwsContext *sws = NULL;
+	AVCodecContext *context = NULL;
+	AVFrame *frame = NULL;
+	AVPacket *packet = NULL;
+	AVCodec *codec;
+	bool success = false;
+
+	codec = avcodec_find_encoder(png ? AV_CODEC_ID_PNG : AV_CODEC_ID_MJPEG);
+	if (!codec) {
+		blog(LOG_WARNING, "No %s encoder for thumbnails",
+		     png ? "PNG" : "JPEG");
 		return false;
 	}
 
-	gs_enter_context(obs->video.graphics);
-	gs_texture_destroy(thumbnail->texture);
-	thumbnail->texture = gs_texture_create(width, height, thumbnail->format,
-					       1, NULL, GS_RENDER_TARGET);
-	if (!thumbnail->texture) {
-		gs_leave_context();
-		blog(LOG_WARNING, "Fail to create thumbnail texture");
-		bfree(thumbnail->data);
-		thumbnail->data = NULL;
-		return false;
+	context = avcodec_alloc_context3(codec);
+	frame = av_frame_alloc();
+	packet = av_packet_alloc();
+	if (!context || !frame || !packet)
+		goto exit;
+
+	context->width = req->width;
+	context->height = req->height;
+	context->time_base = (AVRational){1, 1};
+	context->pix_fmt = png ? AV_PIX_FMT_RGBA : AV_PIX_FMT_YUVJ420P;
+
+	if (!png) {
+		context->flags |= AV_CODEC_FLAG_QSCALE;
+		context->global_quality = FF_QP2LAMBDA *
+					  jpeg_qscale(req->quality);
 	}
 
-	gs_stagesurface_destroy(thumbnail->stage_surface);
-	thumbnail->stage_surface =
-		gs_stagesurface_create(width, height, thumbnail->format);
-	if (!thumbnail->stage_surface) {
-		gs_texture_destroy(thumbnail->texture);
-		gs_leave_context();
-		thumbnail->texture = NULL;
-		blog(LOG_WARNING, "Fail to create thumbnail stage surface");
-		bfree(thumbnail->data);
-		thumbnail->data = NULL;
-		return false;
+	if (avcodec_open2(context, codec, NULL) < 0)
+		goto exit;
+
+	frame->format = context->pix_fmt;
+	frame->width = req->width;
+	frame->height = req->height;
+	frame->quality = context->global_quality;
+
+	if (png) {
+		frame->data[0] = req->data;
+		frame->linesize[0] = src_linesize[0];
+	} else {
+		if (av_frame_get_buffer(frame, 32) < 0)
+			goto exit;
+
+		sws = sws_getContext(req->width, req->height, AV_PIX_FMT_RGBA,
+				     req->width, req->height,
+				     AV_PIX_FMT_YUVJ420P, SWS_BICUBIC, NULL,
+				     NULL, NULL);
+		if (!sws)
+			goto exit;
+
+		sws_scale(sws, src, src_linesize, 0, req->height, frame->data,
+			  frame->linesize);
 	}
-	gs_leave_context();
 
-	thumbnail->width = width;
-	thumbnail->height = height;
-	return true;
+	if (avcodec_send_frame(context, frame) < 0 ||
+	    avcodec_receive_packet(context, packet) < 0)
+		goto exit;
+
+	*out = bmemdup(packet->data, packet->size);
+	*out_size = packet->size;
+	success = true;
+
+exit:
+	sws_freeContext(sws);
+	av_packet_free(&packet);
+	av_frame_free(&frame);
+	avcodec_free_context(&context);
+	return success;
 }
+#else
+static bool encode_image(struct thumbnail_request *req, uint8_t **out,
+			 size_t *out_size)
+{
+	blog(LOG_WARNING, "libobs was built without %s thumbnail support",
+	     req->format == OBS_THUMBNAIL_PNG ? "PNG" : "JPEG");
 
-static void save_texture(obs_thumbnail_t *thumbnail, gs_texture_t *texture)
+	UNUSED_PARAMETER(out);
+	UNUSED_PARAMETER(out_size);
+	return false;
+}
+#endif
+
+static void free_request(struct thumbnail_request *req)
 {
-	if (!thumbnail->data || !texture)
-		return;
+	bfree(req->data);
+	bfree(req);
+}
 
-	uint8_t *data[8] = {0};
-	uint32_t line_size[8] = {0};
-
-	uint32_t width = gs_texture_get_width(texture);
-	uint32_t height = gs_texture_get_height(texture);
-	gs_stage_texture(thumbnail->stage_surface, texture);
-	if (gs_stagesurface_map(thumbnail->stage_surface, &data, &line_size)) {
-		if (line_size[0] == width * 4)
-			memcpy(thumbnail->data, data[0], line_size[0] * height);
-		else {
-			uint32_t copy_length = width * 4;
-			for (int i = 0; i < height; i++)
-				memcpy(thumbnail->data + copy_length * i,
-				       data[0] + line_size[0] * i, copy_length);
-		}
-		gs_stagesurface_unmap(thumbnail->stage_surface);
+static void finish_request(obs_thumbnail_t *thumbnail,
+			   struct thumbnail_request *req)
+{
+	if (req->failed) {
+		if (req->raw_callback)
+			req->raw_callback(req->param, 0, 0, false);
+		else
+			req->callback(req->param, NULL, 0, 0, 0);
+
+	} else if (req->raw_callback) {
+		pthread_mutex_lock(&thumbnail->mutex);
+		if (thumbnail->data != thumbnail->retrieved)
+			bfree(thumbnail->data);
+		thumbnail->data = req->data;
+		thumbnail->width = req->width;
+		thumbnail->height = req->height;
 		os_atomic_set_bool(&thumbnail->ready, true);
-		os_atomic_set_bool(&thumbnail->requested, false);
-		if (thumbnail->callback)
-			thumbnail->callback(thumbnail->callback_param,
-					    thumbnail->width, thumbnail->width,
-					    true);
-	} else
-		blog(LOG_WARNING, "fail to map thumbnail surface");
+		pthread_mutex_unlock(&thumbnail->mutex);
+
+		req->data = NULL;
+		req->raw_callback(req->param, req->width, req->height, true);
+
+	} else {
+		uint8_t *image = NULL;
+		size_t size = 0;
+
+		if (req->format == OBS_THUMBNAIL_RGBA) {
+			image = req->data;
+			size = (size_t)req->width * req->height * 4;
+			req->data = NULL;
+
+		} else if (!encode_image(req, &image, &size)) {
+			blog(LOG_WARNING, "Failed to encode %ux%u thumbnail",
+			     req->width, req->height);
+		}
+
+		if (image)
+			req->callback(req->param, image, size, req->width,
+				      req->height);
+		else
+			req->callback(req->param, NULL, 0, 0, 0);
+		bfree(image);
+	}
+
+	free_request(req);
 }
 
-static obs_thumbnail_t *create_thumbnail(uint32_t width, uint32_t height)
+static void *encode_thread(void *param)
 {
-	obs_thumbnail_t *thumbnail = bzalloc(sizeof(struct obs_thumbnail));
-	if (!thumbnail) {
-		blog(LOG_WARNING, "fail to alloc thumbnail");
-		return NULL;
-	}
+	obs_thumbnail_t *thumbnail = param;
 
-	// The default data format of thumbnail is RGBA
-	thumbnail->format = GS_RGBA;
+	os_set_thread_name("libobs: thumbnail encode thread");
 
-	if (!reset_thumbnail(thumbnail, width, height)) {
-		bfree(thumbnail);
-		thumbnail = NULL;
+	while (os_sem_wait(thumbnail->sem) == 0) {
+		struct thumbnail_request *req = NULL;
+
+		if (os_atomic_load_bool(&thumbnail->stop))
+			break;
+
+		pthread_mutex_lock(&thumbnail->mutex);
+		if (thumbnail->encode_queue.num) {
+			req = thumbnail->encode_queue.array[0];
+			da_erase(thumbnail->encode_queue, 0);
+		}
+		pthread_mutex_unlock(&thumbnail->mutex);
+
+		if (req)
+			finish_request(thumbnail, req);
 	}
 
-	return thumbnail;
+	return NULL;
 }
 
-void obs_thumbnail_destroy(obs_thumbnail_t *thumbnail)
+static void push_encode(obs_thumbnail_t *thumbnail,
+			struct thumbnail_request *req)
 {
-	if (thumbnail) {
-		if (thumbnail->data)
-			bfree(thumbnail->data);
+	pthread_mutex_lock(&thumbnail->mutex);
+	da_push_back(thumbnail->encode_queue, &req);
+	pthread_mutex_unlock(&thumbnail->mutex);
 
-		gs_enter_context(obs->video.graphics);
-		gs_texture_destroy(thumbnail->texture);
-		gs_stagesurface_destroy(thumbnail->stage_surface);
-		gs_leave_context();
+	os_atomic_dec_long(&thumbnail->outstanding);
+	os_sem_post(thumbnail->sem);
+}
+
+/* ------------------------------------------------------------------------- */
+/* graphics thread */
 
-		bfree(thumbnail);
-		blog(LOG_INFO, "Thumbnail is destroyed");
+static void destroy_surface(struct thumbnail_surface *surface)
+{
+	gs_texture_destroy(surface->texture);
+	gs_stagesurface_destroy(surface->stage_surface);
+	memset(surface, 0, sizeof(*surface));
+}
+
+static bool acquire_surface(obs_thumbnail_t *thumbnail, uint32_t width,
+			    uint32_t height, struct thumbnail_surface *surface)
+{
+	for (size_t i = 0; i < thumbnail->free_surfaces.num; i++) {
+		struct thumbnail_surface *free_surface =
+			&thumbnail->free_surfaces.array[i];
+
+		if (free_surface->width == width &&
+		    free_surface->height == height) {
+			*surface = *free_surface;
+			da_erase(thumbnail->free_surfaces, i);
+			return true;
+		}
 	}
+
+	surface->width = width;
+	surface->height = height;
+	surface->texture = gs_texture_create(width, height, GS_RGBA, 1, NULL,
+					     GS_RENDER_TARGET);
+	surface->stage_surface = gs_stagesurface_create(width, height, GS_RGBA);
+
+	if (!surface->texture || !surface->stage_surface) {
+		blog(LOG_WARNING,
+		     "Fail to create thumbnail texture (width/height: %u/%u)",
+		     width, height);
+		destroy_surface(surface);
+		return false;
+	}
+
+	return true;
 }
 
-bool obs_thumbnail_requested()
+static void release_surface(obs_thumbnail_t *thumbnail,
+			    struct thumbnail_surface *surface)
 {
-	obs_thumbnail_t *thumbnail = obs->video.thumbnail;
-	if (thumbnail)
-		return os_atomic_load_bool(&thumbnail->requested);
-	return false;
+	if (thumbnail->free_surfaces.num == MAX_FREE_SURFACES) {
+		destroy_surface(&thumbnail->free_surfaces.array[0]);
+		da_erase(thumbnail->free_surfaces, 0);
+	}
+
+	da_push_back(thumbnail->free_surfaces, surface);
+	memset(surface, 0, sizeof(*surface));
 }
 
-void obs_thumbnail_save(struct obs_core_video *video)
+static void render_thumbnail(struct obs_core_video *video,
+			     gs_texture_t *target)
 {
-	gs_texture_t *target = video->thumbnail->texture;
 	gs_texture_t *base = video->render_texture;
 	uint32_t width = gs_texture_get_width(target);
 	uint32_t height = gs_texture_get_height(target);
@@ -190,18 +352,8 @@ void obs_thumbnail_save(struct obs_core_video *video)
 	uint32_t base_height = gs_texture_get_height(base);
 
 	gs_effect_t *effect = get_scale_effect(video, width, height);
-	gs_technique_t *tech;
-	if (video->thumbnail->format == GS_RGBA) {
-		tech = gs_effect_get_technique(effect, "DrawAlphaDivide");
-	} else {
-		if ((effect == video->default_effect) &&
-		    (width == base_width) && (height == base_height)) {
-			save_texture(video->thumbnail, video->render_texture);
-			return;
-		}
-
-		tech = gs_effect_get_technique(effect, "Draw");
-	}
+	gs_technique_t *tech =
+		gs_effect_get_technique(effect, "DrawAlphaDivide");
 
 	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
 	gs_eparam_t *bres =
@@ -237,8 +389,189 @@ void obs_thumbnail_save(struct obs_core_video *video)
 	}
 	gs_technique_end(tech);
 	gs_enable_blending(true);
+}
+
+static void stage_thumbnail(struct obs_core_video *video,
+			    struct thumbnail_request *req)
+{
+	obs_thumbnail_t *thumbnail = video->thumbnail;
 
-	save_texture(video->thumbnail, target);
+	if (!acquire_surface(thumbnail, req->width, req->height,
+			     &req->surface)) {
+		req->failed = true;
+		push_encode(thumbnail, req);
+		return;
+	}
+
+	render_thumbnail(video, req->surface.texture);
+	gs_stage_texture(req->surface.stage_surface, req->surface.texture);
+
+	req->staged_frame = thumbnail->frame;
+	da_push_back(thumbnail->staged, &req);
+}
+
+static void map_thumbnail(obs_thumbnail_t *thumbnail,
+			  struct thumbnail_request *req)
+{
+	uint8_t *data;
+	uint32_t linesize;
+	uint32_t row_size = req->width * 4;
+
+	req->data = bmalloc((size_t)row_size * req->height);
+
+	if (gs_stagesurface_map(req->surface.stage_surface, &data, &linesize)) {
+		if (linesize == row_size) {
+			memcpy(req->data, data, (size_t)row_size * req->height);
+		} else {
+			for (uint32_t y = 0; y < req->height; y++)
+				memcpy(req->data + row_size * y,
+				       data + linesize * y, row_size);
+		}
+		gs_stagesurface_unmap(req->surface.stage_surface);
+	} else {
+		blog(LOG_WARNING, "fail to map thumbnail surface");
+		req->failed = true;
+	}
+
+	release_surface(thumbnail, &req->surface);
+	push_encode(thumbnail, req);
+}
+
+void obs_thumbnail_save(struct obs_core_video *video)
+{
+	obs_thumbnail_t *thumbnail = video->thumbnail;
+	struct thumbnail_request **queued = NULL;
+	size_t num_queued = 0;
+
+	thumbnail->frame++;
+
+	for (size_t i = 0; i < thumbnail->staged.num; i++) {
+		struct thumbnail_request *req = thumbnail->staged.array[i];
+
+		if (thumbnail->frame - req->staged_frame < THUMBNAIL_MAP_DELAY)
+			continue;
+
+		map_thumbnail(thumbnail, req);
+		da_erase(thumbnail->staged, i--);
+	}
+
+	pthread_mutex_lock(&thumbnail->mutex);
+	if (thumbnail->queued.num) {
+		num_queued = thumbnail->queued.num;
+		queued = bmemdup(thumbnail->queued.array,
+				 num_queued * sizeof(*queued));
+		da_resize(thumbnail->queued, 0);
+	}
+	pthread_mutex_unlock(&thumbnail->mutex);
+
+	for (size_t i = 0; i < num_queued; i++)
+		stage_thumbnail(video, queued[i]);
+
+	bfree(queued);
+}
+
+/* ------------------------------------------------------------------------- */
+
+obs_thumbnail_t *obs_thumbnail_create(void)
+{
+	obs_thumbnail_t *thumbnail = bzalloc(sizeof(struct obs_thumbnail));
+
+	if (pthread_mutex_init(&thumbnail->mutex, NULL) != 0)
+		goto fail_mutex;
+	if (os_sem_init(&thumbnail->sem, 0) != 0)
+		goto fail_sem;
+	if (pthread_create(&thumbnail->thread, NULL, encode_thread,
+			   thumbnail) != 0)
+		goto fail_thread;
+
+	thumbnail->thread_created = true;
+	return thumbnail;
+
+fail_thread:
+	os_sem_destroy(thumbnail->sem);
+fail_sem:
+	pthread_mutex_destroy(&thumbnail->mutex);
+fail_mutex:
+	bfree(thumbnail);
+	blog(LOG_WARNING, "fail to create thumbnail");
+	return NULL;
+}
+
+void obs_thumbnail_destroy(obs_thumbnail_t *thumbnail)
+{
+	if (!thumbnail)
+		return;
+
+	if (thumbnail->thread_created) {
+		os_atomic_set_bool(&thumbnail->stop, true);
+		os_sem_post(thumbnail->sem);
+		pthread_join(thumbnail->thread, NULL);
+	}
+
+	gs_enter_context(obs->video.graphics);
+
+	for (size_t i = 0; i < thumbnail->staged.num; i++) {
+		struct thumbnail_request *req = thumbnail->staged.array[i];
+		destroy_surface(&req->surface);
+		da_push_back(thumbnail->queued, &req);
+	}
+
+	for (size_t i = 0; i < thumbnail->free_surfaces.num; i++)
+		destroy_surface(&thumbnail->free_surfaces.array[i]);
+
+	gs_leave_context();
+
+	/* outstanding requests fail */
+	for (size_t i = 0; i < thumbnail->queued.num; i++)
+		thumbnail->queued.array[i]->failed = true;
+	da_push_back_da(thumbnail->encode_queue, thumbnail->queued);
+
+	for (size_t i = 0; i < thumbnail->encode_queue.num; i++)
+		finish_request(thumbnail, thumbnail->encode_queue.array[i]);
+
+	if (thumbnail->retrieved != thumbnail->data)
+		bfree(thumbnail->retrieved);
+	bfree(thumbnail->data);
+
+	da_free(thumbnail->queued);
+	da_free(thumbnail->encode_queue);
+	da_free(thumbnail->staged);
+	da_free(thumbnail->free_surfaces);
+	os_sem_destroy(thumbnail->sem);
+	pthread_mutex_destroy(&thumbnail->mutex);
+	bfree(thumbnail);
+	blog(LOG_INFO, "Thumbnail is destroyed");
+}
+
+bool obs_thumbnail_requested()
+{
+	obs_thumbnail_t *thumbnail = obs->video.thumbnail;
+	if (thumbnail)
+		return os_atomic_load_long(&thumbnail->outstanding) > 0;
+	return false;
+}
+
+static bool queue_request(struct thumbnail_request *req)
+{
+	obs_thumbnail_t *thumbnail = obs->video.thumbnail;
+
+	if (!req->width || !req->height) {
+		blog(LOG_WARNING, "wrong width/height (%u/%u)", req->width,
+		     req->height);
+		return false;
+	}
+	if (!thumbnail)
+		return false;
+
+	os_atomic_inc_long(&thumbnail->outstanding);
+
+	pthread_mutex_lock(&thumbnail->mutex);
+	da_push_back(thumbnail->queued, &req);
+	pthread_mutex_unlock(&thumbnail->mutex);
+
+	blog(LOG_INFO, "Thumbnail is requested : %u x %u", req->width,
+	     req->height);
+	return true;
 }
 
 void obs_thumbnail_request(uint32_t width, uint32_t height,
@@ -247,72 +580,97 @@ void obs_thumbnail_request(uint32_t width, uint32_t height,
 					    bool request_succeed),
 			   void *param)
 {
-	if (width <= 0 || height <= 0) {
-		blog(LOG_WARNING, "wrong width/height (%d/%d)", width, height);
+	struct thumbnail_request *req = bzalloc(sizeof(*req));
+	req->width = width;
+	req->height = height;
+	req->format = OBS_THUMBNAIL_RGBA;
+	req->raw_callback = callback;
+	req->param = param;
+
+	if (!queue_request(req)) {
+		bfree(req);
 		if (callback)
 			callback(param, 0, 0, false);
-		return;
-	}
-	obs_thumbnail_t *thumbnail = obs->video.thumbnail;
-	if (!thumbnail) {
-		obs->video.thumbnail = thumbnail =
-			create_thumbnail(width, height);
-		if (!thumbnail) {
-			if (callback)
-				callback(param, 0, 0, false);
-			return;
-		}
 	}
+}
 
-	if (thumbnail->width != width || thumbnail != height) {
-		if (!reset_thumbnail(thumbnail, width, height)) {
-			if (callback)
-				callback(param, 0, 0, false);
-			return;
-		}
-	}
+void obs_thumbnail_request_image(uint32_t width, uint32_t height,
+				 enum obs_thumbnail_format format, int quality,
+				 obs_thumbnail_image_cb callback, void *param)
+{
+	struct thumbnail_request *req;
 
-	thumbnail->callback = callback;
-	thumbnail->callback_param = param;
-	os_atomic_set_bool(&thumbnail->requested, true);
-	blog(LOG_INFO, "Thumbnail is requested : %d x %d", width, height);
+	if (!callback)
+		return;
+
+	req = bzalloc(sizeof(*req));
+	req->width = width;
+	req->height = height;
+	req->format = format;
+	req->quality = quality;
+	req->callback = callback;
+	req->param = param;
+
+	if (!queue_request(req)) {
+		bfree(req);
+		callback(param, NULL, 0, 0, 0);
+	}
 }
 
 bool obs_thumbnail_retrieve(void **data, uint32_t *width, uint32_t *height)
 {
 	obs_thumbnail_t *thumbnail = obs->video.thumbnail;
-	if (thumbnail && os_atomic_load_bool(&thumbnail->ready)) {
-		*data = thumbnail->data;
-		*width = thumbnail->width;
-		*height = thumbnail->height;
-		return true;
+	bool ready = false;
+
+	if (thumbnail) {
+		pthread_mutex_lock(&thumbnail->mutex);
+		ready = os_atomic_load_bool(&thumbnail->ready);
+		if (ready) {
+			/* kept until obs_thumbnail_free even if a newer
+			 * thumbnail arrives */
+			if (thumbnail->retrieved != thumbnail->data)
+				bfree(thumbnail->retrieved);
+			thumbnail->retrieved = thumbnail->data;
+
+			*data = thumbnail->data;
+			*width = thumbnail->width;
+			*height = thumbnail->height;
+		}
+		pthread_mutex_unlock(&thumbnail->mutex);
 	}
-	blog(LOG_WARNING, "Thumbnail is not ready, thumbnail %p, ready %d",
-	     thumbnail,
-	     thumbnail ? os_atomic_load_bool(&thumbnail->ready) : false);
-	return false;
+
+	if (!ready)
+		blog(LOG_WARNING,
+		     "Thumbnail is not ready, thumbnail %p, ready %d",
+		     thumbnail, ready);
+	return ready;
 }
 
 void obs_thumbnail_free()
 {
 	obs_thumbnail_t *thumbnail = obs->video.thumbnail;
-	if (thumbnail) {
-		if (thumbnail->data) {
-			bfree(thumbnail->data);
-			thumbnail->data = NULL;
-		}
+	if (!thumbnail)
+		return;
 
-		gs_enter_context(obs->video.graphics);
-		gs_texture_destroy(thumbnail->texture);
-		gs_stagesurface_destroy(thumbnail->stage_surface);
-		gs_leave_context();
-
-		thumbnail->texture = NULL;
-		thumbnail->stage_surface = NULL;
-		thumbnail->width = 0;
-		thumbnail->height = 0;
-		thumbnail->callback = NULL;
-		thumbnail->callback_param = NULL;
-		os_atomic_set_bool(&thumbnail->ready, false);
-	}
+	pthread_mutex_lock(&thumbnail->mutex);
+	if (thumbnail->retrieved != thumbnail->data)
+		bfree(thumbnail->retrieved);
+	bfree(thumbnail->data);
+	thumbnail->retrieved = NULL;
+	thumbnail->data = NULL;
+	thumbnail->width = 0;
+	thumbnail->height = 0;
+	os_atomic_set_bool(&thumbnail->ready, false);
+	pthread_mutex_unlock(&thumbnail->mutex);
+
+	if (!obs->video.graphics)
+		return;
+
+	/* the graphics thread only uses the free surfaces inside the
+	 * graphics context */
+	gs_enter_context(obs->video.graphics);
+	for (size_t i = 0; i < thumbnail->free_surfaces.num; i++)
+		destroy_surface(&thumbnail->free_surfaces.array[i]);
+	da_resize(thumbnail->free_surfaces, 0);
+	gs_leave_context();
 }
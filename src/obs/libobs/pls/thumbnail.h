@@ -1,15 +1,40 @@
 #pragma once
 
+#include "util/darray.h"
+#include "util/threading.h"
+
+struct thumbnail_request;
+
+struct thumbnail_surface {
+	uint32_t width;
+	uint32_t height;
+	gs_texture_t *texture;
+	gs_stagesurf_t *stage_surface;
+};
+
+/* Requests are queued by any thread, rendered and staged by the graphics
+ * thread, mapped a few frames later when the copy has finished on the GPU,
+ * and handed to the encode thread which encodes them and calls back. */
 struct obs_thumbnail {
-	volatile bool requested;
+	pthread_mutex_t mutex;
+	DARRAY(struct thumbnail_request *) queued;
+	DARRAY(struct thumbnail_request *) encode_queue;
+	volatile long outstanding;
+
+	/* graphics thread only */
+	DARRAY(struct thumbnail_request *) staged;
+	DARRAY(struct thumbnail_surface) free_surfaces;
+	uint64_t frame;
+
+	pthread_t thread;
+	bool thread_created;
+	os_sem_t *sem;
+	volatile bool stop;
+
+	/* last RGBA thumbnail, for obs_thumbnail_retrieve */
 	volatile bool ready;
 	uint32_t width;
 	uint32_t height;
 	uint8_t *data;
-	enum gs_color_format format;
-	gs_texture_t *texture;
-	gs_stagesurf_t *stage_surface;
-	bool (*callback)(void *param, uint32_t width, uint32_t height,
-			 bool request_succeed);
-	void *callback_param;
+	uint8_t *retrieved;
 };
@@ -3,8 +3,6 @@
 #include "watermark.h"
 
 static const uint64_t USEC_TO_NSEC = 1000;
-static const uint64_t FADE_IN_TIME_NSEC = 500000000;
-static const uint64_t FADE_OUT_TIME_NSEC = 500000000;
 static const float DEFAULT_OPACITY = 1.0f; // default opacity
 
 static void reset_watermark(obs_watermark_t *watermark)
@@ -18,11 +16,13 @@ static void reset_watermark(obs_watermark_t *watermark)
 	watermark->fade_in_time_nsec = 0;
 	watermark->fade_out_time_nsec = 0;
 	watermark->interval_nsec = 0;
-	watermark->render_width = 0;
-	watermark->render_height = 0;
 	watermark->texture = NULL;
-	watermark->render_texture = NULL;
 	watermark->opaque_effect = NULL;
+	watermark->tech = NULL;
+	watermark->image_param = NULL;
+	watermark->opacity_param = NULL;
+	watermark->opacity = DEFAULT_OPACITY;
+	watermark->fade_scale = 0.0;
 	watermark->enabled = false;
 	watermark->first_show = true;
 	watermark->updated = false;
@@ -50,18 +50,25 @@ static void set_info(struct obs_watermark *watermark,
 	os_atomic_set_bool(&watermark->updated, true);
 }
 
+static inline void set_fade(struct obs_watermark *watermark,
+			    uint64_t duration_nsec)
+{
+	watermark->fade_scale = duration_nsec ? 1.0 / (double)duration_nsec
+					      : 0.0;
+}
+
 static enum obs_watermark_show_type
-get_show_type_internal(struct obs_watermark *watermark)
+get_show_type_internal(struct obs_watermark *watermark, uint64_t current_time)
 {
 	enum obs_watermark_show_type show_type =
 		OBS_WATERMARK_SHOW_TYPE_NOT_SHOW;
 
-	uint64_t current_time = os_gettime_ns();
 	if (watermark->next_timestamp == 0) {
 		show_type = OBS_WATERMARK_SHOW_TYPE_BEGIN;
 		watermark->first_show = true;
 		watermark->next_timestamp =
 			current_time + watermark->fade_in_time_nsec;
+		set_fade(watermark, watermark->fade_in_time_nsec);
 	} else {
 		if (current_time < watermark->next_timestamp)
 			show_type = watermark->show_type;
@@ -83,6 +90,8 @@ get_show_type_internal(struct obs_watermark *watermark)
 				watermark->next_timestamp =
 					current_time +
 					watermark->fade_out_time_nsec;
+				set_fade(watermark,
+					 watermark->fade_out_time_nsec);
 				break;
 			case OBS_WATERMARK_SHOW_TYPE_END:
 				show_type = OBS_WATERMARK_SHOW_TYPE_NOT_SHOW;
@@ -94,6 +103,8 @@ get_show_type_internal(struct obs_watermark *watermark)
 				watermark->next_timestamp =
 					current_time +
 					watermark->fade_in_time_nsec;
+				set_fade(watermark,
+					 watermark->fade_in_time_nsec);
 				break;
 			default:
 				show_type = OBS_WATERMARK_SHOW_TYPE_NOT_SHOW;
@@ -105,13 +116,13 @@ get_show_type_internal(struct obs_watermark *watermark)
 }
 
 static enum obs_watermark_show_type
-get_show_type(struct obs_watermark *watermark)
+get_show_type(struct obs_watermark *watermark, uint64_t current_time)
 {
 	enum obs_watermark_show_type show_type =
 		OBS_WATERMARK_SHOW_TYPE_NOT_SHOW;
 	switch (watermark->policy) {
 	case OBS_WATERMARK_POLICY_CUSTOM:
-		show_type = get_show_type_internal(watermark);
+		show_type = get_show_type_internal(watermark, current_time);
 		break;
 	case OBS_WATERMARK_POLICY_ALWAYS_SHOW:
 		show_type = OBS_WATERMARK_SHOW_TYPE_SHOWING;
@@ -123,15 +134,6 @@ get_show_type(struct obs_watermark *watermark)
 	return show_type;
 }
 
-static inline void set_render_size(uint32_t width, uint32_t height)
-{
-	gs_enable_depth_test(false);
-	gs_set_cull_mode(GS_NEITHER);
-
-	gs_ortho(0.0f, (float)width, 0.0f, (float)height, -100.0f, 100.0f);
-	gs_set_viewport(0, 0, width, height);
-}
-
 static bool reset_texture_and_effect(obs_watermark_t *watermark,
 				     const char *watermark_file_path)
 {
@@ -148,26 +150,6 @@ static bool reset_texture_and_effect(obs_watermark_t *watermark,
 		}
 	}
 
-	if (!watermark->render_texture ||
-	    watermark->render_width != obs->video.ovi.output_width ||
-	    watermark->render_height != obs->video.ovi.output_height) {
-		gs_texture_destroy(watermark->render_texture);
-		watermark->render_texture =
-			gs_texture_create(obs->video.ovi.output_width,
-					  obs->video.ovi.output_height, GS_RGBA,
-					  1, NULL, GS_RENDER_TARGET);
-		if (!watermark->render_texture) {
-			gs_texture_destroy(watermark->texture);
-			watermark->texture = NULL;
-			gs_leave_context();
-			blog(LOG_WARNING,
-			     "Fail to create render texture for watermark.");
-			return false;
-		}
-		watermark->render_width = obs->video.ovi.output_width;
-		watermark->render_height = obs->video.ovi.output_height;
-	}
-
 	if (!watermark->opaque_effect) {
 		char *filename = obs_find_data_file("opaque_pls.effect");
 		watermark->opaque_effect =
@@ -177,6 +159,13 @@ static bool reset_texture_and_effect(obs_watermark_t *watermark,
 		if (!watermark->opaque_effect)
 			blog(LOG_WARNING,
 			     "Opaque effect for watermark is not created.");
+
+		watermark->tech = gs_effect_get_technique(
+			watermark->opaque_effect, "Draw");
+		watermark->image_param = gs_effect_get_param_by_name(
+			watermark->opaque_effect, "image");
+		watermark->opacity_param = gs_effect_get_param_by_name(
+			watermark->opaque_effect, "opacity");
 	}
 
 	gs_leave_context();
@@ -188,70 +177,15 @@ static void release_texture_and_effect(obs_watermark_t *watermark)
 {
 	gs_enter_context(obs->video.graphics);
 	gs_texture_destroy(watermark->texture);
-	gs_texture_destroy(watermark->render_texture);
 	gs_effect_destroy(watermark->opaque_effect);
 	watermark->texture = NULL;
-	watermark->render_texture = NULL;
 	watermark->opaque_effect = NULL;
+	watermark->tech = NULL;
+	watermark->image_param = NULL;
+	watermark->opacity_param = NULL;
 	gs_leave_context();
 }
 
-static gs_texture_t *obs_watermark_render_internal(obs_watermark_t *watermark,
-						   gs_texture_t *texture,
-						   float opacity)
-{
-	uint32_t target_width = gs_texture_get_width(watermark->render_texture);
-	uint32_t target_height =
-		gs_texture_get_height(watermark->render_texture);
-
-	uint32_t base_width = gs_texture_get_width(watermark->texture);
-	uint32_t base_height = gs_texture_get_height(watermark->texture);
-
-	struct vec4 clear_color;
-	vec4_set(&clear_color, 0.0f, 0.0f, 0.0f, 0.0f);
-	gs_set_render_target(watermark->render_texture, NULL);
-	gs_clear(GS_CLEAR_COLOR, &clear_color, 1.0f, 0);
-
-	set_render_size(target_width, target_height);
-
-	gs_effect_t *effect = watermark->opaque_effect;
-	gs_technique_t *tech = gs_effect_get_technique(effect, "Draw");
-
-	gs_eparam_t *param = gs_effect_get_param_by_name(effect, "opacity");
-	gs_effect_set_float(param, 1.0);
-
-	gs_technique_begin(tech);
-	gs_technique_begin_pass(tech, 0);
-
-	param = gs_effect_get_param_by_name(effect, "image");
-	gs_effect_set_texture(param, texture);
-
-	gs_blend_state_push();
-	gs_enable_blending(false);
-
-	gs_draw_sprite(texture, 0, 0, 0);
-
-	param = gs_effect_get_param_by_name(effect, "opacity");
-	gs_effect_set_float(param, opacity);
-
-	gs_set_viewport(watermark->left_margin, watermark->top_margin,
-			base_width, base_height);
-
-	param = gs_effect_get_param_by_name(effect, "image");
-	gs_effect_set_texture(param, watermark->texture);
-
-	gs_reset_blend_state();
-
-	gs_draw_sprite(watermark->texture, 0, target_width, target_height);
-
-	gs_blend_state_pop();
-
-	gs_technique_end_pass(tech);
-	gs_technique_end(tech);
-
-	return watermark->render_texture;
-}
-
 static bool obs_watermark_update_internal(obs_watermark_t *watermark,
 					  const struct obs_watermark_info *info)
 {
@@ -324,12 +258,10 @@ void obs_watermark_destroy(obs_watermark_t *watermark)
 	}
 }
 
-gs_texture_t *obs_watermark_render(obs_watermark_t *watermark,
-				   gs_texture_t *texture)
+bool obs_watermark_visible(obs_watermark_t *watermark)
 {
-	if (!obs_ptr_valid(watermark, "obs_watermark_render") ||
-	    !obs_ptr_valid(texture, "obs_watermark_render"))
-		return texture;
+	if (!obs_watermark_enabled(watermark))
+		return false;
 
 	if (os_atomic_load_bool(&watermark->updated)) {
 		if (!reset_texture_and_effect(watermark,
@@ -338,29 +270,64 @@ gs_texture_t *obs_watermark_render(obs_watermark_t *watermark,
 		os_atomic_set_bool(&watermark->updated, false);
 	}
 
-	watermark->show_type = get_show_type(watermark);
+	if (!watermark->texture || !watermark->tech)
+		return false;
+
+	if (watermark->policy == OBS_WATERMARK_POLICY_ALWAYS_SHOW) {
+		watermark->show_type = OBS_WATERMARK_SHOW_TYPE_SHOWING;
+		watermark->opacity = DEFAULT_OPACITY;
+		return true;
+	}
 
-	float opacity = 1.0f;
-	int64_t time_offset = watermark->next_timestamp - os_gettime_ns();
-	if (time_offset > 0) {
-		if (watermark->show_type == OBS_WATERMARK_SHOW_TYPE_BEGIN)
-			opacity =
-				1.0 - ((float)time_offset / FADE_IN_TIME_NSEC);
-		else if (watermark->show_type == OBS_WATERMARK_SHOW_TYPE_END)
-			opacity = (float)time_offset / FADE_OUT_TIME_NSEC;
+	uint64_t current_time = os_gettime_ns();
+	watermark->show_type = get_show_type(watermark, current_time);
+
+	double remaining = 0.0;
+	if (watermark->next_timestamp > current_time)
+		remaining = (double)(watermark->next_timestamp - current_time);
+
+	switch (watermark->show_type) {
+	case OBS_WATERMARK_SHOW_TYPE_SHOWING:
+		watermark->opacity = DEFAULT_OPACITY;
+		return true;
+	case OBS_WATERMARK_SHOW_TYPE_BEGIN:
+		watermark->opacity =
+			(float)(1.0 - remaining * watermark->fade_scale);
+		return true;
+	case OBS_WATERMARK_SHOW_TYPE_END:
+		watermark->opacity = (float)(remaining * watermark->fade_scale);
+		return true;
+	case OBS_WATERMARK_SHOW_TYPE_NOT_SHOW:
+	default:
+		return false;
 	}
+}
+
+void obs_watermark_render(obs_watermark_t *watermark)
+{
+	gs_technique_t *tech = watermark->tech;
+	size_t passes;
 
-	if (watermark->show_type == OBS_WATERMARK_SHOW_TYPE_SHOWING) {
-		return obs_watermark_render_internal(watermark, texture,
-						     DEFAULT_OPACITY);
+	gs_effect_set_float(watermark->opacity_param, watermark->opacity);
+	gs_effect_set_texture(watermark->image_param, watermark->texture);
 
-	} else if (watermark->show_type == OBS_WATERMARK_SHOW_TYPE_BEGIN ||
-		   watermark->show_type == OBS_WATERMARK_SHOW_TYPE_END) {
-		return obs_watermark_render_internal(watermark, texture,
-						     opacity);
+	gs_blend_state_push();
+	gs_reset_blend_state();
+
+	gs_matrix_push();
+	gs_matrix_translate3f((float)watermark->left_margin,
+			      (float)watermark->top_margin, 0.0f);
+
+	passes = gs_technique_begin(tech);
+	for (size_t i = 0; i < passes; i++) {
+		gs_technique_begin_pass(tech, i);
+		gs_draw_sprite(watermark->texture, 0, 0, 0);
+		gs_technique_end_pass(tech);
 	}
+	gs_technique_end(tech);
 
-	return texture;
+	gs_matrix_pop();
+	gs_blend_state_pop();
 }
 
 void obs_watermark_set_refresh(bool update)
@@ -388,4 +355,5 @@ bool obs_watermark_update(const struct obs_watermark_info *info)
 	obs_watermark_t *watermark = obs_get_watermark();
 	if (watermark && os_atomic_load_bool(&watermark->need_update))
 		return obs_watermark_update_internal(watermark, info);
+	return false;
 }
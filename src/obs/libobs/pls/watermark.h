@@ -23,12 +23,17 @@ struct obs_watermark {
 	uint64_t fade_out_time_nsec;
 	uint64_t interval_nsec;
 
-	uint32_t render_width;
-	uint32_t render_height;
-
 	gs_texture_t *texture;
-	gs_texture_t *render_texture;
 	gs_effect_t *opaque_effect;
+	gs_technique_t *tech;
+	gs_eparam_t *image_param;
+	gs_eparam_t *opacity_param;
+
+	/* opacity of the current frame, the fade of the current show type is
+	 * set up when the show type changes */
+	float opacity;
+	double fade_scale;
+
 	volatile bool enabled;
 	volatile bool updated;
 	volatile bool need_update;
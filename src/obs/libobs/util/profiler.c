@@ -256,6 +256,17 @@ static void merge_call(profile_entry *entry, profile_call *call,
 #endif
 }
 
+enum trace_event_type {
+	TRACE_EVENT_BEGIN,
+	TRACE_EVENT_END,
+	TRACE_EVENT_MARK,
+};
+
+static volatile bool trace_enabled = false;
+static void trace_push(enum trace_event_type type, const char *name,
+		       uint64_t id, uint64_t time);
+static void profiler_trace_free(void);
+
 static bool enabled = false;
 static pthread_mutex_t root_mutex = PTHREAD_MUTEX_INITIALIZER;
 static DARRAY(profile_root_entry) root_entries;
@@ -367,6 +378,9 @@ static void merge_context(profile_call *context)
 
 void profile_start(const char *name)
 {
+	if (os_atomic_load_bool(&trace_enabled))
+		trace_push(TRACE_EVENT_BEGIN, name, 0, os_gettime_ns());
+
 	if (!thread_enabled)
 		return;
 
@@ -395,6 +409,10 @@ void profile_start(const char *name)
 void profile_end(const char *name)
 {
 	uint64_t end = os_gettime_ns();
+
+	if (os_atomic_load_bool(&trace_enabled))
+		trace_push(TRACE_EVENT_END, name, 0, end);
+
 	if (!thread_enabled)
 		return;
 
@@ -825,6 +843,298 @@ void profiler_free(void)
 	}
 
 	da_free(old_root_entries);
+
+	profiler_trace_free();
+}
+
+/* ------------------------------------------------------------------------- */
+/* Tracing */
+
+/* must be a power of two */
+#define TRACE_EVENTS_PER_THREAD 32768
+#define TRACE_EVENTS_MASK (TRACE_EVENTS_PER_THREAD - 1)
+#define TRACE_THREAD_NAME_SIZE 64
+
+struct trace_event {
+	uint64_t time;
+	const char *name;
+	uint64_t id;
+	enum trace_event_type type;
+};
+
+/* single writer ring, only the owning thread writes events and advances
+ * head, readers copy events out and discard any that were overwritten while
+ * copying.  It is freed when its thread exits, or by profiler_trace_free. */
+struct trace_thread {
+	volatile long head;
+	long tid;
+	/* the owning thread's thread_trace_writing */
+	volatile long *writing;
+	char name[TRACE_THREAD_NAME_SIZE];
+	struct trace_event events[TRACE_EVENTS_PER_THREAD];
+};
+
+/* protects the list, rings are only added, removed and freed with it held */
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct trace_thread *) trace_threads;
+static volatile long trace_generation = 1;
+static long trace_next_tid = 1;
+
+static pthread_once_t trace_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t trace_key;
+
+static THREAD_LOCAL struct trace_thread *thread_trace = NULL;
+static THREAD_LOCAL long thread_trace_generation = 0;
+static THREAD_LOCAL char thread_trace_name[TRACE_THREAD_NAME_SIZE];
+
+/* set while the thread uses its ring without the lock, profiler_trace_free
+ * waits for it to clear before freeing the ring */
+static THREAD_LOCAL volatile long thread_trace_writing = 0;
+
+static inline bool thread_trace_valid(void)
+{
+	return thread_trace && thread_trace_generation ==
+				       os_atomic_load_long(&trace_generation);
+}
+
+static void trace_thread_exit(void *data)
+{
+	struct trace_thread *thread = data;
+
+	pthread_mutex_lock(&trace_mutex);
+
+	/* otherwise profiler_trace_free already freed it */
+	if (thread == thread_trace && thread_trace_valid()) {
+		da_erase_item(trace_threads, &thread);
+		bfree(thread);
+	}
+
+	thread_trace = NULL;
+	pthread_mutex_unlock(&trace_mutex);
+}
+
+static void create_trace_key(void)
+{
+	pthread_key_create(&trace_key, trace_thread_exit);
+}
+
+/* call without thread_trace_writing set, profiler_trace_free holds the lock
+ * while it waits for it */
+static void register_trace_thread(void)
+{
+	struct trace_thread *thread;
+
+	pthread_mutex_lock(&trace_mutex);
+
+	/* profiler_trace_free disables tracing before it takes the lock */
+	if (!os_atomic_load_bool(&trace_enabled)) {
+		pthread_mutex_unlock(&trace_mutex);
+		return;
+	}
+
+	thread = bzalloc(sizeof(struct trace_thread));
+	thread->tid = trace_next_tid++;
+	thread->writing = &thread_trace_writing;
+
+	if (*thread_trace_name)
+		strncpy(thread->name, thread_trace_name,
+			TRACE_THREAD_NAME_SIZE - 1);
+	else
+		snprintf(thread->name, TRACE_THREAD_NAME_SIZE, "thread %ld",
+			 thread->tid);
+
+	da_push_back(trace_threads, &thread);
+	thread_trace = thread;
+	thread_trace_generation = os_atomic_load_long(&trace_generation);
+
+	pthread_mutex_unlock(&trace_mutex);
+
+	/* frees the ring when the thread exits */
+	pthread_once(&trace_key_once, create_trace_key);
+	pthread_setspecific(trace_key, thread);
+}
+
+static void trace_push(enum trace_event_type type, const char *name,
+		       uint64_t id, uint64_t time)
+{
+	if (!thread_trace_valid())
+		register_trace_thread();
+
+	/* a full barrier before checking, so either profiler_trace_free sees
+	 * it and waits, or this sees tracing disabled or the ring retired */
+	os_atomic_inc_long(&thread_trace_writing);
+
+	if (os_atomic_load_bool(&trace_enabled) && thread_trace_valid()) {
+		struct trace_thread *thread = thread_trace;
+		unsigned long head = (unsigned long)thread->head;
+		struct trace_event *event =
+			&thread->events[head & TRACE_EVENTS_MASK];
+
+		event->time = time;
+		event->name = name;
+		event->id = id;
+		event->type = type;
+
+		os_atomic_set_long(&thread->head, (long)(head + 1));
+	}
+
+	os_atomic_dec_long(&thread_trace_writing);
+}
+
+void profiler_trace_enable(bool enable)
+{
+	os_atomic_set_bool(&trace_enabled, enable);
+}
+
+bool profiler_trace_enabled(void)
+{
+	return os_atomic_load_bool(&trace_enabled);
+}
+
+void profile_trace_mark(const char *name, uint64_t id)
+{
+	if (os_atomic_load_bool(&trace_enabled))
+		trace_push(TRACE_EVENT_MARK, name, id, os_gettime_ns());
+}
+
+void profile_trace_set_thread_name(const char *name)
+{
+	if (!name)
+		return;
+
+	/* picked up when the thread registers its ring */
+	strncpy(thread_trace_name, name, TRACE_THREAD_NAME_SIZE - 1);
+
+	if (!os_atomic_load_bool(&trace_enabled))
+		return;
+
+	pthread_mutex_lock(&trace_mutex);
+	if (thread_trace_valid())
+		strncpy(thread_trace->name, name, TRACE_THREAD_NAME_SIZE - 1);
+	pthread_mutex_unlock(&trace_mutex);
+}
+
+static void profiler_trace_free(void)
+{
+	/* stops new events first, then waits for the ones being written */
+	os_atomic_set_bool(&trace_enabled, false);
+
+	pthread_mutex_lock(&trace_mutex);
+	/* threads still holding a pointer re-register on their next event */
+	os_atomic_inc_long(&trace_generation);
+	for (size_t i = 0; i < trace_threads.num; i++) {
+		struct trace_thread *thread = trace_threads.array[i];
+
+		while (os_atomic_load_long(thread->writing))
+			os_sleep_ms(0);
+		bfree(thread);
+	}
+	da_free(trace_threads);
+	pthread_mutex_unlock(&trace_mutex);
+}
+
+static void write_json_string(FILE *f, const char *str)
+{
+	fputc('"', f);
+	for (; str && *str; str++) {
+		unsigned char ch = (unsigned char)*str;
+
+		if (ch == '"' || ch == '\\')
+			fprintf(f, "\\%c", ch);
+		else if (ch < 0x20)
+			fprintf(f, "\\u%04x", ch);
+		else
+			fputc(ch, f);
+	}
+	fputc('"', f);
+}
+
+static size_t copy_trace_events(struct trace_thread *thread,
+				struct trace_event *events)
+{
+	unsigned long head = (unsigned long)os_atomic_load_long(&thread->head);
+	unsigned long start = head > TRACE_EVENTS_PER_THREAD
+				      ? head - TRACE_EVENTS_PER_THREAD
+				      : 0;
+
+	for (unsigned long i = start; i < head; i++)
+		events[i - start] = thread->events[i & TRACE_EVENTS_MASK];
+
+	/* skip events the writer overwrote while they were being copied */
+	unsigned long new_head =
+		(unsigned long)os_atomic_load_long(&thread->head);
+	/* the slot at new_head may already be half written */
+	unsigned long valid_start =
+		new_head + 1 > TRACE_EVENTS_PER_THREAD
+			? new_head + 1 - TRACE_EVENTS_PER_THREAD
+			: 0;
+	size_t skip = valid_start > start ? valid_start - start : 0;
+	size_t count = head - start;
+
+	if (skip >= count)
+		return 0;
+
+	memmove(events, events + skip, (count - skip) * sizeof(*events));
+	return count - skip;
+}
+
+static void write_trace_event(FILE *f, long tid, const struct trace_event *e,
+			      bool *first)
+{
+	static const char *phases[] = {"B", "E", "i"};
+
+	fprintf(f, "%s\n{\"name\":", *first ? "" : ",");
+	write_json_string(f, e->name);
+	fprintf(f, ",\"ph\":\"%s\",\"ts\":%" PRIu64 ".%03u,\"pid\":1,"
+		   "\"tid\":%ld",
+		phases[e->type], e->time / 1000, (unsigned)(e->time % 1000),
+		tid);
+
+	if (e->type == TRACE_EVENT_MARK)
+		fprintf(f, ",\"s\":\"t\",\"args\":{\"id\":%" PRIu64 "}",
+			e->id);
+
+	fputc('}', f);
+	*first = false;
+}
+
+bool profiler_trace_dump_json(const char *filename)
+{
+	struct trace_event *events;
+	bool first = true;
+	FILE *f;
+
+	f = os_fopen(filename, "wb");
+	if (!f)
+		return false;
+
+	events = bmalloc(sizeof(struct trace_event) * TRACE_EVENTS_PER_THREAD);
+
+	fputs("{\"traceEvents\":[", f);
+
+	pthread_mutex_lock(&trace_mutex);
+	for (size_t i = 0; i < trace_threads.num; i++) {
+		struct trace_thread *thread = trace_threads.array[i];
+		size_t count = copy_trace_events(thread, events);
+
+		fprintf(f,
+			"%s\n{\"name\":\"thread_name\",\"ph\":\"M\","
+			"\"pid\":1,\"tid\":%ld,\"args\":{\"name\":",
+			first ? "" : ",", thread->tid);
+		write_json_string(f, thread->name);
+		fputs("}}", f);
+		first = false;
+
+		for (size_t j = 0; j < count; j++)
+			write_trace_event(f, thread->tid, &events[j], &first);
+	}
+	pthread_mutex_unlock(&trace_mutex);
+
+	fputs("\n],\"displayTimeUnit\":\"ms\"}\n", f);
+
+	bfree(events);
+	fclose(f);
+	return true;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -33,6 +33,24 @@ EXPORT void profiler_print_time_between_calls(profiler_snapshot_t *snap);
 
 EXPORT void profiler_free(void);
 
+/* ------------------------------------------------------------------------- */
+/* Tracing
+ *
+ * While enabled, every profile_start/profile_end pair and every mark is
+ * recorded with its timestamp into a per-thread ring buffer, so individual
+ * frames can be inspected instead of aggregates.  Marks carry an id (e.g. a
+ * frame timestamp) to follow one frame across threads.  The recorded events
+ * can be written as Chrome trace JSON, which can also be opened in
+ * Perfetto. */
+
+EXPORT void profiler_trace_enable(bool enable);
+EXPORT bool profiler_trace_enabled(void);
+
+EXPORT void profile_trace_mark(const char *name, uint64_t id);
+EXPORT void profile_trace_set_thread_name(const char *name);
+
+EXPORT bool profiler_trace_dump_json(const char *filename);
+
 /* ------------------------------------------------------------------------- */
 /* Profiler name storage */
 
@@ -32,6 +32,7 @@
 
 #include "bmem.h"
 #include "threading.h"
+#include "profiler.h"
 
 struct os_event_data {
 	pthread_mutex_t mutex;
@@ -251,6 +252,8 @@ int os_sem_wait(os_sem_t *sem)
 
 void os_set_thread_name(const char *name)
 {
+	profile_trace_set_thread_name(name);
+
 #if defined(__APPLE__)
 	pthread_setname_np(name);
 #elif defined(__FreeBSD__)
@@ -16,6 +16,7 @@
 
 #include "bmem.h"
 #include "threading.h"
+#include "profiler.h"
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -167,6 +168,8 @@ struct vs_threadname_info {
 
 void os_set_thread_name(const char *name)
 {
+	profile_trace_set_thread_name(name);
+
 #ifdef __MINGW32__
 	UNUSED_PARAMETER(name);
 #else
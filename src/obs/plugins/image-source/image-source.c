@@ -143,10 +143,8 @@ static uint32_t image_source_getheight(void *data)
 	return context->if2.image.cy;
 }
 
-static void image_source_render(void *data, gs_effect_t *effect)
+static void update_capture_valid(struct image_source *context)
 {
-	struct image_source *context = data;
-
 	//PRISM/WangShaohui/20200117/#281/for source unavailable
 	if (context->if2.image.texture ||
 	    (!context->file || 0 == strlen(context->file))) {
@@ -159,6 +157,13 @@ static void image_source_render(void *data, gs_effect_t *effect)
 				? OBS_SOURCE_ERROR_UNKNOWN
 				: OBS_SOURCE_ERROR_NOT_FOUND);
 	}
+}
+
+static void image_source_render(void *data, gs_effect_t *effect)
+{
+	struct image_source *context = data;
+
+	update_capture_valid(context);
 
 	if (!context->if2.image.texture)
 		return;
@@ -169,6 +174,18 @@ static void image_source_render(void *data, gs_effect_t *effect)
 		       context->if2.image.cy);
 }
 
+static gs_texture_t *image_source_get_sprite_texture(void *data, uint32_t *cx,
+						    uint32_t *cy)
+{
+	struct image_source *context = data;
+
+	update_capture_valid(context);
+
+	*cx = context->if2.image.cx;
+	*cy = context->if2.image.cy;
+	return context->if2.image.texture;
+}
+
 static void image_source_tick(void *data, float seconds)
 {
 	struct image_source *context = data;
@@ -266,6 +283,7 @@ static struct obs_source_info image_source_info = {
 	.video_tick = image_source_tick,
 	.get_properties = image_source_properties,
 	.icon_type = OBS_ICON_TYPE_IMAGE,
+	.get_sprite_texture = image_source_get_sprite_texture,
 };
 
 OBS_DECLARE_MODULE()
@@ -18,6 +18,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <xcb/damage.h>
 #include <xcb/randr.h>
 #include <xcb/shm.h>
 #include <xcb/xfixes.h>
@@ -25,6 +26,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <obs-module.h>
 #include <util/dstr.h>
+#include <util/platform.h>
 #include "xcursor-xcb.h"
 #include "xhelpers.h"
 
@@ -32,14 +34,52 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "xshm-input: " msg, ##__VA_ARGS__)
 
+/* regions with more rectangles than this are captured as their bounding box */
+#define XSHM_MAX_RECTS 16
+
+#define XSHM_STATS_INTERVAL_NS 10000000000ULL
+
+/**
+ * Image requests sent on one tick, received and uploaded on the next one
+ *
+ * The rectangles are relative to the captured area and are packed one after
+ * another into the shm segment of the request.
+ */
+struct xshm_request {
+	xcb_shm_get_image_cookie_t cookies[XSHM_MAX_RECTS];
+	xcb_rectangle_t rects[XSHM_MAX_RECTS];
+	uint32_t offsets[XSHM_MAX_RECTS];
+	size_t num_rects;
+	bool full;
+	bool pending;
+};
+
 struct xshm_data {
 	obs_source_t *source;
 
 	xcb_connection_t *xcb;
 	xcb_screen_t *xcb_screen;
-	xcb_shm_t *xshm;
+	xcb_shm_t *xshm[2];
 	xcb_xcursor_t *cursor;
 
+	struct xshm_request requests[2];
+	size_t cur_request;
+	bool need_full;
+
+	xcb_xfixes_get_cursor_image_cookie_t cursor_c;
+	bool cursor_pending;
+
+	bool use_damage;
+	xcb_damage_damage_t damage;
+	xcb_xfixes_region_t region;
+	xcb_xfixes_fetch_region_cookie_t region_c;
+	bool region_pending;
+
+	uint64_t upload_bytes;
+	uint64_t upload_total;
+	uint64_t stats_start;
+	uint64_t capture_start;
+
 	char *server;
 	uint_fast32_t screen_id;
 	int_fast32_t x_org;
@@ -88,9 +128,50 @@ static bool xshm_check_extensions(xcb_connection_t *xcb)
 	if (!xcb_get_extension_data(xcb, &xcb_randr_id)->present)
 		blog(LOG_INFO, "Missing Randr extension !");
 
+	if (!xcb_get_extension_data(xcb, &xcb_damage_id)->present)
+		blog(LOG_INFO, "Missing Damage extension !");
+
 	return ok;
 }
 
+/**
+ * Start tracking the damaged areas of the root window
+ *
+ * @return false if only full frames can be captured
+ */
+static bool xshm_init_damage(struct xshm_data *data)
+{
+	xcb_xfixes_query_version_cookie_t xfix_c;
+	xcb_damage_query_version_cookie_t damage_c;
+	xcb_damage_query_version_reply_t *damage_r;
+
+	if (!xcb_get_extension_data(data->xcb, &xcb_damage_id)->present)
+		return false;
+
+	/* damage reports to xfixes regions, so both have to be initialized */
+	xfix_c = xcb_xfixes_query_version_unchecked(data->xcb,
+						    XCB_XFIXES_MAJOR_VERSION,
+						    XCB_XFIXES_MINOR_VERSION);
+	damage_c = xcb_damage_query_version_unchecked(
+		data->xcb, XCB_DAMAGE_MAJOR_VERSION, XCB_DAMAGE_MINOR_VERSION);
+
+	free(xcb_xfixes_query_version_reply(data->xcb, xfix_c, NULL));
+	damage_r = xcb_damage_query_version_reply(data->xcb, damage_c, NULL);
+	if (!damage_r)
+		return false;
+
+	free(damage_r);
+
+	data->damage = xcb_generate_id(data->xcb);
+	xcb_damage_create(data->xcb, data->damage, data->xcb_screen->root,
+			  XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
+
+	data->region = xcb_generate_id(data->xcb);
+	xcb_xfixes_create_region(data->xcb, data->region, 0, NULL);
+
+	return true;
+}
+
 /**
  * Update the capture
  *
@@ -167,11 +248,33 @@ static void xshm_capture_stop(struct xshm_data *data)
 
 	obs_leave_graphics();
 
-	if (data->xshm) {
-		xshm_xcb_detach(data->xshm);
-		data->xshm = NULL;
+	for (size_t i = 0; i < 2; i++) {
+		if (data->xshm[i]) {
+			xshm_xcb_detach(data->xshm[i]);
+			data->xshm[i] = NULL;
+		}
+	}
+
+	if (data->capture_start) {
+		uint64_t elapsed = os_gettime_ns() - data->capture_start;
+		uint64_t total = data->upload_total + data->upload_bytes;
+
+		if (elapsed)
+			blog(LOG_INFO, "Uploaded %.2f MB/s on average",
+			     (double)total / 1000000.0 /
+				     ((double)elapsed / 1000000000.0));
 	}
 
+	/* outstanding replies are discarded with the connection */
+	memset(data->requests, 0, sizeof(data->requests));
+	data->cursor_pending = false;
+	data->region_pending = false;
+	data->use_damage = false;
+	data->upload_bytes = 0;
+	data->upload_total = 0;
+	data->stats_start = 0;
+	data->capture_start = 0;
+
 	if (data->xcb) {
 		xcb_disconnect(data->xcb);
 		data->xcb = NULL;
@@ -208,15 +311,23 @@ static void xshm_capture_start(struct xshm_data *data)
 		goto fail;
 	}
 
-	data->xshm = xshm_xcb_attach(data->xcb, data->width, data->height);
-	if (!data->xshm) {
-		blog(LOG_ERROR, "failed to attach shm !");
-		goto fail;
+	/* one segment is written by the server while the other is uploaded */
+	for (size_t i = 0; i < 2; i++) {
+		data->xshm[i] = xshm_xcb_attach(data->xcb, data->width,
+						data->height);
+		if (!data->xshm[i]) {
+			blog(LOG_ERROR, "failed to attach shm !");
+			goto fail;
+		}
 	}
 
 	data->cursor = xcb_xcursor_init(data->xcb);
 	xcb_xcursor_offset(data->cursor, data->x_org, data->y_org);
 
+	data->use_damage = xshm_init_damage(data);
+	data->need_full = true;
+	data->capture_start = os_gettime_ns();
+
 	obs_enter_graphics();
 
 	xshm_resize_texture(data);
@@ -401,8 +512,229 @@ static void *xshm_create(obs_data_t *settings, obs_source_t *source)
 	return data;
 }
 
+/**
+ * Clip a rectangle of the root window to the captured area
+ *
+ * @return false if the rectangle is outside of the captured area
+ */
+static bool xshm_clip_rect(struct xshm_data *data, const xcb_rectangle_t *in,
+			   xcb_rectangle_t *out)
+{
+	int_fast32_t x1 = in->x - data->x_org;
+	int_fast32_t y1 = in->y - data->y_org;
+	int_fast32_t x2 = x1 + in->width;
+	int_fast32_t y2 = y1 + in->height;
+
+	if (x1 < 0)
+		x1 = 0;
+	if (y1 < 0)
+		y1 = 0;
+	if (x2 > data->width)
+		x2 = data->width;
+	if (y2 > data->height)
+		y2 = data->height;
+
+	if (x2 <= x1 || y2 <= y1)
+		return false;
+
+	out->x = (int16_t)x1;
+	out->y = (int16_t)y1;
+	out->width = (uint16_t)(x2 - x1);
+	out->height = (uint16_t)(y2 - y1);
+	return true;
+}
+
+/**
+ * Collect the damaged rectangles of a region into a request
+ *
+ * @return false if the full frame should be captured instead
+ */
+static bool xshm_damaged_rects(struct xshm_data *data,
+			       struct xshm_request *req,
+			       xcb_xfixes_fetch_region_reply_t *region)
+{
+	xcb_rectangle_t *rects = xcb_xfixes_fetch_region_rectangles(region);
+	int count = xcb_xfixes_fetch_region_rectangles_length(region);
+	uint64_t area = 0;
+
+	if (count > XSHM_MAX_RECTS) {
+		rects = &region->extents;
+		count = 1;
+	}
+
+	for (int i = 0; i < count; i++) {
+		xcb_rectangle_t *rect = &req->rects[req->num_rects];
+
+		if (!xshm_clip_rect(data, &rects[i], rect))
+			continue;
+
+		area += (uint64_t)rect->width * rect->height;
+		req->num_rects++;
+	}
+
+	/* a single request for everything is cheaper than many big ones */
+	return area <= (uint64_t)data->width * data->height / 2;
+}
+
+/**
+ * Request the images of the damaged rectangles, or of the full frame
+ */
+static void xshm_request_images(struct xshm_data *data,
+				struct xshm_request *req, xcb_shm_t *shm,
+				xcb_xfixes_fetch_region_reply_t *region)
+{
+	uint32_t offset = 0;
+
+	req->num_rects = 0;
+	req->full = !data->use_damage || data->need_full || !region ||
+		    !xshm_damaged_rects(data, req, region);
+
+	if (req->full) {
+		req->rects[0].x = 0;
+		req->rects[0].y = 0;
+		req->rects[0].width = (uint16_t)data->width;
+		req->rects[0].height = (uint16_t)data->height;
+		req->num_rects = 1;
+		data->need_full = false;
+	}
+
+	for (size_t i = 0; i < req->num_rects; i++) {
+		xcb_rectangle_t *rect = &req->rects[i];
+
+		req->offsets[i] = offset;
+		req->cookies[i] = xcb_shm_get_image_unchecked(
+			data->xcb, data->xcb_screen->root,
+			data->x_org + rect->x, data->y_org + rect->y,
+			rect->width, rect->height, ~0,
+			XCB_IMAGE_FORMAT_Z_PIXMAP, shm->seg, offset);
+
+		offset += (uint32_t)rect->width * rect->height * 4;
+	}
+
+	req->pending = req->num_rects > 0;
+}
+
+/**
+ * Wait for the images of a request
+ *
+ * @return true if all images were received
+ */
+static bool xshm_receive_images(struct xshm_data *data,
+				struct xshm_request *req)
+{
+	bool success = true;
+
+	if (!req->pending)
+		return false;
+
+	for (size_t i = 0; i < req->num_rects; i++) {
+		xcb_shm_get_image_reply_t *img_r = xcb_shm_get_image_reply(
+			data->xcb, req->cookies[i], NULL);
+
+		if (!img_r)
+			success = false;
+		free(img_r);
+	}
+
+	req->pending = false;
+
+	/* the damage of the failed rectangles has already been subtracted */
+	if (!success)
+		data->need_full = true;
+
+	return success;
+}
+
+/**
+ * Copy the received rectangles into the texture
+ *
+ * @note requires to be called within the obs graphics context
+ */
+static void xshm_upload_images(struct xshm_data *data,
+			       const struct xshm_request *req,
+			       const uint8_t *shm_data)
+{
+	uint64_t rect_bytes = 0;
+	uint8_t *ptr;
+	uint32_t linesize;
+	size_t i;
+
+	if (req->full) {
+		gs_texture_set_image(data->texture, shm_data, data->width * 4,
+				     false);
+		data->upload_bytes += (uint64_t)data->width * data->height * 4;
+		return;
+	}
+
+	/* the texture keeps the previous frame, only the rectangles are
+	 * uploaded into it */
+	for (i = 0; i < req->num_rects; i++) {
+		const xcb_rectangle_t *rect = &req->rects[i];
+
+		if (!gs_texture_set_image_region(data->texture, rect->x,
+						 rect->y, rect->width,
+						 rect->height,
+						 shm_data + req->offsets[i],
+						 (uint32_t)rect->width * 4))
+			break;
+
+		rect_bytes += (uint64_t)rect->width * rect->height * 4;
+	}
+
+	data->upload_bytes += rect_bytes;
+	if (i == req->num_rects)
+		return;
+
+	/* without region uploads the rectangles are written into the mapped
+	 * texture, which is then uploaded in full */
+	if (!gs_texture_map(data->texture, &ptr, &linesize))
+		return;
+
+	for (i = 0; i < req->num_rects; i++) {
+		const xcb_rectangle_t *rect = &req->rects[i];
+		const uint8_t *src = shm_data + req->offsets[i];
+		uint8_t *dst = ptr + rect->y * linesize + rect->x * 4;
+		size_t row_size = (size_t)rect->width * 4;
+
+		for (uint16_t y = 0; y < rect->height; y++) {
+			memcpy(dst, src, row_size);
+			dst += linesize;
+			src += row_size;
+		}
+	}
+
+	gs_texture_unmap(data->texture);
+	data->upload_bytes += (uint64_t)linesize * data->height;
+}
+
+static void xshm_update_stats(struct xshm_data *data)
+{
+	uint64_t now = os_gettime_ns();
+	uint64_t elapsed;
+
+	if (!data->stats_start) {
+		data->stats_start = now;
+		return;
+	}
+
+	elapsed = now - data->stats_start;
+	if (elapsed < XSHM_STATS_INTERVAL_NS)
+		return;
+
+	blog(LOG_DEBUG, "Uploading %.2f MB/s",
+	     (double)data->upload_bytes / 1000000.0 /
+		     ((double)elapsed / 1000000000.0));
+
+	data->upload_total += data->upload_bytes;
+	data->upload_bytes = 0;
+	data->stats_start = now;
+}
+
 /**
  * Prepare the capture data
+ *
+ * The requests for the next frame are sent before the images received for
+ * this frame are uploaded, so the server copies the screen while we upload.
  */
 static void xshm_video_tick(void *vptr, float seconds)
 {
@@ -414,35 +746,61 @@ static void xshm_video_tick(void *vptr, float seconds)
 	if (!obs_source_showing(data->source))
 		return;
 
-	xcb_shm_get_image_cookie_t img_c;
-	xcb_shm_get_image_reply_t *img_r;
-	xcb_xfixes_get_cursor_image_cookie_t cur_c;
-	xcb_xfixes_get_cursor_image_reply_t *cur_r;
+	size_t prev = data->cur_request;
+	size_t next = prev ^ 1;
+	xcb_generic_event_t *event;
+	xcb_xfixes_fetch_region_reply_t *region_r = NULL;
+	xcb_xfixes_get_cursor_image_reply_t *cur_r = NULL;
+	bool received;
+
+	/* damage notifications are not used, the region is fetched instead */
+	while ((event = xcb_poll_for_event(data->xcb)))
+		free(event);
 
-	img_c = xcb_shm_get_image_unchecked(data->xcb, data->xcb_screen->root,
-					    data->x_org, data->y_org,
-					    data->width, data->height, ~0,
-					    XCB_IMAGE_FORMAT_Z_PIXMAP,
-					    data->xshm->seg, 0);
-	cur_c = xcb_xfixes_get_cursor_image_unchecked(data->xcb);
+	received = xshm_receive_images(data, &data->requests[prev]);
 
-	img_r = xcb_shm_get_image_reply(data->xcb, img_c, NULL);
-	cur_r = xcb_xfixes_get_cursor_image_reply(data->xcb, cur_c, NULL);
+	if (data->cursor_pending) {
+		cur_r = xcb_xfixes_get_cursor_image_reply(
+			data->xcb, data->cursor_c, NULL);
+		data->cursor_pending = false;
+	}
+	if (data->region_pending) {
+		region_r = xcb_xfixes_fetch_region_reply(data->xcb,
+							 data->region_c, NULL);
+		data->region_pending = false;
+	}
 
-	if (!img_r)
-		goto exit;
+	xshm_request_images(data, &data->requests[next], data->xshm[next],
+			    region_r);
+	data->cur_request = next;
+	free(region_r);
+
+	data->cursor_c = xcb_xfixes_get_cursor_image_unchecked(data->xcb);
+	data->cursor_pending = true;
+
+	if (data->use_damage) {
+		xcb_damage_subtract(data->xcb, data->damage, XCB_NONE,
+				    data->region);
+		data->region_c =
+			xcb_xfixes_fetch_region_unchecked(data->xcb, data->region);
+		data->region_pending = true;
+	}
+
+	xcb_flush(data->xcb);
 
 	obs_enter_graphics();
 
-	gs_texture_set_image(data->texture, (void *)data->xshm->data,
-			     data->width * 4, false);
-	xcb_xcursor_update(data->cursor, cur_r);
+	if (received)
+		xshm_upload_images(data, &data->requests[prev],
+				   data->xshm[prev]->data);
+	if (cur_r)
+		xcb_xcursor_update(data->cursor, cur_r);
 
 	obs_leave_graphics();
 
-exit:
-	free(img_r);
 	free(cur_r);
+
+	xshm_update_stats(data);
 }
 
 /**
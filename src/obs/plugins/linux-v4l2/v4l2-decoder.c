@@ -0,0 +1,405 @@
+#include <inttypes.h>
+
+#include <linux/videodev2.h>
+
+#include <util/bmem.h>
+#include <util/circlebuf.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <obs-avc.h>
+
+#include <libavcodec/avcodec.h>
+
+#include "v4l2-decoder.h"
+
+#define blog(level, msg, ...) blog(level, "v4l2-input: " msg, ##__VA_ARGS__)
+
+/* more than this many compressed frames waiting means decoding can't keep
+ * up, at 60 fps this is about 130 ms */
+#define MAX_QUEUED_PACKETS 8
+
+#define MAX_RECEIVE_TIMES 32
+
+/* some devices only send IDR frames when asked, or use intra refresh and
+ * never send one, after this long the decoder recovers on its own */
+#define KEYFRAME_TIMEOUT_NS 2000000000ULL
+
+struct receive_time {
+	int64_t pts;
+	uint64_t time;
+};
+
+struct v4l2_decoder {
+	obs_source_t *source;
+	char *device;
+	enum video_range_type range;
+	bool h264;
+
+	const AVCodec *codec;
+	AVCodecContext *context;
+	AVFrame *frame;
+
+	pthread_t thread;
+	bool thread_created;
+	os_sem_t *sem;
+	volatile bool stop;
+
+	pthread_mutex_t mutex;
+	struct circlebuf packets;
+	bool wait_for_keyframe;
+	uint64_t wait_start;
+	bool keyframe_timeout_logged;
+	struct receive_time receive_times[MAX_RECEIVE_TIMES];
+	size_t receive_idx;
+
+	/* statistics */
+	uint64_t dropped;
+	uint64_t decoded;
+	uint64_t errors;
+	uint64_t latency_frames;
+	uint64_t latency_total;
+	uint64_t latency_max;
+	bool unsupported_format_logged;
+};
+
+static enum AVCodecID get_codec_id(uint32_t pixfmt)
+{
+	switch (pixfmt) {
+	case V4L2_PIX_FMT_MJPEG:
+	case V4L2_PIX_FMT_JPEG:
+		return AV_CODEC_ID_MJPEG;
+	case V4L2_PIX_FMT_H264:
+		return AV_CODEC_ID_H264;
+	default:
+		return AV_CODEC_ID_NONE;
+	}
+}
+
+static enum video_format convert_pixel_format(int format)
+{
+	switch (format) {
+	case AV_PIX_FMT_YUV420P:
+	case AV_PIX_FMT_YUVJ420P:
+		return VIDEO_FORMAT_I420;
+	case AV_PIX_FMT_YUV422P:
+	case AV_PIX_FMT_YUVJ422P:
+		return VIDEO_FORMAT_I422;
+	case AV_PIX_FMT_YUV444P:
+	case AV_PIX_FMT_YUVJ444P:
+		return VIDEO_FORMAT_I444;
+	case AV_PIX_FMT_NV12:
+		return VIDEO_FORMAT_NV12;
+	case AV_PIX_FMT_YUYV422:
+		return VIDEO_FORMAT_YUY2;
+	case AV_PIX_FMT_UYVY422:
+		return VIDEO_FORMAT_UYVY;
+	case AV_PIX_FMT_GRAY8:
+		return VIDEO_FORMAT_Y800;
+	default:
+		return VIDEO_FORMAT_NONE;
+	}
+}
+
+static bool is_full_range(const AVFrame *frame)
+{
+	switch (frame->format) {
+	case AV_PIX_FMT_YUVJ420P:
+	case AV_PIX_FMT_YUVJ422P:
+	case AV_PIX_FMT_YUVJ444P:
+		return true;
+	default:
+		return frame->color_range == AVCOL_RANGE_JPEG;
+	}
+}
+
+bool v4l2_decoder_supported(uint32_t pixfmt)
+{
+	enum AVCodecID id = get_codec_id(pixfmt);
+	return id != AV_CODEC_ID_NONE && avcodec_find_decoder(id) != NULL;
+}
+
+/* call with the mutex locked */
+static uint64_t take_receive_time(struct v4l2_decoder *d, int64_t pts)
+{
+	for (size_t i = 0; i < MAX_RECEIVE_TIMES; i++) {
+		struct receive_time *rt = &d->receive_times[i];
+
+		if (rt->time && rt->pts == pts) {
+			uint64_t time = rt->time;
+			rt->time = 0;
+			return time;
+		}
+	}
+
+	return 0;
+}
+
+static void output_frame(struct v4l2_decoder *d, AVFrame *frame)
+{
+	struct obs_source_frame out = {0};
+	enum video_range_type range = d->range;
+	uint64_t received;
+	int64_t pts;
+
+	out.format = convert_pixel_format(frame->format);
+	if (out.format == VIDEO_FORMAT_NONE) {
+		if (!d->unsupported_format_logged) {
+			blog(LOG_WARNING, "%s: unsupported decoded format %d",
+			     d->device, frame->format);
+			d->unsupported_format_logged = true;
+		}
+		return;
+	}
+
+	if (range == VIDEO_RANGE_DEFAULT)
+		range = is_full_range(frame) ? VIDEO_RANGE_FULL
+					     : VIDEO_RANGE_PARTIAL;
+
+	/* the frame is passed as-is, the source copies it into its own
+	 * frame cache */
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		out.data[i] = frame->data[i];
+		out.linesize[i] = frame->linesize[i];
+	}
+
+	pts = frame->pts != AV_NOPTS_VALUE ? frame->pts
+					   : frame->best_effort_timestamp;
+
+	out.width = frame->width;
+	out.height = frame->height;
+	out.timestamp = (uint64_t)pts;
+	out.full_range = range == VIDEO_RANGE_FULL;
+	video_format_get_parameters(VIDEO_CS_DEFAULT, range, out.color_matrix,
+				    out.color_range_min, out.color_range_max);
+
+	obs_source_output_video(d->source, &out);
+
+	pthread_mutex_lock(&d->mutex);
+	received = take_receive_time(d, pts);
+	pthread_mutex_unlock(&d->mutex);
+
+	if (received) {
+		uint64_t latency = os_gettime_ns() - received;
+
+		d->latency_frames++;
+		d->latency_total += latency;
+		if (latency > d->latency_max)
+			d->latency_max = latency;
+	}
+
+	d->decoded++;
+}
+
+static void decode_packet(struct v4l2_decoder *d, AVPacket *packet)
+{
+	int ret = avcodec_send_packet(d->context, packet);
+	if (ret < 0) {
+		if (!d->errors++)
+			blog(LOG_WARNING, "%s: failed to decode frame: %d",
+			     d->device, ret);
+		return;
+	}
+
+	while (avcodec_receive_frame(d->context, d->frame) == 0)
+		output_frame(d, d->frame);
+}
+
+static void *decode_thread(void *param)
+{
+	struct v4l2_decoder *d = param;
+
+	os_set_thread_name("v4l2-input: decode thread");
+
+	while (os_sem_wait(d->sem) == 0) {
+		AVPacket *packet = NULL;
+
+		if (os_atomic_load_bool(&d->stop))
+			break;
+
+		pthread_mutex_lock(&d->mutex);
+		if (d->packets.size)
+			circlebuf_pop_front(&d->packets, &packet,
+					    sizeof(packet));
+		pthread_mutex_unlock(&d->mutex);
+
+		/* the packet may have been dropped */
+		if (!packet)
+			continue;
+
+		decode_packet(d, packet);
+		av_packet_free(&packet);
+	}
+
+	return NULL;
+}
+
+/* call with the mutex locked */
+static void drop_packets(struct v4l2_decoder *d, size_t count)
+{
+	while (count-- && d->packets.size) {
+		AVPacket *packet;
+
+		circlebuf_pop_front(&d->packets, &packet, sizeof(packet));
+		av_packet_free(&packet);
+		d->dropped++;
+	}
+}
+
+void v4l2_decoder_push(struct v4l2_decoder *d, const uint8_t *data,
+		       size_t size, uint64_t timestamp, bool keyframe)
+{
+	struct receive_time *rt;
+	AVPacket *packet;
+
+	pthread_mutex_lock(&d->mutex);
+
+	if (d->packets.size >= MAX_QUEUED_PACKETS * sizeof(packet)) {
+		/* with h264 the frames after a dropped one can't be decoded
+		 * until the next keyframe */
+		if (d->h264) {
+			drop_packets(d, MAX_QUEUED_PACKETS);
+			if (!d->wait_for_keyframe)
+				d->wait_start = os_gettime_ns();
+			d->wait_for_keyframe = true;
+		} else {
+			drop_packets(d, 1);
+		}
+	}
+
+	/* most UVC drivers don't flag h264 keyframes */
+	if (d->wait_for_keyframe && !keyframe)
+		keyframe = obs_avc_keyframe(data, size);
+
+	if (d->wait_for_keyframe && !keyframe &&
+	    os_gettime_ns() - d->wait_start < KEYFRAME_TIMEOUT_NS) {
+		d->dropped++;
+		pthread_mutex_unlock(&d->mutex);
+		return;
+	}
+
+	if (d->wait_for_keyframe && !keyframe &&
+	    !d->keyframe_timeout_logged) {
+		blog(LOG_WARNING,
+		     "%s: no keyframe after dropped frames, "
+		     "decoding without one",
+		     d->device);
+		d->keyframe_timeout_logged = true;
+	}
+
+	d->wait_for_keyframe = false;
+
+	pthread_mutex_unlock(&d->mutex);
+
+	packet = av_packet_alloc();
+	if (!packet || av_new_packet(packet, (int)size) < 0) {
+		av_packet_free(&packet);
+		return;
+	}
+
+	memcpy(packet->data, data, size);
+	packet->pts = (int64_t)timestamp;
+	packet->dts = (int64_t)timestamp;
+	if (keyframe)
+		packet->flags |= AV_PKT_FLAG_KEY;
+
+	pthread_mutex_lock(&d->mutex);
+
+	rt = &d->receive_times[d->receive_idx++ % MAX_RECEIVE_TIMES];
+	rt->pts = packet->pts;
+	rt->time = os_gettime_ns();
+
+	circlebuf_push_back(&d->packets, &packet, sizeof(packet));
+
+	pthread_mutex_unlock(&d->mutex);
+
+	os_sem_post(d->sem);
+}
+
+struct v4l2_decoder *v4l2_decoder_create(obs_source_t *source,
+					 const char *device, uint32_t pixfmt,
+					 enum video_range_type range)
+{
+	struct v4l2_decoder *d = bzalloc(sizeof(struct v4l2_decoder));
+	enum AVCodecID id = get_codec_id(pixfmt);
+
+	d->source = source;
+	d->device = bstrdup(device);
+	d->range = range;
+	d->h264 = id == AV_CODEC_ID_H264;
+
+	if (pthread_mutex_init(&d->mutex, NULL) != 0) {
+		bfree(d->device);
+		bfree(d);
+		return NULL;
+	}
+
+	d->codec = avcodec_find_decoder(id);
+	if (!d->codec) {
+		blog(LOG_ERROR, "%s: no decoder available", device);
+		goto fail;
+	}
+
+	d->context = avcodec_alloc_context3(d->codec);
+	d->frame = av_frame_alloc();
+	if (!d->context || !d->frame)
+		goto fail;
+
+	/* frame threading lets a 1080p60 MJPEG stream decode on several
+	 * cores, at the cost of a frame of latency per thread */
+	d->context->thread_count = 0;
+	d->context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
+	if (avcodec_open2(d->context, d->codec, NULL) < 0) {
+		blog(LOG_ERROR, "%s: failed to open decoder", device);
+		goto fail;
+	}
+
+	if (os_sem_init(&d->sem, 0) != 0)
+		goto fail;
+	if (pthread_create(&d->thread, NULL, decode_thread, d) != 0)
+		goto fail;
+
+	d->thread_created = true;
+
+	blog(LOG_INFO, "%s: decoding %s with %d threads", device,
+	     d->codec->name, d->context->thread_count);
+	return d;
+
+fail:
+	v4l2_decoder_destroy(d);
+	return NULL;
+}
+
+void v4l2_decoder_destroy(struct v4l2_decoder *d)
+{
+	if (!d)
+		return;
+
+	if (d->thread_created) {
+		os_atomic_set_bool(&d->stop, true);
+		os_sem_post(d->sem);
+		pthread_join(d->thread, NULL);
+
+		blog(LOG_INFO,
+		     "%s: decoded %" PRIu64 " frames, dropped %" PRIu64
+		     ", %" PRIu64 " errors, average decode latency %.2f ms"
+		     ", max %.2f ms",
+		     d->device, d->decoded, d->dropped, d->errors,
+		     d->latency_frames ? (double)d->latency_total /
+						 (double)d->latency_frames /
+						 1000000.0
+				       : 0.0,
+		     (double)d->latency_max / 1000000.0);
+	}
+
+	drop_packets(d, SIZE_MAX);
+	circlebuf_free(&d->packets);
+
+	av_frame_free(&d->frame);
+	avcodec_free_context(&d->context);
+
+	os_sem_destroy(d->sem);
+	pthread_mutex_destroy(&d->mutex);
+	bfree(d->device);
+	bfree(d);
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Decoder for compressed (MJPEG and H.264) capture formats
+ *
+ * Compressed frames are copied out of the mapped v4l2 buffers so the buffers
+ * can be requeued right away, and are decoded on a thread of the decoder.
+ * The decoded frames are passed to the source straight from the decoder.
+ *
+ * Without FFmpeg no compressed format is supported.
+ */
+struct v4l2_decoder;
+
+#if HAVE_FFMPEG
+
+/**
+ * Check if a v4l2 pixel format is a compressed format that can be decoded
+ *
+ * @param pixfmt v4l2 pixel format
+ *
+ * @return true if a decoder is available
+ */
+bool v4l2_decoder_supported(uint32_t pixfmt);
+
+/**
+ * Create a decoder for a v4l2 pixel format
+ *
+ * @param source the source to output the decoded frames to
+ * @param device device name, used for logging
+ * @param pixfmt v4l2 pixel format
+ * @param range color range of the decoded frames, VIDEO_RANGE_DEFAULT to
+ *              use the range the decoder reports
+ *
+ * @return the decoder, or NULL on failure
+ */
+struct v4l2_decoder *v4l2_decoder_create(obs_source_t *source,
+					 const char *device, uint32_t pixfmt,
+					 enum video_range_type range);
+
+/**
+ * Stop the decoder thread and free the decoder
+ *
+ * Logs the decode statistics of the device.
+ *
+ * @param decoder the decoder
+ */
+void v4l2_decoder_destroy(struct v4l2_decoder *decoder);
+
+/**
+ * Queue a compressed frame for decoding
+ *
+ * The data is copied, if the decoder falls behind old frames are dropped.
+ *
+ * @param decoder the decoder
+ * @param data compressed frame
+ * @param size size of the compressed frame
+ * @param timestamp timestamp of the frame
+ * @param keyframe true if the driver flagged the frame as a keyframe, H.264
+ *                 frames are also checked for IDR slices since many drivers
+ *                 never set the flag
+ */
+void v4l2_decoder_push(struct v4l2_decoder *decoder, const uint8_t *data,
+		       size_t size, uint64_t timestamp, bool keyframe);
+
+#else
+
+static inline bool v4l2_decoder_supported(uint32_t pixfmt)
+{
+	UNUSED_PARAMETER(pixfmt);
+	return false;
+}
+
+static inline struct v4l2_decoder *
+v4l2_decoder_create(obs_source_t *source, const char *device, uint32_t pixfmt,
+		    enum video_range_type range)
+{
+	UNUSED_PARAMETER(source);
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(pixfmt);
+	UNUSED_PARAMETER(range);
+	return NULL;
+}
+
+static inline void v4l2_decoder_destroy(struct v4l2_decoder *decoder)
+{
+	UNUSED_PARAMETER(decoder);
+}
+
+static inline void v4l2_decoder_push(struct v4l2_decoder *decoder,
+				     const uint8_t *data, size_t size,
+				     uint64_t timestamp, bool keyframe)
+{
+	UNUSED_PARAMETER(decoder);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(size);
+	UNUSED_PARAMETER(timestamp);
+	UNUSED_PARAMETER(keyframe);
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
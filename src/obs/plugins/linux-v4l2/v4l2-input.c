@@ -36,6 +36,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <obs-module.h>
 
 #include "v4l2-helpers.h"
+#include "v4l2-decoder.h"
 
 #if HAVE_UDEV
 #include "v4l2-udev.h"
@@ -85,6 +86,9 @@ struct v4l2_data {
 	int height;
 	int linesize;
 	struct v4l2_buffer_data buffers;
+
+	/* set for compressed formats */
+	struct v4l2_decoder *decoder;
 };
 
 /* forward declarations */
@@ -198,9 +202,18 @@ static void *v4l2_thread(void *vptr)
 		out.timestamp -= first_ts;
 
 		start = (uint8_t *)data->buffers.info[buf.index].start;
-		for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
-			out.data[i] = start + plane_offsets[i];
-		obs_source_output_video(data->source, &out);
+		if (data->decoder) {
+			/* mjpeg frames are all keyframes */
+			bool keyframe = data->pixfmt != V4L2_PIX_FMT_H264 ||
+					(buf.flags & V4L2_BUF_FLAG_KEYFRAME);
+
+			v4l2_decoder_push(data->decoder, start, buf.bytesused,
+					  out.timestamp, keyframe);
+		} else {
+			for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
+				out.data[i] = start + plane_offsets[i];
+			obs_source_output_video(data->source, &out);
+		}
 
 		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
 			blog(LOG_DEBUG, "failed to enqueue buffer");
@@ -394,7 +407,8 @@ static void v4l2_format_list(int dev, obs_property_t *prop)
 			dstr_cat(&buffer, " (Emulated)");
 
 		if (v4l2_to_obs_video_format(fmt.pixelformat) !=
-		    VIDEO_FORMAT_NONE) {
+			    VIDEO_FORMAT_NONE ||
+		    v4l2_decoder_supported(fmt.pixelformat)) {
 			obs_property_list_add_int(prop, buffer.array,
 						  fmt.pixelformat);
 			blog(LOG_INFO, "Pixelformat: %s (available)",
@@ -805,6 +819,9 @@ static void v4l2_terminate(struct v4l2_data *data)
 		data->thread = 0;
 	}
 
+	v4l2_decoder_destroy(data->decoder);
+	data->decoder = NULL;
+
 	v4l2_destroy_mmap(&data->buffers);
 
 	if (data->dev != -1) {
@@ -895,7 +912,8 @@ static void v4l2_init(struct v4l2_data *data)
 		blog(LOG_ERROR, "Unable to set format");
 		goto fail;
 	}
-	if (v4l2_to_obs_video_format(data->pixfmt) == VIDEO_FORMAT_NONE) {
+	if (v4l2_to_obs_video_format(data->pixfmt) == VIDEO_FORMAT_NONE &&
+	    !v4l2_decoder_supported(data->pixfmt)) {
 		blog(LOG_ERROR, "Selected video format not supported");
 		goto fail;
 	}
@@ -918,6 +936,16 @@ static void v4l2_init(struct v4l2_data *data)
 		goto fail;
 	}
 
+	/* compressed formats are decoded on a thread of their own */
+	if (v4l2_to_obs_video_format(data->pixfmt) == VIDEO_FORMAT_NONE) {
+		data->decoder = v4l2_decoder_create(data->source,
+						    data->device_id,
+						    data->pixfmt,
+						    data->color_range);
+		if (!data->decoder)
+			goto fail;
+	}
+
 	/* start the capture thread */
 	if (os_event_init(&data->event, OS_EVENT_TYPE_MANUAL) != 0)
 		goto fail;
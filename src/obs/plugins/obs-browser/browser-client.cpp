@@ -271,8 +271,8 @@ bool BrowserClient::GetScreenPoint(CefRefPtr<CefBrowser> browser, int viewX,
 }
 
 void BrowserClient::OnPaint(CefRefPtr<CefBrowser>, PaintElementType type,
-			    const RectList &, const void *buffer, int width,
-			    int height)
+			    const RectList &dirtyRects, const void *buffer,
+			    int width, int height)
 {
 	if (type != PET_VIEW) {
 		return;
@@ -284,30 +284,37 @@ void BrowserClient::OnPaint(CefRefPtr<CefBrowser>, PaintElementType type,
 	}
 #endif
 
-	if (!bs) {
+	if (!bs || !width || !height) {
 		return;
 	}
 
-	if (bs->width != width || bs->height != height) {
-		obs_enter_graphics();
-		bs->DestroyTextures();
-		obs_leave_graphics();
+	/* uploads are limited to the bounding box of the dirty rects */
+	int left = width, top = height, right = 0, bottom = 0;
+
+	for (const CefRect &rect : dirtyRects) {
+		if (rect.x < left)
+			left = rect.x;
+		if (rect.y < top)
+			top = rect.y;
+		if (rect.x + rect.width > right)
+			right = rect.x + rect.width;
+		if (rect.y + rect.height > bottom)
+			bottom = rect.y + rect.height;
 	}
 
-	if (!bs->texture && width && height) {
-		obs_enter_graphics();
-		bs->texture = gs_texture_create(width, height, GS_BGRA, 1,
-						(const uint8_t **)&buffer,
-						GS_DYNAMIC);
-		bs->width = width;
-		bs->height = height;
-		obs_leave_graphics();
-	} else {
-		obs_enter_graphics();
-		gs_texture_set_image(bs->texture, (const uint8_t *)buffer,
-				     width * 4, false);
-		obs_leave_graphics();
+	left = left < 0 ? 0 : left;
+	top = top < 0 ? 0 : top;
+	right = right > width ? width : right;
+	bottom = bottom > height ? height : bottom;
+
+	if (left >= right || top >= bottom) {
+		left = top = 0;
+		right = width;
+		bottom = height;
 	}
+
+	gs_rect rect = {left, top, right - left, bottom - top};
+	bs->QueuePaint(rect, buffer, width, height);
 }
 
 #if EXPERIMENTAL_SHARED_TEXTURE_SUPPORT_ENABLED
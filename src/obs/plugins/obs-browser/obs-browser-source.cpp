@@ -24,6 +24,8 @@
 #include <util/threading.h>
 #include <QApplication>
 #include <util/dstr.h>
+#include <util/platform.h>
+#include <inttypes.h>
 #include <functional>
 #include <thread>
 #include <mutex>
@@ -43,6 +45,8 @@ extern bool QueueCEFTask(std::function<void()> task);
 static mutex browser_list_mutex;
 static BrowserSource *first_browser = nullptr;
 
+#define PAINT_STATS_INTERVAL_NS 10000000000ULL
+
 void SendBrowserVisibility(CefRefPtr<CefBrowser> browser, bool isVisible)
 {
 	if (!browser)
@@ -112,6 +116,14 @@ BrowserSource::~BrowserSource()
 	DestroyBrowser();
 	DestroyTextures();
 
+	if (paint_count) {
+		blog(LOG_INFO,
+		     "[browser_source: '%s'] %" PRIu64 " paints with %" PRIu64
+		     " pixels, %" PRIu64 " uploads with %" PRIu64 " pixels",
+		     obs_source_get_name(source), paint_count, paint_pixels,
+		     upload_count, upload_pixels);
+	}
+
 	lock_guard<mutex> lock(browser_list_mutex);
 	if (next)
 		next->p_prev_next = p_prev_next;
@@ -591,6 +603,188 @@ void BrowserSource::Tick()
 	}
 }
 
+static inline bool rect_empty(const gs_rect &rect)
+{
+	return rect.cx <= 0 || rect.cy <= 0;
+}
+
+static void rect_union(gs_rect &dst, const gs_rect &src)
+{
+	if (rect_empty(src))
+		return;
+	if (rect_empty(dst)) {
+		dst = src;
+		return;
+	}
+
+	int right = dst.x + dst.cx;
+	int bottom = dst.y + dst.cy;
+
+	if (src.x + src.cx > right)
+		right = src.x + src.cx;
+	if (src.y + src.cy > bottom)
+		bottom = src.y + src.cy;
+	if (src.x < dst.x)
+		dst.x = src.x;
+	if (src.y < dst.y)
+		dst.y = src.y;
+
+	dst.cx = right - dst.x;
+	dst.cy = bottom - dst.y;
+}
+
+/* called from the CEF thread */
+void BrowserSource::QueuePaint(const gs_rect &rect, const void *buffer, int cx,
+			       int cy)
+{
+	gs_rect full = {0, 0, cx, cy};
+	gs_rect region;
+	int slot = 0;
+
+	{
+		lock_guard<mutex> lock(paint_mutex);
+
+		/* with three buffers there is always one that isn't
+		 * waiting for or being uploaded */
+		while (slot == paint_ready || slot == paint_uploading)
+			slot++;
+
+		if (paint_reset) {
+			for (PaintBuffer &pb : paint_buffers)
+				pb.stale = full;
+			paint_reset = false;
+		}
+
+		for (int i = 0; i < 3; i++) {
+			if (i != slot)
+				rect_union(paint_buffers[i].stale, rect);
+		}
+
+		region = paint_buffers[slot].stale;
+		rect_union(region, rect);
+		paint_buffers[slot].stale = {};
+	}
+
+	PaintBuffer &pb = paint_buffers[slot];
+	if (pb.width != cx || pb.height != cy) {
+		pb.data.resize((size_t)cx * cy * 4);
+		pb.width = cx;
+		pb.height = cy;
+		region = full;
+	}
+
+	const uint8_t *src = (const uint8_t *)buffer;
+	size_t linesize = (size_t)cx * 4;
+
+	for (int y = region.y; y < region.y + region.cy; y++) {
+		size_t offset = y * linesize + region.x * 4;
+		memcpy(pb.data.data() + offset, src + offset, region.cx * 4);
+	}
+
+	lock_guard<mutex> lock(paint_mutex);
+
+	/* the texture never got the previous page, upload its changes too */
+	pb.dirty = rect;
+	if (paint_ready != -1)
+		rect_union(pb.dirty, paint_buffers[paint_ready].dirty);
+
+	paint_ready = slot;
+	paint_count++;
+	paint_pixels += (uint64_t)rect.cx * rect.cy;
+}
+
+/* called from the graphics thread */
+void BrowserSource::UploadPaint()
+{
+	int slot;
+
+	{
+		lock_guard<mutex> lock(paint_mutex);
+		if (paint_ready == -1)
+			return;
+
+		slot = paint_ready;
+		paint_ready = -1;
+		paint_uploading = slot;
+	}
+
+	PaintBuffer &pb = paint_buffers[slot];
+	const uint8_t *data = pb.data.data();
+	gs_rect rect = pb.dirty;
+
+	if (!texture || gs_texture_get_width(texture) != (uint32_t)pb.width ||
+	    gs_texture_get_height(texture) != (uint32_t)pb.height) {
+		gs_texture_destroy(texture);
+		gs_texture_destroy(upload_texture);
+
+		/* only the upload texture is dynamic, the page texture has to
+		 * be a copy destination */
+		texture = gs_texture_create(pb.width, pb.height, GS_BGRA, 1,
+					    &data, 0);
+		upload_texture = gs_texture_create(pb.width, pb.height,
+						   GS_BGRA, 1, nullptr,
+						   GS_DYNAMIC);
+		width = pb.width;
+		height = pb.height;
+		rect = {0, 0, pb.width, pb.height};
+
+	} else if (!rect_empty(rect) && upload_texture) {
+		size_t linesize = (size_t)pb.width * 4;
+		uint32_t map_linesize;
+		uint8_t *ptr;
+
+		if (gs_texture_map(upload_texture, &ptr, &map_linesize)) {
+			for (int y = 0; y < rect.cy; y++) {
+				size_t offset =
+					(rect.y + y) * linesize + rect.x * 4;
+				memcpy(ptr + y * map_linesize, data + offset,
+				       rect.cx * 4);
+			}
+			gs_texture_unmap(upload_texture);
+
+			gs_copy_texture_region(texture, rect.x, rect.y,
+					       upload_texture, 0, 0, rect.cx,
+					       rect.cy);
+		}
+	}
+
+	upload_count++;
+	upload_pixels += (uint64_t)rect.cx * rect.cy;
+
+	uint64_t ts = os_gettime_ns();
+	uint64_t paints;
+
+	{
+		lock_guard<mutex> lock(paint_mutex);
+		paint_uploading = -1;
+		paints = paint_count;
+	}
+
+	if (!stats_ts) {
+		stats_ts = ts;
+		stats_paint_count = paints;
+		stats_upload_count = upload_count;
+		stats_upload_pixels = upload_pixels;
+
+	} else if (ts - stats_ts >= PAINT_STATS_INTERVAL_NS) {
+		double seconds = (double)(ts - stats_ts) / 1000000000.0;
+		double pixels = (double)(upload_pixels - stats_upload_pixels);
+
+		blog(LOG_DEBUG,
+		     "[browser_source: '%s'] %.1f paints/s, %.1f uploads/s, "
+		     "%.2f MB/s uploaded",
+		     obs_source_get_name(source),
+		     (double)(paints - stats_paint_count) / seconds,
+		     (double)(upload_count - stats_upload_count) / seconds,
+		     pixels * 4.0 / seconds / (1024.0 * 1024.0));
+
+		stats_ts = ts;
+		stats_paint_count = paints;
+		stats_upload_count = upload_count;
+		stats_upload_pixels = upload_pixels;
+	}
+}
+
 extern void ProcessCef();
 
 void BrowserSource::Render()
@@ -601,6 +795,8 @@ void BrowserSource::Render()
 	flip = hwaccel && use_hardware;
 #endif
 
+	UploadPaint();
+
 	if (texture) {
 		gs_effect_t *effect =
 			obs_get_base_effect(OBS_EFFECT_PREMULTIPLIED_ALPHA);
@@ -78,14 +78,54 @@ struct BrowserSource {
 	//PRISM/Wangshaohui/20201021/#5271/for cef hardware accelerate
 	bool use_hardware = true;
 
+	/* Pages painted by CEF are copied into one of three buffers, only the
+	 * part that changed, and the graphics thread uploads the changed part
+	 * of the latest one.  This way CEF never waits for the graphics lock. */
+	struct PaintBuffer {
+		std::vector<uint8_t> data;
+		int width = 0;
+		int height = 0;
+
+		/* outdated part of this copy of the page */
+		gs_rect stale = {};
+		/* changed since the previous upload */
+		gs_rect dirty = {};
+	};
+
+	std::mutex paint_mutex;
+	PaintBuffer paint_buffers[3];
+	int paint_ready = -1;
+	int paint_uploading = -1;
+	bool paint_reset = false;
+	gs_texture_t *upload_texture = nullptr;
+
+	uint64_t paint_count = 0;
+	uint64_t paint_pixels = 0;
+	uint64_t upload_count = 0;
+	uint64_t upload_pixels = 0;
+	uint64_t stats_ts = 0;
+	uint64_t stats_paint_count = 0;
+	uint64_t stats_upload_count = 0;
+	uint64_t stats_upload_pixels = 0;
+
+	void QueuePaint(const gs_rect &rect, const void *buffer, int cx,
+			int cy);
+	void UploadPaint();
+
 	inline void DestroyTextures()
 	{
-		if (texture) {
+		if (texture || upload_texture) {
 			obs_enter_graphics();
 			gs_texture_destroy(texture);
+			gs_texture_destroy(upload_texture);
 			texture = nullptr;
+			upload_texture = nullptr;
 			obs_leave_graphics();
 		}
+
+		std::lock_guard<std::mutex> lock(paint_mutex);
+		paint_ready = -1;
+		paint_reset = true;
 	}
 
 	/* ------------------------------PRISM/Wangshaohui/20200811/#3784/for cef interaction --------------begin */
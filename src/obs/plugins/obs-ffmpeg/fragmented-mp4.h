@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <string.h>
+#include <libavformat/avformat.h>
+
+/* Fragmented MP4/MOV writes an empty moov atom up front and then
+ * self-contained moof/mdat fragments, each starting on a video keyframe and
+ * lasting at least the fragment duration.  A file cut short by a crash stays
+ * playable up to its last complete fragment, without remuxing. */
+
+#define FRAGMENTED_MP4_FLAGS "frag_keyframe+empty_moov+delay_moov"
+#define FRAGMENT_DURATION_DEFAULT 2000
+
+static inline bool format_is_mp4(const AVOutputFormat *format)
+{
+	return format && (strcmp(format->name, "mp4") == 0 ||
+			  strcmp(format->name, "mov") == 0);
+}
+
+/* muxer settings set by the user take precedence */
+static inline void set_fragmented_mp4_options(AVDictionary **dict,
+					      int fragment_duration_ms)
+{
+	av_dict_set(dict, "movflags", FRAGMENTED_MP4_FLAGS,
+		    AV_DICT_DONT_OVERWRITE);
+	av_dict_set_int(dict, "min_frag_duration",
+			(int64_t)fragment_duration_ms * 1000,
+			AV_DICT_DONT_OVERWRITE);
+}
@@ -0,0 +1,832 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <util/bmem.h>
+#include <util/circlebuf.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include "ffmpeg-mux/ffmpeg-mux.h"
+#include "obs-ffmpeg-compat.h"
+#include "mux-writer.h"
+
+#include <errno.h>
+#ifdef _WIN32
+#include <stdio.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <libavformat/avformat.h>
+
+#define do_log(level, format, ...)                                    \
+	blog(level, "[mux writer: '%s'] " format, writer->path.array, \
+	     ##__VA_ARGS__)
+
+#define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
+
+/* size of the writes to the file, a multiple of the direct I/O alignment */
+#define WRITE_SIZE (4 * 1024 * 1024)
+#define DIRECT_ALIGNMENT 4096
+
+#define DEFAULT_QUEUE_SIZE (64 * 1024 * 1024)
+
+struct mux_packet {
+	struct encoder_packet pkt;
+	bool copy;
+};
+
+struct mux_writer {
+	struct dstr path;
+	struct dstr muxer_settings;
+	struct dstr vcodec;
+	struct dstr acodec;
+	struct dstr audio_names[MAX_AUDIO_MIXES];
+	struct mux_writer_params params;
+
+	/* ffmpeg */
+	AVFormatContext *output;
+	AVStream *video_stream;
+	AVStream *audio_streams[MAX_AUDIO_MIXES];
+	int num_audio_streams;
+
+	/* kept here rather than in oformat, which libavformat shares between
+	 * every output of the format */
+	enum AVCodecID video_codec;
+	enum AVCodecID audio_codec;
+	bool header_written;
+
+	/* file */
+#ifdef _WIN32
+	FILE *file;
+#else
+	int fd;
+#endif
+	bool direct;
+	uint8_t *bounce;
+	int64_t file_pos;
+
+	/* queue */
+	pthread_mutex_t mutex;
+	bool mutex_failed;
+	struct circlebuf queue;
+	size_t queued_size;
+	size_t peak_queued_size;
+	bool stalled;
+	os_sem_t *sem;
+	os_event_t *space_event;
+
+	pthread_t thread;
+	bool thread_created;
+	volatile bool stop;
+	volatile bool failed;
+	volatile bool closed;
+	int result;
+	struct dstr error;
+
+	/* stats, written under the mutex */
+	uint64_t bytes_written;
+	uint64_t write_time_ns;
+};
+
+/* ------------------------------------------------------------------------- */
+/* file */
+
+static uint8_t *alloc_bounce(void)
+{
+#ifdef _WIN32
+	return NULL;
+#else
+	void *ptr = NULL;
+	if (posix_memalign(&ptr, DIRECT_ALIGNMENT, WRITE_SIZE) != 0)
+		return NULL;
+	return ptr;
+#endif
+}
+
+static bool file_open(struct mux_writer *writer)
+{
+#ifdef _WIN32
+	if (writer->params.direct_io)
+		info("Direct I/O is not supported on this platform");
+
+	writer->file = os_fopen(writer->path.array, "wb");
+	if (!writer->file)
+		return false;
+
+	/* the writes are already coalesced by the avio buffer */
+	setvbuf(writer->file, NULL, _IONBF, 0);
+	return true;
+#else
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+#ifdef O_DIRECT
+	if (writer->params.direct_io) {
+		writer->bounce = alloc_bounce();
+		if (writer->bounce) {
+			writer->fd = open(writer->path.array, flags | O_DIRECT,
+					  0644);
+			if (writer->fd != -1) {
+				writer->direct = true;
+				return true;
+			}
+
+			/* not every filesystem supports it */
+			info("Direct I/O unavailable, using buffered writes");
+			free(writer->bounce);
+			writer->bounce = NULL;
+		}
+	}
+#else
+	if (writer->params.direct_io)
+		info("Direct I/O is not supported on this platform");
+#endif
+
+	writer->fd = open(writer->path.array, flags, 0644);
+	return writer->fd != -1;
+#endif
+}
+
+static void file_close(struct mux_writer *writer)
+{
+#ifdef _WIN32
+	if (writer->file) {
+		fclose(writer->file);
+		writer->file = NULL;
+	}
+#else
+	if (writer->fd != -1) {
+		close(writer->fd);
+		writer->fd = -1;
+	}
+	free(writer->bounce);
+	writer->bounce = NULL;
+#endif
+}
+
+#ifndef _WIN32
+/* direct writes need aligned memory, sizes and offsets, anything else (the
+ * tail of the file, headers rewritten by the muxer) falls back to the page
+ * cache for the rest of the file */
+static void drop_direct(struct mux_writer *writer)
+{
+#ifdef O_DIRECT
+	int flags = fcntl(writer->fd, F_GETFL);
+	if (flags != -1)
+		fcntl(writer->fd, F_SETFL, flags & ~O_DIRECT);
+#endif
+	writer->direct = false;
+}
+
+static bool write_all(int fd, const uint8_t *data, size_t size)
+{
+	while (size > 0) {
+		ssize_t ret = write(fd, data, size);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+
+		data += ret;
+		size -= (size_t)ret;
+	}
+
+	return true;
+}
+#endif
+
+static bool file_write(struct mux_writer *writer, const uint8_t *data,
+		       size_t size)
+{
+#ifdef _WIN32
+	return fwrite(data, 1, size, writer->file) == size;
+#else
+	if (writer->direct) {
+		if (size % DIRECT_ALIGNMENT != 0 ||
+		    writer->file_pos % DIRECT_ALIGNMENT != 0) {
+			drop_direct(writer);
+
+		} else if (((uintptr_t)data % DIRECT_ALIGNMENT) != 0) {
+			memcpy(writer->bounce, data, size);
+			data = writer->bounce;
+		}
+	}
+
+	return write_all(writer->fd, data, size);
+#endif
+}
+
+static int64_t file_seek(struct mux_writer *writer, int64_t offset,
+			 int whence)
+{
+#ifdef _WIN32
+	if (os_fseeki64(writer->file, offset, whence) != 0)
+		return -1;
+	return os_ftelli64(writer->file);
+#else
+	return (int64_t)lseek(writer->fd, (off_t)offset, whence);
+#endif
+}
+
+static int avio_write_cb(void *opaque, uint8_t *buf, int buf_size)
+{
+	struct mux_writer *writer = opaque;
+	uint64_t start = os_gettime_ns();
+
+	if (!file_write(writer, buf, (size_t)buf_size))
+		return AVERROR(EIO);
+
+	writer->file_pos += buf_size;
+
+	pthread_mutex_lock(&writer->mutex);
+	writer->bytes_written += (uint64_t)buf_size;
+	writer->write_time_ns += os_gettime_ns() - start;
+	pthread_mutex_unlock(&writer->mutex);
+	return buf_size;
+}
+
+static int64_t avio_seek_cb(void *opaque, int64_t offset, int whence)
+{
+	struct mux_writer *writer = opaque;
+	int64_t pos;
+
+	if (whence == AVSEEK_SIZE)
+		return -1;
+
+	pos = file_seek(writer, offset, whence & ~AVSEEK_FORCE);
+	if (pos < 0)
+		return AVERROR(EIO);
+
+	writer->file_pos = pos;
+	return pos;
+}
+
+/* ------------------------------------------------------------------------- */
+/* muxer, mirrors the ffmpeg-mux helper process */
+
+static void set_error(struct mux_writer *writer, const char *format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	dstr_vprintf(&writer->error, format, args);
+	va_end(args);
+
+	warn("%s", writer->error.array);
+}
+
+static bool new_stream(struct mux_writer *writer, AVStream **stream,
+		       const char *name, enum AVCodecID *id)
+{
+	const AVCodecDescriptor *desc = avcodec_descriptor_get_by_name(name);
+	AVCodec *codec;
+
+	if (!desc) {
+		set_error(writer, "Couldn't find encoder '%s'", name);
+		return false;
+	}
+
+	*id = desc->id;
+
+	codec = avcodec_find_encoder(desc->id);
+	if (!codec) {
+		set_error(writer, "Couldn't create encoder");
+		return false;
+	}
+
+	*stream = avformat_new_stream(writer->output, codec);
+	if (!*stream) {
+		set_error(writer, "Couldn't create stream for encoder '%s'",
+			  name);
+		return false;
+	}
+
+	(*stream)->id = writer->output->nb_streams - 1;
+	return true;
+}
+
+static void create_video_stream(struct mux_writer *writer)
+{
+	struct mux_writer_params *params = &writer->params;
+	AVCodecContext *context;
+	void *extradata = NULL;
+
+	if (!new_stream(writer, &writer->video_stream, writer->vcodec.array,
+			&writer->video_codec))
+		return;
+
+	if (params->video_header_size) {
+		extradata = av_memdup(params->video_header,
+				      params->video_header_size);
+	}
+
+	context = writer->video_stream->codec;
+	context->bit_rate = params->vbitrate * 1000;
+	context->width = params->width;
+	context->height = params->height;
+	context->coded_width = params->width;
+	context->coded_height = params->height;
+	context->extradata = extradata;
+	context->extradata_size = (int)params->video_header_size;
+	context->time_base = (AVRational){params->fps_den, params->fps_num};
+
+	writer->video_stream->time_base = context->time_base;
+	writer->video_stream->avg_frame_rate = av_inv_q(context->time_base);
+
+	if (writer->output->oformat->flags & AVFMT_GLOBALHEADER)
+		context->flags |= CODEC_FLAG_GLOBAL_H;
+}
+
+static void create_audio_stream(struct mux_writer *writer, int idx)
+{
+	struct mux_writer_audio *audio = &writer->params.audio[idx];
+	AVCodecContext *context;
+	AVStream *stream;
+	void *extradata = NULL;
+
+	if (!new_stream(writer, &stream, writer->acodec.array,
+			&writer->audio_codec))
+		return;
+
+	writer->audio_streams[idx] = stream;
+
+	av_dict_set(&stream->metadata, "title", audio->name, 0);
+
+	stream->time_base = (AVRational){1, audio->sample_rate};
+
+	if (audio->header_size)
+		extradata = av_memdup(audio->header, audio->header_size);
+
+	context = stream->codec;
+	context->bit_rate = audio->bitrate * 1000;
+	context->channels = audio->channels;
+	context->sample_rate = audio->sample_rate;
+	context->sample_fmt = AV_SAMPLE_FMT_S16;
+	context->time_base = stream->time_base;
+	context->extradata = extradata;
+	context->extradata_size = (int)audio->header_size;
+	context->channel_layout =
+		av_get_default_channel_layout(context->channels);
+	//AVlib default channel layout for 4 channels is 4.0 ; fix for quad
+	if (context->channels == 4)
+		context->channel_layout = av_get_channel_layout("quad");
+	//AVlib default channel layout for 5 channels is 5.0 ; fix for 4.1
+	if (context->channels == 5)
+		context->channel_layout = av_get_channel_layout("4.1");
+	if (writer->output->oformat->flags & AVFMT_GLOBALHEADER)
+		context->flags |= CODEC_FLAG_GLOBAL_H;
+
+	writer->num_audio_streams++;
+}
+
+static bool init_streams(struct mux_writer *writer)
+{
+	if (writer->params.has_video)
+		create_video_stream(writer);
+
+	for (int i = 0; i < writer->params.tracks; i++)
+		create_audio_stream(writer, i);
+
+	return writer->video_stream || writer->num_audio_streams;
+}
+
+static int open_output_file(struct mux_writer *writer)
+{
+	AVOutputFormat *format = writer->output->oformat;
+	AVDictionary *dict = NULL;
+	int ret;
+
+	if ((format->flags & AVFMT_NOFILE) == 0) {
+		uint8_t *buf;
+
+		if (!file_open(writer)) {
+			set_error(writer, "Couldn't open '%s', %s",
+				  writer->path.array, strerror(errno));
+			return FFM_ERROR;
+		}
+
+		buf = av_malloc(WRITE_SIZE);
+		writer->output->pb = avio_alloc_context(buf, WRITE_SIZE, 1,
+							writer, NULL,
+							avio_write_cb,
+							avio_seek_cb);
+		if (!writer->output->pb) {
+			av_free(buf);
+			set_error(writer, "Couldn't create I/O context");
+			return FFM_ERROR;
+		}
+	}
+
+	strncpy(writer->output->filename, writer->path.array,
+		sizeof(writer->output->filename));
+	writer->output->filename[sizeof(writer->output->filename) - 1] = 0;
+
+	if ((ret = av_dict_parse_string(&dict, writer->muxer_settings.array,
+					"=", " ", 0))) {
+		warn("Failed to parse muxer settings: %s\n%s", av_err2str(ret),
+		     writer->muxer_settings.array);
+
+		av_dict_free(&dict);
+	}
+
+	ret = avformat_write_header(writer->output, &dict);
+	av_dict_free(&dict);
+
+	if (ret < 0) {
+		set_error(writer, "Error opening '%s': %s", writer->path.array,
+			  av_err2str(ret));
+		return ret == -22 ? FFM_UNSUPPORTED : FFM_ERROR;
+	}
+
+	writer->header_written = true;
+	return FFM_SUCCESS;
+}
+
+static int init_context(struct mux_writer *writer)
+{
+	AVOutputFormat *output_format;
+	int ret;
+
+	output_format = av_guess_format(NULL, writer->path.array, NULL);
+	if (output_format == NULL) {
+		set_error(writer, "Couldn't find an appropriate muxer for '%s'",
+			  writer->path.array);
+		return FFM_ERROR;
+	}
+
+	ret = avformat_alloc_output_context2(&writer->output, output_format,
+					     NULL, NULL);
+	if (ret < 0) {
+		set_error(writer, "Couldn't initialize output context: %s",
+			  av_err2str(ret));
+		return FFM_ERROR;
+	}
+
+	writer->video_codec = AV_CODEC_ID_NONE;
+	writer->audio_codec = AV_CODEC_ID_NONE;
+
+	if (!init_streams(writer))
+		return FFM_ERROR;
+
+	return open_output_file(writer);
+}
+
+static void free_context(struct mux_writer *writer)
+{
+	if (writer->output) {
+		if (writer->header_written &&
+		    av_write_trailer(writer->output) < 0 &&
+		    writer->result == FFM_SUCCESS) {
+			set_error(writer, "Couldn't finish '%s'",
+				  writer->path.array);
+			writer->result = FFM_ERROR;
+		}
+
+		if (writer->output->pb) {
+			avio_flush(writer->output->pb);
+			av_freep(&writer->output->pb->buffer);
+			avio_context_free(&writer->output->pb);
+		}
+
+		avformat_free_context(writer->output);
+		writer->output = NULL;
+	}
+
+	file_close(writer);
+}
+
+static inline int get_index(struct mux_writer *writer,
+			    struct encoder_packet *pkt)
+{
+	if (pkt->type == OBS_ENCODER_VIDEO) {
+		if (writer->video_stream)
+			return writer->video_stream->id;
+	} else {
+		if ((int)pkt->track_idx < writer->params.tracks &&
+		    writer->audio_streams[pkt->track_idx])
+			return writer->audio_streams[pkt->track_idx]->id;
+	}
+
+	return -1;
+}
+
+static inline int64_t rescale_ts(struct mux_writer *writer, int64_t val,
+				 int idx)
+{
+	AVStream *stream = writer->output->streams[idx];
+
+	return av_rescale_q_rnd(val / stream->codec->time_base.num,
+				stream->codec->time_base, stream->time_base,
+				AV_ROUND_NEAR_INF | AV_ROUND_PASS_MINMAX);
+}
+
+static bool mux_packet(struct mux_writer *writer, struct encoder_packet *pkt)
+{
+	int idx = get_index(writer, pkt);
+	AVPacket packet = {0};
+
+	/* The muxer might not support video/audio, or multiple audio tracks */
+	if (idx == -1)
+		return true;
+
+	av_init_packet(&packet);
+
+	packet.data = pkt->data;
+	packet.size = (int)pkt->size;
+	packet.stream_index = idx;
+	packet.pts = rescale_ts(writer, pkt->pts, idx);
+	packet.dts = rescale_ts(writer, pkt->dts, idx);
+
+	if (pkt->keyframe)
+		packet.flags = AV_PKT_FLAG_KEY;
+
+	return av_interleaved_write_frame(writer->output, &packet) >= 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* queue */
+
+static inline void release_packet(struct mux_packet *mp)
+{
+	if (mp->copy)
+		bfree(mp->pkt.data);
+	else
+		obs_encoder_packet_release(&mp->pkt);
+}
+
+static bool pop_packet(struct mux_writer *writer, struct mux_packet *mp)
+{
+	bool popped = false;
+
+	pthread_mutex_lock(&writer->mutex);
+	if (writer->queue.size) {
+		circlebuf_pop_front(&writer->queue, mp, sizeof(*mp));
+		writer->queued_size -= mp->pkt.size;
+		popped = true;
+	}
+	pthread_mutex_unlock(&writer->mutex);
+
+	if (popped)
+		os_event_signal(writer->space_event);
+	return popped;
+}
+
+static void fail(struct mux_writer *writer, int result)
+{
+	writer->result = result;
+	os_atomic_set_bool(&writer->failed, true);
+
+	/* wakes a producer waiting for space */
+	os_event_signal(writer->space_event);
+}
+
+static void *writer_thread(void *data)
+{
+	struct mux_writer *writer = data;
+	struct mux_packet mp;
+	int ret;
+
+	os_set_thread_name("mux-writer");
+
+	ret = init_context(writer);
+	if (ret != FFM_SUCCESS)
+		fail(writer, ret);
+
+	for (;;) {
+		os_sem_wait(writer->sem);
+
+		if (!pop_packet(writer, &mp)) {
+			if (os_atomic_load_bool(&writer->stop))
+				break;
+			continue;
+		}
+
+		if (!os_atomic_load_bool(&writer->failed) &&
+		    !mux_packet(writer, &mp.pkt)) {
+			set_error(writer, "Couldn't write to '%s'",
+				  writer->path.array);
+			fail(writer, FFM_ERROR);
+		}
+
+		release_packet(&mp);
+	}
+
+	free_context(writer);
+	return NULL;
+}
+
+static bool queue_packet(struct mux_writer *writer, struct mux_packet *mp)
+{
+	pthread_mutex_lock(&writer->mutex);
+
+	while (writer->queue.size &&
+	       writer->queued_size + mp->pkt.size >
+		       writer->params.max_queue_size &&
+	       !os_atomic_load_bool(&writer->failed) &&
+	       !os_atomic_load_bool(&writer->closed)) {
+		if (!writer->stalled) {
+			warn("Packet queue full (%zu bytes), the disk can't "
+			     "keep up",
+			     writer->queued_size);
+			writer->stalled = true;
+		}
+
+		pthread_mutex_unlock(&writer->mutex);
+		os_event_wait(writer->space_event);
+		pthread_mutex_lock(&writer->mutex);
+	}
+
+	if (os_atomic_load_bool(&writer->failed) ||
+	    os_atomic_load_bool(&writer->closed)) {
+		pthread_mutex_unlock(&writer->mutex);
+		release_packet(mp);
+		return false;
+	}
+
+	circlebuf_push_back(&writer->queue, mp, sizeof(*mp));
+	writer->queued_size += mp->pkt.size;
+	if (writer->queued_size > writer->peak_queued_size)
+		writer->peak_queued_size = writer->queued_size;
+
+	pthread_mutex_unlock(&writer->mutex);
+
+	os_sem_post(writer->sem);
+	return true;
+}
+
+void mux_writer_close(struct mux_writer *writer)
+{
+	os_atomic_set_bool(&writer->closed, true);
+	os_event_signal(writer->space_event);
+}
+
+bool mux_writer_push(struct mux_writer *writer, struct encoder_packet *packet)
+{
+	struct mux_packet mp = {0};
+
+	obs_encoder_packet_ref(&mp.pkt, packet);
+	return queue_packet(writer, &mp);
+}
+
+bool mux_writer_push_copy(struct mux_writer *writer,
+			  struct encoder_packet *packet)
+{
+	struct mux_packet mp = {.pkt = *packet, .copy = true};
+
+	mp.pkt.data = bmemdup(packet->data, packet->size);
+	return queue_packet(writer, &mp);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void copy_params(struct mux_writer *writer,
+			const struct mux_writer_params *params)
+{
+	struct mux_writer_params *p = &writer->params;
+
+	*p = *params;
+
+	dstr_copy(&writer->path, params->path);
+	dstr_copy(&writer->muxer_settings, params->muxer_settings);
+	dstr_copy(&writer->vcodec, params->vcodec);
+	dstr_copy(&writer->acodec, params->acodec);
+
+	p->path = writer->path.array;
+	p->muxer_settings = writer->muxer_settings.array;
+	p->vcodec = writer->vcodec.array;
+	p->acodec = writer->acodec.array;
+
+	if (params->video_header_size)
+		p->video_header = bmemdup(params->video_header,
+					  params->video_header_size);
+
+	for (int i = 0; i < params->tracks; i++) {
+		struct mux_writer_audio *audio = &p->audio[i];
+
+		dstr_copy(&writer->audio_names[i], audio->name);
+		audio->name = writer->audio_names[i].array;
+
+		if (audio->header_size)
+			audio->header =
+				bmemdup(audio->header, audio->header_size);
+	}
+
+	if (!p->max_queue_size)
+		p->max_queue_size = DEFAULT_QUEUE_SIZE;
+}
+
+static void free_writer(struct mux_writer *writer)
+{
+	struct mux_packet mp;
+
+	while (writer->queue.size) {
+		circlebuf_pop_front(&writer->queue, &mp, sizeof(mp));
+		release_packet(&mp);
+	}
+
+	bfree(writer->params.video_header);
+	for (int i = 0; i < MAX_AUDIO_MIXES; i++) {
+		bfree(writer->params.audio[i].header);
+		dstr_free(&writer->audio_names[i]);
+	}
+
+	dstr_free(&writer->path);
+	dstr_free(&writer->muxer_settings);
+	dstr_free(&writer->vcodec);
+	dstr_free(&writer->acodec);
+	dstr_free(&writer->error);
+
+	circlebuf_free(&writer->queue);
+	os_event_destroy(writer->space_event);
+	os_sem_destroy(writer->sem);
+	if (!writer->mutex_failed)
+		pthread_mutex_destroy(&writer->mutex);
+	bfree(writer);
+}
+
+struct mux_writer *mux_writer_create(const struct mux_writer_params *params)
+{
+	struct mux_writer *writer = bzalloc(sizeof(*writer));
+
+#ifndef _WIN32
+	writer->fd = -1;
+#endif
+	copy_params(writer, params);
+
+	if (pthread_mutex_init(&writer->mutex, NULL) != 0) {
+		writer->mutex_failed = true;
+		goto fail;
+	}
+	if (os_sem_init(&writer->sem, 0) != 0)
+		goto fail;
+	if (os_event_init(&writer->space_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+
+	writer->thread_created = pthread_create(&writer->thread, NULL,
+						writer_thread, writer) == 0;
+	if (!writer->thread_created) {
+		warn("Failed to create writer thread");
+		goto fail;
+	}
+
+	return writer;
+
+fail:
+	free_writer(writer);
+	return NULL;
+}
+
+int mux_writer_destroy(struct mux_writer *writer)
+{
+	struct mux_writer_stats stats;
+	int result;
+
+	if (!writer)
+		return FFM_ERROR;
+
+	os_atomic_set_bool(&writer->stop, true);
+	os_sem_post(writer->sem);
+	pthread_join(writer->thread, NULL);
+
+	mux_writer_get_stats(writer, &stats);
+	info("Wrote %.1f MB, peak queue %.1f MB, disk writes at %.1f MB/s%s",
+	     (double)stats.bytes_written / (1024.0 * 1024.0),
+	     (double)stats.peak_queued_size / (1024.0 * 1024.0),
+	     stats.write_rate / (1024.0 * 1024.0),
+	     writer->params.direct_io ? " (direct I/O requested)" : "");
+
+	result = writer->result;
+	free_writer(writer);
+	return result;
+}
+
+bool mux_writer_failed(struct mux_writer *writer)
+{
+	return os_atomic_load_bool(&writer->failed);
+}
+
+const char *mux_writer_get_error(struct mux_writer *writer)
+{
+	return os_atomic_load_bool(&writer->failed) ? writer->error.array
+						    : NULL;
+}
+
+void mux_writer_get_stats(struct mux_writer *writer,
+			  struct mux_writer_stats *stats)
+{
+	pthread_mutex_lock(&writer->mutex);
+	stats->queued_packets = writer->queue.size / sizeof(struct mux_packet);
+	stats->queued_size = writer->queued_size;
+	stats->peak_queued_size = writer->peak_queued_size;
+	stats->bytes_written = writer->bytes_written;
+	stats->write_rate =
+		writer->write_time_ns
+			? (double)writer->bytes_written * 1000000000.0 /
+				  (double)writer->write_time_ns
+			: 0.0;
+	pthread_mutex_unlock(&writer->mutex);
+}
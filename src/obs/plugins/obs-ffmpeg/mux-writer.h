@@ -0,0 +1,77 @@
+#pragma once
+
+#include <obs-module.h>
+
+/* Muxes encoded packets with libavformat inside the process.  Packets are
+ * referenced into a bounded queue and written by a dedicated thread, so the
+ * encoder only ever waits when the queue is full.  Writes to the file go
+ * through a large buffer, and optionally bypass the page cache (O_DIRECT)
+ * where the platform supports it. */
+
+struct mux_writer;
+
+struct mux_writer_audio {
+	const char *name;
+	int bitrate;
+	int sample_rate;
+	int channels;
+	uint8_t *header;
+	size_t header_size;
+};
+
+struct mux_writer_params {
+	const char *path;
+	const char *muxer_settings;
+
+	bool has_video;
+	const char *vcodec;
+	int vbitrate;
+	int width;
+	int height;
+	int fps_num;
+	int fps_den;
+	uint8_t *video_header;
+	size_t video_header_size;
+
+	int tracks;
+	const char *acodec;
+	struct mux_writer_audio audio[MAX_AUDIO_MIXES];
+
+	size_t max_queue_size;
+	bool direct_io;
+};
+
+struct mux_writer_stats {
+	size_t queued_packets;
+	size_t queued_size;
+	size_t peak_queued_size;
+	uint64_t bytes_written;
+
+	/* rate of the disk writes themselves, in bytes per second */
+	double write_rate;
+};
+
+/* copies the parameters and starts the writer thread, the file is opened on
+ * that thread and errors are reported through mux_writer_failed */
+extern struct mux_writer *mux_writer_create(
+	const struct mux_writer_params *params);
+
+/* flushes the queue, finishes the file and returns an FFM_* code */
+extern int mux_writer_destroy(struct mux_writer *writer);
+
+/* makes pushes fail from now on, and wakes a push waiting for space.  Packets
+ * already queued are still written by mux_writer_destroy */
+extern void mux_writer_close(struct mux_writer *writer);
+
+/* references the packet, waits only while the queue is full */
+extern bool mux_writer_push(struct mux_writer *writer,
+			    struct encoder_packet *packet);
+
+/* for packet data that isn't reference counted */
+extern bool mux_writer_push_copy(struct mux_writer *writer,
+				 struct encoder_packet *packet);
+
+extern bool mux_writer_failed(struct mux_writer *writer);
+extern const char *mux_writer_get_error(struct mux_writer *writer);
+extern void mux_writer_get_stats(struct mux_writer *writer,
+				 struct mux_writer_stats *stats);
@@ -25,6 +25,9 @@
 #include <util/circlebuf.h>
 #include <util/threading.h>
 #include "ffmpeg-mux/ffmpeg-mux.h"
+#include "replay-store.h"
+#include "mux-writer.h"
+#include "fragmented-mp4.h"
 
 //PRISM/LiuHaibin/20200226/#none/for replay buffer message
 #include "obs-internal.h"
@@ -43,9 +46,13 @@
 #define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
 #define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
 
+#define REPLAY_SEGMENT_SIZE (32 * 1024 * 1024)
+
 struct ffmpeg_muxer {
 	obs_output_t *output;
 	os_process_pipe_t *pipe;
+	struct mux_writer *writer;
+	bool use_process;
 	int64_t stop_ts;
 	uint64_t total_bytes;
 	struct dstr path;
@@ -57,17 +64,20 @@ struct ffmpeg_muxer {
 	//PRISM/LiuHaibin/20200616/#3195/for force stop
 	pthread_mutex_t deactive_mutex;
 
+	/* the writer is only taken from the stream with both held: the encoder
+	 * thread holds push_mutex for the whole push (which may wait for the
+	 * disk), other readers only hold writer_mutex briefly */
+	pthread_mutex_t push_mutex;
+	pthread_mutex_t writer_mutex;
+
 	/* replay buffer */
-	struct circlebuf packets;
-	int64_t cur_size;
-	int64_t cur_time;
+	struct replay_store store;
 	int64_t max_size;
 	int64_t max_time;
 	int64_t save_ts;
-	int keyframes;
 	obs_hotkey_id hotkey;
 
-	DARRAY(struct encoder_packet) mux_packets;
+	struct replay_snapshot mux_snapshot;
 	pthread_t mux_thread;
 	bool mux_thread_joinable;
 	volatile bool muxing;
@@ -81,50 +91,87 @@ static const char *ffmpeg_mux_getname(void *type)
 
 static inline void replay_buffer_clear(struct ffmpeg_muxer *stream)
 {
-	while (stream->packets.size > 0) {
-		struct encoder_packet pkt;
-		circlebuf_pop_front(&stream->packets, &pkt, sizeof(pkt));
-		obs_encoder_packet_release(&pkt);
-	}
-
-	circlebuf_free(&stream->packets);
-	stream->cur_size = 0;
-	stream->cur_time = 0;
+	replay_store_clear(&stream->store);
 	stream->max_size = 0;
 	stream->max_time = 0;
 	stream->save_ts = 0;
-	stream->keyframes = 0;
 }
 
 static void ffmpeg_mux_destroy(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
 
-	replay_buffer_clear(stream);
 	if (stream->mux_thread_joinable)
 		pthread_join(stream->mux_thread, NULL);
-	da_free(stream->mux_packets);
+	replay_store_free(&stream->store);
 
+	mux_writer_destroy(stream->writer);
 	os_process_pipe_destroy(stream->pipe);
 	//PRISM/LiuHaibin/20200702/#3195/for force stop
-	if (stream->deactive_mutex)
-		pthread_mutex_destroy(&stream->deactive_mutex);
+	pthread_mutex_destroy(&stream->deactive_mutex);
+	pthread_mutex_destroy(&stream->push_mutex);
+	pthread_mutex_destroy(&stream->writer_mutex);
 	dstr_free(&stream->path);
 	bfree(stream);
 }
 
-static void *ffmpeg_mux_create(obs_data_t *settings, obs_output_t *output)
+static void get_mux_stats_proc(void *data, calldata_t *cd)
 {
-	struct ffmpeg_muxer *stream = bzalloc(sizeof(*stream));
-	stream->output = output;
+	struct ffmpeg_muxer *stream = data;
+	struct mux_writer_stats stats = {0};
+
+	pthread_mutex_lock(&stream->writer_mutex);
+	if (stream->writer)
+		mux_writer_get_stats(stream->writer, &stats);
+	pthread_mutex_unlock(&stream->writer_mutex);
+
+	calldata_set_int(cd, "queued_packets", (long long)stats.queued_packets);
+	calldata_set_int(cd, "queued_bytes", (long long)stats.queued_size);
+	calldata_set_int(cd, "peak_queued_bytes",
+			 (long long)stats.peak_queued_size);
+	calldata_set_int(cd, "bytes_written", (long long)stats.bytes_written);
+	calldata_set_float(cd, "write_rate", stats.write_rate);
+}
+
+/* shared by the recording and replay buffer outputs, ffmpeg_mux_destroy can
+ * be called if it fails */
+static bool init_mutexes(struct ffmpeg_muxer *stream)
+{
+	pthread_mutex_init_value(&stream->deactive_mutex);
+	pthread_mutex_init_value(&stream->push_mutex);
+	pthread_mutex_init_value(&stream->writer_mutex);
 
 	//PRISM/LiuHaibin/20200703/#3195/for force stop
 	if (pthread_mutex_init(&stream->deactive_mutex, NULL) != 0) {
 		warn("Failed to initialize deactive mutex");
+		return false;
+	}
+	if (pthread_mutex_init(&stream->push_mutex, NULL) != 0 ||
+	    pthread_mutex_init(&stream->writer_mutex, NULL) != 0) {
+		warn("Failed to initialize writer mutexes");
+		return false;
+	}
+
+	return true;
+}
+
+static void *ffmpeg_mux_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct ffmpeg_muxer *stream = bzalloc(sizeof(*stream));
+	stream->output = output;
+
+	if (!init_mutexes(stream)) {
 		ffmpeg_mux_destroy(stream);
 		return NULL;
 	}
 
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+	proc_handler_add(ph,
+			 "void get_mux_stats(out int queued_packets, "
+			 "out int queued_bytes, out int peak_queued_bytes, "
+			 "out int bytes_written, out float write_rate)",
+			 get_mux_stats_proc, stream);
+
 	UNUSED_PARAMETER(settings);
 	return stream;
 }
@@ -215,12 +262,32 @@ static void log_muxer_params(struct ffmpeg_muxer *stream, const char *settings)
 	av_dict_free(&dict);
 }
 
+/* the fragmented options go first so that the muxer settings of the user
+ * override them */
+static void get_muxer_settings(struct ffmpeg_muxer *stream,
+			       obs_data_t *settings, struct dstr *mux)
+{
+	AVOutputFormat *format = av_guess_format(NULL, stream->path.array, NULL);
+
+	dstr_free(mux);
+
+	if (obs_data_get_bool(settings, "fragmented_mp4") &&
+	    format_is_mp4(format)) {
+		int duration = (int)obs_data_get_int(settings,
+						     "fragment_duration_ms");
+		dstr_printf(mux, "movflags=%s min_frag_duration=%lld ",
+			    FRAGMENTED_MP4_FLAGS, (long long)duration * 1000);
+	}
+
+	dstr_cat(mux, obs_data_get_string(settings, "muxer_settings"));
+}
+
 static void add_muxer_params(struct dstr *cmd, struct ffmpeg_muxer *stream)
 {
 	obs_data_t *settings = obs_output_get_settings(stream->output);
 	struct dstr mux = {0};
 
-	dstr_copy(&mux, obs_data_get_string(settings, "muxer_settings"));
+	get_muxer_settings(stream, settings, &mux);
 
 	log_muxer_params(stream, mux.array);
 
@@ -281,6 +348,91 @@ static inline void start_pipe(struct ffmpeg_muxer *stream, const char *path)
 	dstr_free(&cmd);
 }
 
+static void get_writer_audio_params(struct mux_writer_audio *audio,
+				    obs_encoder_t *aencoder)
+{
+	obs_data_t *settings = obs_encoder_get_settings(aencoder);
+
+	audio->name = obs_encoder_get_name(aencoder);
+	audio->bitrate = (int)obs_data_get_int(settings, "bitrate");
+	audio->sample_rate = (int)obs_encoder_get_sample_rate(aencoder);
+	audio->channels = (int)audio_output_get_channels(obs_get_audio());
+	obs_encoder_get_extra_data(aencoder, &audio->header,
+				   &audio->header_size);
+
+	obs_data_release(settings);
+}
+
+/* the in-process counterpart of start_pipe, needs the encoder headers so it
+ * is started with the first packet */
+static bool start_writer(struct ffmpeg_muxer *stream)
+{
+	obs_data_t *settings = obs_output_get_settings(stream->output);
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
+	struct mux_writer_params params = {0};
+	struct mux_writer *writer;
+	struct dstr mux = {0};
+
+	get_muxer_settings(stream, settings, &mux);
+
+	params.path = stream->path.array;
+	params.muxer_settings = mux.array ? mux.array : "";
+	params.max_queue_size =
+		(size_t)obs_data_get_int(settings, "mux_queue_mb") * 1024 *
+		1024;
+	params.direct_io = obs_data_get_bool(settings, "mux_direct_io");
+
+	if (vencoder) {
+		obs_data_t *vsettings = obs_encoder_get_settings(vencoder);
+		video_t *video = obs_get_video();
+		const struct video_output_info *info =
+			video_output_get_info(video);
+
+		params.has_video = true;
+		params.vcodec = obs_encoder_get_codec(vencoder);
+		params.vbitrate = (int)obs_data_get_int(vsettings, "bitrate");
+		params.width = (int)obs_output_get_width(stream->output);
+		params.height = (int)obs_output_get_height(stream->output);
+		params.fps_num = (int)info->fps_num;
+		params.fps_den = (int)info->fps_den;
+		obs_encoder_get_extra_data(vencoder, &params.video_header,
+					   &params.video_header_size);
+
+		obs_data_release(vsettings);
+	}
+
+	params.acodec = "aac";
+
+	for (; params.tracks < MAX_AUDIO_MIXES; params.tracks++) {
+		obs_encoder_t *aencoder = obs_output_get_audio_encoder(
+			stream->output, params.tracks);
+		if (!aencoder)
+			break;
+
+		get_writer_audio_params(&params.audio[params.tracks],
+					aencoder);
+	}
+
+	log_muxer_params(stream, params.muxer_settings);
+
+	writer = mux_writer_create(&params);
+	obs_data_release(settings);
+	dstr_free(&mux);
+
+	pthread_mutex_lock(&stream->push_mutex);
+	pthread_mutex_lock(&stream->writer_mutex);
+	stream->writer = writer;
+	pthread_mutex_unlock(&stream->writer_mutex);
+	pthread_mutex_unlock(&stream->push_mutex);
+
+	if (!writer) {
+		warn("Failed to create muxer");
+		return false;
+	}
+
+	return true;
+}
+
 static bool ffmpeg_mux_start(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
@@ -322,10 +474,15 @@ static bool ffmpeg_mux_start(void *data)
 	fclose(test_file);
 	os_unlink(path);
 
-	start_pipe(stream, path);
+	stream->use_process = obs_data_get_bool(settings, "use_mux_process");
+	if (stream->use_process) {
+		start_pipe(stream, path);
+	} else {
+		dstr_copy(&stream->path, path);
+	}
 	obs_data_release(settings);
 
-	if (!stream->pipe) {
+	if (stream->use_process && !stream->pipe) {
 		obs_output_set_last_error(
 			stream->output, obs_module_text("HelperProcessFailed"));
 		warn("Failed to create process pipe");
@@ -343,22 +500,60 @@ static bool ffmpeg_mux_start(void *data)
 	return true;
 }
 
+/* a force stop runs on another thread than the encoder, which may be inside
+ * a push or waiting in it for space.  The push is made to fail and the writer
+ * is only taken once the encoder thread has left it. */
+static struct mux_writer *take_writer(struct ffmpeg_muxer *stream)
+{
+	struct mux_writer *writer;
+
+	pthread_mutex_lock(&stream->writer_mutex);
+	writer = stream->writer;
+	if (writer)
+		mux_writer_close(writer);
+	pthread_mutex_unlock(&stream->writer_mutex);
+
+	pthread_mutex_lock(&stream->push_mutex);
+	pthread_mutex_lock(&stream->writer_mutex);
+	stream->writer = NULL;
+	pthread_mutex_unlock(&stream->writer_mutex);
+	pthread_mutex_unlock(&stream->push_mutex);
+
+	return writer;
+}
+
 static int deactivate(struct ffmpeg_muxer *stream, int code)
 {
+	struct mux_writer *writer = NULL;
+	bool was_active;
+	int ret = -1;
+
 	//PRISM/LiuHaibin/20200703/#3195/for force stop
 	pthread_mutex_lock(&stream->deactive_mutex);
 
-	int ret = -1;
-
-	if (active(stream)) {
-		ret = os_process_pipe_destroy(stream->pipe);
-		stream->pipe = NULL;
+	was_active = active(stream);
+	if (was_active) {
+		if (stream->use_process) {
+			ret = os_process_pipe_destroy(stream->pipe);
+			stream->pipe = NULL;
+		} else {
+			writer = take_writer(stream);
+			ret = FFM_SUCCESS;
+		}
 
 		os_atomic_set_bool(&stream->active, false);
 		os_atomic_set_bool(&stream->sent_headers, false);
+	}
 
+	//PRISM/LiuHaibin/20200703/#3195/for force stop
+	pthread_mutex_unlock(&stream->deactive_mutex);
+
+	/* flushes up to the whole queue to the disk, so it's done without the
+	 * lock */
+	if (writer)
+		ret = mux_writer_destroy(writer);
+	if (was_active)
 		info("Output of file '%s' stopped", stream->path.array);
-	}
 
 	if (code) {
 		obs_output_signal_stop(stream->output, code);
@@ -368,9 +563,6 @@ static int deactivate(struct ffmpeg_muxer *stream, int code)
 
 	os_atomic_set_bool(&stream->stopping, false);
 
-	//PRISM/LiuHaibin/20200703/#3195/for force stop
-	pthread_mutex_unlock(&stream->deactive_mutex);
-
 	return ret;
 }
 
@@ -393,13 +585,23 @@ static void signal_failure(struct ffmpeg_muxer *stream)
 
 	size_t len;
 
-	len = os_process_pipe_read_err(stream->pipe, (uint8_t *)error,
-				       sizeof(error) - 1);
+	if (!stream->use_process) {
+		pthread_mutex_lock(&stream->writer_mutex);
+		const char *writer_error =
+			stream->writer ? mux_writer_get_error(stream->writer)
+				       : NULL;
+		if (writer_error)
+			obs_output_set_last_error(stream->output, writer_error);
+		pthread_mutex_unlock(&stream->writer_mutex);
+	} else {
+		len = os_process_pipe_read_err(stream->pipe, (uint8_t *)error,
+					       sizeof(error) - 1);
 
-	if (len > 0) {
-		error[len] = 0;
-		warn("ffmpeg-mux: %s", error);
-		obs_output_set_last_error(stream->output, error);
+		if (len > 0) {
+			error[len] = 0;
+			warn("ffmpeg-mux: %s", error);
+			obs_output_set_last_error(stream->output, error);
+		}
 	}
 
 	ret = deactivate(stream, 0);
@@ -422,6 +624,28 @@ static bool write_packet(struct ffmpeg_muxer *stream,
 	bool is_video = packet->type == OBS_ENCODER_VIDEO;
 	size_t ret;
 
+	if (!stream->use_process) {
+		bool success;
+
+		pthread_mutex_lock(&stream->push_mutex);
+		success = stream->writer &&
+			  mux_writer_push(stream->writer, packet);
+		pthread_mutex_unlock(&stream->push_mutex);
+
+		/* closed by a force stop, not a failure */
+		if (!success && !active(stream))
+			return false;
+
+		if (!success) {
+			warn("Muxer failed, stopping output");
+			signal_failure(stream);
+			return false;
+		}
+
+		stream->total_bytes += packet->size;
+		return true;
+	}
+
 	struct ffm_packet_info info = {.pts = packet->pts,
 				       .dts = packet->dts,
 				       .size = (uint32_t)packet->size,
@@ -475,6 +699,9 @@ static bool send_headers(struct ffmpeg_muxer *stream)
 	obs_encoder_t *aencoder;
 	size_t idx = 0;
 
+	if (!stream->use_process)
+		return start_writer(stream);
+
 	if (!send_video_headers(stream))
 		return false;
 
@@ -507,8 +734,11 @@ static void ffmpeg_mux_data(void *data, struct encoder_packet *packet)
 	}
 
 	if (!stream->sent_headers) {
-		if (!send_headers(stream))
+		if (!send_headers(stream)) {
+			if (!stream->use_process)
+				signal_failure(stream);
 			return;
+		}
 
 		stream->sent_headers = true;
 	}
@@ -536,6 +766,19 @@ static obs_properties_t *ffmpeg_mux_properties(void *unused)
 	return props;
 }
 
+static void ffmpeg_mux_defaults(obs_data_t *s)
+{
+	/* the helper process isolates crashes in ffmpeg from the program,
+	 * at the cost of copying every packet through a pipe on the encoder
+	 * thread */
+	obs_data_set_default_bool(s, "use_mux_process", false);
+	obs_data_set_default_int(s, "mux_queue_mb", 64);
+	obs_data_set_default_bool(s, "mux_direct_io", false);
+	obs_data_set_default_bool(s, "fragmented_mp4", false);
+	obs_data_set_default_int(s, "fragment_duration_ms",
+				 FRAGMENT_DURATION_DEFAULT);
+}
+
 static uint64_t ffmpeg_mux_total_bytes(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
@@ -567,6 +810,7 @@ struct obs_output_info ffmpeg_muxer = {
 	.encoded_packet = ffmpeg_mux_data,
 	.get_total_bytes = ffmpeg_mux_total_bytes,
 	.get_properties = ffmpeg_mux_properties,
+	.get_defaults = ffmpeg_mux_defaults,
 	//PRISM/Liu.Haibin/20200410/#2321/for device rebuild
 	.force_stop = ffmpeg_mux_force_stop,
 };
@@ -622,6 +866,14 @@ static void *replay_buffer_create(obs_data_t *settings, obs_output_t *output)
 	struct ffmpeg_muxer *stream = bzalloc(sizeof(*stream));
 	stream->output = output;
 
+	if (!init_mutexes(stream)) {
+		ffmpeg_mux_destroy(stream);
+		return NULL;
+	}
+
+	if (!replay_store_init(&stream->store))
+		warn("Failed to initialize replay store");
+
 	stream->hotkey =
 		obs_hotkey_register_output(output, "ReplayBuffer.Save",
 					   obs_module_text("ReplayBuffer.Save"),
@@ -655,6 +907,19 @@ static bool replay_buffer_start(void *data)
 	obs_data_t *s = obs_output_get_settings(stream->output);
 	stream->max_time = obs_data_get_int(s, "max_time_sec") * 1000000LL;
 	stream->max_size = obs_data_get_int(s, "max_size_mb") * (1024 * 1024);
+
+	/* long windows of high bitrate video go to disk past this */
+	int64_t max_memory = obs_data_get_int(s, "max_memory_mb") * 1024 * 1024;
+	int64_t segment_size = REPLAY_SEGMENT_SIZE;
+	if (stream->max_size && stream->max_size / 8 < segment_size)
+		segment_size = stream->max_size / 8;
+
+	const char *spill_dir = obs_data_get_string(s, "spill_directory");
+	if (!spill_dir || !*spill_dir)
+		spill_dir = obs_data_get_string(s, "directory");
+
+	replay_store_reset(&stream->store, spill_dir, max_memory, segment_size);
+	stream->use_process = obs_data_get_bool(s, "use_mux_process");
 	obs_data_release(s);
 
 	os_atomic_set_bool(&stream->active, true);
@@ -666,78 +931,15 @@ static bool replay_buffer_start(void *data)
 	return true;
 }
 
-static bool purge_front(struct ffmpeg_muxer *stream)
-{
-	struct encoder_packet pkt;
-	bool keyframe;
-
-	circlebuf_pop_front(&stream->packets, &pkt, sizeof(pkt));
-
-	keyframe = pkt.type == OBS_ENCODER_VIDEO && pkt.keyframe;
-
-	if (keyframe)
-		stream->keyframes--;
-
-	if (!stream->packets.size) {
-		stream->cur_size = 0;
-		stream->cur_time = 0;
-	} else {
-		struct encoder_packet first;
-		circlebuf_peek_front(&stream->packets, &first, sizeof(first));
-		stream->cur_time = first.dts_usec;
-		stream->cur_size -= (int64_t)pkt.size;
-	}
-
-	obs_encoder_packet_release(&pkt);
-	return keyframe;
-}
-
-static inline void purge(struct ffmpeg_muxer *stream)
-{
-	if (purge_front(stream)) {
-		struct encoder_packet pkt;
-
-		for (;;) {
-			circlebuf_peek_front(&stream->packets, &pkt,
-					     sizeof(pkt));
-			if (pkt.type == OBS_ENCODER_VIDEO && pkt.keyframe)
-				return;
-
-			purge_front(stream);
-		}
-	}
-}
-
-static inline void replay_buffer_purge(struct ffmpeg_muxer *stream,
-				       struct encoder_packet *pkt)
-{
-	if (stream->max_size) {
-		if (!stream->packets.size || stream->keyframes <= 2)
-			return;
-
-		while ((stream->cur_size + (int64_t)pkt->size) >
-		       stream->max_size)
-			purge(stream);
-	}
-
-	if (!stream->packets.size || stream->keyframes <= 2)
-		return;
-
-	while ((pkt->dts_usec - stream->cur_time) > stream->max_time)
-		purge(stream);
-}
-
-static void insert_packet(struct darray *array, struct encoder_packet *packet,
+static void insert_packet(struct darray *array, struct replay_entry *entry,
 			  int64_t video_offset, int64_t *audio_offsets,
 			  int64_t video_dts_offset, int64_t *audio_dts_offsets)
 {
-	struct encoder_packet pkt;
-	DARRAY(struct encoder_packet) packets;
-	packets.da = *array;
+	struct encoder_packet pkt = entry->pkt;
+	DARRAY(struct replay_entry) entries;
+	entries.da = *array;
 	size_t idx;
 
-	obs_encoder_packet_ref(&pkt, packet);
-
 	if (pkt.type == OBS_ENCODER_VIDEO) {
 		pkt.dts_usec -= video_offset;
 		pkt.dts -= video_dts_offset;
@@ -748,14 +950,57 @@ static void insert_packet(struct darray *array, struct encoder_packet *packet,
 		pkt.pts -= audio_dts_offsets[pkt.track_idx];
 	}
 
-	for (idx = packets.num; idx > 0; idx--) {
-		struct encoder_packet *p = packets.array + (idx - 1);
-		if (p->dts_usec < pkt.dts_usec)
+	for (idx = entries.num; idx > 0; idx--) {
+		struct replay_entry *e = entries.array + (idx - 1);
+		if (e->pkt.dts_usec < pkt.dts_usec)
 			break;
 	}
 
-	da_insert(packets, idx, &pkt);
-	*array = packets.da;
+	entry->pkt = pkt;
+	da_insert(entries, idx, entry);
+	*array = entries.da;
+}
+
+/* orders the packets of the snapshot by time, relative to the first packet
+ * of each track */
+static void reorder_packets(struct replay_snapshot *snap)
+{
+	DARRAY(struct replay_entry) entries;
+
+	bool found_video = false;
+	bool found_audio[MAX_AUDIO_MIXES] = {0};
+	int64_t video_offset = 0;
+	int64_t video_dts_offset = 0;
+	int64_t audio_offsets[MAX_AUDIO_MIXES] = {0};
+	int64_t audio_dts_offsets[MAX_AUDIO_MIXES] = {0};
+
+	da_init(entries);
+	da_reserve(entries, snap->entries.num);
+
+	for (size_t i = 0; i < snap->entries.num; i++) {
+		struct replay_entry *entry = snap->entries.array + i;
+		struct encoder_packet *pkt = &entry->pkt;
+
+		if (pkt->type == OBS_ENCODER_VIDEO) {
+			if (!found_video) {
+				video_offset = pkt->dts_usec;
+				video_dts_offset = pkt->dts;
+				found_video = true;
+			}
+		} else {
+			if (!found_audio[pkt->track_idx]) {
+				found_audio[pkt->track_idx] = true;
+				audio_offsets[pkt->track_idx] = pkt->dts_usec;
+				audio_dts_offsets[pkt->track_idx] = pkt->dts;
+			}
+		}
+
+		insert_packet(&entries.da, entry, video_offset, audio_offsets,
+			      video_dts_offset, audio_dts_offsets);
+	}
+
+	da_free(snap->entries);
+	da_move(snap->entries, entries);
 }
 
 /* -------------------------------------------------------------------------- */
@@ -789,16 +1034,33 @@ static inline void set_error_message(struct obs_output *output,
 //End
 /* -------------------------------------------------------------------------- */
 
+static bool push_replay_packet(struct ffmpeg_muxer *stream,
+			       struct replay_entry *entry)
+{
+	bool success;
+
+	pthread_mutex_lock(&stream->push_mutex);
+	success = stream->writer &&
+		  (entry->segment
+			   ? mux_writer_push_copy(stream->writer, &entry->pkt)
+			   : mux_writer_push(stream->writer, &entry->pkt));
+	pthread_mutex_unlock(&stream->push_mutex);
+
+	return success;
+}
+
 static void *replay_buffer_mux_thread(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
+	struct mux_writer *writer;
 
 	//PRISM/LiuHaibin/20200226/#none/for replay buffer message
 	int error_code = OBS_OUTPUT_SUCCESS;
 
-	start_pipe(stream, stream->path.array);
+	if (stream->use_process)
+		start_pipe(stream, stream->path.array);
 
-	if (!stream->pipe) {
+	if (stream->use_process && !stream->pipe) {
 		warn("Failed to create process pipe");
 
 		//PRISM/LiuHaibin/20200226/#none/for replay buffer message
@@ -820,17 +1082,51 @@ static void *replay_buffer_mux_thread(void *data)
 		goto error;
 	}
 
-	for (size_t i = 0; i < stream->mux_packets.num; i++) {
-		struct encoder_packet *pkt = &stream->mux_packets.array[i];
-		write_packet(stream, pkt);
-		obs_encoder_packet_release(pkt);
+	struct replay_snapshot *snap = &stream->mux_snapshot;
+	reorder_packets(snap);
+
+	for (size_t i = 0; i < snap->entries.num; i++) {
+		struct replay_entry *entry = &snap->entries.array[i];
+
+		if (!replay_snapshot_read(&stream->store, snap, entry)) {
+			set_error_message(stream->output,
+					  "[replay buffer] Could not read "
+					  "buffered packets");
+			error_code = OBS_OUTPUT_ERROR;
+			goto error;
+		}
+
+		if (stream->use_process) {
+			write_packet(stream, &entry->pkt);
+		} else if (!push_replay_packet(stream, entry)) {
+			set_error_message(stream->output,
+					  "[replay buffer] Could not write "
+					  "packets");
+			error_code = OBS_OUTPUT_ERROR;
+			goto error;
+		}
+
+		if (entry->segment)
+			entry->pkt.data = NULL;
+		else
+			obs_encoder_packet_release(&entry->pkt);
 	}
 
 	info("Wrote replay buffer to '%s'", stream->path.array);
 error:
+	writer = take_writer(stream);
+	if (writer) {
+		if (mux_writer_destroy(writer) != FFM_SUCCESS &&
+		    error_code == OBS_OUTPUT_SUCCESS) {
+			set_error_message(stream->output,
+					  "[replay buffer] Could not write "
+					  "file");
+			error_code = OBS_OUTPUT_ERROR;
+		}
+	}
 	os_process_pipe_destroy(stream->pipe);
 	stream->pipe = NULL;
-	da_free(stream->mux_packets);
+	replay_snapshot_free(&stream->store, &stream->mux_snapshot);
 	os_atomic_set_bool(&stream->muxing, false);
 
 	//PRISM/LiuHaibin/20200226/#none/for replay buffer message
@@ -840,43 +1136,9 @@ error:
 
 static void replay_buffer_save(struct ffmpeg_muxer *stream)
 {
-	const size_t size = sizeof(struct encoder_packet);
-	size_t num_packets = stream->packets.size / size;
-
-	da_reserve(stream->mux_packets, num_packets);
-
-	/* ---------------------------- */
-	/* reorder packets */
-
-	bool found_video = false;
-	bool found_audio[MAX_AUDIO_MIXES] = {0};
-	int64_t video_offset = 0;
-	int64_t video_dts_offset = 0;
-	int64_t audio_offsets[MAX_AUDIO_MIXES] = {0};
-	int64_t audio_dts_offsets[MAX_AUDIO_MIXES] = {0};
-
-	for (size_t i = 0; i < num_packets; i++) {
-		struct encoder_packet *pkt;
-		pkt = circlebuf_data(&stream->packets, i * size);
-
-		if (pkt->type == OBS_ENCODER_VIDEO) {
-			if (!found_video) {
-				video_offset = pkt->dts_usec;
-				video_dts_offset = pkt->dts;
-				found_video = true;
-			}
-		} else {
-			if (!found_audio[pkt->track_idx]) {
-				found_audio[pkt->track_idx] = true;
-				audio_offsets[pkt->track_idx] = pkt->dts_usec;
-				audio_dts_offsets[pkt->track_idx] = pkt->dts;
-			}
-		}
-
-		insert_packet(&stream->mux_packets.da, pkt, video_offset,
-			      audio_offsets, video_dts_offset,
-			      audio_dts_offsets);
-	}
+	/* only references the packets, reading back and reordering them is
+	 * left to the mux thread */
+	replay_store_snapshot(&stream->store, &stream->mux_snapshot);
 
 	/* ---------------------------- */
 	/* generate filename */
@@ -904,6 +1166,11 @@ static void replay_buffer_save(struct ffmpeg_muxer *stream)
 	stream->mux_thread_joinable = pthread_create(&stream->mux_thread, NULL,
 						     replay_buffer_mux_thread,
 						     stream) == 0;
+	if (!stream->mux_thread_joinable) {
+		warn("Failed to create replay buffer mux thread");
+		replay_snapshot_free(&stream->store, &stream->mux_snapshot);
+		os_atomic_set_bool(&stream->muxing, false);
+	}
 }
 
 static void deactivate_replay_buffer(struct ffmpeg_muxer *stream, int code)
@@ -923,7 +1190,6 @@ static void deactivate_replay_buffer(struct ffmpeg_muxer *stream, int code)
 static void replay_buffer_data(void *data, struct encoder_packet *packet)
 {
 	struct ffmpeg_muxer *stream = data;
-	struct encoder_packet pkt;
 
 	if (!active(stream))
 		return;
@@ -945,17 +1211,8 @@ static void replay_buffer_data(void *data, struct encoder_packet *packet)
 		}
 	}
 
-	obs_encoder_packet_ref(&pkt, packet);
-	replay_buffer_purge(stream, &pkt);
-
-	if (!stream->packets.size)
-		stream->cur_time = pkt.dts_usec;
-	stream->cur_size += pkt.size;
-
-	circlebuf_push_back(&stream->packets, packet, sizeof(*packet));
-
-	if (packet->type == OBS_ENCODER_VIDEO && packet->keyframe)
-		stream->keyframes++;
+	replay_store_push(&stream->store, packet, stream->max_time,
+			  stream->max_size);
 
 	if (stream->save_ts && packet->sys_dts_usec >= stream->save_ts) {
 		if (os_atomic_load_bool(&stream->muxing))
@@ -975,9 +1232,11 @@ static void replay_buffer_defaults(obs_data_t *s)
 {
 	obs_data_set_default_int(s, "max_time_sec", 15);
 	obs_data_set_default_int(s, "max_size_mb", 500);
+	obs_data_set_default_int(s, "max_memory_mb", 256);
 	obs_data_set_default_string(s, "format", "%CCYY-%MM-%DD %hh-%mm-%ss");
 	obs_data_set_default_string(s, "extension", "mp4");
 	obs_data_set_default_bool(s, "allow_spaces", true);
+	ffmpeg_mux_defaults(s);
 }
 
 struct obs_output_info replay_buffer = {
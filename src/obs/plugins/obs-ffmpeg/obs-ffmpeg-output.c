@@ -30,12 +30,15 @@
 #include "obs-ffmpeg-formats.h"
 #include "closest-pixel-format.h"
 #include "obs-ffmpeg-compat.h"
+#include "fragmented-mp4.h"
 
 struct ffmpeg_cfg {
 	const char *url;
 	const char *format_name;
 	const char *format_mime_type;
 	const char *muxer_settings;
+	bool fragmented_mp4;
+	int fragment_duration_ms;
 	int gop_size;
 	int video_bitrate;
 	int audio_bitrate;
@@ -441,6 +444,10 @@ static inline bool open_output_file(struct ffmpeg_data *data)
 		return false;
 	}
 
+	if (data->config.fragmented_mp4 && format_is_mp4(format))
+		set_fragmented_mp4_options(&dict,
+					   data->config.fragment_duration_ms);
+
 	if (av_dict_count(dict) > 0) {
 		struct dstr str = {0};
 
@@ -1086,12 +1093,17 @@ static bool try_connect(struct ffmpeg_output *output)
 	settings = obs_output_get_settings(output->output);
 
 	obs_data_set_default_int(settings, "gop_size", 120);
+	obs_data_set_default_int(settings, "fragment_duration_ms",
+				 FRAGMENT_DURATION_DEFAULT);
 
 	config.url = obs_data_get_string(settings, "url");
 	config.format_name = get_string_or_null(settings, "format_name");
 	config.format_mime_type =
 		get_string_or_null(settings, "format_mime_type");
 	config.muxer_settings = obs_data_get_string(settings, "muxer_settings");
+	config.fragmented_mp4 = obs_data_get_bool(settings, "fragmented_mp4");
+	config.fragment_duration_ms =
+		(int)obs_data_get_int(settings, "fragment_duration_ms");
 	config.video_bitrate = (int)obs_data_get_int(settings, "video_bitrate");
 	config.audio_bitrate = (int)obs_data_get_int(settings, "audio_bitrate");
 	config.gop_size = (int)obs_data_get_int(settings, "gop_size");
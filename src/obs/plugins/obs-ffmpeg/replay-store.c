@@ -0,0 +1,638 @@
+#include <util/bmem.h>
+#include <util/platform.h>
+#include "replay-store.h"
+
+/* how much the spill thread writes before letting go of the write lock */
+#define MAX_SPILL_BATCH (8 * 1024 * 1024)
+#define MIN_SEGMENT_SIZE (1024 * 1024)
+
+struct replay_packet {
+	struct encoder_packet pkt;
+	uint64_t offset;
+};
+
+struct replay_segment {
+	struct replay_segment *next;
+	long refs;
+	char *path;
+
+	/* spill thread only, open while it is the current segment */
+	FILE *file;
+	uint64_t bytes;
+
+	/* committed packets, the payloads are in the file */
+	DARRAY(struct replay_packet) packets;
+	int64_t size;
+	int keyframes;
+};
+
+static inline bool is_keyframe(const struct encoder_packet *pkt)
+{
+	return pkt->type == OBS_ENCODER_VIDEO && pkt->keyframe;
+}
+
+/* ------------------------------------------------------------------------- */
+/* segments, called with the store locked */
+
+static void free_segment(struct replay_store *store, struct replay_segment *seg)
+{
+	if (seg->file)
+		fclose(seg->file);
+
+	/* keep the file around for the next segment while the buffer runs */
+	if (store->dir.len) {
+		da_push_back(store->free_files, &seg->path);
+	} else {
+		os_unlink(seg->path);
+		bfree(seg->path);
+	}
+
+	da_free(seg->packets);
+	bfree(seg);
+}
+
+static inline void release_segment(struct replay_store *store,
+				   struct replay_segment *seg)
+{
+	if (--seg->refs == 0)
+		free_segment(store, seg);
+}
+
+static void drop_first_segment(struct replay_store *store)
+{
+	struct replay_segment *seg = store->first_segment;
+
+	store->first_segment = seg->next;
+	if (store->last_segment == seg)
+		store->last_segment = NULL;
+	if (store->cur_segment == seg)
+		store->cur_segment = NULL;
+
+	store->total_size -= seg->size;
+	store->keyframes -= seg->keyframes;
+	release_segment(store, seg);
+}
+
+static void delete_free_files(struct replay_store *store)
+{
+	for (size_t i = 0; i < store->free_files.num; i++) {
+		os_unlink(store->free_files.array[i]);
+		bfree(store->free_files.array[i]);
+	}
+
+	da_free(store->free_files);
+}
+
+/* ------------------------------------------------------------------------- */
+/* spill thread */
+
+static struct replay_segment *open_segment(struct replay_store *store)
+{
+	struct replay_segment *seg = bzalloc(sizeof(*seg));
+	seg->refs = 1;
+
+	pthread_mutex_lock(&store->mutex);
+
+	if (store->free_files.num) {
+		seg->path = *(char **)da_end(store->free_files);
+		da_pop_back(store->free_files);
+	} else {
+		struct dstr path = {0};
+		dstr_printf(&path, "%s/.replay-%p-%u.tmp", store->dir.array,
+			    store, store->file_counter++);
+		seg->path = path.array;
+	}
+
+	pthread_mutex_unlock(&store->mutex);
+
+	/* reused files are overwritten in place instead of being truncated
+	 * and allocated again */
+	seg->file = os_fopen(seg->path, "r+b");
+	if (!seg->file)
+		seg->file = os_fopen(seg->path, "wb");
+
+	if (!seg->file) {
+		blog(LOG_WARNING, "replay buffer: Failed to open '%s'",
+		     seg->path);
+		os_unlink(seg->path);
+		bfree(seg->path);
+		bfree(seg);
+		return NULL;
+	}
+
+	return seg;
+}
+
+static void commit_packet(struct replay_segment *seg,
+			  const struct encoder_packet *pkt, uint64_t offset)
+{
+	struct replay_packet *rp = da_push_back_new(seg->packets);
+
+	rp->pkt = *pkt;
+	rp->pkt.data = NULL;
+	rp->offset = offset;
+
+	seg->size += (int64_t)pkt->size;
+	if (is_keyframe(pkt))
+		seg->keyframes++;
+}
+
+static inline void link_segment(struct replay_store *store,
+				struct replay_segment *seg)
+{
+	if (store->last_segment)
+		store->last_segment->next = seg;
+	else
+		store->first_segment = seg;
+
+	store->last_segment = seg;
+	store->cur_segment = seg;
+}
+
+/* returns true if there is more to write */
+static bool spill(struct replay_store *store)
+{
+	struct replay_segment *cur;
+	struct replay_segment *next = NULL;
+	DARRAY(struct encoder_packet) done;
+	uint64_t *offsets = NULL;
+	size_t num_cur = 0;
+	size_t written = 0;
+	int64_t target;
+	int64_t batch = 0;
+	bool success = true;
+	bool more;
+
+	da_init(done);
+
+	pthread_mutex_lock(&store->mutex);
+
+	if (!store->dir.len || store->spill_failed) {
+		pthread_mutex_unlock(&store->mutex);
+		return false;
+	}
+
+	target = store->mem_limit * 3 / 4;
+
+	while (store->packets.size && store->mem_size > target &&
+	       batch < MAX_SPILL_BATCH) {
+		struct encoder_packet *pkt = da_push_back_new(store->spilling);
+
+		circlebuf_pop_front(&store->packets, pkt, sizeof(*pkt));
+		store->mem_size -= (int64_t)pkt->size;
+		batch += (int64_t)pkt->size;
+	}
+
+	more = store->packets.size && store->mem_size > target;
+	cur = store->cur_segment;
+
+	pthread_mutex_unlock(&store->mutex);
+
+	if (!store->spilling.num)
+		return false;
+
+	offsets = bmalloc(store->spilling.num * sizeof(uint64_t));
+
+	/* the packets are written without holding the store lock, the new
+	 * segment is only linked in when they are committed so that the
+	 * current one can't be purged while it's written to */
+	for (; written < store->spilling.num; written++) {
+		struct encoder_packet *pkt = store->spilling.array + written;
+		struct replay_segment *seg = next ? next : cur;
+
+		if (!seg || (is_keyframe(pkt) &&
+			     (int64_t)seg->bytes >= store->segment_size)) {
+			if (next)
+				break;
+
+			next = open_segment(store);
+			if (!next) {
+				success = false;
+				break;
+			}
+
+			seg = next;
+		}
+
+		if (fwrite(pkt->data, 1, pkt->size, seg->file) != pkt->size) {
+			blog(LOG_WARNING, "replay buffer: Failed to write to "
+					  "'%s'",
+			     seg->path);
+			success = false;
+			break;
+		}
+
+		offsets[written] = seg->bytes;
+		seg->bytes += pkt->size;
+
+		if (!next)
+			num_cur++;
+	}
+
+	/* once the next segment is linked, the current one is finished */
+	if (cur) {
+		fflush(cur->file);
+		if (next && written > num_cur) {
+			fclose(cur->file);
+			cur->file = NULL;
+		}
+	}
+	if (next)
+		fflush(next->file);
+
+	pthread_mutex_lock(&store->mutex);
+
+	for (size_t i = 0; i < num_cur; i++)
+		commit_packet(cur, store->spilling.array + i, offsets[i]);
+
+	if (next && written > num_cur) {
+		link_segment(store, next);
+		for (size_t i = num_cur; i < written; i++)
+			commit_packet(next, store->spilling.array + i,
+				      offsets[i]);
+	} else if (next) {
+		free_segment(store, next);
+	}
+
+	/* whatever couldn't be written goes back to the memory tier */
+	for (size_t i = store->spilling.num; i > written; i--) {
+		struct encoder_packet *pkt = store->spilling.array + (i - 1);
+
+		circlebuf_push_front(&store->packets, pkt, sizeof(*pkt));
+		store->mem_size += (int64_t)pkt->size;
+	}
+
+	if (!success) {
+		blog(LOG_WARNING, "replay buffer: Keeping packets in memory "
+				  "from now on");
+		store->spill_failed = true;
+	}
+
+	/* the payloads are on disk now, let go of the memory */
+	da_move(done, store->spilling);
+	done.num = written;
+
+	pthread_mutex_unlock(&store->mutex);
+
+	for (size_t i = 0; i < done.num; i++)
+		obs_encoder_packet_release(done.array + i);
+
+	da_free(done);
+	bfree(offsets);
+	return success && more;
+}
+
+static void *spill_thread(void *data)
+{
+	struct replay_store *store = data;
+
+	os_set_thread_name("replay-buffer: spill thread");
+
+	while (os_sem_wait(store->sem) == 0) {
+		if (os_atomic_load_bool(&store->stop))
+			break;
+
+		bool more;
+		do {
+			pthread_mutex_lock(&store->write_mutex);
+			more = spill(store);
+			pthread_mutex_unlock(&store->write_mutex);
+		} while (more);
+	}
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+bool replay_store_init(struct replay_store *store)
+{
+	memset(store, 0, sizeof(*store));
+
+	if (pthread_mutex_init(&store->mutex, NULL) != 0)
+		return false;
+	if (pthread_mutex_init(&store->write_mutex, NULL) != 0)
+		goto fail_write_mutex;
+	if (os_sem_init(&store->sem, 0) != 0)
+		goto fail_sem;
+
+	store->thread_created =
+		pthread_create(&store->thread, NULL, spill_thread, store) == 0;
+	if (!store->thread_created)
+		goto fail_thread;
+
+	store->initialized = true;
+	return true;
+
+fail_thread:
+	os_sem_destroy(store->sem);
+fail_sem:
+	pthread_mutex_destroy(&store->write_mutex);
+fail_write_mutex:
+	pthread_mutex_destroy(&store->mutex);
+	return false;
+}
+
+void replay_store_free(struct replay_store *store)
+{
+	if (!store->initialized)
+		return;
+
+	os_atomic_set_bool(&store->stop, true);
+	os_sem_post(store->sem);
+	pthread_join(store->thread, NULL);
+
+	replay_store_clear(store);
+
+	circlebuf_free(&store->packets);
+	da_free(store->spilling);
+	os_sem_destroy(store->sem);
+	pthread_mutex_destroy(&store->write_mutex);
+	pthread_mutex_destroy(&store->mutex);
+	store->initialized = false;
+}
+
+void replay_store_reset(struct replay_store *store, const char *dir,
+			int64_t mem_limit, int64_t segment_size)
+{
+	if (!store->initialized)
+		return;
+
+	replay_store_clear(store);
+
+	pthread_mutex_lock(&store->mutex);
+
+	store->mem_limit = mem_limit;
+	store->segment_size = segment_size < MIN_SEGMENT_SIZE
+				      ? MIN_SEGMENT_SIZE
+				      : segment_size;
+	store->spill_failed = false;
+
+	if (mem_limit && dir && *dir) {
+		dstr_copy(&store->dir, dir);
+		dstr_replace(&store->dir, "\\", "/");
+		if (dstr_end(&store->dir) == '/')
+			dstr_resize(&store->dir, store->dir.len - 1);
+	}
+
+	pthread_mutex_unlock(&store->mutex);
+}
+
+void replay_store_clear(struct replay_store *store)
+{
+	if (!store->initialized)
+		return;
+
+	pthread_mutex_lock(&store->write_mutex);
+	pthread_mutex_lock(&store->mutex);
+
+	while (store->packets.size) {
+		struct encoder_packet pkt;
+		circlebuf_pop_front(&store->packets, &pkt, sizeof(pkt));
+		obs_encoder_packet_release(&pkt);
+	}
+
+	/* with the directory cleared, segments that snapshots still use
+	 * delete their files once they are released */
+	dstr_free(&store->dir);
+
+	while (store->first_segment)
+		drop_first_segment(store);
+
+	delete_free_files(store);
+
+	store->mem_size = 0;
+	store->total_size = 0;
+	store->keyframes = 0;
+
+	pthread_mutex_unlock(&store->mutex);
+	pthread_mutex_unlock(&store->write_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/* purging, called with the store locked */
+
+static int64_t oldest_dts_usec(struct replay_store *store)
+{
+	struct replay_segment *seg = store->first_segment;
+
+	if (seg && seg->packets.num)
+		return seg->packets.array[0].pkt.dts_usec;
+	if (store->spilling.num)
+		return store->spilling.array[0].dts_usec;
+	if (store->packets.size) {
+		struct encoder_packet *pkt = circlebuf_data(&store->packets, 0);
+		return pkt->dts_usec;
+	}
+
+	return 0;
+}
+
+static inline bool stored(struct replay_store *store)
+{
+	return store->packets.size || store->spilling.num ||
+	       store->first_segment;
+}
+
+static bool purge_front(struct replay_store *store)
+{
+	struct encoder_packet pkt;
+	bool keyframe;
+
+	circlebuf_pop_front(&store->packets, &pkt, sizeof(pkt));
+
+	keyframe = is_keyframe(&pkt);
+	if (keyframe)
+		store->keyframes--;
+
+	store->mem_size -= (int64_t)pkt.size;
+	store->total_size -= (int64_t)pkt.size;
+
+	obs_encoder_packet_release(&pkt);
+	return keyframe;
+}
+
+/* drops packets up to the next keyframe */
+static inline void purge_memory(struct replay_store *store)
+{
+	if (purge_front(store)) {
+		while (store->packets.size) {
+			struct encoder_packet *pkt =
+				circlebuf_data(&store->packets, 0);
+			if (is_keyframe(pkt))
+				return;
+
+			purge_front(store);
+		}
+	}
+}
+
+static inline bool over_limit(struct replay_store *store,
+			      const struct encoder_packet *pkt,
+			      int64_t max_time, int64_t max_size)
+{
+	if (max_size && store->total_size + (int64_t)pkt->size > max_size)
+		return true;
+
+	return pkt->dts_usec - oldest_dts_usec(store) > max_time;
+}
+
+static void purge(struct replay_store *store, const struct encoder_packet *pkt,
+		  int64_t max_time, int64_t max_size)
+{
+	while (stored(store) && store->keyframes > 2 &&
+	       over_limit(store, pkt, max_time, max_size)) {
+		struct replay_segment *seg = store->first_segment;
+
+		if (seg) {
+			/* segments are purged whole, the one being written
+			 * to has to be finished first */
+			if (seg == store->cur_segment ||
+			    store->keyframes - seg->keyframes < 2)
+				return;
+
+			drop_first_segment(store);
+			continue;
+		}
+
+		/* older than the memory tier, wait for them to be written */
+		if (store->spilling.num)
+			return;
+
+		purge_memory(store);
+	}
+}
+
+void replay_store_push(struct replay_store *store,
+		       struct encoder_packet *packet, int64_t max_time,
+		       int64_t max_size)
+{
+	struct encoder_packet pkt;
+	bool spill;
+
+	obs_encoder_packet_ref(&pkt, packet);
+
+	pthread_mutex_lock(&store->mutex);
+
+	purge(store, &pkt, max_time, max_size);
+
+	circlebuf_push_back(&store->packets, &pkt, sizeof(pkt));
+	store->mem_size += (int64_t)pkt.size;
+	store->total_size += (int64_t)pkt.size;
+	if (is_keyframe(&pkt))
+		store->keyframes++;
+
+	spill = store->dir.len && !store->spill_failed &&
+		store->mem_size > store->mem_limit;
+
+	pthread_mutex_unlock(&store->mutex);
+
+	if (spill)
+		os_sem_post(store->sem);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline void add_memory_entry(struct replay_snapshot *snap,
+				    struct encoder_packet *pkt)
+{
+	struct replay_entry *entry = da_push_back_new(snap->entries);
+	obs_encoder_packet_ref(&entry->pkt, pkt);
+}
+
+void replay_store_snapshot(struct replay_store *store,
+			   struct replay_snapshot *snap)
+{
+	const size_t size = sizeof(struct encoder_packet);
+
+	memset(snap, 0, sizeof(*snap));
+
+	pthread_mutex_lock(&store->mutex);
+
+	for (struct replay_segment *seg = store->first_segment; seg;
+	     seg = seg->next) {
+		seg->refs++;
+		da_push_back(snap->segments, &seg);
+
+		for (size_t i = 0; i < seg->packets.num; i++) {
+			struct replay_packet *rp = seg->packets.array + i;
+			struct replay_entry *entry =
+				da_push_back_new(snap->entries);
+
+			entry->pkt = rp->pkt;
+			entry->segment = seg;
+			entry->offset = rp->offset;
+		}
+	}
+
+	for (size_t i = 0; i < store->spilling.num; i++)
+		add_memory_entry(snap, store->spilling.array + i);
+
+	for (size_t i = 0; i < store->packets.size / size; i++)
+		add_memory_entry(snap, circlebuf_data(&store->packets, i * size));
+
+	pthread_mutex_unlock(&store->mutex);
+}
+
+bool replay_snapshot_read(struct replay_store *store,
+			  struct replay_snapshot *snap,
+			  struct replay_entry *entry)
+{
+	struct replay_segment *seg = entry->segment;
+	size_t size = entry->pkt.size;
+
+	if (!seg)
+		return true;
+
+	if (snap->read_segment != seg) {
+		if (snap->read_file)
+			fclose(snap->read_file);
+
+		snap->read_segment = seg;
+		snap->read_file = os_fopen(seg->path, "rb");
+		if (!snap->read_file) {
+			blog(LOG_WARNING, "replay buffer: Failed to open '%s'",
+			     seg->path);
+			snap->read_segment = NULL;
+			return false;
+		}
+	}
+
+	da_resize(snap->buffer, size);
+
+	if (os_fseeki64(snap->read_file, (int64_t)entry->offset, SEEK_SET) !=
+		    0 ||
+	    fread(snap->buffer.array, 1, size, snap->read_file) != size) {
+		blog(LOG_WARNING, "replay buffer: Failed to read from '%s'",
+		     seg->path);
+		return false;
+	}
+
+	entry->pkt.data = snap->buffer.array;
+
+	UNUSED_PARAMETER(store);
+	return true;
+}
+
+void replay_snapshot_free(struct replay_store *store,
+			  struct replay_snapshot *snap)
+{
+	for (size_t i = 0; i < snap->entries.num; i++) {
+		struct replay_entry *entry = snap->entries.array + i;
+		if (!entry->segment)
+			obs_encoder_packet_release(&entry->pkt);
+	}
+
+	if (snap->read_file)
+		fclose(snap->read_file);
+
+	pthread_mutex_lock(&store->mutex);
+	for (size_t i = 0; i < snap->segments.num; i++)
+		release_segment(store, snap->segments.array[i]);
+	pthread_mutex_unlock(&store->mutex);
+
+	da_free(snap->entries);
+	da_free(snap->segments);
+	da_free(snap->buffer);
+	memset(snap, 0, sizeof(*snap));
+}
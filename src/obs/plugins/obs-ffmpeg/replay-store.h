@@ -0,0 +1,92 @@
+#pragma once
+
+#include <obs-module.h>
+#include <util/circlebuf.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/threading.h>
+
+/* Packets of the replay buffer.  The most recent ones are kept in memory,
+ * once they use more than the memory limit the oldest ones are written by a
+ * background thread to segment files.  Segments start on a video keyframe
+ * and are purged as a whole, their files are kept and reused for new
+ * segments until the buffer stops. */
+
+struct replay_segment;
+
+struct replay_store {
+	bool initialized;
+	pthread_mutex_t mutex;
+
+	/* memory tier, newest packets */
+	struct circlebuf packets;
+	int64_t mem_size;
+
+	/* taken from the memory tier, being written by the spill thread */
+	DARRAY(struct encoder_packet) spilling;
+	int64_t spilling_size;
+
+	/* disk tier, oldest first */
+	struct replay_segment *first_segment;
+	struct replay_segment *last_segment;
+	struct replay_segment *cur_segment;
+	DARRAY(char *) free_files;
+
+	int64_t total_size;
+	int keyframes;
+
+	struct dstr dir;
+	int64_t mem_limit;
+	int64_t segment_size;
+	uint32_t file_counter;
+	bool spill_failed;
+
+	/* held by the spill thread while it writes */
+	pthread_mutex_t write_mutex;
+	pthread_t thread;
+	bool thread_created;
+	os_sem_t *sem;
+	volatile bool stop;
+};
+
+/* a packet of a snapshot, packets in segments are read back when muxed */
+struct replay_entry {
+	struct encoder_packet pkt;
+	struct replay_segment *segment;
+	uint64_t offset;
+};
+
+struct replay_snapshot {
+	DARRAY(struct replay_entry) entries;
+	DARRAY(struct replay_segment *) segments;
+
+	/* for reading back */
+	struct replay_segment *read_segment;
+	FILE *read_file;
+	DARRAY(uint8_t) buffer;
+};
+
+extern bool replay_store_init(struct replay_store *store);
+extern void replay_store_free(struct replay_store *store);
+
+/* mem_limit 0 keeps everything in memory */
+extern void replay_store_reset(struct replay_store *store, const char *dir,
+			       int64_t mem_limit, int64_t segment_size);
+extern void replay_store_clear(struct replay_store *store);
+
+/* purges the oldest packets beyond the limits and adds a reference to the
+ * packet, never waits for the disk */
+extern void replay_store_push(struct replay_store *store,
+			      struct encoder_packet *packet, int64_t max_time,
+			      int64_t max_size);
+
+/* references every packet currently stored, in order */
+extern void replay_store_snapshot(struct replay_store *store,
+				  struct replay_snapshot *snap);
+
+/* fills in the data of the entry, valid until the next call */
+extern bool replay_snapshot_read(struct replay_store *store,
+				 struct replay_snapshot *snap,
+				 struct replay_entry *entry);
+extern void replay_snapshot_free(struct replay_store *store,
+				 struct replay_snapshot *snap);
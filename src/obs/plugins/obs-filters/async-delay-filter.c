@@ -1,7 +1,9 @@
 #include <obs-module.h>
 #include <util/circlebuf.h>
+#include <util/threading.h>
 //PRISM/LiuHaibin/20200803/#None/https://github.com/obsproject/obs-studio/pull/2657
 #include <util/util_uint64.h>
+#include "delay-buffer.h"
 
 #ifndef SEC_TO_NSEC
 #define SEC_TO_NSEC 1000000000ULL
@@ -12,8 +14,12 @@
 #endif
 
 #define SETTING_DELAY_MS "delay_ms"
+#define SETTING_COMPRESS "compress"
+#define SETTING_MEMORY_LIMIT "memory_limit_mb"
 
 #define TEXT_DELAY_MS obs_module_text("DelayMs")
+#define TEXT_COMPRESS obs_module_text("DelayCompress")
+#define TEXT_MEMORY_LIMIT obs_module_text("DelayMemoryLimit")
 
 struct async_delay_data {
 	obs_source_t *context;
@@ -25,6 +31,15 @@ struct async_delay_data {
 	struct circlebuf audio_frames;
 	struct obs_audio_data audio_output;
 
+	/* compressed video frames, used instead of video_frames for long
+	 * delays.  only created and destroyed on the video thread, update
+	 * just requests it through compress/memory_limit and reset_video */
+	struct delay_buffer *compressed_frames;
+	struct obs_source_frame *output_frame;
+	size_t buffer_memory_limit;
+	size_t memory_limit;
+	bool compress;
+
 	uint64_t last_video_ts;
 	uint64_t last_audio_ts;
 	uint64_t interval;
@@ -51,6 +66,18 @@ static void free_video_data(struct async_delay_data *filter,
 				    sizeof(struct obs_source_frame *));
 		obs_source_release_frame(parent, frame);
 	}
+
+	if (filter->compressed_frames)
+		delay_buffer_clear(filter->compressed_frames);
+}
+
+static inline void release_output_frame(struct async_delay_data *filter)
+{
+	struct obs_source_frame *frame = filter->output_frame;
+
+	if (frame && os_atomic_dec_long(&frame->refs) == 0)
+		obs_source_frame_destroy(frame);
+	filter->output_frame = NULL;
 }
 
 static inline void free_audio_packet(struct obs_audio_data *audio)
@@ -78,9 +105,9 @@ static void async_delay_filter_update(void *data, obs_data_t *settings)
 		(uint64_t)obs_data_get_int(settings, SETTING_DELAY_MS) *
 		MSEC_TO_NSEC;
 
-	if (new_interval < filter->interval)
-		free_video_data(filter, obs_filter_get_parent(filter->context));
-
+	filter->compress = obs_data_get_bool(settings, SETTING_COMPRESS);
+	filter->memory_limit =
+		(size_t)obs_data_get_int(settings, SETTING_MEMORY_LIMIT) << 20;
 	filter->reset_audio = true;
 	filter->reset_video = true;
 	filter->interval = new_interval;
@@ -88,6 +115,29 @@ static void async_delay_filter_update(void *data, obs_data_t *settings)
 	filter->audio_delay_reached = false;
 }
 
+static void update_compressed_frames(struct async_delay_data *filter)
+{
+	size_t memory_limit = filter->memory_limit;
+	bool compress = filter->compress;
+
+	if (compress != !!filter->compressed_frames) {
+		if (compress) {
+			filter->compressed_frames = delay_buffer_create(
+				obs_source_get_name(filter->context),
+				memory_limit);
+		} else {
+			delay_buffer_log_stats(filter->compressed_frames);
+			delay_buffer_destroy(filter->compressed_frames);
+			filter->compressed_frames = NULL;
+		}
+	} else if (compress && memory_limit != filter->buffer_memory_limit) {
+		delay_buffer_set_memory_limit(filter->compressed_frames,
+					      memory_limit);
+	}
+
+	filter->buffer_memory_limit = memory_limit;
+}
+
 static void *async_delay_filter_create(obs_data_t *settings,
 				       obs_source_t *context)
 {
@@ -107,12 +157,28 @@ static void async_delay_filter_destroy(void *data)
 {
 	struct async_delay_data *filter = data;
 
+	if (filter->compressed_frames) {
+		delay_buffer_log_stats(filter->compressed_frames);
+		delay_buffer_destroy(filter->compressed_frames);
+	}
+
+	release_output_frame(filter);
 	free_audio_packet(&filter->audio_output);
 	circlebuf_free(&filter->video_frames);
 	circlebuf_free(&filter->audio_frames);
 	bfree(data);
 }
 
+static bool compress_modified(obs_properties_t *props, obs_property_t *p,
+			      obs_data_t *settings)
+{
+	bool compress = obs_data_get_bool(settings, SETTING_COMPRESS);
+
+	p = obs_properties_get(props, SETTING_MEMORY_LIMIT);
+	obs_property_set_visible(p, compress);
+	return true;
+}
+
 static obs_properties_t *async_delay_filter_properties(void *data)
 {
 	obs_properties_t *props = obs_properties_create();
@@ -121,10 +187,23 @@ static obs_properties_t *async_delay_filter_properties(void *data)
 						   TEXT_DELAY_MS, 0, 20000, 1);
 	obs_property_int_set_suffix(p, " ms");
 
+	p = obs_properties_add_bool(props, SETTING_COMPRESS, TEXT_COMPRESS);
+	obs_property_set_modified_callback(p, compress_modified);
+
+	p = obs_properties_add_int(props, SETTING_MEMORY_LIMIT,
+				   TEXT_MEMORY_LIMIT, 64, 65536, 64);
+	obs_property_int_set_suffix(p, " MB");
+
 	UNUSED_PARAMETER(data);
 	return props;
 }
 
+static void async_delay_filter_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_bool(settings, SETTING_COMPRESS, false);
+	obs_data_set_default_int(settings, SETTING_MEMORY_LIMIT, 2048);
+}
+
 static void async_delay_filter_remove(void *data, obs_source_t *parent)
 {
 	struct async_delay_data *filter = data;
@@ -142,6 +221,162 @@ static inline bool is_timestamp_jump(uint64_t ts, uint64_t prev_ts)
 	return ts < prev_ts || (ts - prev_ts) > SEC_TO_NSEC;
 }
 
+static size_t get_frame_planes(const struct obs_source_frame *frame,
+			       struct delay_plane *planes)
+{
+	uint32_t heights[MAX_AV_PLANES] = {0};
+	uint32_t pixel_sizes[MAX_AV_PLANES] = {1, 1, 1, 1};
+	uint32_t height = frame->height;
+	size_t num_planes = 0;
+
+	switch (frame->format) {
+	case VIDEO_FORMAT_I420:
+		heights[0] = height;
+		heights[1] = heights[2] = height / 2;
+		num_planes = 3;
+		break;
+
+	case VIDEO_FORMAT_NV12:
+		heights[0] = height;
+		heights[1] = height / 2;
+		pixel_sizes[1] = 2;
+		num_planes = 2;
+		break;
+
+	case VIDEO_FORMAT_I444:
+	case VIDEO_FORMAT_I422:
+		heights[0] = heights[1] = heights[2] = height;
+		num_planes = 3;
+		break;
+
+	case VIDEO_FORMAT_YVYU:
+	case VIDEO_FORMAT_YUY2:
+	case VIDEO_FORMAT_UYVY:
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+	case VIDEO_FORMAT_AYUV:
+		heights[0] = height;
+		pixel_sizes[0] = 4;
+		num_planes = 1;
+		break;
+
+	case VIDEO_FORMAT_BGR3:
+		heights[0] = height;
+		pixel_sizes[0] = 3;
+		num_planes = 1;
+		break;
+
+	case VIDEO_FORMAT_Y800:
+		heights[0] = height;
+		num_planes = 1;
+		break;
+
+	case VIDEO_FORMAT_I40A:
+		heights[0] = heights[3] = height;
+		heights[1] = heights[2] = height / 2;
+		num_planes = 4;
+		break;
+
+	case VIDEO_FORMAT_I42A:
+	case VIDEO_FORMAT_YUVA:
+		heights[0] = heights[1] = heights[2] = heights[3] = height;
+		num_planes = 4;
+		break;
+
+	case VIDEO_FORMAT_NONE:
+		break;
+	}
+
+	for (size_t i = 0; i < num_planes; i++) {
+		planes[i].data = frame->data[i];
+		planes[i].linesize = frame->linesize[i];
+		planes[i].rows = heights[i];
+		planes[i].pixel_size = pixel_sizes[i];
+	}
+
+	return num_planes;
+}
+
+static struct obs_source_frame *
+get_output_frame(struct async_delay_data *filter,
+		 const struct obs_source_frame *info)
+{
+	struct obs_source_frame *frame = filter->output_frame;
+
+	/* reuse the previous output frame once libobs has released it */
+	if (frame && (os_atomic_load_long(&frame->refs) != 1 ||
+		      frame->format != info->format ||
+		      frame->width != info->width ||
+		      frame->height != info->height)) {
+		release_output_frame(filter);
+		frame = NULL;
+	}
+
+	if (!frame) {
+		frame = obs_source_frame_create(info->format, info->width,
+						info->height);
+		frame->refs = 1;
+		filter->output_frame = frame;
+	}
+
+	os_atomic_inc_long(&frame->refs);
+	return frame;
+}
+
+static struct obs_source_frame *
+pop_compressed_frame(struct async_delay_data *filter,
+		     struct obs_source_frame *info)
+{
+	struct obs_source_frame *output = get_output_frame(filter, info);
+	struct delay_plane planes[MAX_AV_PLANES];
+	size_t num_planes = get_frame_planes(output, planes);
+	uint8_t *data[MAX_AV_PLANES];
+	uint32_t linesize[MAX_AV_PLANES];
+
+	if (!delay_buffer_pop(filter->compressed_frames, NULL, planes,
+			      num_planes, NULL, 0)) {
+		os_atomic_dec_long(&output->refs);
+		return NULL;
+	}
+
+	/* frame properties come from the original frame, plane pointers and
+	 * the reference count stay those of the output frame */
+	memcpy(data, output->data, sizeof(data));
+	memcpy(linesize, output->linesize, sizeof(linesize));
+	info->refs = output->refs;
+	info->prev_frame = false;
+	*output = *info;
+	memcpy(output->data, data, sizeof(data));
+	memcpy(output->linesize, linesize, sizeof(linesize));
+
+	return output;
+}
+
+static struct obs_source_frame *
+async_delay_filter_video_compressed(struct async_delay_data *filter,
+				    obs_source_t *parent,
+				    struct obs_source_frame *frame)
+{
+	struct delay_buffer *buffer = filter->compressed_frames;
+	struct delay_plane planes[MAX_AV_PLANES];
+	size_t num_planes = get_frame_planes(frame, planes);
+	struct obs_source_frame info;
+
+	delay_buffer_push(buffer, frame->timestamp, planes, num_planes, frame,
+			  sizeof(*frame));
+	obs_source_release_frame(parent, frame);
+
+	if (!delay_buffer_peek(buffer, NULL, &info, sizeof(info)))
+		return NULL;
+	if (!filter->video_delay_reached &&
+	    filter->last_video_ts - info.timestamp < filter->interval)
+		return NULL;
+
+	filter->video_delay_reached = true;
+	return pop_compressed_frame(filter, &info);
+}
+
 static struct obs_source_frame *
 async_delay_filter_video(void *data, struct obs_source_frame *frame)
 {
@@ -153,12 +388,18 @@ async_delay_filter_video(void *data, struct obs_source_frame *frame)
 	if (filter->reset_video ||
 	    is_timestamp_jump(frame->timestamp, filter->last_video_ts)) {
 		free_video_data(filter, parent);
+		if (filter->reset_video)
+			update_compressed_frames(filter);
 		filter->video_delay_reached = false;
 		filter->reset_video = false;
 	}
 
 	filter->last_video_ts = frame->timestamp;
 
+	if (filter->compressed_frames)
+		return async_delay_filter_video_compressed(filter, parent,
+							   frame);
+
 	circlebuf_push_back(&filter->video_frames, &frame,
 			    sizeof(struct obs_source_frame *));
 	circlebuf_peek_front(&filter->video_frames, &output,
@@ -242,6 +483,7 @@ struct obs_source_info async_delay_filter = {
 	.create = async_delay_filter_create,
 	.destroy = async_delay_filter_destroy,
 	.update = async_delay_filter_update,
+	.get_defaults = async_delay_filter_defaults,
 	.get_properties = async_delay_filter_properties,
 	.filter_video = async_delay_filter_video,
 #ifdef DELAY_AUDIO
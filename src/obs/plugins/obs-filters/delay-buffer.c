@@ -0,0 +1,821 @@
+#include <inttypes.h>
+
+#include "delay-buffer.h"
+
+#include <util/circlebuf.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <emmintrin.h>
+
+#define MAX_WORKERS 4
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 14
+#define LZ_HASH_SIZE (1 << LZ_HASH_BITS)
+#define LZ_MAX_OFFSET 65535
+#define LZ_LAST_LITERALS 5
+#define LZ_MATCH_LIMIT 12
+
+/* -------------------------------------------------------- */
+
+struct stored_plane {
+	uint8_t *data;
+	size_t size;
+	bool compressed;
+	uint32_t linesize;
+	uint32_t rows;
+	uint32_t pixel_size;
+};
+
+struct delay_entry {
+	uint64_t ts;
+	struct stored_plane planes[MAX_AV_PLANES];
+	size_t num_planes;
+	void *meta;
+	size_t meta_size;
+	size_t raw_size;
+	size_t stored_size;
+
+	/* the following are protected by the buffer mutex */
+	bool compressing;
+	bool compressed;
+	bool abandoned;
+};
+
+struct delay_worker {
+	struct delay_buffer *db;
+	pthread_t thread;
+	bool initialized;
+
+	uint32_t *hash_table;
+	uint8_t *scratch;
+	size_t scratch_size;
+};
+
+struct delay_buffer {
+	char *name;
+
+	pthread_mutex_t mutex;
+	struct circlebuf entries;
+	struct circlebuf jobs;
+	size_t memory_limit;
+	size_t stored_bytes;
+	size_t raw_bytes;
+
+	os_sem_t *job_sem;
+	volatile bool stop;
+	struct delay_worker workers[MAX_WORKERS];
+	size_t num_workers;
+
+	uint64_t dropped_frames;
+	uint64_t decode_time_ns;
+	uint64_t decode_count;
+	bool warned_limit;
+
+	/* only used by the consumer in delay_buffer_pop */
+	uint8_t *decode_scratch;
+	size_t decode_scratch_size;
+};
+
+/* -------------------------------------------------------- */
+/* LZ compression, byte-oriented sequences of literals + matches  */
+
+static inline uint32_t read32(const uint8_t *ptr)
+{
+	uint32_t val;
+	memcpy(&val, ptr, sizeof(val));
+	return val;
+}
+
+static inline uint32_t lz_hash(uint32_t val)
+{
+	return (val * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+static inline size_t lz_bound(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+static inline uint8_t *write_length(uint8_t *op, size_t len)
+{
+	while (len >= 255) {
+		*(op++) = 255;
+		len -= 255;
+	}
+	*(op++) = (uint8_t)len;
+	return op;
+}
+
+static inline uint8_t *write_literals(uint8_t *op, const uint8_t *literals,
+				      size_t lit_len, size_t match_len)
+{
+	uint8_t *token = op++;
+
+	*token = (uint8_t)((lit_len >= 15 ? 15 : lit_len) << 4);
+	*token |= (uint8_t)(match_len >= 15 ? 15 : match_len);
+
+	if (lit_len >= 15)
+		op = write_length(op, lit_len - 15);
+
+	memcpy(op, literals, lit_len);
+	return op + lit_len;
+}
+
+static size_t lz_compress(const uint8_t *src, size_t size, uint8_t *dst,
+			  uint32_t *table)
+{
+	const uint8_t *end = src + size;
+	const uint8_t *anchor = src;
+	const uint8_t *ip = src + 1;
+	uint8_t *op = dst;
+
+	memset(table, 0, sizeof(uint32_t) * LZ_HASH_SIZE);
+
+	if (size > LZ_MATCH_LIMIT) {
+		const uint8_t *match_start_limit = end - LZ_MATCH_LIMIT;
+		const uint8_t *match_end_limit = end - LZ_LAST_LITERALS;
+
+		while (ip < match_start_limit) {
+			uint32_t seq = read32(ip);
+			uint32_t h = lz_hash(seq);
+			const uint8_t *ref = src + table[h];
+			const uint8_t *match;
+			size_t offset;
+
+			table[h] = (uint32_t)(ip - src);
+
+			if (ref >= ip || (size_t)(ip - ref) > LZ_MAX_OFFSET ||
+			    read32(ref) != seq) {
+				/* skip faster through incompressible data */
+				ip += 1 + ((ip - anchor) >> 6);
+				continue;
+			}
+
+			offset = (size_t)(ip - ref);
+			match = ip;
+			ip += LZ_MIN_MATCH;
+			ref += LZ_MIN_MATCH;
+			while (ip < match_end_limit && *ip == *ref) {
+				ip++;
+				ref++;
+			}
+
+			size_t match_len = (size_t)(ip - match) - LZ_MIN_MATCH;
+
+			op = write_literals(op, anchor, (size_t)(match - anchor),
+					    match_len);
+			*(op++) = (uint8_t)(offset & 0xFF);
+			*(op++) = (uint8_t)(offset >> 8);
+			if (match_len >= 15)
+				op = write_length(op, match_len - 15);
+
+			anchor = ip;
+		}
+	}
+
+	op = write_literals(op, anchor, (size_t)(end - anchor), 0);
+	return (size_t)(op - dst);
+}
+
+/* copies 16 bytes, callers make sure both buffers have room for it */
+static inline void copy16(uint8_t *dst, const uint8_t *src)
+{
+	_mm_storeu_si128((__m128i *)dst,
+			 _mm_loadu_si128((const __m128i *)src));
+}
+
+static inline bool read_length(const uint8_t **ip, const uint8_t *end,
+			       size_t *len)
+{
+	uint8_t val;
+
+	do {
+		if (*ip >= end)
+			return false;
+		val = *((*ip)++);
+		*len += val;
+	} while (val == 255);
+
+	return true;
+}
+
+static bool lz_decompress(const uint8_t *src, size_t size, uint8_t *dst,
+			  size_t dst_size)
+{
+	const uint8_t *ip = src;
+	const uint8_t *end = src + size;
+	uint8_t *op = dst;
+	uint8_t *op_end = dst + dst_size;
+
+	while (ip < end) {
+		uint8_t token = *(ip++);
+		size_t lit_len = token >> 4;
+		size_t match_len = token & 15;
+		size_t offset;
+
+		if (lit_len == 15 && !read_length(&ip, end, &lit_len))
+			return false;
+		if (lit_len > (size_t)(end - ip) ||
+		    lit_len > (size_t)(op_end - op))
+			return false;
+
+		if (lit_len <= 16 && end - ip >= 16 && op_end - op >= 16)
+			copy16(op, ip);
+		else
+			memcpy(op, ip, lit_len);
+		op += lit_len;
+		ip += lit_len;
+
+		/* the last sequence only contains literals */
+		if (ip == end)
+			break;
+		if (end - ip < 2)
+			return false;
+
+		offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+
+		if (match_len == 15 && !read_length(&ip, end, &match_len))
+			return false;
+		match_len += LZ_MIN_MATCH;
+
+		if (!offset || offset > (size_t)(op - dst) ||
+		    match_len > (size_t)(op_end - op))
+			return false;
+
+		const uint8_t *match = op - offset;
+
+		if (offset >= 16 && (size_t)(op_end - op) >= match_len + 16) {
+			for (size_t i = 0; i < match_len; i += 16)
+				copy16(op + i, match + i);
+			op += match_len;
+			continue;
+		}
+
+		if (offset == 1) {
+			memset(op, *match, match_len);
+			op += match_len;
+			continue;
+		}
+
+		/* overlapping matches repeat with a period of the offset, so the
+		 * non-overlapping part doubles with each copy */
+		for (size_t remaining = match_len; remaining;) {
+			size_t n = (size_t)(op - match);
+			if (n > remaining)
+				n = remaining;
+
+			memcpy(op, match, n);
+			op += n;
+			remaining -= n;
+		}
+	}
+
+	return op == op_end;
+}
+
+/* -------------------------------------------------------- */
+/* left-neighbour delta filter, makes flat/gradient areas compressible */
+
+static void delta_encode(uint8_t *dst, const uint8_t *src, uint32_t linesize,
+			 uint32_t rows, uint32_t pixel_size)
+{
+	for (uint32_t y = 0; y < rows; y++) {
+		const uint8_t *in = src + (size_t)y * linesize;
+		uint8_t *out = dst + (size_t)y * linesize;
+		uint32_t x = pixel_size;
+
+		memcpy(out, in, pixel_size);
+
+		for (; x + 16 <= linesize; x += 16) {
+			__m128i cur = _mm_loadu_si128((const __m128i *)(in + x));
+			__m128i left = _mm_loadu_si128(
+				(const __m128i *)(in + x - pixel_size));
+			_mm_storeu_si128((__m128i *)(out + x),
+					 _mm_sub_epi8(cur, left));
+		}
+
+		for (; x < linesize; x++)
+			out[x] = (uint8_t)(in[x] - in[x - pixel_size]);
+	}
+}
+
+static inline __m128i prefix_sum_epi8(__m128i val, uint32_t pixel_size)
+{
+	switch (pixel_size) {
+	case 1:
+		val = _mm_add_epi8(val, _mm_slli_si128(val, 1));
+		/* fall through */
+	case 2:
+		val = _mm_add_epi8(val, _mm_slli_si128(val, 2));
+		/* fall through */
+	case 4:
+		val = _mm_add_epi8(val, _mm_slli_si128(val, 4));
+		val = _mm_add_epi8(val, _mm_slli_si128(val, 8));
+	}
+	return val;
+}
+
+static inline __m128i broadcast_last_pixel(const uint8_t *pixel,
+					   uint32_t pixel_size)
+{
+	switch (pixel_size) {
+	case 1:
+		return _mm_set1_epi8((char)*pixel);
+	case 2:
+		return _mm_set1_epi16((short)(pixel[0] | (pixel[1] << 8)));
+	default:
+		return _mm_set1_epi32((int)read32(pixel));
+	}
+}
+
+static void delta_decode(uint8_t *dst, uint32_t dst_linesize,
+			 const uint8_t *src, uint32_t linesize, uint32_t rows,
+			 uint32_t pixel_size)
+{
+	uint32_t copy_size = linesize < dst_linesize ? linesize : dst_linesize;
+	bool simd = pixel_size == 1 || pixel_size == 2 || pixel_size == 4;
+
+	for (uint32_t y = 0; y < rows; y++) {
+		const uint8_t *in = src + (size_t)y * linesize;
+		uint8_t *out = dst + (size_t)y * dst_linesize;
+		uint32_t x = pixel_size;
+
+		memcpy(out, in, pixel_size);
+
+		/* 16 byte blocks are a running sum per byte lane, carried over
+		 * from the previous pixel */
+		if (simd) {
+			for (; x + 16 <= copy_size; x += 16) {
+				__m128i val = _mm_loadu_si128(
+					(const __m128i *)(in + x));
+				__m128i carry = broadcast_last_pixel(
+					out + x - pixel_size, pixel_size);
+
+				val = _mm_add_epi8(
+					prefix_sum_epi8(val, pixel_size),
+					carry);
+				_mm_storeu_si128((__m128i *)(out + x), val);
+			}
+		}
+
+		for (; x < copy_size; x++)
+			out[x] = (uint8_t)(in[x] + out[x - pixel_size]);
+	}
+}
+
+static void copy_plane(uint8_t *dst, uint32_t dst_linesize, const uint8_t *src,
+		       uint32_t linesize, uint32_t rows)
+{
+	if (dst_linesize == linesize) {
+		memcpy(dst, src, (size_t)linesize * rows);
+		return;
+	}
+
+	uint32_t copy_size = linesize < dst_linesize ? linesize : dst_linesize;
+	for (uint32_t y = 0; y < rows; y++)
+		memcpy(dst + (size_t)y * dst_linesize,
+		       src + (size_t)y * linesize, copy_size);
+}
+
+/* -------------------------------------------------------- */
+
+static void free_entry_data(struct delay_entry *entry)
+{
+	for (size_t i = 0; i < entry->num_planes; i++)
+		bfree(entry->planes[i].data);
+	bfree(entry->meta);
+	bfree(entry);
+}
+
+/* must be called with the mutex locked.  entries that are still owned by a
+ * worker thread are freed by the worker once it's done with them. */
+static void release_entry(struct delay_buffer *db, struct delay_entry *entry)
+{
+	db->stored_bytes -= entry->stored_size;
+	db->raw_bytes -= entry->raw_size;
+
+	if (entry->compressed)
+		free_entry_data(entry);
+	else
+		entry->abandoned = true;
+}
+
+static void compress_entry(struct delay_worker *worker,
+			   struct delay_entry *entry,
+			   struct stored_plane *out_planes)
+{
+	for (size_t i = 0; i < entry->num_planes; i++) {
+		struct stored_plane *plane = &entry->planes[i];
+		struct stored_plane *out = &out_planes[i];
+		size_t bound = lz_bound(plane->size);
+
+		*out = *plane;
+		out->data = NULL;
+
+		if (worker->scratch_size < plane->size) {
+			worker->scratch = brealloc(worker->scratch,
+						   plane->size);
+			worker->scratch_size = plane->size;
+		}
+
+		delta_encode(worker->scratch, plane->data, plane->linesize,
+			     plane->rows, plane->pixel_size);
+
+		uint8_t *data = bmalloc(bound);
+		size_t size = lz_compress(worker->scratch, plane->size, data,
+					  worker->hash_table);
+
+		if (size < plane->size) {
+			out->data = brealloc(data, size);
+			out->size = size;
+			out->compressed = true;
+		} else {
+			out->data = brealloc(data, plane->size);
+			memcpy(out->data, plane->data, plane->size);
+			out->compressed = false;
+		}
+	}
+}
+
+static void *worker_thread(void *data)
+{
+	struct delay_worker *worker = data;
+	struct delay_buffer *db = worker->db;
+
+	os_set_thread_name("delay-buffer: compression thread");
+
+	while (os_sem_wait(db->job_sem) == 0) {
+		struct stored_plane out_planes[MAX_AV_PLANES];
+		struct delay_entry *entry = NULL;
+
+		if (os_atomic_load_bool(&db->stop))
+			break;
+
+		pthread_mutex_lock(&db->mutex);
+		if (db->jobs.size) {
+			circlebuf_pop_front(&db->jobs, &entry, sizeof(entry));
+			if (entry->abandoned) {
+				free_entry_data(entry);
+				entry = NULL;
+			} else {
+				entry->compressing = true;
+			}
+		}
+		pthread_mutex_unlock(&db->mutex);
+
+		if (!entry)
+			continue;
+
+		compress_entry(worker, entry, out_planes);
+
+		pthread_mutex_lock(&db->mutex);
+		if (entry->abandoned) {
+			for (size_t i = 0; i < entry->num_planes; i++)
+				bfree(out_planes[i].data);
+			free_entry_data(entry);
+		} else {
+			size_t stored_size = 0;
+
+			for (size_t i = 0; i < entry->num_planes; i++) {
+				bfree(entry->planes[i].data);
+				entry->planes[i] = out_planes[i];
+				stored_size += out_planes[i].size;
+			}
+
+			db->stored_bytes -= entry->stored_size;
+			db->stored_bytes += stored_size;
+			entry->stored_size = stored_size;
+			entry->compressing = false;
+			entry->compressed = true;
+		}
+		pthread_mutex_unlock(&db->mutex);
+	}
+
+	return NULL;
+}
+
+/* -------------------------------------------------------- */
+
+struct delay_buffer *delay_buffer_create(const char *name, size_t memory_limit)
+{
+	struct delay_buffer *db = bzalloc(sizeof(*db));
+	int num_workers = os_get_logical_cores() / 2;
+
+	if (num_workers < 1)
+		num_workers = 1;
+	else if (num_workers > MAX_WORKERS)
+		num_workers = MAX_WORKERS;
+
+	db->name = bstrdup(name);
+	db->memory_limit = memory_limit;
+	pthread_mutex_init_value(&db->mutex);
+
+	if (pthread_mutex_init(&db->mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&db->job_sem, 0) != 0)
+		goto fail;
+
+	for (int i = 0; i < num_workers; i++) {
+		struct delay_worker *worker = &db->workers[i];
+
+		worker->db = db;
+		worker->hash_table = bmalloc(sizeof(uint32_t) * LZ_HASH_SIZE);
+		db->num_workers++;
+
+		worker->initialized = pthread_create(&worker->thread, NULL,
+						     worker_thread,
+						     worker) == 0;
+		if (!worker->initialized)
+			goto fail;
+	}
+
+	return db;
+
+fail:
+	blog(LOG_WARNING, "[delay buffer: '%s'] Failed to initialize", name);
+	delay_buffer_destroy(db);
+	return NULL;
+}
+
+void delay_buffer_destroy(struct delay_buffer *db)
+{
+	if (!db)
+		return;
+
+	os_atomic_set_bool(&db->stop, true);
+
+	for (size_t i = 0; i < db->num_workers; i++) {
+		if (db->workers[i].initialized)
+			os_sem_post(db->job_sem);
+	}
+
+	for (size_t i = 0; i < db->num_workers; i++) {
+		struct delay_worker *worker = &db->workers[i];
+
+		if (worker->initialized)
+			pthread_join(worker->thread, NULL);
+		bfree(worker->hash_table);
+		bfree(worker->scratch);
+	}
+
+	/* no workers are left, so everything can be freed directly */
+	while (db->jobs.size) {
+		struct delay_entry *entry;
+		circlebuf_pop_front(&db->jobs, &entry, sizeof(entry));
+		if (entry->abandoned)
+			free_entry_data(entry);
+	}
+	while (db->entries.size) {
+		struct delay_entry *entry;
+		circlebuf_pop_front(&db->entries, &entry, sizeof(entry));
+		free_entry_data(entry);
+	}
+
+	circlebuf_free(&db->jobs);
+	circlebuf_free(&db->entries);
+	os_sem_destroy(db->job_sem);
+	pthread_mutex_destroy(&db->mutex);
+	bfree(db->decode_scratch);
+	bfree(db->name);
+	bfree(db);
+}
+
+void delay_buffer_clear(struct delay_buffer *db)
+{
+	pthread_mutex_lock(&db->mutex);
+	while (db->entries.size) {
+		struct delay_entry *entry;
+		circlebuf_pop_front(&db->entries, &entry, sizeof(entry));
+		release_entry(db, entry);
+	}
+	db->warned_limit = false;
+	pthread_mutex_unlock(&db->mutex);
+}
+
+void delay_buffer_set_memory_limit(struct delay_buffer *db,
+				   size_t memory_limit)
+{
+	pthread_mutex_lock(&db->mutex);
+	db->memory_limit = memory_limit;
+	db->warned_limit = false;
+	pthread_mutex_unlock(&db->mutex);
+}
+
+/* must be called with the mutex locked */
+static void enforce_memory_limit(struct delay_buffer *db)
+{
+	while (db->stored_bytes > db->memory_limit && db->entries.size > 1) {
+		struct delay_entry *entry;
+		circlebuf_pop_front(&db->entries, &entry, sizeof(entry));
+		release_entry(db, entry);
+		db->dropped_frames++;
+
+		if (!db->warned_limit) {
+			blog(LOG_WARNING,
+			     "[delay buffer: '%s'] Memory limit of %" PRIu64
+			     " MB reached, dropping oldest frames",
+			     db->name, (uint64_t)(db->memory_limit >> 20));
+			db->warned_limit = true;
+		}
+	}
+}
+
+void delay_buffer_push(struct delay_buffer *db, uint64_t ts,
+		       const struct delay_plane *planes, size_t num_planes,
+		       const void *meta, size_t meta_size)
+{
+	struct delay_entry *entry = bzalloc(sizeof(*entry));
+
+	if (num_planes > MAX_AV_PLANES)
+		num_planes = MAX_AV_PLANES;
+
+	entry->ts = ts;
+	entry->num_planes = num_planes;
+	entry->meta = meta_size ? bmemdup(meta, meta_size) : NULL;
+	entry->meta_size = meta_size;
+
+	for (size_t i = 0; i < num_planes; i++) {
+		struct stored_plane *plane = &entry->planes[i];
+
+		plane->linesize = planes[i].linesize;
+		plane->rows = planes[i].rows;
+		plane->pixel_size = planes[i].pixel_size ? planes[i].pixel_size
+							 : 1;
+		plane->size = (size_t)plane->linesize * plane->rows;
+		plane->data = bmemdup(planes[i].data, plane->size);
+		entry->raw_size += plane->size;
+	}
+
+	entry->stored_size = entry->raw_size;
+
+	pthread_mutex_lock(&db->mutex);
+	circlebuf_push_back(&db->entries, &entry, sizeof(entry));
+	circlebuf_push_back(&db->jobs, &entry, sizeof(entry));
+	db->stored_bytes += entry->stored_size;
+	db->raw_bytes += entry->raw_size;
+	enforce_memory_limit(db);
+	pthread_mutex_unlock(&db->mutex);
+
+	os_sem_post(db->job_sem);
+}
+
+size_t delay_buffer_count(struct delay_buffer *db)
+{
+	size_t count;
+
+	pthread_mutex_lock(&db->mutex);
+	count = db->entries.size / sizeof(struct delay_entry *);
+	pthread_mutex_unlock(&db->mutex);
+
+	return count;
+}
+
+bool delay_buffer_peek(struct delay_buffer *db, uint64_t *ts, void *meta,
+		       size_t meta_size)
+{
+	struct delay_entry *entry = NULL;
+
+	pthread_mutex_lock(&db->mutex);
+	if (db->entries.size) {
+		circlebuf_peek_front(&db->entries, &entry, sizeof(entry));
+		if (ts)
+			*ts = entry->ts;
+		if (meta && meta_size == entry->meta_size)
+			memcpy(meta, entry->meta, meta_size);
+	}
+	pthread_mutex_unlock(&db->mutex);
+
+	return !!entry;
+}
+
+static bool decode_entry(struct delay_entry *entry, struct delay_plane *planes,
+			 size_t num_planes, uint8_t **scratch,
+			 size_t *scratch_size)
+{
+	/* dropping a frame without decoding it */
+	if (!planes)
+		return true;
+	if (num_planes != entry->num_planes)
+		return false;
+
+	for (size_t i = 0; i < num_planes; i++) {
+		struct stored_plane *plane = &entry->planes[i];
+		size_t raw_size = (size_t)plane->linesize * plane->rows;
+
+		if (planes[i].rows != plane->rows)
+			return false;
+
+		if (!plane->compressed) {
+			copy_plane(planes[i].data, planes[i].linesize,
+				   plane->data, plane->linesize, plane->rows);
+			continue;
+		}
+
+		if (*scratch_size < raw_size) {
+			*scratch = brealloc(*scratch, raw_size);
+			*scratch_size = raw_size;
+		}
+
+		if (!lz_decompress(plane->data, plane->size, *scratch,
+				   raw_size))
+			return false;
+
+		delta_decode(planes[i].data, planes[i].linesize, *scratch,
+			     plane->linesize, plane->rows, plane->pixel_size);
+	}
+
+	return true;
+}
+
+bool delay_buffer_pop(struct delay_buffer *db, uint64_t *ts,
+		      struct delay_plane *planes, size_t num_planes,
+		      void *meta, size_t meta_size)
+{
+	struct delay_entry *entry = NULL;
+	uint64_t start_time = os_gettime_ns();
+	bool success;
+
+	pthread_mutex_lock(&db->mutex);
+	if (!db->entries.size) {
+		pthread_mutex_unlock(&db->mutex);
+		return false;
+	}
+
+	circlebuf_pop_front(&db->entries, &entry, sizeof(entry));
+	db->stored_bytes -= entry->stored_size;
+	db->raw_bytes -= entry->raw_size;
+
+	/* not compressed yet: the raw planes are still valid, so copy them
+	 * directly and let the worker free the entry */
+	if (!entry->compressed) {
+		success = decode_entry(entry, planes, num_planes,
+				       &db->decode_scratch,
+				       &db->decode_scratch_size);
+		if (ts)
+			*ts = entry->ts;
+		if (meta && meta_size == entry->meta_size)
+			memcpy(meta, entry->meta, meta_size);
+
+		entry->abandoned = true;
+		pthread_mutex_unlock(&db->mutex);
+		return success;
+	}
+	pthread_mutex_unlock(&db->mutex);
+
+	success = decode_entry(entry, planes, num_planes, &db->decode_scratch,
+			       &db->decode_scratch_size);
+	if (ts)
+		*ts = entry->ts;
+	if (meta && meta_size == entry->meta_size)
+		memcpy(meta, entry->meta, meta_size);
+
+	free_entry_data(entry);
+
+	if (planes) {
+		pthread_mutex_lock(&db->mutex);
+		db->decode_time_ns += os_gettime_ns() - start_time;
+		db->decode_count++;
+		pthread_mutex_unlock(&db->mutex);
+	}
+
+	if (!success)
+		blog(LOG_WARNING, "[delay buffer: '%s'] Failed to decode frame",
+		     db->name);
+	return success;
+}
+
+void delay_buffer_get_stats(struct delay_buffer *db,
+			    struct delay_buffer_stats *stats)
+{
+	pthread_mutex_lock(&db->mutex);
+	stats->raw_bytes = db->raw_bytes;
+	stats->stored_bytes = db->stored_bytes;
+	stats->frames = db->entries.size / sizeof(struct delay_entry *);
+	stats->dropped_frames = db->dropped_frames;
+	stats->avg_decode_ns =
+		db->decode_count ? db->decode_time_ns / db->decode_count : 0;
+	pthread_mutex_unlock(&db->mutex);
+}
+
+void delay_buffer_log_stats(struct delay_buffer *db)
+{
+	struct delay_buffer_stats stats;
+	double ratio;
+
+	delay_buffer_get_stats(db, &stats);
+	if (!stats.frames)
+		return;
+
+	ratio = stats.stored_bytes
+			? (double)stats.raw_bytes / (double)stats.stored_bytes
+			: 0.0;
+
+	blog(LOG_INFO,
+	     "[delay buffer: '%s'] %" PRIu64 " frames, %" PRIu64
+	     " MB stored (compression ratio %.2f:1), "
+	     "average decode time %.2f ms, %" PRIu64 " frames dropped",
+	     db->name, stats.frames, stats.stored_bytes >> 20, ratio,
+	     (double)stats.avg_decode_ns / 1000000.0, stats.dropped_frames);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <obs-module.h>
+
+/* Compressed frame store used by the delay filters for long delays.
+ *
+ * Frames are copied on push and compressed losslessly on worker threads
+ * (left-neighbour delta followed by a fast LZ pass per plane).  They are
+ * decompressed just-in-time when popped.  The total amount of memory held
+ * by stored frames is kept within the configured limit by dropping the
+ * oldest frames. */
+
+struct delay_buffer;
+
+struct delay_plane {
+	uint8_t *data;
+	uint32_t linesize;
+	uint32_t rows;
+	uint32_t pixel_size;
+};
+
+struct delay_buffer_stats {
+	uint64_t raw_bytes;
+	uint64_t stored_bytes;
+	uint64_t frames;
+	uint64_t dropped_frames;
+	uint64_t avg_decode_ns;
+};
+
+extern struct delay_buffer *delay_buffer_create(const char *name,
+						size_t memory_limit);
+extern void delay_buffer_destroy(struct delay_buffer *db);
+
+extern void delay_buffer_clear(struct delay_buffer *db);
+extern void delay_buffer_set_memory_limit(struct delay_buffer *db,
+					  size_t memory_limit);
+
+/* Copies the planes and metadata and queues the frame for compression */
+extern void delay_buffer_push(struct delay_buffer *db, uint64_t ts,
+			      const struct delay_plane *planes,
+			      size_t num_planes, const void *meta,
+			      size_t meta_size);
+
+extern size_t delay_buffer_count(struct delay_buffer *db);
+extern bool delay_buffer_peek(struct delay_buffer *db, uint64_t *ts,
+			      void *meta, size_t meta_size);
+
+/* Decompresses the oldest frame into the destination planes, which must
+ * have the same layout as the planes that were pushed.  If planes is NULL the
+ * frame is dropped without being decompressed. */
+extern bool delay_buffer_pop(struct delay_buffer *db, uint64_t *ts,
+			     struct delay_plane *planes, size_t num_planes,
+			     void *meta, size_t meta_size);
+
+extern void delay_buffer_get_stats(struct delay_buffer *db,
+				   struct delay_buffer_stats *stats);
+extern void delay_buffer_log_stats(struct delay_buffer *db);
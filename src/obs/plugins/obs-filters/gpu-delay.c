@@ -1,10 +1,23 @@
 #include <obs-module.h>
 #include <util/circlebuf.h>
+#include <util/threading.h>
 //PRISM/LiuHaibin/20200803/#None/https://github.com/obsproject/obs-studio/pull/2657
 #include <util/util_uint64.h>
+#include "delay-buffer.h"
 
 #define S_DELAY_MS "delay_ms"
+#define S_COMPRESS "compress"
+#define S_MEMORY_LIMIT "memory_limit_mb"
 #define T_DELAY_MS obs_module_text("DelayMs")
+#define T_COMPRESS obs_module_text("DelayCompress")
+#define T_MEMORY_LIMIT obs_module_text("DelayMemoryLimit")
+
+#define MAX_DELAY_MS 500
+#define MAX_COMPRESSED_DELAY_MS 20000
+
+/* frames are read back this many frames after being staged so mapping never
+ * stalls the graphics thread */
+#define NUM_STAGES 3
 
 struct frame {
 	gs_texrender_t *render;
@@ -20,6 +33,25 @@ struct gpu_delay_filter_data {
 	uint32_t cy;
 	bool target_valid;
 	bool processed_frame;
+
+	/* set by update, applied by the tick on the graphics thread, which
+	 * also renders, so the buffers are never swapped under the render */
+	uint64_t new_delay_ns;
+	bool new_compress;
+	size_t new_memory_limit;
+	volatile bool settings_changed;
+
+	/* compressed mode: frames are read back to system memory and stored
+	 * compressed instead of keeping one render texture per frame */
+	struct delay_buffer *buffer;
+	size_t memory_limit;
+	gs_texrender_t *capture;
+	gs_stagesurf_t *stages[NUM_STAGES];
+	bool staged[NUM_STAGES];
+	size_t stage_index;
+	gs_texture_t *output;
+	uint8_t *output_data;
+	bool output_valid;
 };
 
 static const char *gpu_delay_filter_get_name(void *unused)
@@ -37,7 +69,25 @@ static void free_textures(struct gpu_delay_filter_data *f)
 		gs_texrender_destroy(frame.render);
 	}
 	circlebuf_free(&f->frames);
+
+	gs_texrender_destroy(f->capture);
+	f->capture = NULL;
+	for (size_t i = 0; i < NUM_STAGES; i++) {
+		gs_stagesurface_destroy(f->stages[i]);
+		f->stages[i] = NULL;
+		f->staged[i] = false;
+	}
+	gs_texture_destroy(f->output);
+	f->output = NULL;
 	obs_leave_graphics();
+
+	bfree(f->output_data);
+	f->output_data = NULL;
+	f->output_valid = false;
+	f->stage_index = 0;
+
+	if (f->buffer)
+		delay_buffer_clear(f->buffer);
 }
 
 static size_t num_frames(struct circlebuf *buf)
@@ -54,6 +104,9 @@ static void update_interval(struct gpu_delay_filter_data *f,
 	}
 
 	f->interval_ns = new_interval_ns;
+	if (f->buffer)
+		return;
+
 	size_t num = (size_t)(f->delay_ns / new_interval_ns);
 
 	if (num > num_frames(&f->frames)) {
@@ -138,14 +191,58 @@ static inline bool check_size(struct gpu_delay_filter_data *f)
 static void gpu_delay_filter_update(void *data, obs_data_t *s)
 {
 	struct gpu_delay_filter_data *f = data;
+	bool compress = obs_data_get_bool(s, S_COMPRESS);
+	uint64_t delay_ms = (uint64_t)obs_data_get_int(s, S_DELAY_MS);
+
+	if (!compress && delay_ms > MAX_DELAY_MS)
+		delay_ms = MAX_DELAY_MS;
 
-	f->delay_ns = (uint64_t)obs_data_get_int(s, S_DELAY_MS) * 1000000ULL;
+	f->new_delay_ns = delay_ms * 1000000ULL;
+	f->new_compress = compress;
+	f->new_memory_limit = (size_t)obs_data_get_int(s, S_MEMORY_LIMIT)
+			      << 20;
+	os_atomic_set_bool(&f->settings_changed, true);
+}
+
+static void apply_settings(struct gpu_delay_filter_data *f)
+{
+	bool compress = f->new_compress;
+	size_t memory_limit = f->new_memory_limit;
+
+	f->delay_ns = f->new_delay_ns;
 
 	/* full reset */
 	f->cx = 0;
 	f->cy = 0;
 	f->interval_ns = 0;
 	free_textures(f);
+
+	if (compress && !f->buffer) {
+		f->buffer = delay_buffer_create(
+			obs_source_get_name(f->context), memory_limit);
+	} else if (!compress && f->buffer) {
+		delay_buffer_log_stats(f->buffer);
+		delay_buffer_destroy(f->buffer);
+		f->buffer = NULL;
+	} else if (compress && memory_limit != f->memory_limit) {
+		delay_buffer_set_memory_limit(f->buffer, memory_limit);
+	}
+
+	f->memory_limit = memory_limit;
+}
+
+static bool compress_modified(obs_properties_t *props, obs_property_t *p,
+			      obs_data_t *settings)
+{
+	bool compress = obs_data_get_bool(settings, S_COMPRESS);
+
+	p = obs_properties_get(props, S_DELAY_MS);
+	obs_property_int_set_limits(
+		p, 0, compress ? MAX_COMPRESSED_DELAY_MS : MAX_DELAY_MS, 1);
+
+	p = obs_properties_get(props, S_MEMORY_LIMIT);
+	obs_property_set_visible(p, compress);
+	return true;
 }
 
 static obs_properties_t *gpu_delay_filter_properties(void *data)
@@ -153,13 +250,27 @@ static obs_properties_t *gpu_delay_filter_properties(void *data)
 	obs_properties_t *props = obs_properties_create();
 
 	obs_property_t *p = obs_properties_add_int(props, S_DELAY_MS,
-						   T_DELAY_MS, 0, 500, 1);
+						   T_DELAY_MS, 0, MAX_DELAY_MS,
+						   1);
 	obs_property_int_set_suffix(p, " ms");
 
+	p = obs_properties_add_bool(props, S_COMPRESS, T_COMPRESS);
+	obs_property_set_modified_callback(p, compress_modified);
+
+	p = obs_properties_add_int(props, S_MEMORY_LIMIT, T_MEMORY_LIMIT, 64,
+				   65536, 64);
+	obs_property_int_set_suffix(p, " MB");
+
 	UNUSED_PARAMETER(data);
 	return props;
 }
 
+static void gpu_delay_filter_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_bool(settings, S_COMPRESS, false);
+	obs_data_set_default_int(settings, S_MEMORY_LIMIT, 2048);
+}
+
 static void *gpu_delay_filter_create(obs_data_t *settings,
 				     obs_source_t *context)
 {
@@ -175,6 +286,10 @@ static void gpu_delay_filter_destroy(void *data)
 	struct gpu_delay_filter_data *f = data;
 
 	free_textures(f);
+	if (f->buffer) {
+		delay_buffer_log_stats(f->buffer);
+		delay_buffer_destroy(f->buffer);
+	}
 	bfree(f);
 }
 
@@ -186,26 +301,156 @@ static void gpu_delay_filter_tick(void *data, float t)
 
 	f->processed_frame = false;
 
+	if (os_atomic_set_bool(&f->settings_changed, false))
+		apply_settings(f);
+
 	if (check_size(f))
 		return;
 	check_interval(f);
 }
 
+static void render_target(struct gpu_delay_filter_data *f,
+			  obs_source_t *target, obs_source_t *parent,
+			  gs_texrender_t *render)
+{
+	gs_texrender_reset(render);
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+	if (gs_texrender_begin(render, f->cx, f->cy)) {
+		uint32_t parent_flags = obs_source_get_output_flags(target);
+		bool custom_draw = (parent_flags & OBS_SOURCE_CUSTOM_DRAW) != 0;
+		bool async = (parent_flags & OBS_SOURCE_ASYNC) != 0;
+		struct vec4 clear_color;
+
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)f->cx, 0.0f, (float)f->cy, -100.0f,
+			 100.0f);
+
+		if (target == parent && !custom_draw && !async)
+			obs_source_default_render(target);
+		else
+			obs_source_video_render(target);
+
+		gs_texrender_end(render);
+	}
+
+	gs_blend_state_pop();
+}
+
+static void draw_texture(struct gpu_delay_filter_data *f, gs_texture_t *tex)
+{
+	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+	gs_effect_set_texture(image, tex);
+
+	while (gs_effect_loop(effect, "Draw"))
+		gs_draw_sprite(tex, 0, f->cx, f->cy);
+}
+
 static void draw_frame(struct gpu_delay_filter_data *f)
 {
 	struct frame frame;
 	circlebuf_peek_front(&f->frames, &frame, sizeof(frame));
 
-	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
 	gs_texture_t *tex = gs_texrender_get_texture(frame.render);
+	if (tex)
+		draw_texture(f, tex);
+}
+
+static bool init_compressed_textures(struct gpu_delay_filter_data *f)
+{
+	if (f->output)
+		return true;
+
+	f->capture = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	for (size_t i = 0; i < NUM_STAGES; i++)
+		f->stages[i] = gs_stagesurface_create(f->cx, f->cy, GS_RGBA);
+	f->output = gs_texture_create(f->cx, f->cy, GS_RGBA, 1, NULL,
+				      GS_DYNAMIC);
+	f->output_data = bmalloc((size_t)f->cx * f->cy * 4);
+
+	return !!f->output;
+}
+
+/* maps the surface staged NUM_STAGES frames ago and moves it into the
+ * compressed buffer, then stages the newly captured frame in its place */
+static void stage_capture(struct gpu_delay_filter_data *f)
+{
+	size_t idx = f->stage_index;
+	gs_stagesurf_t *stage = f->stages[idx];
+	gs_texture_t *tex = gs_texrender_get_texture(f->capture);
+	uint8_t *data;
+	uint32_t linesize;
+
+	if (!stage)
+		return;
+
+	if (f->staged[idx] && gs_stagesurface_map(stage, &data, &linesize)) {
+		struct delay_plane plane = {data, linesize, f->cy, 4};
+
+		delay_buffer_push(f->buffer, 0, &plane, 1, NULL, 0);
+		gs_stagesurface_unmap(stage);
+	}
+
+	f->staged[idx] = false;
 	if (tex) {
-		gs_eparam_t *image =
-			gs_effect_get_param_by_name(effect, "image");
-		gs_effect_set_texture(image, tex);
+		gs_stage_texture(stage, tex);
+		f->staged[idx] = true;
+	}
+
+	f->stage_index = (idx + 1) % NUM_STAGES;
+}
+
+/* pops the frame that is exactly delay frames old, older frames (e.g. after
+ * the delay was lowered) are dropped without being decoded.  delays shorter
+ * than the staging pipeline end up being NUM_STAGES frames. */
+static void update_output(struct gpu_delay_filter_data *f)
+{
+	size_t num = (size_t)(f->delay_ns / f->interval_ns);
+	size_t count = delay_buffer_count(f->buffer);
+
+	/* a frame only comes out of the staging pipeline after NUM_STAGES
+	 * frames, shorter delays would never match below */
+	if (num < NUM_STAGES)
+		num = NUM_STAGES;
+
+	while (count && NUM_STAGES + count - 1 > num) {
+		delay_buffer_pop(f->buffer, NULL, NULL, 0, NULL, 0);
+		count--;
+	}
+
+	if (count && NUM_STAGES + count - 1 == num) {
+		struct delay_plane plane = {f->output_data, f->cx * 4, f->cy,
+					    4};
+
+		if (delay_buffer_pop(f->buffer, NULL, &plane, 1, NULL, 0)) {
+			gs_texture_set_image(f->output, f->output_data,
+					     f->cx * 4, false);
+			f->output_valid = true;
+		}
+	}
+}
 
-		while (gs_effect_loop(effect, "Draw"))
-			gs_draw_sprite(tex, 0, f->cx, f->cy);
+static void render_compressed(struct gpu_delay_filter_data *f,
+			      obs_source_t *target, obs_source_t *parent)
+{
+	if (!f->processed_frame) {
+		if (!f->interval_ns || !init_compressed_textures(f)) {
+			obs_source_skip_video_filter(f->context);
+			return;
+		}
+
+		render_target(f, target, parent, f->capture);
+		stage_capture(f);
+		update_output(f);
+		f->processed_frame = true;
 	}
+
+	if (f->output_valid)
+		draw_texture(f, f->output);
 }
 
 static void gpu_delay_filter_render(void *data, gs_effect_t *effect)
@@ -214,6 +459,11 @@ static void gpu_delay_filter_render(void *data, gs_effect_t *effect)
 	obs_source_t *target = obs_filter_get_target(f->context);
 	obs_source_t *parent = obs_filter_get_parent(f->context);
 
+	if (f->target_valid && target && parent && f->buffer) {
+		render_compressed(f, target, parent);
+		return;
+	}
+
 	if (!f->target_valid || !target || !parent || !f->frames.size) {
 		obs_source_skip_video_filter(f->context);
 		return;
@@ -227,31 +477,7 @@ static void gpu_delay_filter_render(void *data, gs_effect_t *effect)
 	struct frame frame;
 	circlebuf_pop_front(&f->frames, &frame, sizeof(frame));
 
-	gs_texrender_reset(frame.render);
-
-	gs_blend_state_push();
-	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
-
-	if (gs_texrender_begin(frame.render, f->cx, f->cy)) {
-		uint32_t parent_flags = obs_source_get_output_flags(target);
-		bool custom_draw = (parent_flags & OBS_SOURCE_CUSTOM_DRAW) != 0;
-		bool async = (parent_flags & OBS_SOURCE_ASYNC) != 0;
-		struct vec4 clear_color;
-
-		vec4_zero(&clear_color);
-		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
-		gs_ortho(0.0f, (float)f->cx, 0.0f, (float)f->cy, -100.0f,
-			 100.0f);
-
-		if (target == parent && !custom_draw && !async)
-			obs_source_default_render(target);
-		else
-			obs_source_video_render(target);
-
-		gs_texrender_end(frame.render);
-	}
-
-	gs_blend_state_pop();
+	render_target(f, target, parent, frame.render);
 
 	circlebuf_push_back(&f->frames, &frame, sizeof(frame));
 	draw_frame(f);
@@ -268,6 +494,7 @@ struct obs_source_info gpu_delay_filter = {
 	.create = gpu_delay_filter_create,
 	.destroy = gpu_delay_filter_destroy,
 	.update = gpu_delay_filter_update,
+	.get_defaults = gpu_delay_filter_defaults,
 	.get_properties = gpu_delay_filter_properties,
 	.video_tick = gpu_delay_filter_tick,
 	.video_render = gpu_delay_filter_render,
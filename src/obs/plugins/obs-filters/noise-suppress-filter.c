@@ -2,8 +2,11 @@
 #include <inttypes.h>
 
 #include <util/circlebuf.h>
+#include <util/threading.h>
+#include <util/platform.h>
 #include <obs-module.h>
 #include <speex/speex_preprocess.h>
+#include <emmintrin.h>
 
 /* -------------------------------------------------------- */
 
@@ -29,8 +32,26 @@
 
 #define MAX_PREPROC_CHANNELS 8
 
+/* Channels handled by each processing thread.  The filter's own thread
+ * always handles the first group, extra groups get a worker thread each. */
+#define CHANNELS_PER_WORKER 2
+#define MAX_WORKERS (MAX_PREPROC_CHANNELS / CHANNELS_PER_WORKER - 1)
+
 /* -------------------------------------------------------- */
 
+struct noise_suppress_data;
+
+struct ns_worker {
+	struct noise_suppress_data *ng;
+	size_t first_channel;
+	size_t last_channel;
+
+	pthread_t thread;
+	os_sem_t *start;
+	os_sem_t *done;
+	bool initialized;
+};
+
 struct noise_suppress_data {
 	obs_source_t *context;
 	int suppress_level;
@@ -54,6 +75,15 @@ struct noise_suppress_data {
 	/* output data */
 	struct obs_audio_data output_audio;
 	DARRAY(float) output_data;
+
+	/* worker threads for channels beyond the first group */
+	struct ns_worker workers[MAX_WORKERS];
+	size_t num_workers;
+	volatile bool stop_workers;
+
+	/* processing cost statistics */
+	uint64_t process_time_ns;
+	uint64_t process_count;
 };
 
 /* -------------------------------------------------------- */
@@ -66,6 +96,191 @@ static const float c_16_to_32 = ((float)INT16_MAX + 1.0f);
 
 /* -------------------------------------------------------- */
 
+/* Convert a float segment to 16bit, eight samples at a time.  Values are
+ * clamped to [-1.0, 1.0] and truncated, matching the scalar conversion. */
+static inline void convert_to_16bit(spx_int16_t *dst, const float *src,
+				    size_t frames)
+{
+	const __m128 max_val = _mm_set1_ps(1.0f);
+	const __m128 min_val = _mm_set1_ps(-1.0f);
+	const __m128 mul = _mm_set1_ps(c_32_to_16);
+	size_t i = 0;
+
+	for (; i + 8 <= frames; i += 8) {
+		__m128 lo = _mm_loadu_ps(src + i);
+		__m128 hi = _mm_loadu_ps(src + i + 4);
+
+		lo = _mm_mul_ps(_mm_min_ps(_mm_max_ps(lo, min_val), max_val),
+				mul);
+		hi = _mm_mul_ps(_mm_min_ps(_mm_max_ps(hi, min_val), max_val),
+				mul);
+
+		_mm_storeu_si128((__m128i *)(dst + i),
+				 _mm_packs_epi32(_mm_cvttps_epi32(lo),
+						 _mm_cvttps_epi32(hi)));
+	}
+
+	for (; i < frames; i++) {
+		float s = src[i];
+		if (s > 1.0f)
+			s = 1.0f;
+		else if (s < -1.0f)
+			s = -1.0f;
+		dst[i] = (spx_int16_t)(s * c_32_to_16);
+	}
+}
+
+static inline void convert_to_32bit(float *dst, const spx_int16_t *src,
+				    size_t frames)
+{
+	const __m128 mul = _mm_set1_ps(1.0f / c_16_to_32);
+	size_t i = 0;
+
+	for (; i + 8 <= frames; i += 8) {
+		__m128i val = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(val, val), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(val, val), 16);
+
+		_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), mul));
+		_mm_storeu_ps(dst + i + 4,
+			      _mm_mul_ps(_mm_cvtepi32_ps(hi), mul));
+	}
+
+	for (; i < frames; i++)
+		dst[i] = (float)src[i] / c_16_to_32;
+}
+
+static void process_channels(struct noise_suppress_data *ng, size_t first,
+			     size_t last)
+{
+	const size_t segment_size = ng->frames * sizeof(float);
+
+	for (size_t i = first; i < last; i++) {
+		float *copy_buffer = ng->copy_buffers[i];
+		spx_int16_t *segment_buffer = ng->segment_buffers[i];
+
+		/* Pop from input circlebuf */
+		circlebuf_pop_front(&ng->input_buffers[i], copy_buffer,
+				    segment_size);
+
+		/* Set args */
+		speex_preprocess_ctl(ng->states[i],
+				     SPEEX_PREPROCESS_SET_NOISE_SUPPRESS,
+				     &ng->suppress_level);
+
+		/* Convert to 16bit, execute, convert back to 32bit */
+		convert_to_16bit(segment_buffer, copy_buffer, ng->frames);
+		speex_preprocess_run(ng->states[i], segment_buffer);
+		convert_to_32bit(copy_buffer, segment_buffer, ng->frames);
+
+		/* Push to output circlebuf */
+		circlebuf_push_back(&ng->output_buffers[i], copy_buffer,
+				    segment_size);
+	}
+}
+
+static void *worker_thread(void *data)
+{
+	struct ns_worker *worker = data;
+	struct noise_suppress_data *ng = worker->ng;
+
+	os_set_thread_name("noise-suppress: worker thread");
+
+	for (;;) {
+		if (os_sem_wait(worker->start) != 0 || ng->stop_workers)
+			break;
+
+		process_channels(ng, worker->first_channel,
+				 worker->last_channel);
+		os_sem_post(worker->done);
+	}
+
+	return NULL;
+}
+
+static void stop_workers(struct noise_suppress_data *ng)
+{
+	ng->stop_workers = true;
+
+	for (size_t i = 0; i < ng->num_workers; i++) {
+		struct ns_worker *worker = &ng->workers[i];
+
+		if (worker->initialized) {
+			os_sem_post(worker->start);
+			pthread_join(worker->thread, NULL);
+		}
+
+		os_sem_destroy(worker->start);
+		os_sem_destroy(worker->done);
+	}
+
+	ng->num_workers = 0;
+}
+
+static void start_workers(struct noise_suppress_data *ng)
+{
+	size_t channels = ng->channels;
+
+	if (channels <= CHANNELS_PER_WORKER)
+		return;
+
+	for (size_t c = CHANNELS_PER_WORKER; c < channels;
+	     c += CHANNELS_PER_WORKER) {
+		struct ns_worker *worker = &ng->workers[ng->num_workers];
+
+		worker->ng = ng;
+		worker->first_channel = c;
+		worker->last_channel = c + CHANNELS_PER_WORKER;
+		if (worker->last_channel > channels)
+			worker->last_channel = channels;
+
+		if (os_sem_init(&worker->start, 0) != 0)
+			goto fail;
+		if (os_sem_init(&worker->done, 0) != 0) {
+			os_sem_destroy(worker->start);
+			goto fail;
+		}
+
+		ng->num_workers++;
+		worker->initialized = pthread_create(&worker->thread, NULL,
+						     worker_thread,
+						     worker) == 0;
+		if (!worker->initialized)
+			goto fail;
+	}
+
+	return;
+
+fail:
+	warn("Failed to create worker thread, processing all channels on "
+	     "the audio thread");
+	stop_workers(ng);
+	ng->stop_workers = false;
+}
+
+static inline void process(struct noise_suppress_data *ng)
+{
+	size_t first_group = ng->channels;
+	uint64_t start_time = os_gettime_ns();
+
+	if (ng->num_workers) {
+		first_group = CHANNELS_PER_WORKER;
+
+		for (size_t i = 0; i < ng->num_workers; i++)
+			os_sem_post(ng->workers[i].start);
+	}
+
+	process_channels(ng, 0, first_group);
+
+	for (size_t i = 0; i < ng->num_workers; i++)
+		os_sem_wait(ng->workers[i].done);
+
+	ng->process_time_ns += os_gettime_ns() - start_time;
+	ng->process_count++;
+}
+
+/* -------------------------------------------------------- */
+
 static const char *noise_suppress_name(void *unused)
 {
 	UNUSED_PARAMETER(unused);
@@ -76,6 +291,15 @@ static void noise_suppress_destroy(void *data)
 {
 	struct noise_suppress_data *ng = data;
 
+	/* wall time of a whole segment, the channels run in parallel */
+	if (ng->process_count) {
+		debug("average time per 10ms segment (%zu channels): %" PRIu64
+		      " ns",
+		      ng->channels, ng->process_time_ns / ng->process_count);
+	}
+
+	stop_workers(ng);
+
 	for (size_t i = 0; i < ng->channels; i++) {
 		speex_preprocess_state_destroy(ng->states[i]);
 		circlebuf_free(&ng->input_buffers[i]);
@@ -118,7 +342,7 @@ static void noise_suppress_update(void *data, obs_data_t *s)
 	if (ng->states[0])
 		return;
 
-	/* One speex state for each channel (limit 2) */
+	/* One speex state for each channel */
 	ng->copy_buffers[0] = bmalloc(frames * channels * sizeof(float));
 	ng->segment_buffers[0] =
 		bmalloc(frames * channels * sizeof(spx_int16_t));
@@ -129,6 +353,8 @@ static void noise_suppress_update(void *data, obs_data_t *s)
 
 	for (size_t i = 0; i < channels; i++)
 		alloc_channel(ng, sample_rate, i, frames);
+
+	start_workers(ng);
 }
 
 static void *noise_suppress_create(obs_data_t *settings, obs_source_t *filter)
@@ -141,47 +367,6 @@ static void *noise_suppress_create(obs_data_t *settings, obs_source_t *filter)
 	return ng;
 }
 
-static inline void process(struct noise_suppress_data *ng)
-{
-	/* Pop from input circlebuf */
-	for (size_t i = 0; i < ng->channels; i++)
-		circlebuf_pop_front(&ng->input_buffers[i], ng->copy_buffers[i],
-				    ng->frames * sizeof(float));
-
-	/* Set args */
-	for (size_t i = 0; i < ng->channels; i++)
-		speex_preprocess_ctl(ng->states[i],
-				     SPEEX_PREPROCESS_SET_NOISE_SUPPRESS,
-				     &ng->suppress_level);
-
-	/* Convert to 16bit */
-	for (size_t i = 0; i < ng->channels; i++)
-		for (size_t j = 0; j < ng->frames; j++) {
-			float s = ng->copy_buffers[i][j];
-			if (s > 1.0f)
-				s = 1.0f;
-			else if (s < -1.0f)
-				s = -1.0f;
-			ng->segment_buffers[i][j] =
-				(spx_int16_t)(s * c_32_to_16);
-		}
-
-	/* Execute */
-	for (size_t i = 0; i < ng->channels; i++)
-		speex_preprocess_run(ng->states[i], ng->segment_buffers[i]);
-
-	/* Convert back to 32bit */
-	for (size_t i = 0; i < ng->channels; i++)
-		for (size_t j = 0; j < ng->frames; j++)
-			ng->copy_buffers[i][j] =
-				(float)ng->segment_buffers[i][j] / c_16_to_32;
-
-	/* Push to output circlebuf */
-	for (size_t i = 0; i < ng->channels; i++)
-		circlebuf_push_back(&ng->output_buffers[i], ng->copy_buffers[i],
-				    ng->frames * sizeof(float));
-}
-
 struct ng_audio_info {
 	uint32_t frames;
 	uint64_t timestamp;
@@ -1,10 +1,33 @@
 #include <obs-module.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
 
 #define TIMING_TIME 0
 #define TIMING_FRAME 1
 
+#define PRELOAD_FRAMES_DEFAULT 10
+#define PRELOAD_TIMEOUT_NS 10000000000ULL
+
 enum fade_style { FADE_STYLE_FADE_OUT_FADE_IN, FADE_STYLE_CROSS_FADE };
 
+/* The first frames of the stinger are played once in advance and kept as
+ * textures, and the media is left paused at its start with its first frames
+ * decoded.  A transition then draws the resident frames until the media,
+ * unpaused on the same tick, catches up with them. */
+enum preload_state {
+	PRELOAD_NONE,
+	PRELOAD_CAPTURING,
+	PRELOAD_READY,
+	PRELOAD_FAILED,
+};
+
+struct stinger_frame {
+	gs_texture_t *tex;
+	uint64_t ts;
+};
+
 struct stinger_info {
 	obs_source_t *source;
 
@@ -22,6 +45,16 @@ struct stinger_info {
 	int monitoring_type;
 	enum fade_style fade_style;
 
+	int preload_frames;
+	enum preload_state preload_state;
+	volatile bool preload_reset;
+	DARRAY(struct stinger_frame) frames;
+	gs_texrender_t *capture;
+	uint64_t capture_start_ns;
+	bool capture_playing;
+	uint32_t frame_cx;
+	uint32_t frame_cy;
+
 	float (*mix_a)(void *data, float t);
 	float (*mix_b)(void *data, float t);
 };
@@ -67,6 +100,9 @@ static void stinger_update(void *data, obs_data_t *settings)
 	s->fade_style =
 		(enum fade_style)obs_data_get_int(settings, "audio_fade_style");
 
+	s->preload_frames = (int)obs_data_get_int(settings, "preload_frames");
+	os_atomic_set_bool(&s->preload_reset, true);
+
 	switch (s->fade_style) {
 	default:
 	case FADE_STYLE_FADE_OUT_FADE_IN:
@@ -93,13 +129,211 @@ static void *stinger_create(obs_data_t *settings, obs_source_t *source)
 	return s;
 }
 
+static void free_preloaded_frames(struct stinger_info *s)
+{
+	for (size_t i = 0; i < s->frames.num; i++)
+		gs_texture_destroy(s->frames.array[i].tex);
+	da_free(s->frames);
+
+	gs_texrender_destroy(s->capture);
+	s->capture = NULL;
+}
+
 static void stinger_destroy(void *data)
 {
 	struct stinger_info *s = data;
+
+	obs_enter_graphics();
+	free_preloaded_frames(s);
+	obs_leave_graphics();
+
 	obs_source_release(s->media_source);
 	bfree(s);
 }
 
+static inline size_t preloaded_size(struct stinger_info *s)
+{
+	return (size_t)s->frame_cx * s->frame_cy * 4 * s->frames.num;
+}
+
+static void start_capture(struct stinger_info *s)
+{
+	/* the warm-up run is not part of any transition, keep it silent */
+	obs_source_set_monitoring_type(s->media_source,
+				       OBS_MONITORING_TYPE_NONE);
+	obs_source_media_restart(s->media_source);
+
+	s->capture_start_ns = os_gettime_ns();
+	s->capture_playing = false;
+	s->preload_state = PRELOAD_CAPTURING;
+}
+
+static void end_capture(struct stinger_info *s, bool arm)
+{
+	obs_source_set_monitoring_type(s->media_source, s->monitoring_type);
+
+	gs_texrender_destroy(s->capture);
+	s->capture = NULL;
+
+	if (arm && s->frames.num) {
+		/* paused at the start, the next frames are decoded ahead */
+		obs_source_media_restart_to_pos(s->media_source, true, 0);
+		s->preload_state = PRELOAD_READY;
+
+		blog(LOG_INFO,
+		     "[stinger: '%s'] Preloaded %zu frames (%.1f MB)",
+		     obs_source_get_name(s->source), s->frames.num,
+		     (double)preloaded_size(s) / (1024.0 * 1024.0));
+	} else if (arm) {
+		/* don't retry until the settings change */
+		s->preload_state = PRELOAD_FAILED;
+	} else {
+		s->preload_state = PRELOAD_NONE;
+	}
+}
+
+static void capture_frame(struct stinger_info *s)
+{
+	obs_source_t *media = s->media_source;
+	enum obs_media_state state = obs_source_media_get_state(media);
+	uint32_t cx = obs_source_get_width(media);
+	uint32_t cy = obs_source_get_height(media);
+	uint64_t ts;
+
+	/* until the restart is through, the state is the one of the last
+	 * run */
+	if (state == OBS_MEDIA_STATE_PLAYING)
+		s->capture_playing = true;
+
+	if ((s->capture_playing && (state == OBS_MEDIA_STATE_ENDED ||
+				    state == OBS_MEDIA_STATE_STOPPED)) ||
+	    state == OBS_MEDIA_STATE_ERROR ||
+	    os_gettime_ns() - s->capture_start_ns > PRELOAD_TIMEOUT_NS) {
+		end_capture(s, true);
+		return;
+	}
+
+	if (state != OBS_MEDIA_STATE_PLAYING ||
+	    !obs_source_media_is_update_done(media) || !cx || !cy)
+		return;
+
+	ts = (uint64_t)obs_source_media_get_time(media) * 1000000ULL;
+	if (s->frames.num) {
+		if (ts <= s->frames.array[s->frames.num - 1].ts)
+			return;
+		if (cx != s->frame_cx || cy != s->frame_cy) {
+			end_capture(s, true);
+			return;
+		}
+	}
+
+	if (!s->capture)
+		s->capture = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+
+	gs_texrender_reset(s->capture);
+	if (!gs_texrender_begin(s->capture, cx, cy))
+		return;
+
+	struct vec4 clear_color;
+	vec4_zero(&clear_color);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+	gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+	/* keep the alpha of the stinger as is */
+	gs_blend_state_push();
+	gs_enable_blending(false);
+	obs_source_video_render(media);
+	gs_blend_state_pop();
+
+	gs_texrender_end(s->capture);
+
+	struct stinger_frame *frame = da_push_back_new(s->frames);
+	frame->tex = gs_texture_create(cx, cy, GS_RGBA, 1, NULL, 0);
+	frame->ts = ts;
+	gs_copy_texture(frame->tex, gs_texrender_get_texture(s->capture));
+
+	s->frame_cx = cx;
+	s->frame_cy = cy;
+
+	if (s->frames.num >= (size_t)s->preload_frames)
+		end_capture(s, true);
+}
+
+static void stinger_video_tick(void *data, float seconds)
+{
+	struct stinger_info *s = data;
+
+	if (os_atomic_set_bool(&s->preload_reset, false)) {
+		obs_enter_graphics();
+		free_preloaded_frames(s);
+		obs_leave_graphics();
+
+		s->preload_state = PRELOAD_NONE;
+	}
+
+	if (!s->media_source || s->transitioning || s->preload_frames <= 0)
+		return;
+
+	if (s->preload_state == PRELOAD_NONE) {
+		start_capture(s);
+
+	} else if (s->preload_state == PRELOAD_CAPTURING) {
+		obs_enter_graphics();
+		capture_frame(s);
+		obs_leave_graphics();
+	}
+
+	UNUSED_PARAMETER(seconds);
+}
+
+/* the resident frame for this point of the transition, as long as the media
+ * itself hasn't caught up with it */
+static gs_texture_t *get_preloaded_frame(struct stinger_info *s, float t)
+{
+	struct stinger_frame *frame = NULL;
+	struct stinger_frame *last;
+	uint64_t elapsed;
+	uint64_t media_ts;
+
+	if (s->preload_state != PRELOAD_READY || !s->frames.num)
+		return NULL;
+
+	last = s->frames.array + (s->frames.num - 1);
+	elapsed = (uint64_t)((double)t * (double)s->duration_ns);
+	if (elapsed > last->ts + obs_get_frame_interval_ns())
+		return NULL;
+
+	for (size_t i = s->frames.num; i > 0; i--) {
+		if (s->frames.array[i - 1].ts <= elapsed) {
+			frame = &s->frames.array[i - 1];
+			break;
+		}
+	}
+
+	if (!frame)
+		frame = s->frames.array;
+
+	media_ts = (uint64_t)obs_source_media_get_time(s->media_source) *
+		   1000000ULL;
+	if (obs_source_media_get_state(s->media_source) ==
+		    OBS_MEDIA_STATE_PLAYING &&
+	    media_ts > frame->ts)
+		return NULL;
+
+	return frame->tex;
+}
+
+static void draw_preloaded_frame(gs_texture_t *tex)
+{
+	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+
+	gs_effect_set_texture(image, tex);
+
+	while (gs_effect_loop(effect, "Draw"))
+		gs_draw_sprite(tex, 0, 0, 0);
+}
+
 static void stinger_video_render(void *data, gs_effect_t *effect)
 {
 	//PRISM/Wang.Chuanjing/20200916/Nelo/for transition crash
@@ -123,6 +357,12 @@ static void stinger_video_render(void *data, gs_effect_t *effect)
 	float source_cy = (float)obs_source_get_height(s->source);
 	uint32_t media_cx = obs_source_get_width(s->media_source);
 	uint32_t media_cy = obs_source_get_height(s->media_source);
+	gs_texture_t *preloaded = get_preloaded_frame(s, t);
+
+	if (preloaded) {
+		media_cx = s->frame_cx;
+		media_cy = s->frame_cy;
+	}
 
 	if (!media_cx || !media_cy)
 		return;
@@ -132,7 +372,10 @@ static void stinger_video_render(void *data, gs_effect_t *effect)
 
 	gs_matrix_push();
 	gs_matrix_scale3f(scale_x, scale_y, 1.0f);
-	obs_source_video_render(s->media_source);
+	if (preloaded)
+		draw_preloaded_frame(preloaded);
+	else
+		obs_source_video_render(s->media_source);
 	gs_matrix_pop();
 
 	UNUSED_PARAMETER(effect);
@@ -221,10 +464,20 @@ static void stinger_transition_start(void *data)
 
 	if (s->media_source) {
 		calldata_t cd = {0};
+		bool restart = false;
 
 		proc_handler_t *ph =
 			obs_source_get_proc_handler(s->media_source);
 
+		/* an unfinished warm-up left the media somewhere in the
+		 * middle */
+		if (s->preload_state == PRELOAD_CAPTURING) {
+			obs_enter_graphics();
+			end_capture(s, false);
+			obs_leave_graphics();
+			restart = true;
+		}
+
 		if (s->transitioning) {
 			proc_handler_call(ph, "restart", &cd);
 			return;
@@ -258,6 +511,14 @@ static void stinger_transition_start(void *data)
 
 		calldata_free(&cd);
 
+		/* the media may have been closed since it was armed */
+		if (s->preload_state == PRELOAD_READY &&
+		    obs_source_media_get_state(s->media_source) ==
+			    OBS_MEDIA_STATE_PAUSED)
+			obs_source_media_play_pause(s->media_source, false);
+		else if (restart || s->preload_state == PRELOAD_READY)
+			obs_source_media_restart(s->media_source);
+
 		obs_source_add_active_child(s->source, s->media_source);
 	}
 
@@ -268,9 +529,15 @@ static void stinger_transition_stop(void *data)
 {
 	struct stinger_info *s = data;
 
-	if (s->media_source)
+	if (s->media_source) {
 		obs_source_remove_active_child(s->source, s->media_source);
 
+		/* ready for the next transition */
+		if (s->preload_state == PRELOAD_READY)
+			obs_source_media_restart_to_pos(s->media_source, true,
+							0);
+	}
+
 	s->transitioning = false;
 }
 
@@ -313,6 +580,30 @@ static bool transition_point_type_modified(obs_properties_t *ppts,
 	return true;
 }
 
+/* shows the memory the resident frames take, or would take */
+static void set_preload_memory_suffix(obs_property_t *p,
+				      struct stinger_info *s)
+{
+	struct dstr suffix = {0};
+	char size[32];
+	double bytes = 0.0;
+
+	if (s && s->preload_state == PRELOAD_READY) {
+		bytes = (double)preloaded_size(s);
+	} else if (s && s->media_source) {
+		bytes = (double)obs_source_get_width(s->media_source) *
+			(double)obs_source_get_height(s->media_source) * 4.0 *
+			(double)s->preload_frames;
+	}
+
+	snprintf(size, sizeof(size), "%.1f", bytes / (1024.0 * 1024.0));
+
+	dstr_copy(&suffix, obs_module_text("PreloadMemory"));
+	dstr_replace(&suffix, "%1", size);
+	obs_property_int_set_suffix(p, suffix.array);
+	dstr_free(&suffix);
+}
+
 static obs_properties_t *stinger_properties(void *data)
 {
 	obs_properties_t *ppts = obs_properties_create();
@@ -335,6 +626,10 @@ static obs_properties_t *stinger_properties(void *data)
 			       obs_module_text("TransitionPoint"), 0, 120000,
 			       1);
 
+	p = obs_properties_add_int(ppts, "preload_frames",
+				   obs_module_text("PreloadFrames"), 0, 300, 1);
+	set_preload_memory_suffix(p, data);
+
 	obs_property_t *monitor_list = obs_properties_add_list(
 		ppts, "audio_monitoring", obs_module_text("AudioMonitoring"),
 		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
@@ -363,6 +658,12 @@ static obs_properties_t *stinger_properties(void *data)
 	return ppts;
 }
 
+static void stinger_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, "preload_frames",
+				 PRELOAD_FRAMES_DEFAULT);
+}
+
 struct obs_source_info stinger_transition = {
 	.id = "obs_stinger_transition",
 	.type = OBS_SOURCE_TYPE_TRANSITION,
@@ -370,6 +671,8 @@ struct obs_source_info stinger_transition = {
 	.create = stinger_create,
 	.destroy = stinger_destroy,
 	.update = stinger_update,
+	.get_defaults = stinger_defaults,
+	.video_tick = stinger_video_tick,
 	.video_render = stinger_video_render,
 	.audio_render = stinger_audio_render,
 	.get_properties = stinger_properties,
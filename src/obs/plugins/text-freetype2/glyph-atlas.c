@@ -0,0 +1,350 @@
+#include <obs-module.h>
+#include <util/bmem.h>
+#include "glyph-atlas.h"
+
+extern FT_Library ft2_lib;
+extern uint32_t texbuf_w, texbuf_h;
+
+/* keeps linear filtering from bleeding into the neighbouring glyphs */
+#define GLYPH_PADDING 1
+
+/* rows are a bit taller than the glyph that opens them so that glyphs of
+ * similar height can share them */
+#define SHELF_ALIGN 4
+
+static pthread_mutex_t atlas_list_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct glyph_atlas *first_atlas = NULL;
+
+static void evict_shelf(struct glyph_atlas *atlas, uint32_t idx)
+{
+	struct glyph_shelf *shelf = atlas->shelves.array + idx;
+
+	for (size_t i = 0; i < num_cache_slots; i++) {
+		struct glyph_info *glyph = atlas->glyphs[i];
+
+		if (glyph && glyph->shelf == idx) {
+			bfree(glyph);
+			atlas->glyphs[i] = NULL;
+		}
+	}
+
+	for (uint32_t y = 0; y < shelf->h; y++)
+		memset(atlas->texbuf + (shelf->y + y) * texbuf_w, 0, texbuf_w);
+
+	shelf->x = 0;
+	atlas->dirty = true;
+}
+
+static struct glyph_shelf *find_space(struct glyph_atlas *atlas, uint32_t w,
+				      uint32_t h)
+{
+	struct glyph_shelf *best = NULL;
+	struct glyph_shelf *lru = NULL;
+	uint32_t shelf_h = (h + SHELF_ALIGN) & ~(SHELF_ALIGN - 1);
+	uint32_t next_y = 0;
+
+	if (w + GLYPH_PADDING > texbuf_w)
+		return NULL;
+
+	for (size_t i = 0; i < atlas->shelves.num; i++) {
+		struct glyph_shelf *shelf = atlas->shelves.array + i;
+
+		next_y = shelf->y + shelf->h + GLYPH_PADDING;
+
+		if (shelf->h < h || shelf->x + w + GLYPH_PADDING > texbuf_w)
+			continue;
+		if (!best || shelf->h < best->h)
+			best = shelf;
+	}
+
+	/* don't waste tall rows on small glyphs while there's room left */
+	if (best && best->h <= shelf_h * 2)
+		return best;
+
+	if (next_y + shelf_h <= texbuf_h) {
+		struct glyph_shelf *shelf = da_push_back_new(atlas->shelves);
+		shelf->y = next_y;
+		shelf->h = shelf_h;
+		return shelf;
+	}
+
+	if (best)
+		return best;
+
+	/* full, evict the row used longest ago that no text holds, which
+	 * includes the rows of the text that is being cached */
+	for (size_t i = 0; i < atlas->shelves.num; i++) {
+		struct glyph_shelf *shelf = atlas->shelves.array + i;
+
+		if (shelf->h < h || shelf->users > 0)
+			continue;
+		if (!lru || shelf->last_used < lru->last_used)
+			lru = shelf;
+	}
+
+	if (lru)
+		evict_shelf(atlas, (uint32_t)(lru - atlas->shelves.array));
+	return lru;
+}
+
+static void hold_glyph(struct glyph_atlas *atlas, struct glyph_atlas_use *use,
+		       const struct glyph_info *glyph)
+{
+	uint32_t idx = glyph->shelf;
+
+	if (!use)
+		return;
+	if (use->max_h < (uint32_t)glyph->h)
+		use->max_h = (uint32_t)glyph->h;
+
+	if (da_find(use->shelves, &idx, 0) == DARRAY_INVALID) {
+		da_push_back(use->shelves, &idx);
+		atlas->shelves.array[idx].users++;
+	}
+}
+
+/* call with the atlas locked */
+static void release_shelves(struct glyph_atlas *atlas,
+			    struct glyph_atlas_use *use)
+{
+	for (size_t i = 0; i < use->shelves.num; i++)
+		atlas->shelves.array[use->shelves.array[i]].users--;
+
+	da_free(use->shelves);
+	use->max_h = 0;
+}
+
+void glyph_atlas_release_use(struct glyph_atlas *atlas,
+			     struct glyph_atlas_use *use)
+{
+	if (!atlas) {
+		da_free(use->shelves);
+		use->max_h = 0;
+		return;
+	}
+
+	pthread_mutex_lock(&atlas->mutex);
+	release_shelves(atlas, use);
+	pthread_mutex_unlock(&atlas->mutex);
+}
+
+#define glyph_pos x + (y * slot->bitmap.pitch)
+#define buf_pos (shelf->x + x) + ((shelf->y + y) * texbuf_w)
+
+void glyph_atlas_cache(struct glyph_atlas *atlas, struct glyph_atlas_use *use,
+		       const wchar_t *text)
+{
+	struct glyph_atlas_use prev = {0};
+	FT_GlyphSlot slot;
+	FT_UInt glyph_index;
+	uint32_t cached_glyphs = 0;
+	uint64_t seq;
+	size_t len;
+
+	if (!atlas || !text)
+		return;
+
+	pthread_mutex_lock(&atlas->mutex);
+
+	/* the previous text keeps its rows until the new one holds its own,
+	 * the vertex buffer still draws it until it is laid out again */
+	if (use) {
+		prev = *use;
+		memset(use, 0, sizeof(*use));
+	}
+
+	slot = atlas->face->glyph;
+	seq = ++atlas->use_counter;
+	len = wcslen(text);
+
+	for (size_t i = 0; i < len; i++) {
+		struct glyph_shelf *shelf;
+		struct glyph_info *glyph;
+
+		glyph_index = FT_Get_Char_Index(atlas->face, text[i]);
+		if (glyph_index >= num_cache_slots)
+			continue;
+
+		glyph = atlas->glyphs[glyph_index];
+		if (glyph) {
+			atlas->shelves.array[glyph->shelf].last_used = seq;
+			hold_glyph(atlas, use, glyph);
+			continue;
+		}
+
+		FT_Load_Glyph(atlas->face, glyph_index, FT_LOAD_DEFAULT);
+		FT_Render_Glyph(slot, FT_RENDER_MODE_NORMAL);
+
+		uint32_t g_w = slot->bitmap.width;
+		uint32_t g_h = slot->bitmap.rows;
+
+		shelf = find_space(atlas, g_w, g_h);
+		if (!shelf) {
+			blog(LOG_WARNING,
+			     "Out of space trying to render glyphs");
+			break;
+		}
+
+		glyph = bzalloc(sizeof(struct glyph_info));
+		glyph->u = (float)shelf->x / (float)texbuf_w;
+		glyph->u2 = (float)(shelf->x + g_w) / (float)texbuf_w;
+		glyph->v = (float)shelf->y / (float)texbuf_h;
+		glyph->v2 = (float)(shelf->y + g_h) / (float)texbuf_h;
+		glyph->w = g_w;
+		glyph->h = g_h;
+		glyph->yoff = slot->bitmap_top;
+		glyph->xoff = slot->bitmap_left;
+		glyph->xadv = slot->advance.x >> 6;
+		glyph->shelf = (uint32_t)(shelf - atlas->shelves.array);
+		atlas->glyphs[glyph_index] = glyph;
+
+		for (uint32_t y = 0; y < g_h; y++) {
+			for (uint32_t x = 0; x < g_w; x++)
+				atlas->texbuf[buf_pos] =
+					slot->bitmap.buffer[glyph_pos];
+		}
+
+		shelf->x += g_w + GLYPH_PADDING;
+		shelf->last_used = seq;
+		hold_glyph(atlas, use, glyph);
+		cached_glyphs++;
+	}
+
+	if (cached_glyphs > 0)
+		atlas->dirty = true;
+
+	release_shelves(atlas, &prev);
+
+	pthread_mutex_unlock(&atlas->mutex);
+}
+
+gs_texture_t *glyph_atlas_get_texture(struct glyph_atlas *atlas)
+{
+	gs_texture_t *tex;
+
+	pthread_mutex_lock(&atlas->mutex);
+
+	if (!atlas->tex) {
+		atlas->tex = gs_texture_create(
+			texbuf_w, texbuf_h, GS_A8, 1,
+			(const uint8_t **)&atlas->texbuf, GS_DYNAMIC);
+		atlas->dirty = false;
+
+	} else if (atlas->dirty) {
+		gs_texture_set_image(atlas->tex, atlas->texbuf, texbuf_w,
+				     false);
+		atlas->dirty = false;
+	}
+
+	tex = atlas->tex;
+
+	pthread_mutex_unlock(&atlas->mutex);
+	return tex;
+}
+
+static void glyph_atlas_destroy(struct glyph_atlas *atlas)
+{
+	for (size_t i = 0; i < num_cache_slots; i++)
+		bfree(atlas->glyphs[i]);
+
+	if (atlas->tex) {
+		obs_enter_graphics();
+		gs_texture_destroy(atlas->tex);
+		obs_leave_graphics();
+	}
+
+	if (atlas->face)
+		FT_Done_Face(atlas->face);
+
+	da_free(atlas->shelves);
+	pthread_mutex_destroy(&atlas->mutex);
+	bfree(atlas->texbuf);
+	bfree(atlas->path);
+	bfree(atlas);
+}
+
+static struct glyph_atlas *glyph_atlas_create(const char *path, FT_Long index,
+					      uint16_t size)
+{
+	struct glyph_atlas *atlas = bzalloc(sizeof(struct glyph_atlas));
+	struct glyph_atlas_use use = {0};
+
+	if (pthread_mutex_init(&atlas->mutex, NULL) != 0) {
+		bfree(atlas);
+		return NULL;
+	}
+
+	atlas->refs = 1;
+	atlas->path = bstrdup(path);
+	atlas->index = index;
+	atlas->size = size;
+
+	if (FT_New_Face(ft2_lib, path, index, &atlas->face) != 0) {
+		atlas->face = NULL;
+		glyph_atlas_destroy(atlas);
+		return NULL;
+	}
+
+	FT_Set_Pixel_Sizes(atlas->face, 0, size);
+	FT_Select_Charmap(atlas->face, FT_ENCODING_UNICODE);
+
+	atlas->texbuf = bzalloc(texbuf_w * texbuf_h);
+
+	glyph_atlas_cache(atlas, &use,
+			  L"abcdefghijklmnopqrstuvwxyz"
+			  L"ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890"
+			  L"!@#$%^&*()-_=+,<.>/?\\|[]{}`~ \'\"\0");
+	atlas->base_h = use.max_h;
+	glyph_atlas_release_use(atlas, &use);
+	return atlas;
+}
+
+struct glyph_atlas *glyph_atlas_get(const char *path, FT_Long index,
+				    uint16_t size)
+{
+	struct glyph_atlas *atlas;
+
+	/* also serializes the use of the freetype library */
+	pthread_mutex_lock(&atlas_list_mutex);
+
+	for (atlas = first_atlas; atlas; atlas = atlas->next) {
+		if (atlas->index == index && atlas->size == size &&
+		    strcmp(atlas->path, path) == 0) {
+			atlas->refs++;
+			goto unlock;
+		}
+	}
+
+	atlas = glyph_atlas_create(path, index, size);
+	if (atlas) {
+		atlas->next = first_atlas;
+		first_atlas = atlas;
+	}
+
+unlock:
+	pthread_mutex_unlock(&atlas_list_mutex);
+	return atlas;
+}
+
+void glyph_atlas_release(struct glyph_atlas *atlas)
+{
+	struct glyph_atlas **prev;
+
+	if (!atlas)
+		return;
+
+	pthread_mutex_lock(&atlas_list_mutex);
+
+	if (--atlas->refs == 0) {
+		for (prev = &first_atlas; *prev; prev = &(*prev)->next) {
+			if (*prev == atlas) {
+				*prev = atlas->next;
+				break;
+			}
+		}
+
+		glyph_atlas_destroy(atlas);
+	}
+
+	pthread_mutex_unlock(&atlas_list_mutex);
+}
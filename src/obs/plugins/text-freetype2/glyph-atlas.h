@@ -0,0 +1,86 @@
+#pragma once
+
+#include <obs-module.h>
+#include <util/darray.h>
+#include <util/threading.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#define num_cache_slots 65535
+
+struct glyph_info {
+	float u, v, u2, v2;
+	int32_t w, h, xoff, yoff;
+	int32_t xadv;
+	uint32_t shelf;
+};
+
+/* glyphs are packed into rows of the atlas, a row is evicted as a whole */
+struct glyph_shelf {
+	uint32_t x, y, h;
+	uint64_t last_used;
+	long users;
+};
+
+/* the rows holding the glyphs of one source's text, and the tallest of
+ * those glyphs */
+struct glyph_atlas_use {
+	DARRAY(uint32_t) shelves;
+	uint32_t max_h;
+};
+
+/* One atlas is shared by every text source that uses the same font file,
+ * face and size.  Glyphs are rendered into it the first time any of them
+ * needs them, and when it is full the least recently used row that no
+ * source's text holds is evicted, so the glyphs of laid out text stay
+ * valid. */
+struct glyph_atlas {
+	struct glyph_atlas *next;
+	long refs;
+
+	char *path;
+	FT_Long index;
+	uint16_t size;
+
+	pthread_mutex_t mutex;
+	FT_Face face;
+
+	/* tallest of the standard glyphs, the minimum line height */
+	uint32_t base_h;
+
+	uint8_t *texbuf;
+	gs_texture_t *tex;
+	bool dirty;
+
+	DARRAY(struct glyph_shelf) shelves;
+	uint64_t use_counter;
+
+	struct glyph_info *glyphs[num_cache_slots];
+};
+
+extern struct glyph_atlas *glyph_atlas_get(const char *path, FT_Long index,
+					   uint16_t size);
+extern void glyph_atlas_release(struct glyph_atlas *atlas);
+
+/* renders the glyphs of the text that aren't in the atlas yet, and makes
+ * use hold the rows of the text instead of those of its previous text */
+extern void glyph_atlas_cache(struct glyph_atlas *atlas,
+			      struct glyph_atlas_use *use, const wchar_t *text);
+
+/* lets the rows held by use be evicted again, atlas may be NULL */
+extern void glyph_atlas_release_use(struct glyph_atlas *atlas,
+				    struct glyph_atlas_use *use);
+
+/* uploads the glyphs added since the last call, graphics thread only */
+extern gs_texture_t *glyph_atlas_get_texture(struct glyph_atlas *atlas);
+
+/* the glyph table may only be read with the atlas locked */
+static inline void glyph_atlas_lock(struct glyph_atlas *atlas)
+{
+	pthread_mutex_lock(&atlas->mutex);
+}
+
+static inline void glyph_atlas_unlock(struct glyph_atlas *atlas)
+{
+	pthread_mutex_unlock(&atlas->mutex);
+}
@@ -169,17 +169,9 @@ static void ft2_source_destroy(void *data)
 {
 	struct ft2_source *srcdata = data;
 
-	if (srcdata->font_face != NULL) {
-		FT_Done_Face(srcdata->font_face);
-		srcdata->font_face = NULL;
-	}
-
-	for (uint32_t i = 0; i < num_cache_slots; i++) {
-		if (srcdata->cacheglyphs[i] != NULL) {
-			bfree(srcdata->cacheglyphs[i]);
-			srcdata->cacheglyphs[i] = NULL;
-		}
-	}
+	glyph_atlas_release_use(srcdata->atlas, &srcdata->atlas_use);
+	glyph_atlas_release(srcdata->atlas);
+	srcdata->atlas = NULL;
 
 	if (srcdata->font_name != NULL)
 		bfree(srcdata->font_name);
@@ -187,8 +179,9 @@ static void ft2_source_destroy(void *data)
 		bfree(srcdata->font_style);
 	if (srcdata->text != NULL)
 		bfree(srcdata->text);
-	if (srcdata->texbuf != NULL)
-		bfree(srcdata->texbuf);
+	if (srcdata->laid_out_text != NULL)
+		bfree(srcdata->laid_out_text);
+	da_free(srcdata->layout);
 	if (srcdata->colorbuf != NULL)
 		bfree(srcdata->colorbuf);
 	if (srcdata->text_file != NULL)
@@ -196,10 +189,6 @@ static void ft2_source_destroy(void *data)
 
 	obs_enter_graphics();
 
-	if (srcdata->tex != NULL) {
-		gs_texture_destroy(srcdata->tex);
-		srcdata->tex = NULL;
-	}
 	if (srcdata->vbuf != NULL) {
 		gs_vertexbuffer_destroy(srcdata->vbuf);
 		srcdata->vbuf = NULL;
@@ -217,22 +206,28 @@ static void ft2_source_destroy(void *data)
 static void ft2_source_render(void *data, gs_effect_t *effect)
 {
 	struct ft2_source *srcdata = data;
+	gs_texture_t *tex;
+
 	if (srcdata == NULL)
 		return;
 
-	if (srcdata->tex == NULL || srcdata->vbuf == NULL)
+	if (srcdata->atlas == NULL || srcdata->vbuf == NULL)
 		return;
 	if (srcdata->text == NULL || *srcdata->text == 0)
 		return;
 
+	tex = glyph_atlas_get_texture(srcdata->atlas);
+	if (tex == NULL)
+		return;
+
 	gs_reset_blend_state();
 	if (srcdata->outline_text)
-		draw_outlines(srcdata);
+		draw_outlines(srcdata, tex);
 	if (srcdata->drop_shadow)
-		draw_drop_shadow(srcdata);
+		draw_drop_shadow(srcdata, tex);
 
-	draw_uv_vbuffer(srcdata->vbuf, srcdata->tex, srcdata->draw_effect,
-			(uint32_t)wcslen(srcdata->text) * 6);
+	draw_uv_vbuffer(srcdata->vbuf, tex, srcdata->draw_effect,
+			srcdata->num_glyphs * 6);
 
 	UNUSED_PARAMETER(effect);
 }
@@ -242,6 +237,7 @@ static void ft2_video_tick(void *data, float seconds)
 	struct ft2_source *srcdata = data;
 	if (srcdata == NULL)
 		return;
+
 	if (!srcdata->from_file || !srcdata->text_file)
 		return;
 
@@ -255,7 +251,8 @@ static void ft2_video_tick(void *data, float seconds)
 			else
 				load_text_from_file(srcdata,
 						    srcdata->text_file);
-			cache_glyphs(srcdata, srcdata->text);
+			glyph_atlas_cache(srcdata->atlas,
+					  &srcdata->atlas_use, srcdata->text);
 			set_up_vertex_buffer(srcdata);
 			srcdata->update_file = false;
 		}
@@ -278,12 +275,10 @@ static bool init_font(struct ft2_source *srcdata)
 	if (!path)
 		return false;
 
-	if (srcdata->font_face != NULL) {
-		FT_Done_Face(srcdata->font_face);
-		srcdata->font_face = NULL;
-	}
-
-	return FT_New_Face(ft2_lib, path, index, &srcdata->font_face) == 0;
+	glyph_atlas_release_use(srcdata->atlas, &srcdata->atlas_use);
+	glyph_atlas_release(srcdata->atlas);
+	srcdata->atlas = glyph_atlas_get(path, index, srcdata->font_size);
+	return srcdata->atlas != NULL;
 }
 
 static void ft2_source_update(void *data, obs_data_t *settings)
@@ -381,7 +376,6 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 		bfree(srcdata->font_style);
 		srcdata->font_name = NULL;
 		srcdata->font_style = NULL;
-		srcdata->max_h = 0;
 		vbuf_needs_update = true;
 	}
 
@@ -390,25 +384,16 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	srcdata->font_size = font_size;
 	srcdata->font_flags = font_flags;
 
-	if (!init_font(srcdata) || srcdata->font_face == NULL) {
+	if (!init_font(srcdata)) {
 		blog(LOG_WARNING, "FT2-text: Failed to load font %s",
 		     srcdata->font_name);
 		goto error;
-	} else {
-		FT_Set_Pixel_Sizes(srcdata->font_face, 0, srcdata->font_size);
-		FT_Select_Charmap(srcdata->font_face, FT_ENCODING_UNICODE);
 	}
 
-	if (srcdata->texbuf != NULL) {
-		bfree(srcdata->texbuf);
-		srcdata->texbuf = NULL;
-	}
-	srcdata->texbuf = bzalloc(texbuf_w * texbuf_h);
-
-	if (srcdata->font_face)
-		cache_standard_glyphs(srcdata);
-
 skip_font_load:
+	if (vbuf_needs_update)
+		invalidate_layout(srcdata);
+
 	if (from_file) {
 		const char *tmp = obs_data_get_string(settings, "text_file");
 
@@ -452,8 +437,9 @@ skip_font_load:
 		os_utf8_to_wcs_ptr(tmp, strlen(tmp), &srcdata->text);
 	}
 
-	if (srcdata->font_face) {
-		cache_glyphs(srcdata, srcdata->text);
+	if (srcdata->atlas) {
+		glyph_atlas_cache(srcdata->atlas, &srcdata->atlas_use,
+				  srcdata->text);
 		set_up_vertex_buffer(srcdata);
 	}
 
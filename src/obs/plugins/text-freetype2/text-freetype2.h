@@ -19,14 +19,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <obs-module.h>
 #include <ft2build.h>
+#include "glyph-atlas.h"
 
-#define num_cache_slots 65535
-#define src_glyph srcdata->cacheglyphs[glyph_index]
+#define src_glyph srcdata->atlas->glyphs[glyph_index]
 
-struct glyph_info {
-	float u, v, u2, v2;
-	int32_t w, h, xoff, yoff;
-	int32_t xadv;
+/* where the layout is before a character of the text */
+struct layout_state {
+	uint32_t dx, dy, max_y;
+	uint32_t glyphs;
 };
 
 struct ft2_source {
@@ -44,20 +44,22 @@ struct ft2_source {
 	uint64_t last_checked;
 
 	uint32_t cx, cy, max_h, custom_width;
-	uint32_t texbuf_x, texbuf_y;
 	uint32_t color[2];
 	uint32_t *colorbuf;
 
 	int32_t cur_scroll, scroll_speed;
 
-	gs_texture_t *tex;
+	struct glyph_atlas *atlas;
+	struct glyph_atlas_use atlas_use;
 
-	struct glyph_info *cacheglyphs[num_cache_slots];
-
-	FT_Face font_face;
-
-	uint8_t *texbuf;
 	gs_vertbuffer_t *vbuf;
+	uint32_t vbuf_glyphs;
+	uint32_t num_glyphs;
+
+	/* the text the vertex buffer holds, and the layout state before each
+	 * of its characters, so only what follows a change is laid out */
+	wchar_t *laid_out_text;
+	DARRAY(struct layout_state) layout;
 
 	gs_effect_t *draw_effect;
 	bool outline_text, drop_shadow;
@@ -75,8 +77,8 @@ static void ft2_source_update(void *data, obs_data_t *settings);
 static void ft2_source_render(void *data, gs_effect_t *effect);
 static void ft2_video_tick(void *data, float seconds);
 
-void draw_outlines(struct ft2_source *srcdata);
-void draw_drop_shadow(struct ft2_source *srcdata);
+void draw_outlines(struct ft2_source *srcdata, gs_texture_t *tex);
+void draw_drop_shadow(struct ft2_source *srcdata, gs_texture_t *tex);
 
 static uint32_t ft2_source_get_width(void *data);
 static uint32_t ft2_source_get_height(void *data);
@@ -91,8 +93,6 @@ time_t get_modified_timestamp(char *filename);
 void load_text_from_file(struct ft2_source *srcdata, const char *filename);
 void read_from_end(struct ft2_source *srcdata, const char *filename);
 
-void cache_standard_glyphs(struct ft2_source *srcdata);
-void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs);
-
 void set_up_vertex_buffer(struct ft2_source *srcdata);
+void invalidate_layout(struct ft2_source *srcdata);
 void fill_vertex_buffer(struct ft2_source *srcdata);
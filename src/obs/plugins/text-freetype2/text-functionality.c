@@ -26,9 +26,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 float offsets[16] = {-2.0f, 0.0f, 0.0f, -2.0f, 2.0f,  0.0f, 2.0f,  0.0f,
 		     0.0f,  2.0f, 0.0f, 2.0f,  -2.0f, 0.0f, -2.0f, 0.0f};
 
-extern uint32_t texbuf_w, texbuf_h;
-
-void draw_outlines(struct ft2_source *srcdata)
+void draw_outlines(struct ft2_source *srcdata, gs_texture_t *tex)
 {
 	// Horrible (hopefully temporary) solution for outlines.
 	uint32_t *tmp;
@@ -45,9 +43,8 @@ void draw_outlines(struct ft2_source *srcdata)
 	for (int32_t i = 0; i < 8; i++) {
 		gs_matrix_translate3f(offsets[i * 2], offsets[(i * 2) + 1],
 				      0.0f);
-		draw_uv_vbuffer(srcdata->vbuf, srcdata->tex,
-				srcdata->draw_effect,
-				(uint32_t)wcslen(srcdata->text) * 6);
+		draw_uv_vbuffer(srcdata->vbuf, tex, srcdata->draw_effect,
+				srcdata->num_glyphs * 6);
 	}
 	gs_matrix_identity();
 	gs_matrix_pop();
@@ -55,7 +52,7 @@ void draw_outlines(struct ft2_source *srcdata)
 	vdata->colors = tmp;
 }
 
-void draw_drop_shadow(struct ft2_source *srcdata)
+void draw_drop_shadow(struct ft2_source *srcdata, gs_texture_t *tex)
 {
 	// Horrible (hopefully temporary) solution for drop shadow.
 	uint32_t *tmp;
@@ -70,51 +67,98 @@ void draw_drop_shadow(struct ft2_source *srcdata)
 
 	gs_matrix_push();
 	gs_matrix_translate3f(4.0f, 4.0f, 0.0f);
-	draw_uv_vbuffer(srcdata->vbuf, srcdata->tex, srcdata->draw_effect,
-			(uint32_t)wcslen(srcdata->text) * 6);
+	draw_uv_vbuffer(srcdata->vbuf, tex, srcdata->draw_effect,
+			srcdata->num_glyphs * 6);
 	gs_matrix_identity();
 	gs_matrix_pop();
 
 	vdata->colors = tmp;
 }
 
+void invalidate_layout(struct ft2_source *srcdata)
+{
+	bfree(srcdata->laid_out_text);
+	srcdata->laid_out_text = NULL;
+	da_resize(srcdata->layout, 0);
+}
+
+/* the vertex buffer only grows, so text that changes all the time (timers,
+ * tickers) keeps reusing it */
+static bool reserve_vertex_buffer(struct ft2_source *srcdata, size_t len)
+{
+	uint32_t glyphs = 64;
+
+	if (srcdata->vbuf && srcdata->vbuf_glyphs >= len)
+		return true;
+
+	while (glyphs < len)
+		glyphs *= 2;
+
+	if (srcdata->vbuf != NULL) {
+		gs_vertexbuffer_destroy(srcdata->vbuf);
+		srcdata->vbuf = NULL;
+		srcdata->vbuf_glyphs = 0;
+	}
+
+	srcdata->vbuf = create_uv_vbuffer(glyphs * 6, true);
+	if (!srcdata->vbuf)
+		return false;
+
+	bfree(srcdata->colorbuf);
+	srcdata->colorbuf = bmalloc(sizeof(uint32_t) * glyphs * 6);
+	for (size_t i = 0; i < glyphs * 6; i++)
+		srcdata->colorbuf[i] = 0xFF000000;
+
+	srcdata->vbuf_glyphs = glyphs;
+	invalidate_layout(srcdata);
+	return true;
+}
+
 void set_up_vertex_buffer(struct ft2_source *srcdata)
 {
 	FT_UInt glyph_index = 0;
 	uint32_t x = 0, space_pos = 0, word_width = 0;
+	uint32_t max_h;
 	size_t len;
 
-	if (!srcdata->text)
+	if (!srcdata->text || !srcdata->atlas)
 		return;
 
+	obs_enter_graphics();
+	glyph_atlas_lock(srcdata->atlas);
+
+	/* the line height only depends on the glyphs of this source's text,
+	 * a taller one changes it */
+	max_h = srcdata->atlas->base_h;
+	if (max_h < srcdata->atlas_use.max_h)
+		max_h = srcdata->atlas_use.max_h;
+
+	if (srcdata->max_h != max_h) {
+		srcdata->max_h = max_h;
+		invalidate_layout(srcdata);
+	}
+
 	if (srcdata->custom_width >= 100)
 		srcdata->cx = srcdata->custom_width;
 	else
 		srcdata->cx = get_ft2_text_width(srcdata->text, srcdata);
 	srcdata->cy = srcdata->max_h;
 
-	obs_enter_graphics();
-	if (srcdata->vbuf != NULL) {
-		gs_vertbuffer_t *tmpvbuf = srcdata->vbuf;
-		srcdata->vbuf = NULL;
-		gs_vertexbuffer_destroy(tmpvbuf);
-	}
-
 	if (*srcdata->text == 0) {
-		obs_leave_graphics();
-		return;
+		srcdata->num_glyphs = 0;
+		invalidate_layout(srcdata);
+		goto finish;
 	}
 
-	srcdata->vbuf =
-		create_uv_vbuffer((uint32_t)wcslen(srcdata->text) * 6, true);
+	len = wcslen(srcdata->text);
+	if (!reserve_vertex_buffer(srcdata, len))
+		goto finish;
 
 	if (srcdata->custom_width <= 100)
 		goto skip_word_wrap;
 	if (!srcdata->word_wrap)
 		goto skip_word_wrap;
 
-	len = wcslen(srcdata->text);
-
 	for (uint32_t i = 0; i <= len; i++) {
 		if (i == wcslen(srcdata->text))
 			goto eos_check;
@@ -138,17 +182,22 @@ void set_up_vertex_buffer(struct ft2_source *srcdata)
 		if (srcdata->text[i] == L' ')
 			space_pos = i;
 	next_char:;
-		glyph_index =
-			FT_Get_Char_Index(srcdata->font_face, srcdata->text[i]);
-		word_width += src_glyph->xadv;
+		glyph_index = FT_Get_Char_Index(srcdata->atlas->face,
+						srcdata->text[i]);
+		if (glyph_index < num_cache_slots && src_glyph != NULL)
+			word_width += src_glyph->xadv;
 	eos_skip:;
 	}
 
 skip_word_wrap:;
 	fill_vertex_buffer(srcdata);
+
+finish:
+	glyph_atlas_unlock(srcdata->atlas);
 	obs_leave_graphics();
 }
 
+/* call with the atlas locked */
 void fill_vertex_buffer(struct ft2_source *srcdata)
 {
 	struct gs_vb_data *vdata = gs_vertexbuffer_get_data(srcdata->vbuf);
@@ -160,178 +209,71 @@ void fill_vertex_buffer(struct ft2_source *srcdata)
 
 	FT_UInt glyph_index = 0;
 
-	uint32_t dx = 0, dy = srcdata->max_h, max_y = dy;
-	uint32_t cur_glyph = 0;
+	struct layout_state state = {0, srcdata->max_h, srcdata->max_h, 0};
 	size_t len = wcslen(srcdata->text);
+	size_t start = 0;
 
-	if (srcdata->colorbuf != NULL) {
-		bfree(srcdata->colorbuf);
-		srcdata->colorbuf = NULL;
-	}
-	srcdata->colorbuf =
-		bzalloc(sizeof(uint32_t) * wcslen(srcdata->text) * 6);
-	for (size_t i = 0; i < len * 6; i++) {
-		srcdata->colorbuf[i] = 0xFF000000;
+	/* everything before the first changed character is laid out the
+	 * same as before */
+	if (srcdata->laid_out_text && srcdata->layout.num) {
+		const wchar_t *old = srcdata->laid_out_text;
+
+		while (start < len && old[start] == srcdata->text[start])
+			start++;
+
+		state = srcdata->layout.array[start];
 	}
 
-	for (size_t i = 0; i < len; i++) {
-	add_linebreak:;
-		if (srcdata->text[i] != L'\n')
-			goto draw_glyph;
-		dx = 0;
-		i++;
-		dy += srcdata->max_h + 4;
-		if (i == wcslen(srcdata->text))
-			goto skip_glyph;
-		if (srcdata->text[i] == L'\n')
-			goto add_linebreak;
-	draw_glyph:;
-		// Skip filthy dual byte Windows line breaks
-		if (srcdata->text[i] == L'\r')
-			goto skip_glyph;
+	da_resize(srcdata->layout, len + 1);
 
-		glyph_index =
-			FT_Get_Char_Index(srcdata->font_face, srcdata->text[i]);
-		if (src_glyph == NULL)
-			goto skip_glyph;
+	for (size_t i = start; i < len; i++) {
+		uint32_t cur_glyph = state.glyphs;
 
-		if (srcdata->custom_width < 100)
-			goto skip_custom_width;
+		srcdata->layout.array[i] = state;
 
-		if (dx + src_glyph->xadv > srcdata->custom_width) {
-			dx = 0;
-			dy += srcdata->max_h + 4;
+		if (srcdata->text[i] == L'\n') {
+			state.dx = 0;
+			state.dy += srcdata->max_h + 4;
+			continue;
 		}
 
-	skip_custom_width:;
+		// Skip filthy dual byte Windows line breaks
+		if (srcdata->text[i] == L'\r')
+			continue;
+
+		glyph_index = FT_Get_Char_Index(srcdata->atlas->face,
+						srcdata->text[i]);
+		if (glyph_index >= num_cache_slots || src_glyph == NULL)
+			continue;
+
+		if (srcdata->custom_width >= 100 &&
+		    state.dx + src_glyph->xadv > srcdata->custom_width) {
+			state.dx = 0;
+			state.dy += srcdata->max_h + 4;
+		}
 
 		set_v3_rect(vdata->points + (cur_glyph * 6),
-			    (float)dx + (float)src_glyph->xoff,
-			    (float)dy - (float)src_glyph->yoff,
+			    (float)state.dx + (float)src_glyph->xoff,
+			    (float)state.dy - (float)src_glyph->yoff,
 			    (float)src_glyph->w, (float)src_glyph->h);
 		set_v2_uv(tvarray + (cur_glyph * 6), src_glyph->u, src_glyph->v,
 			  src_glyph->u2, src_glyph->v2);
 		set_rect_colors2(col + (cur_glyph * 6), srcdata->color[0],
 				 srcdata->color[1]);
-		dx += src_glyph->xadv;
-		if (dy - (float)src_glyph->yoff + src_glyph->h > max_y)
-			max_y = dy - src_glyph->yoff + src_glyph->h;
-		cur_glyph++;
-	skip_glyph:;
+		state.dx += src_glyph->xadv;
+		if (state.dy - (float)src_glyph->yoff + src_glyph->h >
+		    state.max_y)
+			state.max_y = state.dy - src_glyph->yoff + src_glyph->h;
+		state.glyphs++;
 	}
 
-	srcdata->cy = max_y;
-}
-
-void cache_standard_glyphs(struct ft2_source *srcdata)
-{
-	for (uint32_t i = 0; i < num_cache_slots; i++) {
-		if (srcdata->cacheglyphs[i] != NULL) {
-			bfree(srcdata->cacheglyphs[i]);
-			srcdata->cacheglyphs[i] = NULL;
-		}
-	}
+	srcdata->layout.array[len] = state;
 
-	srcdata->texbuf_x = 0;
-	srcdata->texbuf_y = 0;
+	bfree(srcdata->laid_out_text);
+	srcdata->laid_out_text = bwstrdup(srcdata->text);
 
-	cache_glyphs(srcdata, L"abcdefghijklmnopqrstuvwxyz"
-			      L"ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890"
-			      L"!@#$%^&*()-_=+,<.>/?\\|[]{}`~ \'\"\0");
-}
-
-#define glyph_pos x + (y * slot->bitmap.pitch)
-#define buf_pos (dx + x) + ((dy + y) * texbuf_w)
-
-void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs)
-{
-	FT_GlyphSlot slot;
-	FT_UInt glyph_index = 0;
-
-	if (!srcdata->font_face || !cache_glyphs)
-		return;
-
-	slot = srcdata->font_face->glyph;
-
-	uint32_t dx = srcdata->texbuf_x, dy = srcdata->texbuf_y;
-
-	int32_t cached_glyphs = 0;
-	size_t len = wcslen(cache_glyphs);
-
-	for (size_t i = 0; i < len; i++) {
-		glyph_index =
-			FT_Get_Char_Index(srcdata->font_face, cache_glyphs[i]);
-
-		if (src_glyph != NULL)
-			goto skip_glyph;
-
-		FT_Load_Glyph(srcdata->font_face, glyph_index, FT_LOAD_DEFAULT);
-		FT_Render_Glyph(slot, FT_RENDER_MODE_NORMAL);
-
-		uint32_t g_w = slot->bitmap.width;
-		uint32_t g_h = slot->bitmap.rows;
-
-		if (srcdata->max_h < g_h)
-			srcdata->max_h = g_h;
-
-		if (dx + g_w >= texbuf_w) {
-			dx = 0;
-			dy += srcdata->max_h + 1;
-		}
-
-		if (dy + g_h >= texbuf_h) {
-			blog(LOG_WARNING,
-			     "Out of space trying to render glyphs");
-			break;
-		}
-
-		src_glyph = bzalloc(sizeof(struct glyph_info));
-		src_glyph->u = (float)dx / (float)texbuf_w;
-		src_glyph->u2 = (float)(dx + g_w) / (float)texbuf_w;
-		src_glyph->v = (float)dy / (float)texbuf_h;
-		src_glyph->v2 = (float)(dy + g_h) / (float)texbuf_h;
-		src_glyph->w = g_w;
-		src_glyph->h = g_h;
-		src_glyph->yoff = slot->bitmap_top;
-		src_glyph->xoff = slot->bitmap_left;
-		src_glyph->xadv = slot->advance.x >> 6;
-
-		for (uint32_t y = 0; y < g_h; y++) {
-			for (uint32_t x = 0; x < g_w; x++)
-				srcdata->texbuf[buf_pos] =
-					slot->bitmap.buffer[glyph_pos];
-		}
-
-		dx += (g_w + 1);
-		if (dx >= texbuf_w) {
-			dx = 0;
-			dy += srcdata->max_h;
-		}
-
-		cached_glyphs++;
-	skip_glyph:;
-	}
-
-	srcdata->texbuf_x = dx;
-	srcdata->texbuf_y = dy;
-
-	if (cached_glyphs > 0) {
-
-		obs_enter_graphics();
-
-		if (srcdata->tex != NULL) {
-			gs_texture_t *tmp_texture = NULL;
-			tmp_texture = srcdata->tex;
-			srcdata->tex = NULL;
-			gs_texture_destroy(tmp_texture);
-		}
-
-		srcdata->tex = gs_texture_create(
-			texbuf_w, texbuf_h, GS_A8, 1,
-			(const uint8_t **)&srcdata->texbuf, 0);
-
-		obs_leave_graphics();
-	}
+	srcdata->num_glyphs = state.glyphs;
+	srcdata->cy = state.max_y;
 }
 
 time_t get_modified_timestamp(char *filename)
@@ -497,7 +439,7 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 
 uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata)
 {
-	FT_GlyphSlot slot = srcdata->font_face->glyph;
+	FT_Face face = srcdata->atlas->face;
 	FT_UInt glyph_index = 0;
 	uint32_t w = 0, max_w = 0;
 	size_t len;
@@ -507,16 +449,23 @@ uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata)
 
 	len = wcslen(text);
 	for (size_t i = 0; i < len; i++) {
-		glyph_index = FT_Get_Char_Index(srcdata->font_face, text[i]);
-		FT_Load_Glyph(srcdata->font_face, glyph_index, FT_LOAD_DEFAULT);
-
-		if (text[i] == L'\n')
+		if (text[i] == L'\n') {
 			w = 0;
-		else {
-			w += slot->advance.x >> 6;
-			if (w > max_w)
-				max_w = w;
+			continue;
 		}
+
+		/* the advances of cached glyphs don't need the glyph to be
+		 * loaded again */
+		glyph_index = FT_Get_Char_Index(face, text[i]);
+		if (glyph_index < num_cache_slots && src_glyph != NULL) {
+			w += src_glyph->xadv;
+		} else {
+			FT_Load_Glyph(face, glyph_index, FT_LOAD_DEFAULT);
+			w += face->glyph->advance.x >> 6;
+		}
+
+		if (w > max_w)
+			max_w = w;
 	}
 
 	return max_w;
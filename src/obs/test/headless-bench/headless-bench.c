@@ -0,0 +1,200 @@
+/*
+ * Runs the graphics thread, output conversion and raw video output on the
+ * software graphics module, so that frame pacing and the CPU cost of each
+ * stage can be measured on hosts without a GPU.
+ *
+ *   headless-bench [seconds] [items] [trace.json]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <obs.h>
+#include <util/darray.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+
+#define BASE_WIDTH 1920
+#define BASE_HEIGHT 1080
+#define OUTPUT_WIDTH 1280
+#define OUTPUT_HEIGHT 720
+
+struct frame_stats {
+	DARRAY(uint64_t) timestamps;
+};
+
+static void receive_frame(void *param, struct video_data *frame)
+{
+	struct frame_stats *stats = param;
+	da_push_back(stats->timestamps, &frame->timestamp);
+}
+
+static bool create_obs(profiler_name_store_t *names)
+{
+	struct obs_video_info ovi = {0};
+	struct obs_audio_info oai = {0};
+
+	if (!obs_startup("en-US", NULL, names))
+		return false;
+
+	ovi.graphics_module = DL_SOFTWARE;
+	ovi.fps_num = 30;
+	ovi.fps_den = 1;
+	ovi.base_width = BASE_WIDTH;
+	ovi.base_height = BASE_HEIGHT;
+	ovi.output_width = OUTPUT_WIDTH;
+	ovi.output_height = OUTPUT_HEIGHT;
+	ovi.output_format = VIDEO_FORMAT_NV12;
+	ovi.gpu_conversion = true;
+	ovi.colorspace = VIDEO_CS_709;
+	ovi.range = VIDEO_RANGE_PARTIAL;
+	ovi.scale_type = OBS_SCALE_BICUBIC;
+
+	if (obs_reset_video(&ovi) != OBS_VIDEO_SUCCESS)
+		return false;
+
+	oai.samples_per_sec = 48000;
+	oai.speakers = SPEAKERS_STEREO;
+	return obs_reset_audio(&oai);
+}
+
+static obs_scene_t *create_scene(int items)
+{
+	obs_scene_t *scene = obs_scene_create("benchmark scene");
+
+	for (int i = 0; i < items; i++) {
+		obs_data_t *settings = obs_data_create();
+		obs_source_t *source;
+		obs_sceneitem_t *item;
+		struct vec2 pos;
+		char name[32];
+
+		snprintf(name, sizeof(name), "color %d", i);
+		obs_data_set_int(settings, "color",
+				 0xFF000000 | ((uint32_t)i * 0x2468AC));
+		obs_data_set_int(settings, "width", BASE_WIDTH / 4);
+		obs_data_set_int(settings, "height", BASE_HEIGHT / 4);
+
+		source = obs_source_create("color_source", name, settings,
+					   NULL);
+		obs_data_release(settings);
+		if (!source)
+			continue;
+
+		vec2_set(&pos, (float)((i * 97) % (BASE_WIDTH * 3 / 4)),
+			 (float)((i * 53) % (BASE_HEIGHT * 3 / 4)));
+
+		item = obs_scene_add(scene, source);
+		obs_sceneitem_set_pos(item, &pos);
+		obs_sceneitem_set_rot(item, (float)(i % 4) * 5.0f);
+		obs_source_release(source);
+	}
+
+	return scene;
+}
+
+static void print_pacing(struct frame_stats *stats)
+{
+	uint64_t interval = obs_get_frame_interval_ns();
+	uint64_t min_ns = UINT64_MAX;
+	uint64_t max_ns = 0;
+	uint64_t late = 0;
+	double total = 0.0;
+	size_t count = stats->timestamps.num;
+
+	for (size_t i = 1; i < count; i++) {
+		uint64_t diff = stats->timestamps.array[i] -
+				stats->timestamps.array[i - 1];
+
+		if (diff < min_ns)
+			min_ns = diff;
+		if (diff > max_ns)
+			max_ns = diff;
+		if (diff > interval * 3 / 2)
+			late++;
+		total += (double)diff;
+	}
+
+	printf("frames output:   %zu\n", count);
+	printf("frames rendered: %" PRIu32 " (%" PRIu32 " lagged)\n",
+	       obs_get_total_frames(), obs_get_lagged_frames());
+	printf("average render:  %.3f ms\n",
+	       (double)obs_get_average_frame_time_ns() / 1000000.0);
+
+	if (count > 1) {
+		printf("output interval: avg %.3f ms, min %.3f ms, "
+		       "max %.3f ms, %" PRIu64 " late\n",
+		       total / (double)(count - 1) / 1000000.0,
+		       (double)min_ns / 1000000.0, (double)max_ns / 1000000.0,
+		       late);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct frame_stats stats = {0};
+	profiler_name_store_t *names;
+	profiler_snapshot_t *snap;
+	obs_scene_t *scene;
+	const char *trace_file = NULL;
+	int seconds = 10;
+	int items = 16;
+	int ret = 0;
+
+	if (argc > 1)
+		seconds = atoi(argv[1]);
+	if (argc > 2)
+		items = atoi(argv[2]);
+	if (argc > 3)
+		trace_file = argv[3];
+
+	names = profiler_name_store_create();
+	profiler_start();
+
+	if (!create_obs(names)) {
+		fprintf(stderr, "Couldn't initialize OBS with the software "
+				"graphics module\n");
+		ret = 1;
+		goto shutdown;
+	}
+
+	obs_load_all_modules();
+	obs_post_load_modules();
+
+	scene = create_scene(items);
+	obs_set_output_source(0, obs_scene_get_source(scene));
+
+	/* the first frames are setup, don't count them */
+	os_sleep_ms(1000);
+
+	if (trace_file)
+		profiler_trace_enable(true);
+
+	obs_add_raw_video_callback(NULL, receive_frame, &stats);
+	os_sleep_ms((uint32_t)seconds * 1000);
+	obs_remove_raw_video_callback(receive_frame, &stats);
+
+	if (trace_file) {
+		profiler_trace_enable(false);
+		if (!profiler_trace_dump_json(trace_file))
+			fprintf(stderr, "Couldn't write '%s'\n", trace_file);
+	}
+
+	print_pacing(&stats);
+
+	obs_set_output_source(0, NULL);
+	obs_scene_release(scene);
+
+	snap = profile_snapshot_create();
+	profiler_print(snap);
+	profiler_print_time_between_calls(snap);
+	profile_snapshot_free(snap);
+
+shutdown:
+	obs_shutdown();
+	profiler_stop();
+	profiler_free();
+	profiler_name_store_free(names);
+	da_free(stats.timestamps);
+	return ret;
+}
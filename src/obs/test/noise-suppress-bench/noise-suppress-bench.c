@@ -0,0 +1,226 @@
+/*
+ * Feeds 10ms segments of noise through the noise suppression filter of the
+ * obs-filters module for several speaker layouts, and prints the time each
+ * segment takes with and without the filter.
+ *
+ *   noise-suppress-bench [segments]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <obs.h>
+#include <util/platform.h>
+
+#define SAMPLE_RATE 48000
+#define SEGMENT_FRAMES (SAMPLE_RATE / 100)
+#define SEGMENT_NS 10000000ULL
+
+/* one second of input, played in a loop */
+#define INPUT_SEGMENTS 100
+
+struct layout {
+	const char *name;
+	enum speaker_layout speakers;
+	size_t channels;
+};
+
+static const struct layout layouts[] = {
+	{"mono", SPEAKERS_MONO, 1},
+	{"stereo", SPEAKERS_STEREO, 2},
+	{"5.1", SPEAKERS_5POINT1, 6},
+	{"7.1", SPEAKERS_7POINT1, 8},
+};
+
+/* ------------------------------------------------------------------------- */
+
+static const char *bench_source_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Benchmark audio";
+}
+
+static void *bench_source_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void bench_source_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+/* audio is output by the benchmark itself, so that the filter runs on the
+ * benchmark thread */
+static struct obs_source_info bench_source = {
+	.id = "noise_suppress_bench_source",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_AUDIO,
+	.get_name = bench_source_name,
+	.create = bench_source_create,
+	.destroy = bench_source_destroy,
+};
+
+/* ------------------------------------------------------------------------- */
+
+static void find_filters(void *param, const struct obs_module_info *info)
+{
+	obs_module_t **module = param;
+
+	if (*module || !strstr(info->bin_path, "obs-filters"))
+		return;
+
+	if (obs_open_module(module, info->bin_path, info->data_path) !=
+	    MODULE_SUCCESS)
+		*module = NULL;
+}
+
+/* only the filters are needed, the other modules may need graphics */
+static bool load_filters(void)
+{
+	obs_module_t *module = NULL;
+
+	obs_find_modules(find_filters, &module);
+	return module && obs_init_module(module);
+}
+
+static float *create_input(size_t channels)
+{
+	size_t frames = SEGMENT_FRAMES * INPUT_SEGMENTS;
+	float *input = bmalloc(channels * frames * sizeof(float));
+	uint32_t seed = 1;
+
+	/* a quiet tone over white noise */
+	for (size_t c = 0; c < channels; c++) {
+		for (size_t i = 0; i < frames; i++) {
+			seed = seed * 1664525 + 1013904223;
+			input[c * frames + i] =
+				(float)(seed >> 8) / (float)(1 << 24) * 0.2f -
+				0.1f + ((i / 48) % 2 ? 0.05f : -0.05f);
+		}
+	}
+
+	return input;
+}
+
+static uint64_t run(obs_source_t *source, const struct layout *layout,
+		    const float *input, int segments)
+{
+	struct obs_source_audio audio = {0};
+	size_t frames = SEGMENT_FRAMES * INPUT_SEGMENTS;
+	uint64_t start;
+
+	audio.frames = SEGMENT_FRAMES;
+	audio.speakers = layout->speakers;
+	audio.format = AUDIO_FORMAT_FLOAT_PLANAR;
+	audio.samples_per_sec = SAMPLE_RATE;
+
+	start = os_gettime_ns();
+
+	for (int i = 0; i < segments; i++) {
+		size_t offset = (size_t)(i % INPUT_SEGMENTS) * SEGMENT_FRAMES;
+
+		for (size_t c = 0; c < layout->channels; c++)
+			audio.data[c] = (const uint8_t *)(input + c * frames +
+							  offset);
+
+		audio.timestamp = (uint64_t)i * SEGMENT_NS;
+		obs_source_output_audio(source, &audio);
+	}
+
+	return os_gettime_ns() - start;
+}
+
+static bool bench_layout(const struct layout *layout, int segments)
+{
+	struct obs_audio_info oai = {SAMPLE_RATE, layout->speakers};
+	obs_source_t *source;
+	obs_source_t *filter;
+	uint64_t base_ns;
+	uint64_t filter_ns;
+	float *input;
+	double per_call;
+
+	if (!obs_reset_audio(&oai)) {
+		fprintf(stderr, "Couldn't reset audio to %s\n", layout->name);
+		return false;
+	}
+
+	source = obs_source_create("noise_suppress_bench_source", "bench",
+				   NULL, NULL);
+	filter = obs_source_create_private("noise_suppress_filter",
+					   "noise suppression", NULL);
+	if (!source || !filter) {
+		fprintf(stderr, "Couldn't create the noise suppression "
+				"filter, was obs-filters built with "
+				"speexdsp?\n");
+		obs_source_release(filter);
+		obs_source_release(source);
+		return false;
+	}
+
+	input = create_input(layout->channels);
+
+	/* the cost of outputting audio without the filter */
+	run(source, layout, input, INPUT_SEGMENTS);
+	base_ns = run(source, layout, input, segments);
+
+	obs_source_filter_add(source, filter);
+	run(source, layout, input, INPUT_SEGMENTS);
+	filter_ns = run(source, layout, input, segments);
+	obs_source_filter_remove(source, filter);
+
+	per_call = (double)filter_ns / (double)segments / 1000000.0;
+
+	printf("%-8s %8zu %10.4f ms %10.4f ms %8.2f %%\n", layout->name,
+	       layout->channels, per_call,
+	       ((double)filter_ns - (double)base_ns) / (double)segments /
+		       1000000.0,
+	       per_call * 100.0 / ((double)SEGMENT_NS / 1000000.0));
+
+	bfree(input);
+	obs_source_release(filter);
+	obs_source_release(source);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	int segments = 3000;
+	int ret = 0;
+
+	if (argc > 1)
+		segments = atoi(argv[1]);
+	if (segments <= 0)
+		segments = 3000;
+
+	if (!obs_startup("en-US", NULL, NULL)) {
+		fprintf(stderr, "Couldn't initialize OBS\n");
+		return 1;
+	}
+
+	if (!load_filters()) {
+		fprintf(stderr, "Couldn't load the obs-filters module\n");
+		ret = 1;
+		goto shutdown;
+	}
+
+	obs_register_source(&bench_source);
+
+	printf("%d segments of %d frames at %d Hz\n\n", segments,
+	       SEGMENT_FRAMES, SAMPLE_RATE);
+	printf("%-8s %8s %13s %13s %10s\n", "layout", "channels", "per call",
+	       "filter only", "realtime");
+
+	for (size_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++) {
+		if (!bench_layout(&layouts[i], segments)) {
+			ret = 1;
+			break;
+		}
+	}
+
+shutdown:
+	obs_shutdown();
+	return ret;
+}
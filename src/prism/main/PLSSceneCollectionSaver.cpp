@@ -0,0 +1,287 @@
+#include "PLSSceneCollectionSaver.h"
+
+#include <util/platform.h>
+#include <util/threading.h>
+
+#include <algorithm>
+
+using namespace std;
+
+/* some state has no change signal (private settings, plugin state written by
+ * save callbacks), so every source is saved again at least this often */
+#define FULL_SAVE_INTERVAL_NS 30000000000ULL
+
+/* indentation of the items of the top level arrays in the saved file */
+#define ARRAY_ITEM_INDENT "        "
+
+static const char *sourceSignals[] = {"update",
+				      "rename",
+				      "enable",
+				      "mute",
+				      "volume",
+				      "audio_sync",
+				      "audio_mixers",
+				      "update_flags",
+				      "filter_add",
+				      "filter_remove",
+				      "reorder_filters",
+				      "push_to_mute_changed",
+				      "push_to_mute_delay",
+				      "push_to_talk_changed",
+				      "push_to_talk_delay"};
+
+static const char *sceneSignals[] = {"item_add", "item_remove", "reorder", "item_visible", "item_locked", "item_transform"};
+
+static const char *filterSignals[] = {"update", "rename", "enable"};
+
+struct PLSSceneCollectionSaver::Fragment {
+	/* immutable copy of the saved source until the writer serializes it */
+	OBSData data;
+	string json;
+};
+
+struct PLSSceneCollectionSaver::SourceEntry {
+	OBSWeakSource weak;
+	atomic<bool> dirty{true};
+	shared_ptr<Fragment> fragment;
+	vector<OBSSignal> signals;
+	vector<OBSSignal> filterSignals;
+};
+
+struct PLSSceneCollectionSaver::Job {
+	string file;
+	OBSData saveData;
+	vector<shared_ptr<Fragment>> sources;
+	vector<shared_ptr<Fragment>> groups;
+};
+
+PLSSceneCollectionSaver::PLSSceneCollectionSaver() : writerThread([this]() { WriterThread(); }) {}
+
+PLSSceneCollectionSaver::~PLSSceneCollectionSaver()
+{
+	{
+		lock_guard<mutex> lock(jobMutex);
+		exiting = true;
+	}
+
+	jobCond.notify_all();
+	writerThread.join();
+}
+
+void PLSSceneCollectionSaver::SourceChanged(void *param, calldata_t *data)
+{
+	static_cast<SourceEntry *>(param)->dirty = true;
+	UNUSED_PARAMETER(data);
+}
+
+void PLSSceneCollectionSaver::SourceRenamed(void *param, calldata_t *data)
+{
+	static_cast<PLSSceneCollectionSaver *>(param)->sourceRenamed = true;
+	UNUSED_PARAMETER(data);
+}
+
+unique_ptr<PLSSceneCollectionSaver::SourceEntry> PLSSceneCollectionSaver::CreateEntry(obs_source_t *source)
+{
+	unique_ptr<SourceEntry> entry = make_unique<SourceEntry>();
+	signal_handler_t *handler = obs_source_get_signal_handler(source);
+
+	OBSWeakSource weak = obs_source_get_weak_source(source);
+	obs_weak_source_release(weak);
+	entry->weak = weak;
+
+	entry->signals.reserve(sizeof(sourceSignals) / sizeof(sourceSignals[0]) + sizeof(sceneSignals) / sizeof(sceneSignals[0]) + 1);
+
+	for (const char *signal : sourceSignals)
+		entry->signals.emplace_back(handler, signal, SourceChanged, entry.get());
+
+	/* the items referencing the source by its old name are saved with
+	 * the scenes and groups, which don't signal the rename themselves */
+	entry->signals.emplace_back(handler, "rename", SourceRenamed, this);
+
+	if (obs_scene_from_source(source) || obs_group_from_source(source)) {
+		for (const char *signal : sceneSignals)
+			entry->signals.emplace_back(handler, signal, SourceChanged, entry.get());
+	}
+
+	return entry;
+}
+
+void PLSSceneCollectionSaver::Snapshot(obs_source_t *source, SourceEntry &entry)
+{
+	/* cleared first so that changes made while saving mark it again */
+	entry.dirty = false;
+
+	obs_data_t *data = obs_save_source(source);
+
+	/* the saved data shares the live settings objects, which can change
+	 * while the writer thread serializes them */
+	shared_ptr<Fragment> fragment = make_shared<Fragment>();
+	fragment->data = obs_data_create();
+	obs_data_release(fragment->data);
+	obs_data_apply(fragment->data, data);
+	obs_data_release(data);
+
+	entry.fragment = fragment;
+
+	/* filters are saved as part of their parent */
+	entry.filterSignals.clear();
+
+	auto connectFilter = [](obs_source_t *, obs_source_t *filter, void *param) {
+		SourceEntry *entry = static_cast<SourceEntry *>(param);
+		signal_handler_t *handler = obs_source_get_signal_handler(filter);
+
+		for (const char *signal : filterSignals)
+			entry->filterSignals.emplace_back(handler, signal, SourceChanged, entry);
+	};
+
+	obs_source_enum_filters(source, connectFilter, &entry);
+}
+
+void PLSSceneCollectionSaver::Save(const char *file, obs_data_t *saveData, const vector<OBSSource> &skipSources, bool full)
+{
+	uint64_t now = os_gettime_ns();
+	if (now - lastFullSave >= FULL_SAVE_INTERVAL_NS)
+		full = true;
+	if (full)
+		lastFullSave = now;
+
+	/* cleared first so that renames while saving mark it again */
+	bool renamed = sourceRenamed.exchange(false);
+
+	/* enumerated the same way obs_save_sources does, without saving */
+	vector<OBSSource> sources;
+	auto addSource = [](void *param, obs_source_t *source) {
+		static_cast<vector<OBSSource> *>(param)->emplace_back(source);
+		return false;
+	};
+	obs_data_array_release(obs_save_sources_filtered(addSource, &sources));
+
+	unique_ptr<Job> job = make_unique<Job>();
+	job->file = file;
+	job->saveData = obs_data_create();
+	obs_data_release(job->saveData);
+	obs_data_apply(job->saveData, saveData);
+
+	unordered_map<obs_source_t *, unique_ptr<SourceEntry>> current;
+	current.reserve(sources.size());
+
+	for (obs_source_t *source : sources) {
+		if (find(skipSources.begin(), skipSources.end(), source) != skipSources.end())
+			continue;
+
+		unique_ptr<SourceEntry> entry;
+		auto it = entries.find(source);
+		if (it != entries.end() && obs_weak_source_references_source(it->second->weak, source))
+			entry = move(it->second);
+		else
+			entry = CreateEntry(source);
+
+		bool scene = obs_scene_from_source(source) || obs_group_from_source(source);
+		if (full || entry->dirty || (renamed && scene))
+			Snapshot(source, *entry);
+
+		if (obs_source_is_group(source))
+			job->groups.push_back(entry->fragment);
+		else
+			job->sources.push_back(entry->fragment);
+
+		current.emplace(source, move(entry));
+	}
+
+	/* entries of removed sources disconnect their signals here */
+	entries.swap(current);
+
+	{
+		lock_guard<mutex> lock(jobMutex);
+		pendingJob = move(job);
+	}
+
+	jobCond.notify_all();
+}
+
+void PLSSceneCollectionSaver::Flush()
+{
+	unique_lock<mutex> lock(jobMutex);
+	jobCond.wait(lock, [this]() { return !pendingJob && !writing; });
+}
+
+void PLSSceneCollectionSaver::Clear()
+{
+	Flush();
+	entries.clear();
+}
+
+void PLSSceneCollectionSaver::WriterThread()
+{
+	os_set_thread_name("scene collection writer");
+
+	unique_lock<mutex> lock(jobMutex);
+
+	for (;;) {
+		jobCond.wait(lock, [this]() { return pendingJob || exiting; });
+		if (!pendingJob)
+			break;
+
+		unique_ptr<Job> job = move(pendingJob);
+		writing = true;
+		lock.unlock();
+
+		Write(*job);
+		job.reset();
+
+		lock.lock();
+		writing = false;
+		jobCond.notify_all();
+	}
+}
+
+void PLSSceneCollectionSaver::Write(Job &job)
+{
+	auto appendArray = [](string &json, const char *name, vector<shared_ptr<Fragment>> &fragments) {
+		json += "\n    \"";
+		json += name;
+		json += "\": [";
+
+		for (size_t i = 0; i < fragments.size(); i++) {
+			Fragment &fragment = *fragments[i];
+
+			if (fragment.data) {
+				const char *text = obs_data_get_json(fragment.data);
+
+				/* re-indent for its place in the file */
+				fragment.json.clear();
+				for (const char *ch = text; *ch; ch++) {
+					fragment.json += *ch;
+					if (*ch == '\n')
+						fragment.json += ARRAY_ITEM_INDENT;
+				}
+
+				fragment.data = nullptr;
+			}
+
+			json += i ? ",\n" ARRAY_ITEM_INDENT : "\n" ARRAY_ITEM_INDENT;
+			json += fragment.json;
+		}
+
+		if (!fragments.empty())
+			json += "\n    ";
+		json += "]";
+	};
+
+	string json = obs_data_get_json(job.saveData);
+
+	/* reopen the top level object to append the source arrays */
+	json.pop_back();
+	if (json.size() > 1) {
+		json.pop_back();
+		json += ",";
+	}
+
+	appendArray(json, "groups", job.groups);
+	json += ",";
+	appendArray(json, "sources", job.sources);
+	json += "\n}";
+
+	if (!os_quick_write_utf8_file_safe(job.file.c_str(), json.c_str(), json.size(), false, "tmp", "bak"))
+		blog(LOG_ERROR, "Could not save scene data to %s", job.file.c_str());
+}
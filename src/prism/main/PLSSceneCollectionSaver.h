@@ -0,0 +1,63 @@
+#pragma once
+
+#include <obs.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/* Saves the scene collection without stalling the UI thread.
+ *
+ * Save() snapshots the collection on the calling (UI) thread, but only saves
+ * sources again that signalled a change since the last save; the others reuse
+ * the JSON text serialized for them the previous time.  Serializing and
+ * writing the file happen on a writer thread, and a save requested while
+ * another one is still waiting replaces it. */
+class PLSSceneCollectionSaver {
+public:
+	PLSSceneCollectionSaver();
+	~PLSSceneCollectionSaver();
+
+	/* saveData holds everything but the "sources" and "groups" arrays,
+	 * skipSources are sources already saved in saveData.  A full save
+	 * snapshots every source again. */
+	void Save(const char *file, obs_data_t *saveData, const std::vector<OBSSource> &skipSources, bool full);
+
+	/* waits until the last requested save is on disk */
+	void Flush();
+
+	/* flushes and drops all cached sources */
+	void Clear();
+
+private:
+	struct Fragment;
+	struct SourceEntry;
+	struct Job;
+
+	std::unordered_map<obs_source_t *, std::unique_ptr<SourceEntry>> entries;
+	uint64_t lastFullSave = 0;
+
+	/* scenes and groups reference their items by source name */
+	std::atomic<bool> sourceRenamed{false};
+
+	std::mutex jobMutex;
+	std::condition_variable jobCond;
+	std::unique_ptr<Job> pendingJob;
+	bool writing = false;
+	bool exiting = false;
+	std::thread writerThread;
+
+	std::unique_ptr<SourceEntry> CreateEntry(obs_source_t *source);
+	void Snapshot(obs_source_t *source, SourceEntry &entry);
+
+	static void SourceChanged(void *param, calldata_t *data);
+	static void SourceRenamed(void *param, calldata_t *data);
+
+	void WriterThread();
+	static void Write(Job &job);
+};
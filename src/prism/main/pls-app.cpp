@@ -440,6 +440,9 @@ bool PLSApp::InitGlobalConfigDefaults()
 #endif
 
 	config_set_default_bool(globalConfig, "BasicWindow", "PreviewEnabled", true);
+	config_set_default_string(globalConfig, "BasicWindow", "DisplayRenderPolicy", "Full");
+	config_set_default_uint(globalConfig, "BasicWindow", "DisplayMaxFPS", 30);
+	config_set_default_uint(globalConfig, "BasicWindow", "DisplayIdleFPS", 10);
 	config_set_default_bool(globalConfig, "BasicWindow", "PreviewProgramMode", false);
 	config_set_default_bool(globalConfig, "BasicWindow", "SceneDuplicationMode", true);
 	config_set_default_bool(globalConfig, "BasicWindow", "SwapScenesMode", true);
@@ -7,7 +7,9 @@
 #include <QScreen>
 #include <QResizeEvent>
 #include <QShowEvent>
+#include <QHideEvent>
 #include <QDebug>
+#include <util/dstr.h>
 #include "pls-common-define.hpp"
 #include "source-tree.hpp"
 #include "window-dock.hpp"
@@ -28,6 +30,17 @@ static inline QColor rgba_to_color(uint32_t rgba)
 	return QColor::fromRgb(rgba & 0xFF, (rgba >> 8) & 0xFF, (rgba >> 16) & 0xFF, (rgba >> 24) & 0xFF);
 }
 
+static obs_display_render_policy getConfigRenderPolicy(config_t *config)
+{
+	const char *policy = config_get_string(config, "BasicWindow", "DisplayRenderPolicy");
+
+	if (astrcmpi(policy, "Capped") == 0)
+		return OBS_DISPLAY_RENDER_CAPPED;
+	if (astrcmpi(policy, "OnChange") == 0)
+		return OBS_DISPLAY_RENDER_ON_CHANGE;
+	return OBS_DISPLAY_RENDER_FULL;
+}
+
 static QWidget *getDock(PLSQTDisplay *display)
 {
 	for (QWidget *dock = display; dock; dock = dock->parentWidget()) {
@@ -75,6 +88,7 @@ PLSQTDisplay::PLSQTDisplay(QWidget *parent, Qt::WindowFlags flags, PLSDpiHelper
 
 	connect(windowHandle(), &QWindow::visibleChanged, windowVisible);
 	connect(windowHandle(), &QWindow::screenChanged, sizeChanged);
+	connect(qApp, &QGuiApplication::applicationStateChanged, this, &PLSQTDisplay::UpdateRenderPolicy);
 
 	displayText = new QLabel(this);
 	displayText->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
@@ -154,10 +168,42 @@ void PLSQTDisplay::CreateDisplay()
 	QTToGSWindow(winId(), info.window);
 
 	display = obs_display_create(&info, backgroundColor);
+	UpdateRenderPolicy();
 
 	emit DisplayCreated(this);
 }
 
+void PLSQTDisplay::UpdateRenderPolicy()
+{
+	if (!display)
+		return;
+
+	config_t *config = App()->GlobalConfig();
+	obs_display_render_policy policy = useConfigRenderPolicy ? getConfigRenderPolicy(config) : OBS_DISPLAY_RENDER_FULL;
+	uint32_t maxFPS = useConfigRenderPolicy ? (uint32_t)config_get_uint(config, "BasicWindow", "DisplayMaxFPS") : 0;
+
+	// hidden covers minimized too, the top level sends its children spontaneous hide events
+	if (!displayShown) {
+		policy = OBS_DISPLAY_RENDER_OFF;
+	} else if (throttleWhenInactive && policy != OBS_DISPLAY_RENDER_ON_CHANGE && QGuiApplication::applicationState() != Qt::ApplicationActive) {
+		uint32_t idleFPS = (uint32_t)config_get_uint(config, "BasicWindow", "DisplayIdleFPS");
+		if (idleFPS && (policy == OBS_DISPLAY_RENDER_FULL || !maxFPS || idleFPS < maxFPS)) {
+			policy = OBS_DISPLAY_RENDER_CAPPED;
+			maxFPS = idleFPS;
+		}
+	}
+
+	obs_display_set_max_fps(display, maxFPS);
+	obs_display_set_render_policy(display, policy);
+}
+
+void PLSQTDisplay::SetRenderThrottling(bool useConfigPolicy, bool throttleInactive)
+{
+	useConfigRenderPolicy = useConfigPolicy;
+	throttleWhenInactive = throttleInactive;
+	UpdateRenderPolicy();
+}
+
 void PLSQTDisplay::AdjustResizeUI()
 {
 	bool handled = false;
@@ -214,6 +260,44 @@ void PLSQTDisplay::paintEvent(QPaintEvent *event)
 	QWidget::paintEvent(event);
 }
 
+void PLSQTDisplay::showEvent(QShowEvent *event)
+{
+	QWidget::showEvent(event);
+
+	displayShown = true;
+	UpdateRenderPolicy();
+}
+
+void PLSQTDisplay::hideEvent(QHideEvent *event)
+{
+	QWidget::hideEvent(event);
+
+	displayShown = false;
+	UpdateRenderPolicy();
+}
+
+bool PLSQTDisplay::event(QEvent *event)
+{
+	// what the on-change policy treats as a change, the scene is edited through these
+	switch (event->type()) {
+	case QEvent::Paint:
+	case QEvent::MouseButtonPress:
+	case QEvent::MouseButtonRelease:
+	case QEvent::MouseButtonDblClick:
+	case QEvent::MouseMove:
+	case QEvent::Wheel:
+	case QEvent::KeyPress:
+	case QEvent::KeyRelease:
+	case QEvent::Leave:
+		obs_display_request_render(display);
+		break;
+	default:
+		break;
+	}
+
+	return QWidget::event(event);
+}
+
 void PLSQTDisplay::resizeManual()
 {
 	if (!display) {
@@ -22,6 +22,9 @@ class PLSQTDisplay : public QWidget {
 	bool isResizing = false;
 	bool isDisplayActive = false;
 	bool displayTextAsGuide = false;
+	bool displayShown = false;
+	bool useConfigRenderPolicy = true;
+	bool throttleWhenInactive = false;
 
 	void CreateDisplay();
 	void AdjustResizeUI();
@@ -29,8 +32,15 @@ class PLSQTDisplay : public QWidget {
 	virtual bool eventFilter(QObject *object, QEvent *event) override;
 	void resizeEvent(QResizeEvent *event) override;
 	void paintEvent(QPaintEvent *event) override;
+	void showEvent(QShowEvent *event) override;
+	void hideEvent(QHideEvent *event) override;
+	bool event(QEvent *event) override;
 	void resizeManual();
 
+protected:
+	// the configured render policy and the cap while the application is inactive are meant for previews, a display that feeds a screen keeps rendering until it is hidden
+	void SetRenderThrottling(bool useConfigPolicy, bool throttleInactive);
+
 signals:
 	void DisplayCreated(PLSQTDisplay *window);
 	void DisplayResized();
@@ -42,6 +52,7 @@ public slots:
 	void beginResizeSlot();
 	void endResizeSlot();
 	virtual void visibleSlot(bool visible);
+	void UpdateRenderPolicy();
 
 public:
 	static void OnSourceCaptureState(void *data, calldata_t *calldata);
@@ -618,13 +618,19 @@ VolumeMeter::VolumeMeter(QWidget *parent, obs_volmeter_t *obs_volmeter, bool ver
 
 	channels = (int)audio_output_get_channels(obs_get_audio());
 
+	for (int channelNr = 0; channelNr < MAX_AUDIO_CHANNELS; channelNr++) {
+		pendingMagnitude[channelNr] = -M_INFINITE;
+		pendingPeak[channelNr] = -M_INFINITE;
+		pendingInputPeak[channelNr] = -M_INFINITE;
+	}
+
 	PLSDpiHelper dpiHelper;
 	dpiHelper.notifyDpiChanged(this, [=](double dpi) { handleChannelCofigurationChange(dpi, true); });
 
+	// The timer starts once a meter is shown.
 	updateTimerRef = updateTimer.toStrongRef();
 	if (!updateTimerRef) {
 		updateTimerRef = QSharedPointer<VolumeMeterTimer>::create();
-		updateTimerRef->start(34);
 		updateTimer = updateTimerRef;
 	}
 
@@ -637,27 +643,44 @@ VolumeMeter::~VolumeMeter()
 	delete tickPaintCache;
 }
 
-void VolumeMeter::setLevels(const float magnitude[MAX_AUDIO_CHANNELS], const float peak[MAX_AUDIO_CHANNELS], const float inputPeak[MAX_AUDIO_CHANNELS])
+static inline void storeMax(std::atomic<float> &value, float level)
 {
-	uint64_t ts = os_gettime_ns();
-	QMutexLocker locker(&dataMutex);
+	float current = value.load(std::memory_order_relaxed);
+	while (level > current && !value.compare_exchange_weak(current, level, std::memory_order_relaxed))
+		;
+}
 
-	currentLastUpdateTime = ts;
+void VolumeMeter::setLevels(const float magnitude[MAX_AUDIO_CHANNELS], const float peak[MAX_AUDIO_CHANNELS], const float inputPeak[MAX_AUDIO_CHANNELS])
+{
+	// Called from the audio thread. Keep the highest peaks until the next
+	// refresh, so that the ones between two refreshes aren't lost.
 	for (int channelNr = 0; channelNr < MAX_AUDIO_CHANNELS; channelNr++) {
-		currentMagnitude[channelNr] = magnitude[channelNr];
-		currentPeak[channelNr] = peak[channelNr];
-		currentInputPeak[channelNr] = inputPeak[channelNr];
+		pendingMagnitude[channelNr].store(magnitude[channelNr], std::memory_order_relaxed);
+		storeMax(pendingPeak[channelNr], peak[channelNr]);
+		storeMax(pendingInputPeak[channelNr], inputPeak[channelNr]);
 	}
 
-	// In case there are more updates then redraws we must make sure
-	// that the ballistics of peak and hold are recalculated.
-	locker.unlock();
-	calculateBallistics(ts);
+	currentLastUpdateTime.store(os_gettime_ns(), std::memory_order_relaxed);
+	levelsSequence.fetch_add(1, std::memory_order_release);
+}
+
+inline void VolumeMeter::consumeLevels()
+{
+	uint32_t sequence = levelsSequence.load(std::memory_order_acquire);
+	if (sequence == consumedSequence)
+		return;
+
+	consumedSequence = sequence;
+	for (int channelNr = 0; channelNr < MAX_AUDIO_CHANNELS; channelNr++) {
+		currentMagnitude[channelNr] = pendingMagnitude[channelNr].load(std::memory_order_relaxed);
+		currentPeak[channelNr] = pendingPeak[channelNr].exchange(-M_INFINITE, std::memory_order_relaxed);
+		currentInputPeak[channelNr] = pendingInputPeak[channelNr].exchange(-M_INFINITE, std::memory_order_relaxed);
+	}
 }
 
 inline void VolumeMeter::resetLevels()
 {
-	currentLastUpdateTime = 0;
+	currentLastUpdateTime.store(0, std::memory_order_relaxed);
 	for (int channelNr = 0; channelNr < MAX_AUDIO_CHANNELS; channelNr++) {
 		currentMagnitude[channelNr] = -M_INFINITE;
 		currentPeak[channelNr] = -M_INFINITE;
@@ -674,8 +697,6 @@ inline void VolumeMeter::resetLevels()
 
 inline void VolumeMeter::handleChannelCofigurationChange(double dpi, bool dpiChanged)
 {
-	QMutexLocker locker(&dataMutex);
-
 	int currentNrAudioChannels = obs_volmeter_get_nr_channels(obs_volmeter);
 	if (dpiChanged || displayNrAudioChannels != currentNrAudioChannels) {
 		// Make room for 3 pixels meter, with one pixel between each.
@@ -687,12 +708,14 @@ inline void VolumeMeter::handleChannelCofigurationChange(double dpi, bool dpiCha
 			resetLevels();
 		} else
 			setMinimumSize(130 * dpi, (displayNrAudioChannels - 1) * 7 * dpi + 12 * dpi);
+
+		barCacheDirty = true;
 	}
 }
 
 inline bool VolumeMeter::detectIdle(uint64_t ts)
 {
-	double timeSinceLastUpdate = (ts - currentLastUpdateTime) * 0.000000001;
+	double timeSinceLastUpdate = (ts - currentLastUpdateTime.load(std::memory_order_relaxed)) * 0.000000001;
 	if (timeSinceLastUpdate > 0.5) {
 		resetLevels();
 		return true;
@@ -758,29 +781,27 @@ inline void VolumeMeter::calculateBallisticsForChannel(int channelNr, uint64_t t
 
 inline void VolumeMeter::calculateBallistics(uint64_t ts, qreal timeSinceLastRedraw)
 {
-	QMutexLocker locker(&dataMutex);
-
 	for (int channelNr = 0; channelNr < MAX_AUDIO_CHANNELS; channelNr++)
 		calculateBallisticsForChannel(channelNr, ts, timeSinceLastRedraw);
 }
 
-void VolumeMeter::paintInputMeter(QPainter &painter, int x, int y, int width, int height, float peakHold)
+QColor VolumeMeter::inputMeterColor(float peakHold) const
 {
-	QMutexLocker locker(&dataMutex);
-	QColor color;
-
 	if (peakHold < minimumInputLevel)
-		color = backgroundNominalColor;
+		return backgroundNominalColor;
 	else if (peakHold < warningLevel)
-		color = foregroundNominalColor;
+		return foregroundNominalColor;
 	else if (peakHold < errorLevel)
-		color = foregroundWarningColor;
+		return foregroundWarningColor;
 	else if (peakHold <= clipLevel)
-		color = foregroundErrorColor;
+		return foregroundErrorColor;
 	else
-		color = clipColor;
+		return clipColor;
+}
 
-	painter.fillRect(x, y, width, height, color);
+void VolumeMeter::paintInputMeter(QPainter &painter, int x, int y, int width, int height, float peakHold)
+{
+	painter.fillRect(x, y, width, height, inputMeterColor(peakHold));
 }
 
 #define CLIP_FLASH_DURATION_MS 1000
@@ -796,7 +817,6 @@ void VolumeMeter::paintHMeter(QPainter &painter, int x, int y, int width, int he
 
 	qreal scale = width / minimumLevel;
 
-	QMutexLocker locker(&dataMutex);
 	int minimumPosition = x + 0;
 	int maximumPosition = x + width;
 	int magnitudePosition = int(x + width - (magnitude * scale));
@@ -808,7 +828,6 @@ void VolumeMeter::paintHMeter(QPainter &painter, int x, int y, int width, int he
 	int nominalLength = warningPosition - minimumPosition;
 	int warningLength = errorPosition - warningPosition;
 	int errorLength = maximumPosition - errorPosition;
-	locker.unlock();
 
 	if (clipping) {
 		peakPosition = maximumPosition;
@@ -856,41 +875,114 @@ void VolumeMeter::paintHMeter(QPainter &painter, int x, int y, int width, int he
 		painter.fillRect(magnitudePosition - 3 * dpi, y, 3 * dpi, height, magnitudeColor);
 }
 
-void VolumeMeter::paintEvent(QPaintEvent *event)
+VolumeMeter::BarState VolumeMeter::getBarState(int width, int channelNr, bool idle) const
 {
-	double dpi = PLSDpiHelper::getDpi(this);
-	uint64_t ts = os_gettime_ns();
-	qreal timeSinceLastRedraw = (ts - lastRedrawTime) * 0.000000001;
+	qreal scale = width / minimumLevel;
+	BarState state;
 
-	const QRect rect = event->region().boundingRect();
-	int width = rect.width();
-	int height = rect.height();
+	state.magnitudePosition = int(width - (displayMagnitude[channelNr] * scale));
+	state.peakPosition = clipping ? width : int(width - (displayPeak[channelNr] * scale));
+	state.peakHoldPosition = int(width - (displayPeakHold[channelNr] * scale));
+	state.inputColor = idle ? 0 : inputMeterColor(displayInputPeakHold[channelNr]).rgba();
+	state.idle = idle;
+	return state;
+}
 
-	handleChannelCofigurationChange(dpi);
-	calculateBallistics(ts, timeSinceLastRedraw);
-	bool idle = detectIdle(ts);
+void VolumeMeter::paintBars(double dpi, bool idle)
+{
+	qreal ratio = devicePixelRatioF();
+	QSize cacheSize = size() * ratio;
+	bool full = barCacheDirty;
 
-	// Actual painting of the widget starts here.
-	QPainter painter(this);
+	if (barCache.size() != cacheSize) {
+		barCache = QPixmap(cacheSize);
+		barCache.setDevicePixelRatio(ratio);
+		full = true;
+	}
+
+	if (full) {
+		barCache.fill(Qt::transparent);
+		barCacheDirty = false;
+	}
+
+	QPainter painter(&barCache);
 
 	for (int channelNr = 0; channelNr < displayNrAudioChannels; channelNr++) {
 
 		int channelNrFixed = (displayNrAudioChannels == 1 && channels > 2) ? 2 : channelNr;
+		int y = channelNr * 7 * dpi + 10 * dpi;
 
-		paintHMeter(painter, 0, channelNr * 7 * dpi + 10 * dpi, width - 4 * dpi, 2 * dpi, displayMagnitude[channelNrFixed], displayPeak[channelNrFixed], displayPeakHold[channelNrFixed]);
-
-		if (idle)
+		BarState state = getBarState(width() - 4 * dpi, channelNrFixed, idle);
+		if (!full && state == paintedBars[channelNr])
 			continue;
 
+		paintedBars[channelNr] = state;
+		paintHMeter(painter, 0, y, width() - 4 * dpi, 2 * dpi, displayMagnitude[channelNrFixed], displayPeak[channelNrFixed], displayPeakHold[channelNrFixed]);
+
 		// By not drawing the input meter boxes the user can
 		// see that the audio stream has been stopped, without
 		// having too much visual impact.
-		paintInputMeter(painter, 0, channelNr * 7 * dpi + 10 * dpi, 3 * dpi, 2 * dpi, displayInputPeakHold[channelNrFixed]);
+		if (!idle)
+			paintInputMeter(painter, 0, y, 3 * dpi, 2 * dpi, displayInputPeakHold[channelNrFixed]);
+
+		if (!full)
+			update(0, y, width(), 2 * dpi);
 	}
 
+	if (full)
+		update();
+}
+
+void VolumeMeter::refresh(uint64_t ts)
+{
+	double dpi = PLSDpiHelper::getDpi(this);
+	qreal timeSinceLastRedraw = (ts - lastRedrawTime) * 0.000000001;
+
+	handleChannelCofigurationChange(dpi);
+	consumeLevels();
+	calculateBallistics(ts, timeSinceLastRedraw);
+	bool idle = detectIdle(ts);
+
+	paintBars(dpi, idle);
+
 	lastRedrawTime = ts;
 }
 
+void VolumeMeter::paintEvent(QPaintEvent *event)
+{
+	if (barCache.isNull())
+		refresh(os_gettime_ns());
+
+	// Only the bars that changed are painted again, into the cache.
+	const QRect rect = event->rect();
+	qreal ratio = barCache.devicePixelRatio();
+
+	QPainter painter(this);
+	painter.drawPixmap(QRectF(rect), barCache, QRectF(QPointF(rect.topLeft()) * ratio, QSizeF(rect.size()) * ratio));
+}
+
+void VolumeMeter::showEvent(QShowEvent *event)
+{
+	QWidget::showEvent(event);
+	updateTimerRef->UpdateActive();
+}
+
+void VolumeMeter::hideEvent(QHideEvent *event)
+{
+	QWidget::hideEvent(event);
+
+	// Visibility of the meter is only updated after the event
+	QMetaObject::invokeMethod(updateTimerRef.data(), "UpdateActive", Qt::QueuedConnection);
+}
+
+void VolumeMeter::changeEvent(QEvent *event)
+{
+	QWidget::changeEvent(event);
+
+	if (event->type() == QEvent::StyleChange)
+		barCacheDirty = true;
+}
+
 void VolumeMeterTimer::AddVolControl(VolumeMeter *meter)
 {
 	volumeMeters.push_back(meter);
@@ -899,10 +991,33 @@ void VolumeMeterTimer::AddVolControl(VolumeMeter *meter)
 void VolumeMeterTimer::RemoveVolControl(VolumeMeter *meter)
 {
 	volumeMeters.removeOne(meter);
+	UpdateActive();
+}
+
+void VolumeMeterTimer::UpdateActive()
+{
+	// Nothing is repainted while no meter is visible, for example when
+	// the mixer dock is hidden.
+	bool visible = false;
+	for (VolumeMeter *meter : volumeMeters) {
+		if (meter->isVisible()) {
+			visible = true;
+			break;
+		}
+	}
+
+	if (visible && !isActive())
+		start(34);
+	else if (!visible && isActive())
+		stop();
 }
 
 void VolumeMeterTimer::timerEvent(QTimerEvent *)
 {
-	for (VolumeMeter *meter : volumeMeters)
-		meter->update();
+	uint64_t ts = os_gettime_ns();
+
+	for (VolumeMeter *meter : volumeMeters) {
+		if (meter->isVisible())
+			meter->refresh(ts);
+	}
 }
@@ -7,6 +7,8 @@
 #include <QTimer>
 #include <QMutex>
 #include <QList>
+#include <QPixmap>
+#include <atomic>
 #include "frontend-api.h"
 #include "PLSDpiHelper.h"
 
@@ -52,18 +54,45 @@ private:
 	static QWeakPointer<VolumeMeterTimer> updateTimer;
 	QSharedPointer<VolumeMeterTimer> updateTimerRef;
 
+	// What a bar was last painted with, a bar is only painted again
+	// when one of these changes.
+	struct BarState {
+		int magnitudePosition = 0;
+		int peakPosition = 0;
+		int peakHoldPosition = 0;
+		QRgb inputColor = 0;
+		bool idle = false;
+
+		inline bool operator==(const BarState &other) const
+		{
+			return magnitudePosition == other.magnitudePosition && peakPosition == other.peakPosition && peakHoldPosition == other.peakHoldPosition &&
+			       inputColor == other.inputColor && idle == other.idle;
+		}
+		inline bool operator!=(const BarState &other) const { return !(*this == other); }
+	};
+
 	inline void resetLevels();
+	inline void consumeLevels();
 	inline void handleChannelCofigurationChange(double dpi, bool dpiChanged = false);
 	inline bool detectIdle(uint64_t ts);
 	inline void calculateBallistics(uint64_t ts, qreal timeSinceLastRedraw = 0.0);
 	inline void calculateBallisticsForChannel(int channelNr, uint64_t ts, qreal timeSinceLastRedraw);
 
+	QColor inputMeterColor(float peakHold) const;
+	BarState getBarState(int width, int channelNr, bool idle) const;
+	void paintBars(double dpi, bool idle);
 	void paintInputMeter(QPainter &painter, int x, int y, int width, int height, float peakHold);
 	void paintHMeter(QPainter &painter, int x, int y, int width, int height, float magnitude, float peak, float peakHold);
 
-	QMutex dataMutex;
+	// Written by the audio thread without locking, the peaks keep their
+	// maximum until the next refresh takes them.
+	std::atomic<uint64_t> currentLastUpdateTime{0};
+	std::atomic<uint32_t> levelsSequence{0};
+	std::atomic<float> pendingMagnitude[MAX_AUDIO_CHANNELS];
+	std::atomic<float> pendingPeak[MAX_AUDIO_CHANNELS];
+	std::atomic<float> pendingInputPeak[MAX_AUDIO_CHANNELS];
+	uint32_t consumedSequence = 0;
 
-	uint64_t currentLastUpdateTime = 0;
 	float currentMagnitude[MAX_AUDIO_CHANNELS];
 	float currentPeak[MAX_AUDIO_CHANNELS];
 	float currentInputPeak[MAX_AUDIO_CHANNELS];
@@ -77,6 +106,10 @@ private:
 	float displayInputPeakHold[MAX_AUDIO_CHANNELS];
 	uint64_t displayInputPeakHoldLastUpdateTime[MAX_AUDIO_CHANNELS];
 
+	QPixmap barCache;
+	bool barCacheDirty = true;
+	BarState paintedBars[MAX_AUDIO_CHANNELS];
+
 	QFont tickFont;
 	QColor backgroundNominalColor;
 	QColor backgroundWarningColor;
@@ -108,6 +141,7 @@ public:
 	~VolumeMeter();
 
 	void setLevels(const float magnitude[MAX_AUDIO_CHANNELS], const float peak[MAX_AUDIO_CHANNELS], const float inputPeak[MAX_AUDIO_CHANNELS]);
+	void refresh(uint64_t ts);
 
 	QColor getBackgroundNominalColor() const;
 	void setBackgroundNominalColor(QColor c);
@@ -153,8 +187,13 @@ public:
 
 protected:
 	void paintEvent(QPaintEvent *event) override;
+	void showEvent(QShowEvent *event) override;
+	void hideEvent(QHideEvent *event) override;
+	void changeEvent(QEvent *event) override;
 };
 
+// Refreshes all meters from one timer, the repaints of the bars that changed
+// are batched into a single paint pass by Qt.
 class VolumeMeterTimer : public QTimer {
 	Q_OBJECT
 
@@ -164,6 +203,9 @@ public:
 	void AddVolControl(VolumeMeter *meter);
 	void RemoveVolControl(VolumeMeter *meter);
 
+public slots:
+	void UpdateActive();
+
 protected:
 	void timerEvent(QTimerEvent *event) override;
 	QList<VolumeMeter *> volumeMeters;
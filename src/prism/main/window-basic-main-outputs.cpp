@@ -908,6 +908,8 @@ bool SimpleOutput::ConfigureRecording(bool updateReplayBuffer)
 	bool noSpace = config_get_bool(main->Config(), "SimpleOutput", "FileNameWithoutSpace");
 	const char *filenameFormat = config_get_string(main->Config(), "Output", "FilenameFormatting");
 	bool overwriteIfExists = config_get_bool(main->Config(), "Output", "OverwriteIfExists");
+	bool fragmented = config_get_bool(main->Config(), "Output", "FragmentedMP4");
+	int fragmentDuration = config_get_int(main->Config(), "Output", "FragmentDuration");
 	const char *rbPrefix = config_get_string(main->Config(), "SimpleOutput", "RecRBPrefix");
 	const char *rbSuffix = config_get_string(main->Config(), "SimpleOutput", "RecRBSuffix");
 	int rbTime = config_get_int(main->Config(), "SimpleOutput", "RecRBTime");
@@ -968,6 +970,8 @@ bool SimpleOutput::ConfigureRecording(bool updateReplayBuffer)
 	}
 
 	obs_data_set_string(settings, "muxer_settings", mux);
+	obs_data_set_bool(settings, "fragmented_mp4", fragmented);
+	obs_data_set_int(settings, "fragment_duration_ms", fragmentDuration);
 
 	if (updateReplayBuffer)
 		obs_output_update(replayBuffer, settings);
@@ -1334,6 +1338,8 @@ inline void AdvancedOutput::SetupRecording()
 
 	obs_data_set_string(settings, "path", path);
 	obs_data_set_string(settings, "muxer_settings", mux);
+	obs_data_set_bool(settings, "fragmented_mp4", config_get_bool(main->Config(), "Output", "FragmentedMP4"));
+	obs_data_set_int(settings, "fragment_duration_ms", config_get_int(main->Config(), "Output", "FragmentDuration"));
 	obs_output_update(fileOutput, settings);
 	if (replayBuffer)
 		obs_output_update(replayBuffer, settings);
@@ -1364,6 +1370,8 @@ inline void AdvancedOutput::SetupFFmpeg()
 	obs_data_set_string(settings, "format_name", formatName);
 	obs_data_set_string(settings, "format_mime_type", mimeType);
 	obs_data_set_string(settings, "muxer_settings", muxCustom);
+	obs_data_set_bool(settings, "fragmented_mp4", config_get_bool(main->Config(), "Output", "FragmentedMP4"));
+	obs_data_set_int(settings, "fragment_duration_ms", config_get_int(main->Config(), "Output", "FragmentDuration"));
 	obs_data_set_int(settings, "gop_size", gopSize);
 	obs_data_set_int(settings, "video_bitrate", vBitrate);
 	obs_data_set_string(settings, "video_encoder", vEncoder);
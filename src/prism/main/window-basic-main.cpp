@@ -695,11 +695,10 @@ static void SaveAudioDevice(const char *name, int channel, obs_data_t *parent, v
 }
 
 static obs_data_t *GenerateSaveData(obs_data_array_t *sceneOrder, int transitionDuration, obs_data_array_t *transitions, OBSScene &scene, OBSSource &curProgramScene,
-				    obs_data_array_t *savedProjectorList, obs_data_t *beautyConfigObj)
+				    obs_data_array_t *savedProjectorList, obs_data_t *beautyConfigObj, vector<OBSSource> &audioSources)
 {
 	obs_data_t *saveData = obs_data_create();
 
-	vector<OBSSource> audioSources;
 	audioSources.reserve(5);
 
 	SaveAudioDevice(DESKTOP_AUDIO_1, 1, saveData, audioSources);
@@ -709,27 +708,8 @@ static obs_data_t *GenerateSaveData(obs_data_array_t *sceneOrder, int transition
 	SaveAudioDevice(AUX_AUDIO_3, 5, saveData, audioSources);
 	SaveAudioDevice(AUX_AUDIO_4, 6, saveData, audioSources);
 
-	/* -------------------------------- */
-	/* save non-group sources           */
-
-	auto FilterAudioSources = [&](obs_source_t *source) {
-		if (obs_source_is_group(source))
-			return false;
-
-		return find(begin(audioSources), end(audioSources), source) == end(audioSources);
-	};
-	using FilterAudioSources_t = decltype(FilterAudioSources);
-
-	obs_data_array_t *sourcesArray =
-		obs_save_sources_filtered([](void *data, obs_source_t *source) { return (*static_cast<FilterAudioSources_t *>(data))(source); }, static_cast<void *>(&FilterAudioSources));
-
-	/* -------------------------------- */
-	/* save group sources separately    */
-
-	/* saving separately ensures they won't be loaded in older versions */
-	obs_data_array_t *groupsArray = obs_save_sources_filtered([](void *, obs_source_t *source) { return obs_source_is_group(source); }, nullptr);
-
-	/* -------------------------------- */
+	/* the "sources" and "groups" arrays are added by sceneSaver, groups
+	 * are saved separately so they won't be loaded in older versions */
 
 	obs_source_t *transition = obs_get_output_source(0);
 	obs_source_t *currentScene = obs_scene_get_source(scene);
@@ -742,13 +722,9 @@ static obs_data_t *GenerateSaveData(obs_data_array_t *sceneOrder, int transition
 	obs_data_set_string(saveData, "current_program_scene", programName);
 	obs_data_set_array(saveData, "scene_order", sceneOrder);
 	obs_data_set_string(saveData, "name", sceneCollection);
-	obs_data_set_array(saveData, "sources", sourcesArray);
-	obs_data_set_array(saveData, "groups", groupsArray);
 	obs_data_set_array(saveData, "transitions", transitions);
 	obs_data_set_array(saveData, "saved_projectors", savedProjectorList);
 	obs_data_set_obj(saveData, "beauty_config", beautyConfigObj);
-	obs_data_array_release(sourcesArray);
-	obs_data_array_release(groupsArray);
 
 	obs_data_set_string(saveData, "current_transition", obs_source_get_name(transition));
 	obs_data_set_int(saveData, "transition_duration", transitionDuration);
@@ -868,7 +844,7 @@ obs_data_array_t *PLSBasic::SaveProjectors()
 	return savedProjectors;
 }
 
-void PLSBasic::Save(const char *file)
+void PLSBasic::Save(const char *file, bool full)
 {
 	OBSScene scene = GetCurrentScene();
 	OBSSource curProgramScene = OBSGetStrongRef(programScene);
@@ -879,7 +855,9 @@ void PLSBasic::Save(const char *file)
 	obs_data_array_t *transitions = ui->scenesFrame->SaveTransitions();
 	obs_data_array_t *savedProjectorList = SaveProjectors();
 	obs_data_t *beautyConfigObj = SaveBeautyConfig();
-	obs_data_t *saveData = GenerateSaveData(sceneOrder, ui->scenesFrame->GetTransitionDurationValue(), transitions, scene, curProgramScene, savedProjectorList, beautyConfigObj);
+	vector<OBSSource> audioSources;
+	obs_data_t *saveData = GenerateSaveData(sceneOrder, ui->scenesFrame->GetTransitionDurationValue(), transitions, scene, curProgramScene, savedProjectorList, beautyConfigObj,
+						audioSources);
 
 	obs_data_set_bool(saveData, "preview_locked", ui->preview->Locked());
 	obs_data_set_bool(saveData, "scaling_enabled", ui->preview->IsFixedScaling());
@@ -895,8 +873,7 @@ void PLSBasic::Save(const char *file)
 		obs_data_release(moduleObj);
 	}
 
-	if (!obs_data_save_json_safe(saveData, file, "tmp", "bak"))
-		blog(LOG_ERROR, "Could not save scene data to %s", file);
+	sceneSaver.Save(file, saveData, audioSources, full);
 
 	obs_data_release(saveData);
 	obs_data_array_release(sceneOrder);
@@ -1628,6 +1605,9 @@ bool PLSBasic::InitBasicConfigDefaults()
 
 	config_set_default_string(basicConfig, "Output", "FilenameFormatting", "%CCYY-%MM-%DD %hh-%mm-%ss");
 
+	config_set_default_bool(basicConfig, "Output", "FragmentedMP4", false);
+	config_set_default_uint(basicConfig, "Output", "FragmentDuration", 2000);
+
 	config_set_default_bool(basicConfig, "Output", "DelayEnable", false);
 	config_set_default_uint(basicConfig, "Output", "DelaySec", 20);
 	config_set_default_bool(basicConfig, "Output", "DelayPreserve", true);
@@ -2581,7 +2561,8 @@ void PLSBasic::SaveProjectNow()
 		return;
 
 	projectChanged = true;
-	SaveProjectDeferred();
+	SaveProjectInternal(true);
+	sceneSaver.Flush();
 }
 
 void PLSBasic::SaveProject()
@@ -2594,6 +2575,11 @@ void PLSBasic::SaveProject()
 }
 
 void PLSBasic::SaveProjectDeferred()
+{
+	SaveProjectInternal(false);
+}
+
+void PLSBasic::SaveProjectInternal(bool full)
 {
 	if (disableSaving)
 		return;
@@ -2619,7 +2605,7 @@ void PLSBasic::SaveProjectDeferred()
 	if (ret <= 0)
 		return;
 
-	Save(savePath);
+	Save(savePath, full);
 }
 
 void PLSBasic::resetWindowGeometry(QWidget *loginView, const QPoint prismLoginViewCenterPoint)
@@ -4099,7 +4085,7 @@ void PLSBasic::RenderMain(void *data, uint32_t cx, uint32_t cy)
 		if (source)
 			obs_source_video_render(source);
 	} else {
-		obs_render_main_texture_src_color_only();
+		obs_render_main_texture_scaled_src_color_only(uint32_t(window->previewCX), uint32_t(window->previewCY));
 	}
 	gs_load_vertexbuffer(nullptr);
 
@@ -4560,6 +4546,7 @@ void PLSBasic::ClearSceneData()
 	blog(LOG_INFO, "%sclear scene data.", TRACE_INPUT_SOURCE);
 
 	disableSaving++;
+	sceneSaver.Clear();
 
 	CloseDialogs();
 
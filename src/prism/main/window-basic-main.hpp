@@ -33,6 +33,7 @@
 #include "window-projector.hpp"
 #include "window-basic-about.hpp"
 #include "auth-base.hpp"
+#include "PLSSceneCollectionSaver.h"
 
 #include <frontend-internal.hpp>
 
@@ -188,6 +189,7 @@ private:
 	bool loaded = false;
 	long disableSaving = 1;
 	bool projectChanged = false;
+	PLSSceneCollectionSaver sceneSaver;
 	bool previewEnabled = true;
 	bool isSelected = false;
 	bool isCopyScene = false;
@@ -309,7 +311,8 @@ private:
 	void UpdateVolumeControlsPeakMeterType();
 	void ClearVolumeControls();
 
-	void Save(const char *file);
+	void Save(const char *file, bool full);
+	void SaveProjectInternal(bool full);
 	void Load(const char *file);
 
 	void InitHotkeys();
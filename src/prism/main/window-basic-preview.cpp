@@ -25,6 +25,7 @@ PLSBasicPreview::PLSBasicPreview(QWidget *parent, Qt::WindowFlags flags) : PLSQT
 {
 	ResetScrollingOffset();
 	setMouseTracking(true);
+	SetRenderThrottling(true, true);
 }
 
 PLSBasicPreview::~PLSBasicPreview()
@@ -22,6 +22,9 @@ PLSProjector::PLSProjector(QWidget *widget, obs_source_t *source_, int monitor,
 	setMouseTracking(true);
 	setCursor(Qt::ArrowCursor);
 
+	// projectors feed screens and capture cards, only stop them while hidden
+	SetRenderThrottling(false, false);
+
 	projectorTitle = std::move(title);
 	savedMonitor = monitor;
 	isWindow = savedMonitor < 0;
@@ -566,7 +569,7 @@ void PLSProjector::PLSRenderMultiview(void *data, uint32_t cx, uint32_t cy)
 	if (studioMode)
 		obs_source_video_render(previewSrc);
 	else
-		obs_render_main_texture();
+		obs_render_main_texture_scaled(uint32_t(window->ppiCX), uint32_t(window->ppiCY));
 	if (drawSafeArea) {
 		renderVB(window->actionSafeMargin, targetCX, targetCY, outerColor);
 		renderVB(window->graphicsSafeMargin, targetCX, targetCY, outerColor);
@@ -604,7 +607,7 @@ void PLSProjector::PLSRenderMultiview(void *data, uint32_t cx, uint32_t cy)
 	gs_matrix_translate3f(window->sourceX, window->sourceY, 0.0f);
 	gs_matrix_scale3f(window->ppiScaleX, window->ppiScaleY, 1.0f);
 	setRegion(window->sourceX, window->sourceY, window->ppiCX, window->ppiCY);
-	obs_render_main_texture();
+	obs_render_main_texture_scaled(uint32_t(window->ppiCX), uint32_t(window->ppiCY));
 	endRegion();
 	gs_matrix_pop();
 
@@ -679,7 +682,7 @@ void PLSProjector::PLSRender(void *data, uint32_t cx, uint32_t cy)
 	if (source)
 		obs_source_video_render(source);
 	else
-		obs_render_main_texture();
+		obs_render_main_texture_scaled(uint32_t(newCX), uint32_t(newCY));
 
 	endRegion();
 }